@@ -207,8 +207,7 @@ public:
 
             index_t  m256_frame_size = (int)m_y.GetFrameStride() / 32;
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         __m256i *y_addr = (__m256i *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -232,23 +231,24 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_y;
         }
 #endif
 
         // float用実装
-        if ( DataType<FT>::type == BB_TYPE_FP32 ) {
+        static SimdKernel forward_kernel("AveragePooling::Forward", {SimdLevel::AVX2});
+        if ( DataType<FT>::type == BB_TYPE_FP32 && forward_kernel.Select() >= SimdLevel::AVX2 ) {
             auto x_ptr = m_x.LockConst<FT>();
             auto y_ptr = m_y.Lock<FT>(true);
 
             index_t  m256_frame_size = (int)m_y.GetFrameStride() / sizeof(float);
 
-            __m256   frac = _mm256_set1_ps(1.0f / (m_filter_h_size * m_filter_w_size));
+            float frac_val = 1.0f / (m_filter_h_size * m_filter_w_size);
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) BB_TARGET_AVX2 {
+                __m256 frac = _mm256_set1_ps(frac_val);
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float *y_addr = (float *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -275,7 +275,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_y;
         }
@@ -287,8 +287,7 @@ public:
 
             auto frame_size = m_x.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
@@ -309,7 +308,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_y;
         }
@@ -350,7 +349,8 @@ public:
         }
 #endif
 
-        if ( DataType<BT>::type == BB_TYPE_FP32 && DataType<FT>::type == BB_TYPE_FP32 ) {
+        static SimdKernel backward_kernel("AveragePooling::Backward", {SimdLevel::AVX2});
+        if ( DataType<BT>::type == BB_TYPE_FP32 && DataType<FT>::type == BB_TYPE_FP32 && backward_kernel.Select() >= SimdLevel::AVX2 ) {
             // float用実装
             index_t  m256_frame_size = m_dx.GetFrameStride() / sizeof(float);
 
@@ -361,10 +361,10 @@ public:
             auto dy_ptr = dy.LockConst<BT>();
             auto dx_ptr = m_dx.Lock<BT>(true);
 
-            __m256   frac = _mm256_set1_ps(1.0f / (m_filter_h_size * m_filter_w_size));
+            float frac_val = 1.0f / (m_filter_h_size * m_filter_w_size);
 
-    #pragma omp parallel for
-            for (index_t n = 0; n < m_input_c_size; ++n) {
+            ParallelFor(0, m_input_c_size, [&](index_t n) BB_TARGET_AVX2 {
+                __m256 frac = _mm256_set1_ps(frac_val);
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float const * y_addr  = (float const *)y_ptr.GetAddr(GetOutputNode(n, y, x));
@@ -382,7 +382,7 @@ public:
                                         if ( ix < m_input_w_size ) {
                                             float       *dx_addr = (float *)dx_ptr.GetAddr(GetInputNode(n, iy, ix));
                                             __m256 dx = _mm256_load_ps(&dx_addr[frame]);
-                                            __m256 dx = _mm256_add_ps(dx, in_grad);
+                                            dx = _mm256_add_ps(dx, in_grad);
                                             _mm256_store_ps(&dx_addr[frame], dx);
                                         }
                                     }
@@ -391,7 +391,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_dx;
         }
@@ -407,8 +407,7 @@ public:
 
             auto frame_size = m_x.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
@@ -428,7 +427,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_dx;
         }
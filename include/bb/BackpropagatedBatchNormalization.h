@@ -255,8 +255,7 @@ public:
             auto dy_ptr          = dy_buf.LockConst<T>();
             auto dx_ptr          = dx_buf.Lock<T>(true);
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 T mean = 0;
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     mean += x_ptr.Get(frame, node);
@@ -279,7 +278,7 @@ public:
                     auto dy = dy_ptr.Get(frame, node);
                     dx_ptr.Set(frame, node, dy + (x - t) * m_gain);
                 }
-            }
+            });
 
             // ゲイン減衰
             m_gain *= m_beta;
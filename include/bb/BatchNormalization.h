@@ -308,6 +308,23 @@ public:
     }
     
 
+    bool IsBypass(void) const { return m_bypass; }
+
+    // 推論時の y = gain * x + offset の係数
+    T GetNormalizeGain(index_t node) const
+    {
+        auto gamma_ptr = lock_gamma_const();
+        auto var_ptr   = m_running_var.LockConst();
+        return gamma_ptr(node) / (std::sqrt(var_ptr(node)) + (T)1.0e-7);
+    }
+
+    T GetNormalizeOffset(index_t node) const
+    {
+        auto beta_ptr = lock_beta_const();
+        auto mean_ptr = m_running_mean.LockConst();
+        return beta_ptr(node) - GetNormalizeGain(node) * mean_ptr(node);
+    }
+
     // ノード単位でのForward計算
     std::vector<double> ForwardNode(index_t node, std::vector<double> x_vec) const
     {
@@ -331,6 +348,19 @@ public:
     void        SetFrameBufferX(FrameBuffer x_buf) { m_x_buf = x_buf; }
     FrameBuffer GetFrameBufferX(void)              { return m_x_buf; }
 
+    // ノードの並べ替え(前段の SparseLayer と揃える場合に使用)
+    void PermuteNodes(std::vector<index_t> const &order)
+    {
+        Tensor_PermuteRows(*m_gamma,  order);
+        Tensor_PermuteRows(*m_beta,   order);
+        Tensor_PermuteRows(*m_dgamma, order);
+        Tensor_PermuteRows(*m_dbeta,  order);
+        Tensor_PermuteRows(m_mean,         order);
+        Tensor_PermuteRows(m_rstd,         order);
+        Tensor_PermuteRows(m_running_mean, order);
+        Tensor_PermuteRows(m_running_var,  order);
+    }
+
     /**
      * @brief  forward演算
      * @detail forward演算を行う
@@ -345,70 +375,51 @@ public:
             return x_buf;
         }
 
+        // 推論時はモデルを変更しない
+        if ( !train ) {
+            InferenceContext ctx;
+            return Forward(x_buf, ctx);
+        }
+
         // 出力設定
         FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), x_buf.GetType());
 
         // backwardの為に保存
-        if ( train ) {
-            m_x_buf = x_buf;
-        }
+        m_x_buf = x_buf;
         
 #ifdef BB_WITH_CUDA
         if ( DataType<T>::type == BB_TYPE_FP32 && !m_host_only && x_buf.IsDeviceAvailable() && y_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
-            if ( train ) {
-                auto dev_x_ptr     = x_buf.LockDeviceMemoryConst();
-                auto dev_y_ptr     = y_buf.LockDeviceMemory(true);
-                auto dev_gamma_ptr = m_gamma->LockDeviceMemoryConst();
-                auto dev_beta_ptr  = m_beta->LockDeviceMemoryConst();
-                auto dev_mean_ptr = m_mean.LockDeviceMemory(true);
-                auto dev_rstd_ptr = m_rstd.LockDeviceMemory(true);
-                auto dev_running_mean_ptr = m_running_mean.LockDeviceMemory();
-                auto dev_running_var_ptr = m_running_var.LockDeviceMemory();
-
-                bbcu_fp32_BatchNormalization_ForwardTraining
-                    (
-                        (float const *)dev_x_ptr.GetAddr(),
-                        (float       *)dev_y_ptr.GetAddr(),
-                        (float const *)dev_gamma_ptr.GetAddr(),
-                        (float const *)dev_beta_ptr.GetAddr(),
-                        (float       *)dev_mean_ptr.GetAddr(),
-                        (float       *)dev_rstd_ptr.GetAddr(),
-                        (float       *)dev_running_mean_ptr.GetAddr(),
-                        (float       *)dev_running_var_ptr.GetAddr(),
-                        (float        )m_momentum,
-                        (int          )x_buf.GetNodeSize(),
-                        (int          )x_buf.GetFrameSize(),
-                        (int          )x_buf.GetFrameStride() / sizeof(float)
-                    );
-                return y_buf;
-            }
-            else {
-                auto dev_x_ptr            = x_buf.LockDeviceMemoryConst();
-                auto dev_y_ptr            = y_buf.LockDeviceMemory(true);
-                auto dev_gamma_ptr        = m_gamma->LockDeviceMemoryConst();
-                auto dev_beta_ptr         = m_beta->LockDeviceMemoryConst();
-                auto dev_running_mean_ptr = m_running_mean.LockDeviceMemoryConst();
-                auto dev_running_var_ptr  = m_running_var.LockDeviceMemoryConst();
-
-                bbcu_fp32_BatchNormalization_ForwardInference
-                    (
-                        (float const *)dev_x_ptr.GetAddr(),
-                        (float       *)dev_y_ptr.GetAddr(),
-                        (float const *)dev_gamma_ptr.GetAddr(),
-                        (float const *)dev_beta_ptr.GetAddr(),
-                        (float       *)dev_running_mean_ptr.GetAddr(),
-                        (float       *)dev_running_var_ptr.GetAddr(),
-                        (int          )x_buf.GetNodeSize(),
-                        (int          )x_buf.GetFrameSize(),
-                        (int          )x_buf.GetFrameStride() / sizeof(float)
-                    );
-                return y_buf;
-            }
+            auto dev_x_ptr     = x_buf.LockDeviceMemoryConst();
+            auto dev_y_ptr     = y_buf.LockDeviceMemory(true);
+            auto dev_gamma_ptr = m_gamma->LockDeviceMemoryConst();
+            auto dev_beta_ptr  = m_beta->LockDeviceMemoryConst();
+            auto dev_mean_ptr = m_mean.LockDeviceMemory(true);
+            auto dev_rstd_ptr = m_rstd.LockDeviceMemory(true);
+            auto dev_running_mean_ptr = m_running_mean.LockDeviceMemory();
+            auto dev_running_var_ptr = m_running_var.LockDeviceMemory();
+
+            bbcu_fp32_BatchNormalization_ForwardTraining
+                (
+                    (float const *)dev_x_ptr.GetAddr(),
+                    (float       *)dev_y_ptr.GetAddr(),
+                    (float const *)dev_gamma_ptr.GetAddr(),
+                    (float const *)dev_beta_ptr.GetAddr(),
+                    (float       *)dev_mean_ptr.GetAddr(),
+                    (float       *)dev_rstd_ptr.GetAddr(),
+                    (float       *)dev_running_mean_ptr.GetAddr(),
+                    (float       *)dev_running_var_ptr.GetAddr(),
+                    (float        )m_momentum,
+                    (int          )x_buf.GetNodeSize(),
+                    (int          )x_buf.GetFrameSize(),
+                    (int          )x_buf.GetFrameStride() / sizeof(float)
+                );
+            return y_buf;
         }
 #endif
 
 
-        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd ) {
+        static SimdKernel forward_kernel("BatchNormalization::Forward", {SimdLevel::AVX2});
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && forward_kernel.Select() >= SimdLevel::AVX2 ) {
             // SIMD版
             auto node_size    = x_buf.GetNodeSize();
             auto frame_size   = x_buf.GetFrameSize();
@@ -427,84 +438,66 @@ public:
             auto running_mean_ptr = m_running_mean.Lock();
             auto running_var_ptr  = m_running_var.Lock();
 
-            if (train) {
+            ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
                 const __m256    reciprocal_frame_size = _mm256_set1_ps(1.0f / (float)frame_size);
                 const __m256    epsilon = _mm256_set1_ps(1.0e-7f);
 
-                #pragma omp parallel for
-                for (int node = 0; node < (int)node_size; ++node) {
-                    float const *x_addr = x_ptr.GetAddr(node);
-                    float       *y_addr = y_ptr.GetAddr(node);
-
-                    // 平均と分散計算
-                    __m256 mean_sum = _mm256_set1_ps(0.0f);
-                    __m256 mean_c   = _mm256_set1_ps(0.0f);
-                    __m256 var_sum  = _mm256_set1_ps(0.0f);
-                    __m256 var_c    = _mm256_set1_ps(0.0f);
-                    for ( int frame = 0; frame < mm256_frame_size; frame += 8) {
-                        __m256 x = _mm256_load_ps(&x_addr[frame + 0]);
-                        __m256 mean_y = _mm256_sub_ps(x, mean_c);
-                        __m256 mean_t = _mm256_add_ps(mean_sum, mean_y);
-                               mean_c = _mm256_sub_ps(_mm256_sub_ps(mean_t, mean_sum), mean_y);
-                        mean_sum = mean_t;
-
-                        __m256 var_y = _mm256_fmsub_ps(x, x, var_c);
-                        __m256 var_t = _mm256_add_ps(var_sum, var_y);
-                               var_c = _mm256_sub_ps(_mm256_sub_ps(var_t, var_sum), var_y);
-                        var_sum = var_t;
-                    }
-                    __m256 mean = _mm256_mul_ps(bb_mm256_hsum_ps(mean_sum), reciprocal_frame_size);
-                    __m256 var = _mm256_fmsub_ps(bb_mm256_hsum_ps(var_sum), reciprocal_frame_size, _mm256_mul_ps(mean, mean));
-                    var = _mm256_max_ps(var, _mm256_set1_ps(0.0f)); // 誤差対策(負にならないようにクリップ)
-
-                    __m256 varx = _mm256_max_ps(var, epsilon);
-                    __m256 rstd = _mm256_rsqrt_ps(varx);
-
-                    varx = _mm256_mul_ps(varx, _mm256_set1_ps(0.5f));
-                    rstd = _mm256_mul_ps(rstd, _mm256_fnmadd_ps(varx, _mm256_mul_ps(rstd, rstd), _mm256_set1_ps(1.5f)));
-                    rstd = _mm256_mul_ps(rstd, _mm256_fnmadd_ps(varx, _mm256_mul_ps(rstd, rstd), _mm256_set1_ps(1.5f)));
-
-                    // 実行時の mean と var 保存
-                    running_mean_ptr[node] = running_mean_ptr[node] * m_momentum + bb_mm256_cvtss_f32(mean) * (1.0f - m_momentum);
-                    running_var_ptr[node]  = running_var_ptr[node]  * m_momentum + bb_mm256_cvtss_f32(var)  * (1.0f - m_momentum);
-                    
-                    // 結果の保存
-                    mean_ptr[node] = bb_mm256_cvtss_f32(mean);
-                    rstd_ptr[node] = bb_mm256_cvtss_f32(rstd);
-
-                    // 正規化 と gamma/beta 処理
-                    __m256 gamma = _mm256_set1_ps(gamma_ptr[node]);
-                    __m256 beta = _mm256_set1_ps(beta_ptr[node]);
-    //              for (int frame = 0; frame < mm256_frame_size; frame += 8) {
-                    for (int frame = mm256_frame_size-8; frame >= 0; frame -= 8) {
-                    __m256 x = _mm256_load_ps(&x_addr[frame]);
-                        __m256 xn = _mm256_mul_ps(_mm256_sub_ps(x, mean), rstd);
-                        __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
-                        _mm256_store_ps(&y_addr[frame], y);
-                    }
+                // 末尾ブロックのフレーム外(パディング)は集計に含めない
+                const __m256    tail_mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(
+                                                _mm256_set1_epi32((int)frame_size - (mm256_frame_size - 8)),
+                                                _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+                float const *x_addr = x_ptr.GetAddr(node);
+                float       *y_addr = y_ptr.GetAddr(node);
+
+                // 平均と分散計算
+                __m256 mean_sum = _mm256_set1_ps(0.0f);
+                __m256 mean_c   = _mm256_set1_ps(0.0f);
+                __m256 var_sum  = _mm256_set1_ps(0.0f);
+                __m256 var_c    = _mm256_set1_ps(0.0f);
+                for ( int frame = 0; frame < mm256_frame_size; frame += 8) {
+                    __m256 x = _mm256_load_ps(&x_addr[frame + 0]);
+                    if ( frame + 8 > frame_size ) { x = _mm256_and_ps(x, tail_mask); }
+                    __m256 mean_y = _mm256_sub_ps(x, mean_c);
+                    __m256 mean_t = _mm256_add_ps(mean_sum, mean_y);
+                           mean_c = _mm256_sub_ps(_mm256_sub_ps(mean_t, mean_sum), mean_y);
+                    mean_sum = mean_t;
+
+                    __m256 var_y = _mm256_fmsub_ps(x, x, var_c);
+                    __m256 var_t = _mm256_add_ps(var_sum, var_y);
+                           var_c = _mm256_sub_ps(_mm256_sub_ps(var_t, var_sum), var_y);
+                    var_sum = var_t;
                 }
-            }
-            else {
-                #pragma omp parallel for
-                for (int node = 0; node < (int)node_size; ++node) {
-                    auto x_addr = x_ptr.GetAddr(node);
-                    auto y_addr = y_ptr.GetAddr(node);
-
-                    __m256 running_mean = _mm256_set1_ps(running_mean_ptr[node]);
-                    __m256 running_var = _mm256_set1_ps(1.0f / (sqrt(running_var_ptr[node]) + 1.0e-7f));
-
-                    __m256 gamma = _mm256_set1_ps(gamma_ptr[node]);
-                    __m256 beta = _mm256_set1_ps(beta_ptr[node]);
-
-                    for (int frame = 0; frame < mm256_frame_size; frame += 8) {
-                        __m256 x = _mm256_load_ps(&x_addr[frame]);
-                        __m256 xc = _mm256_sub_ps(x, running_mean);
-                        __m256 xn = _mm256_mul_ps(xc, running_var);
-                        __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
-                        _mm256_store_ps(&y_addr[frame], y);
-                    }
+                __m256 mean = _mm256_mul_ps(bb_mm256_hsum_ps(mean_sum), reciprocal_frame_size);
+                __m256 var = _mm256_fmsub_ps(bb_mm256_hsum_ps(var_sum), reciprocal_frame_size, _mm256_mul_ps(mean, mean));
+                var = _mm256_max_ps(var, _mm256_set1_ps(0.0f)); // 誤差対策(負にならないようにクリップ)
+
+                __m256 varx = _mm256_max_ps(var, epsilon);
+                __m256 rstd = _mm256_rsqrt_ps(varx);
+
+                varx = _mm256_mul_ps(varx, _mm256_set1_ps(0.5f));
+                rstd = _mm256_mul_ps(rstd, _mm256_fnmadd_ps(varx, _mm256_mul_ps(rstd, rstd), _mm256_set1_ps(1.5f)));
+                rstd = _mm256_mul_ps(rstd, _mm256_fnmadd_ps(varx, _mm256_mul_ps(rstd, rstd), _mm256_set1_ps(1.5f)));
+
+                // 実行時の mean と var 保存
+                running_mean_ptr[node] = running_mean_ptr[node] * m_momentum + bb_mm256_cvtss_f32(mean) * (1.0f - m_momentum);
+                running_var_ptr[node]  = running_var_ptr[node]  * m_momentum + bb_mm256_cvtss_f32(var)  * (1.0f - m_momentum);
+
+                // 結果の保存
+                mean_ptr[node] = bb_mm256_cvtss_f32(mean);
+                rstd_ptr[node] = bb_mm256_cvtss_f32(rstd);
+
+                // 正規化 と gamma/beta 処理
+                __m256 gamma = _mm256_set1_ps(gamma_ptr[node]);
+                __m256 beta = _mm256_set1_ps(beta_ptr[node]);
+//              for (int frame = 0; frame < mm256_frame_size; frame += 8) {
+                for (int frame = mm256_frame_size-8; frame >= 0; frame -= 8) {
+                __m256 x = _mm256_load_ps(&x_addr[frame]);
+                    __m256 xn = _mm256_mul_ps(_mm256_sub_ps(x, mean), rstd);
+                    __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
+                    _mm256_store_ps(&y_addr[frame], y);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -525,66 +518,47 @@ public:
             auto running_mean_ptr = m_running_mean.Lock();
             auto running_var_ptr  = m_running_var.Lock();
 
-            if ( train ) {
-                #pragma omp parallel for
-                for (index_t node = 0; node < node_size; ++node) {
-                    // カハンの加算アルゴリズム(Kahan summation algorithm) [意味があるかは分からないが、どうせバス律速だろうからついで]
-                    T s1 = 0, c1 = 0, y1, t1;
-                    T s2 = 0, c2 = 0, y2, t2;
-                    for ( index_t frame = 0; frame < frame_size; ++frame) {
-                        T x = x_ptr.Get(frame, node);
-
-                        y1 = x - c1;
-                        t1 = s1 + y1;
-                        c1 = (t1 - s1) - y1;
-                        s1 = t1;
-
-                        y2 = (x * x) - c2;
-                        t2 = s2 + y2;
-                        c2 = (t2 - s2) - y2;
-                        s2 = t2;
-                    }
+            ParallelFor(0, node_size, [&](index_t node) {
+                // カハンの加算アルゴリズム(Kahan summation algorithm) [意味があるかは分からないが、どうせバス律速だろうからついで]
+                T s1 = 0, c1 = 0, y1, t1;
+                T s2 = 0, c2 = 0, y2, t2;
+                for ( index_t frame = 0; frame < frame_size; ++frame) {
+                    T x = x_ptr.Get(frame, node);
 
-                    // 集計
-                    T mean = s1 / (T)frame_size;
-                    T var  = (s2 / (T)frame_size) - (mean * mean);
-                    var = std::max((T)0, var);  // 演算誤差で負にならないようにクリップ  // 演算誤差で負にならないようにクリップ
-                    T std  = std::sqrt(var);
-                    T rstd = (T)1.0 / (std + (T)1.0e-7);
-
-                    running_mean_ptr[node] = (running_mean_ptr[node] * m_momentum) + (mean * ((T)1.0 - m_momentum));
-                    running_var_ptr[node]  = (running_var_ptr[node]  * m_momentum) + (var *  ((T)1.0 - m_momentum));
-                    
-                    mean_ptr[node] = mean;
-                    rstd_ptr[node] = rstd;
-
-                    // 正規化
-                    T   gamma = gamma_ptr[node];
-                    T   beta  = beta_ptr[node];
-                    for ( index_t frame = 0; frame < frame_size; ++frame) {
-                        T x = x_ptr.Get(frame, node);
-                        x = (x - mean) * rstd;
-                        x = x * gamma + beta;
-                        y_ptr.Set(frame, node, x);
-                    }
+                    y1 = x - c1;
+                    t1 = s1 + y1;
+                    c1 = (t1 - s1) - y1;
+                    s1 = t1;
+
+                    y2 = (x * x) - c2;
+                    t2 = s2 + y2;
+                    c2 = (t2 - s2) - y2;
+                    s2 = t2;
                 }
-            }
-            else {
-                #pragma omp parallel for
-                for (index_t node = 0; node < node_size; ++node) {
-                    T   gamma = gamma_ptr[node];
-                    T   beta  = beta_ptr[node];
-                    T   mean  = running_mean_ptr[node];
-                    T   var   = running_var_ptr[node];
-
-                    T   rstd  = (T)1.0 / (std::sqrt(var) + (T)1.0e-7);
-
-                    for ( index_t frame = 0; frame < frame_size; ++frame) {
-                        T x = x_ptr.Get(frame, node);
-                        y_ptr.Set(frame, node, ((x - mean) * rstd) * gamma + beta);
-                    }
+
+                // 集計
+                T mean = s1 / (T)frame_size;
+                T var  = (s2 / (T)frame_size) - (mean * mean);
+                var = std::max((T)0, var);  // 演算誤差で負にならないようにクリップ  // 演算誤差で負にならないようにクリップ
+                T std  = std::sqrt(var);
+                T rstd = (T)1.0 / (std + (T)1.0e-7);
+
+                running_mean_ptr[node] = (running_mean_ptr[node] * m_momentum) + (mean * ((T)1.0 - m_momentum));
+                running_var_ptr[node]  = (running_var_ptr[node]  * m_momentum) + (var *  ((T)1.0 - m_momentum));
+
+                mean_ptr[node] = mean;
+                rstd_ptr[node] = rstd;
+
+                // 正規化
+                T   gamma = gamma_ptr[node];
+                T   beta  = beta_ptr[node];
+                for ( index_t frame = 0; frame < frame_size; ++frame) {
+                    T x = x_ptr.Get(frame, node);
+                    x = (x - mean) * rstd;
+                    x = x * gamma + beta;
+                    y_ptr.Set(frame, node, x);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -592,6 +566,120 @@ public:
     }
 
 
+    /**
+     * @brief  推論用forward演算
+     * @detail 実行時の平均と分散を読み出すだけでモデルを変更しない
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
+        // bypass
+        if (m_bypass) {
+            return x_buf;
+        }
+
+        // 出力設定
+        FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), x_buf.GetType());
+
+#ifdef BB_WITH_CUDA
+        if ( DataType<T>::type == BB_TYPE_FP32 && !m_host_only && x_buf.IsDeviceAvailable() && y_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
+            auto dev_x_ptr            = x_buf.LockDeviceMemoryConst();
+            auto dev_y_ptr            = y_buf.LockDeviceMemory(true);
+            auto dev_gamma_ptr        = m_gamma->LockDeviceMemoryConst();
+            auto dev_beta_ptr         = m_beta->LockDeviceMemoryConst();
+            auto dev_running_mean_ptr = m_running_mean.LockDeviceMemoryConst();
+            auto dev_running_var_ptr  = m_running_var.LockDeviceMemoryConst();
+
+            bbcu_fp32_BatchNormalization_ForwardInference
+                (
+                    (float const *)dev_x_ptr.GetAddr(),
+                    (float       *)dev_y_ptr.GetAddr(),
+                    (float const *)dev_gamma_ptr.GetAddr(),
+                    (float const *)dev_beta_ptr.GetAddr(),
+                    (float       *)dev_running_mean_ptr.GetAddr(),
+                    (float       *)dev_running_var_ptr.GetAddr(),
+                    (int          )x_buf.GetNodeSize(),
+                    (int          )x_buf.GetFrameSize(),
+                    (int          )x_buf.GetFrameStride() / sizeof(float)
+                );
+            return y_buf;
+        }
+#endif
+
+        static SimdKernel forward_kernel("BatchNormalization::ForwardInference", {SimdLevel::AVX2});
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && forward_kernel.Select() >= SimdLevel::AVX2 ) {
+            // SIMD版
+            auto node_size    = x_buf.GetNodeSize();
+            auto frame_size   = x_buf.GetFrameSize();
+
+            const int   mm256_frame_size = ((int)frame_size + 7) / 8 * 8;
+
+            auto x_ptr            = x_buf.LockConst<T>();
+            auto y_ptr            = y_buf.Lock<T>();
+
+            auto gamma_ptr        = lock_gamma_const();
+            auto beta_ptr         = lock_beta_const();
+
+            auto running_mean_ptr = m_running_mean.LockConst();
+            auto running_var_ptr  = m_running_var.LockConst();
+
+            ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
+                auto x_addr = x_ptr.GetAddr(node);
+                auto y_addr = y_ptr.GetAddr(node);
+
+                __m256 running_mean = _mm256_set1_ps(running_mean_ptr[node]);
+                __m256 running_var = _mm256_set1_ps(1.0f / (sqrt(running_var_ptr[node]) + 1.0e-7f));
+
+                __m256 gamma = _mm256_set1_ps(gamma_ptr[node]);
+                __m256 beta = _mm256_set1_ps(beta_ptr[node]);
+
+                for (int frame = 0; frame < mm256_frame_size; frame += 8) {
+                    __m256 x = _mm256_load_ps(&x_addr[frame]);
+                    __m256 xc = _mm256_sub_ps(x, running_mean);
+                    __m256 xn = _mm256_mul_ps(xc, running_var);
+                    __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
+                    _mm256_store_ps(&y_addr[frame], y);
+                }
+            });
+
+            return y_buf;
+        }
+
+        {
+            // 汎用版
+            auto node_size    = x_buf.GetNodeSize();
+            auto frame_size   = x_buf.GetFrameSize();
+
+            auto x_ptr            = x_buf.LockConst<T>();
+            auto y_ptr            = y_buf.Lock<T>();
+
+            auto gamma_ptr        = lock_gamma_const();
+            auto beta_ptr         = lock_beta_const();
+
+            auto running_mean_ptr = m_running_mean.LockConst();
+            auto running_var_ptr  = m_running_var.LockConst();
+
+            ParallelFor(0, node_size, [&](index_t node) {
+                T   gamma = gamma_ptr[node];
+                T   beta  = beta_ptr[node];
+                T   mean  = running_mean_ptr[node];
+                T   var   = running_var_ptr[node];
+
+                T   rstd  = (T)1.0 / (std::sqrt(var) + (T)1.0e-7);
+
+                for ( index_t frame = 0; frame < frame_size; ++frame) {
+                    T x = x_ptr.Get(frame, node);
+                    y_ptr.Set(frame, node, ((x - mean) * rstd) * gamma + beta);
+                }
+            });
+
+            return y_buf;
+        }
+    }
+
+
     // forward 再計算
     FrameBuffer ReForward(FrameBuffer x_buf)
     {
@@ -649,8 +737,7 @@ public:
             auto running_mean_ptr = m_running_mean.Lock();
             auto running_var_ptr  = m_running_var.Lock();
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 // 集計
                 T mean = mean_ptr[node];
                 T rstd = rstd_ptr[node];
@@ -664,7 +751,7 @@ public:
                     x = x * gamma + beta;
                     y_ptr.Set(frame, node, x);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -720,7 +807,8 @@ public:
         }
 #endif
 
-        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd ) {
+        static SimdKernel backward_kernel("BatchNormalization::Backward", {SimdLevel::AVX2});
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && backward_kernel.Select() >= SimdLevel::AVX2 ) {
             auto node_size    = dy_buf.GetNodeSize();
             auto frame_size   = dy_buf.GetFrameSize();
     //      auto frame_stride = dy_buf.GetFrameStride() / sizeof(float);
@@ -736,16 +824,20 @@ public:
             auto rstd_ptr         = m_rstd.LockConst();
        
         
-            // 逆数生成
-            const __m256    reciprocal_frame_size = _mm256_set1_ps(1.0f / (float)frame_size);
-
             auto x_ptr  = x_buf.LockConst<T>();
 //          auto y_ptr  = y_buf.LockConst<T>();
             auto dx_ptr = dx_buf.Lock<T>();
             auto dy_ptr = dy_buf.LockConst<T>();
 
-            #pragma omp parallel for
-            for (int node = 0; node < (int)node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
+                // 逆数生成
+                const __m256    reciprocal_frame_size = _mm256_set1_ps(1.0f / (float)frame_size);
+
+                // 末尾ブロックのフレーム外(パディング)は集計に含めない
+                const __m256    tail_mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(
+                                                _mm256_set1_epi32((int)frame_size - (mm256_frame_size - 8)),
+                                                _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
                 auto dy_addr = dy_ptr.GetAddr(node);
                 auto dx_addr = dx_ptr.GetAddr(node);
                 auto x_addr  = x_ptr.GetAddr(node);
@@ -761,10 +853,15 @@ public:
 
                 for (int frame = 0; frame < mm256_frame_size; frame += 8) {
                     __m256 x = _mm256_load_ps(&x_addr[frame]);
+                    __m256 dy = _mm256_load_ps(&dy_addr[frame]);
+                    if ( frame + 8 > frame_size ) {
+                        x  = _mm256_and_ps(x,  tail_mask);
+                        dy = _mm256_and_ps(dy, tail_mask);
+                    }
+
                     __m256 xc = _mm256_sub_ps(x, mean);
                     __m256 xn = _mm256_mul_ps(xc, rstd);
 
-                    __m256 dy = _mm256_load_ps(&dy_addr[frame]);
                     dbeta = _mm256_add_ps(dy, dbeta);
                     dgamma = _mm256_fmadd_ps(xn, dy, dgamma);
 
@@ -792,7 +889,7 @@ public:
                     __m256 dx = _mm256_fmadd_ps(_mm256_mul_ps(x, dvar), reciprocal_frame_size, dxc);
                     _mm256_store_ps(&dx_addr[frame], dx);
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -819,8 +916,7 @@ public:
             auto dx_ptr = dx_buf.Lock<T>();
             auto dy_ptr = dy_buf.LockConst<T>();
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 T   mean   = mean_ptr[node];
                 T   rstd   = rstd_ptr[node];
                 T   gamma  = gamma_ptr[node];
@@ -856,7 +952,7 @@ public:
                     T dx  = dxc + dmean + (x * dvar / (T)frame_size);
                     dx_ptr.Set(frame, node, dx);
                 }
-            }
+            });
 
             return dx_buf;
         } 
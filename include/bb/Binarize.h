@@ -91,7 +91,14 @@ public:
     }
 
     std::string GetClassName(void) const { return "Binarize"; }
+    bool IsForwardReplayable(void) const { return true; }
     
+    // 推論時に2値化しているか(派生クラスで多値モードを持つ場合にオーバーライド)
+    virtual bool IsBinaryMode(void) const { return true; }
+
+    // 2値化の閾値
+    RealType GetBinaryThreshold(void) const { return m_binary_th; }
+
     
     // ノード単位でのForward計算
     std::vector<double> ForwardNode(index_t node, std::vector<double> x_vec) const
@@ -115,13 +122,26 @@ public:
      */
     inline FrameBuffer Forward(FrameBuffer x_buf, bool train = true)
     {
-        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
-
         // backwardの為に保存
         if ( train ) {
             m_x_buf = x_buf;
         }
 
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    inline FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
+        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
+
         // 戻り値のサイズ設定
         FrameBuffer y_buf( x_buf.GetFrameSize(), x_buf.GetShape(), DataType<BinType>::type);
 
@@ -172,12 +192,11 @@ public:
             auto y_ptr = y_buf.Lock<BinType>();
 
             // Binarize
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
-                    y_ptr.Set(frame, node, x_ptr.Get(frame, node) > (RealType)0.0 ? (BinType)1.0 : (BinType)0.0);
+                    y_ptr.Set(frame, node, x_ptr.Get(frame, node) > m_binary_th ? (BinType)1.0 : (BinType)0.0);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -230,15 +249,14 @@ public:
             auto dx_ptr = dx_buf.Lock<RealType>();
             
             // hard-tanh
-    #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto dy = dy_ptr.Get(frame, node);
                     auto x  = x_ptr.Get(frame, node);
                     if ( x <= m_hardtanh_min || x >= m_hardtanh_max) { dy = (RealType)0.0; }
                     dx_ptr.Set(frame, node, dy);
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -0,0 +1,284 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+
+#include <limits>
+
+#ifdef BB_WITH_CEREAL
+#include <cereal/archives/json.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/array.hpp>
+#endif
+
+#include "bb/Manager.h"
+#include "bb/Activation.h"
+#include "bb/FrameBuffer.h"
+#include "bb/SimdSupport.h"
+
+
+namespace bb {
+
+
+// BinarizeThreshold (ノード毎の閾値による2値化)
+//  推論専用で、invert=0 なら x > th、invert=1 なら x < th で 1 を出力する
+//  BatchNormalization + Binarize の畳み込み先(FoldBatchNormalization.h)として使う
+template <typename BinType = Bit, typename RealType = float>
+class BinarizeThreshold : public Activation
+{
+    using _super = Activation;
+
+protected:
+    bool                    m_host_simd = true;
+
+    Tensor_<RealType>       m_threshold;
+    Tensor_<std::int32_t>   m_invert;
+
+protected:
+    BinarizeThreshold() {}
+
+    /**
+     * @brief  コマンド処理
+     * @detail コマンド処理
+     * @param  args   コマンド
+     */
+    void CommandProc(std::vector<std::string> args)
+    {
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
+    }
+
+public:
+    ~BinarizeThreshold() {}
+
+    static std::shared_ptr<BinarizeThreshold> Create(void)
+    {
+        return std::shared_ptr<BinarizeThreshold>(new BinarizeThreshold);
+    }
+
+    static std::shared_ptr<BinarizeThreshold> Create(indices_t const &shape)
+    {
+        auto self = std::shared_ptr<BinarizeThreshold>(new BinarizeThreshold);
+        self->SetInputShape(shape);
+        return self;
+    }
+
+    std::string GetClassName(void) const { return "BinarizeThreshold"; }
+
+
+    // Serialize
+    void Save(std::ostream &os) const
+    {
+        SaveIndices(os, this->m_shape);
+        m_threshold.Save(os);
+        m_invert.Save(os);
+    }
+
+    void Load(std::istream &is)
+    {
+        this->m_shape = LoadIndices(is);
+        m_threshold.Load(is);
+        m_invert.Load(is);
+    }
+
+
+#ifdef BB_WITH_CEREAL
+    template <class Archive>
+    void save(Archive& archive, std::uint32_t const version) const
+    {
+        _super::save(archive, version);
+        archive(cereal::make_nvp("node_shape", this->m_shape));
+        archive(cereal::make_nvp("threshold",  m_threshold));
+        archive(cereal::make_nvp("invert",     m_invert));
+    }
+
+    template <class Archive>
+    void load(Archive& archive, std::uint32_t const version)
+    {
+        _super::load(archive, version);
+        archive(cereal::make_nvp("node_shape", this->m_shape));
+        archive(cereal::make_nvp("threshold",  m_threshold));
+        archive(cereal::make_nvp("invert",     m_invert));
+    }
+
+    void Save(cereal::JSONOutputArchive& archive) const
+    {
+        archive(cereal::make_nvp("BinarizeThreshold", *this));
+    }
+
+    void Load(cereal::JSONInputArchive& archive)
+    {
+        archive(cereal::make_nvp("BinarizeThreshold", *this));
+    }
+#endif
+
+
+    /**
+     * @brief  入力形状設定
+     * @detail 入力形状を設定する
+     *         閾値は 0、比較は x > th に初期化する
+     * @param  shape      1フレームのノードを構成するshape
+     * @return 出力形状を返す
+     */
+    indices_t SetInputShape(indices_t shape)
+    {
+        // 設定済みなら何もしない
+        if ( shape == this->GetInputShape() ) {
+            return this->GetOutputShape();
+        }
+
+        _super::SetInputShape(shape);
+
+        m_threshold.Resize(this->m_shape); m_threshold = (RealType)0;
+        m_invert.Resize(this->m_shape);    m_invert    = 0;
+
+        return shape;
+    }
+
+
+    // 閾値設定
+    void SetThreshold(index_t node, RealType th, bool invert = false)
+    {
+        BB_ASSERT(node >= 0 && node < m_threshold.GetSize());
+        auto th_ptr     = m_threshold.Lock();
+        auto invert_ptr = m_invert.Lock();
+        th_ptr[node]     = th;
+        invert_ptr[node] = invert ? 1 : 0;
+    }
+
+    RealType GetThreshold(index_t node) const
+    {
+        auto th_ptr = m_threshold.LockConst();
+        return th_ptr[node];
+    }
+
+    bool GetInvert(index_t node) const
+    {
+        auto invert_ptr = m_invert.LockConst();
+        return invert_ptr[node] != 0;
+    }
+
+    // 一括設定用
+    auto lock_threshold(void)             { return m_threshold.Lock(); }
+    auto lock_threshold_const(void) const { return m_threshold.LockConst(); }
+    auto lock_invert(void)                { return m_invert.Lock(); }
+    auto lock_invert_const(void)    const { return m_invert.LockConst(); }
+
+
+    // ノード単位でのForward計算
+    std::vector<double> ForwardNode(index_t node, std::vector<double> x_vec) const
+    {
+        auto th_ptr     = m_threshold.LockConst();
+        auto invert_ptr = m_invert.LockConst();
+
+        double th     = (double)th_ptr[node];
+        bool   invert = (invert_ptr[node] != 0);
+
+        std::vector<double> y_vec;
+        for ( auto x : x_vec ) {
+            y_vec.push_back((invert ? (x < th) : (x > th)) ? 1.0 : 0.0);
+        }
+        return y_vec;
+    }
+
+
+    /**
+     * @brief  forward演算
+     * @detail forward演算を行う
+     *         推論専用のため train に関わらず同じ結果を返す
+     * @param  x     入力データ
+     * @param  train 学習時にtrueを指定
+     * @return forward演算結果
+     */
+    inline FrameBuffer Forward(FrameBuffer x_buf, bool /*train*/ = true)
+    {
+        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
+
+        // SetInputShpaeされていなければ初回に設定
+        if ( x_buf.GetShape() != this->GetInputShape() ) {
+            SetInputShape(x_buf.GetShape());
+        }
+
+        FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), DataType<BinType>::type);
+
+        index_t frame_size = x_buf.GetFrameSize();
+        index_t node_size  = x_buf.GetNodeSize();
+
+        auto x_ptr      = x_buf.LockConst<RealType>();
+        auto y_ptr      = y_buf.Lock<BinType>(true);
+        auto th_ptr     = m_threshold.LockConst();
+        auto invert_ptr = m_invert.LockConst();
+
+        static SimdKernel forward_kernel("BinarizeThreshold::Forward", {SimdLevel::AVX2});
+        if ( DataType<RealType>::type == BB_TYPE_FP32 && m_host_simd && forward_kernel.Select() >= SimdLevel::AVX2 ) {
+            // SIMD版(8フレーム単位で比較し、Bit出力はそのまま1byteに詰める)
+            index_t mm256_frame_size = (frame_size + 7) / 8 * 8;
+
+            ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
+                auto x_addr = (float const *)x_ptr.GetAddr(node);
+                auto y_addr = (void *)y_ptr.GetAddr(node);
+
+                __m256 th     = _mm256_set1_ps((float)th_ptr[node]);
+                bool   invert = (invert_ptr[node] != 0);
+
+                for ( index_t frame = 0; frame < mm256_frame_size; frame += 8 ) {
+                    __m256 x    = _mm256_load_ps(&x_addr[frame]);
+                    __m256 mask = invert ? _mm256_cmp_ps(x, th, _CMP_LT_OQ) : _mm256_cmp_ps(x, th, _CMP_GT_OQ);
+                    if ( DataType<BinType>::type == BB_TYPE_BIT ) {
+                        ((std::uint8_t *)y_addr)[frame / 8] = (std::uint8_t)_mm256_movemask_ps(mask);
+                    }
+                    else {
+                        _mm256_store_ps(&((float *)y_addr)[frame], _mm256_and_ps(mask, _mm256_set1_ps(1.0f)));
+                    }
+                }
+            });
+
+            return y_buf;
+        }
+
+        {
+            // 汎用版
+            ParallelFor(0, node_size, [&](index_t node) {
+                RealType th     = th_ptr[node];
+                bool     invert = (invert_ptr[node] != 0);
+                for ( index_t frame = 0; frame < frame_size; ++frame ) {
+                    RealType x = x_ptr.Get(frame, node);
+                    bool     y = invert ? (x < th) : (x > th);
+                    y_ptr.Set(frame, node, y ? (BinType)1.0 : (BinType)0.0);
+                }
+            });
+
+            return y_buf;
+        }
+    }
+
+
+   /**
+     * @brief  backward演算
+     * @detail 推論専用のため勾配は流さない(0を返す)
+     * @return backward演算結果
+     */
+    inline FrameBuffer Backward(FrameBuffer dy_buf)
+    {
+        FrameBuffer dx_buf(dy_buf.GetFrameSize(), dy_buf.GetShape(), DataType<RealType>::type);
+        dx_buf.FillZero();
+        return dx_buf;
+    }
+};
+
+
+}
+
+
+// end of file
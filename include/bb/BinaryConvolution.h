@@ -0,0 +1,57 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include "bb/DataType.h"
+#include "bb/Sequential.h"
+#include "bb/BinaryDense.h"
+#include "bb/BatchNormalization.h"
+#include "bb/Binarize.h"
+#include "bb/LoweringConvolution.h"
+
+
+namespace bb {
+
+
+/**
+ * @brief  BinaryDense による2値畳み込みの生成
+ * @detail LoweringConvolution の中に BinaryDense と BatchNormalization を置く
+ *         FT が Bit の場合は Col2Im に渡すために末尾に Binarize を追加する
+ *         (im2col で並べた Bit の窓をそのまま XNOR + popcount で処理する)
+ * @param  output_ch      出力チャネル数
+ * @param  filter_h_size  フィルタ高さ
+ * @param  filter_w_size  フィルタ幅
+ * @param  y_stride       縦ストライド
+ * @param  x_stride       横ストライド
+ * @param  padding        "valid" or "same"
+ * @return 生成した LoweringConvolution
+ */
+template <typename FT = Bit, typename BT = float>
+std::shared_ptr< LoweringConvolution<FT, BT> > BinaryConvolution_Create(
+            index_t         output_ch,
+            index_t         filter_h_size,
+            index_t         filter_w_size,
+            index_t         y_stride = 1,
+            index_t         x_stride = 1,
+            std::string     padding  = "valid"
+        )
+{
+    auto layer = Sequential::Create();
+    layer->Add(BinaryDense<FT, BT>::Create(output_ch));
+    layer->Add(BatchNormalization<BT>::Create());
+    if ( DataType<FT>::type == BB_TYPE_BIT ) {
+        layer->Add(Binarize<FT, BT>::Create());
+    }
+    return LoweringConvolution<FT, BT>::Create(layer, filter_h_size, filter_w_size, y_stride, x_stride, padding);
+}
+
+
+}
@@ -0,0 +1,589 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "bb/DataType.h"
+#include "bb/Model.h"
+#include "bb/SimdSupport.h"
+#include "bb/GemmSimd.h"
+
+
+namespace bb {
+
+
+/**
+ * @brief  64x64 ビット行列の転置
+ * @detail a[i] の bit j と a[j] の bit i を入れ替える(LSB first)
+ * @param  a 64ワードの配列(in-place で転置する)
+ */
+inline void BinaryDense_Transpose64(std::uint64_t a[64])
+{
+    std::uint64_t m = 0x00000000FFFFFFFFull;
+    for ( int j = 32; j != 0; j >>= 1, m ^= (m << j) ) {
+        for ( int k = 0; k < 64; k = ((k | j) + 1) & ~j ) {
+            std::uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k]     ^= (t << j);
+            a[k | j] ^= t;
+        }
+    }
+}
+
+
+/**
+ * @brief  XOR した 64bit 列の1の数 Σ popcount(a[i] ^ b[i])
+ * @param  a    ビット列
+ * @param  b    ビット列
+ * @param  size ワード数
+ * @return 1の数
+ */
+inline int BinaryDense_XorPopcount(std::uint64_t const *a, std::uint64_t const *b, index_t size)
+{
+    int count0 = 0, count1 = 0;
+    index_t i = 0;
+    for ( ; i + 2 <= size; i += 2 ) {
+        count0 += bb_popcount64(a[i+0] ^ b[i+0]);
+        count1 += bb_popcount64(a[i+1] ^ b[i+1]);
+    }
+    if ( i < size ) {
+        count0 += bb_popcount64(a[i] ^ b[i]);
+    }
+    return count0 + count1;
+}
+
+/**
+ * @brief  1本の重みビット列 w と4フレーム分の入力ビット列 x0～x3 の XOR popcount
+ * @detail w を1回の読み込みで4フレームに使い、独立した4系列で popcnt の依存を切る
+ *         popcnt 命令を使うためビルドターゲットを付けている(呼び出し側で CPU 対応を確認すること)
+ */
+BB_TARGET_AVX2_POPCNT inline void BinaryDense_XorPopcount4_Popcnt(std::uint64_t const *w, std::uint64_t const *x, index_t x_stride, index_t size, int count[4])
+{
+    std::uint64_t const *x0 = x;
+    std::uint64_t const *x1 = x0 + x_stride;
+    std::uint64_t const *x2 = x1 + x_stride;
+    std::uint64_t const *x3 = x2 + x_stride;
+    int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    for ( index_t i = 0; i < size; ++i ) {
+        std::uint64_t wi = w[i];
+        c0 += bb_popcount64(wi ^ x0[i]);
+        c1 += bb_popcount64(wi ^ x1[i]);
+        c2 += bb_popcount64(wi ^ x2[i]);
+        c3 += bb_popcount64(wi ^ x3[i]);
+    }
+    count[0] = c0;
+    count[1] = c1;
+    count[2] = c2;
+    count[3] = c3;
+}
+
+
+// 重み2値化 Dense レイヤー
+//  ・重みは sign(W) (W>=0 で +1, W<0 で -1)、入力は Bit(0:-1, 1:+1) または実数(x>0 で +1) として扱う
+//  ・forward は重みと入力をビットに詰めて XNOR + popcount で y = Σ w*x を求める
+//  ・backward は STE (straight-through estimator) で、W は [-1, +1] にクリップして保持する
+//  ・バイアスとスケールは持たない(後段に BatchNormalization を置く前提)
+template <typename FT = Bit, typename BT = float>
+class BinaryDense : public Model
+{
+    using _super = Model;
+
+protected:
+    bool                        m_host_only = false;
+    bool                        m_host_simd = true;
+
+    BT                          m_initialize_std = (BT)0.01;
+    std::mt19937_64             m_mt;
+
+    index_t                     m_input_node_size = 0;
+    indices_t                   m_input_shape;
+    index_t                     m_output_node_size = 0;
+    indices_t                   m_output_shape;
+
+    FrameBuffer                 m_x_buf;
+
+    std::shared_ptr<Tensor>     m_W;
+    std::shared_ptr<Tensor>     m_dW;
+
+    bool                        m_flagClamp = false;
+
+public:
+    struct create_t
+    {
+        indices_t       output_shape;
+        BT              initialize_std = (BT)0.01;
+        std::uint64_t   seed = 1;
+    };
+
+protected:
+    BinaryDense(create_t const &create)
+    {
+        m_W  = std::make_shared<Tensor>();
+        m_dW = std::make_shared<Tensor>();
+
+        BB_ASSERT(!create.output_shape.empty());
+
+        m_initialize_std = create.initialize_std;
+        m_mt.seed(create.seed);
+
+        m_output_shape     = create.output_shape;
+        m_output_node_size = GetShapeSize(m_output_shape);
+    }
+
+    void CommandProc(std::vector<std::string> args)
+    {
+        _super::CommandProc(args);
+
+        // HostOnlyモード設定
+        if (args.size() == 2 && args[0] == "host_only")
+        {
+            m_host_only = EvalBool(args[1]);
+        }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
+    }
+
+public:
+    ~BinaryDense() {}
+
+    static std::shared_ptr<BinaryDense> Create(create_t const &create)
+    {
+        return std::shared_ptr<BinaryDense>(new BinaryDense(create));
+    }
+
+    static std::shared_ptr<BinaryDense> Create(indices_t const &output_shape)
+    {
+        create_t create;
+        create.output_shape = output_shape;
+        return Create(create);
+    }
+
+    static std::shared_ptr<BinaryDense> Create(index_t output_node_size)
+    {
+        create_t create;
+        create.output_shape.resize(1);
+        create.output_shape[0] = output_node_size;
+        return Create(create);
+    }
+
+    static std::shared_ptr<BinaryDense> CreateEx(
+            indices_t       output_shape,
+            BT              initialize_std = (BT)0.01,
+            std::uint64_t   seed = 1
+        )
+    {
+        create_t create;
+        create.output_shape   = output_shape;
+        create.initialize_std = initialize_std;
+        create.seed           = seed;
+        return Create(create);
+    }
+
+
+    std::string GetClassName(void) const { return "BinaryDense"; }
+
+    Tensor       &W(void)       { return *m_W; }
+    Tensor const &W(void) const { return *m_W; }
+    Tensor       &dW(void)       { return *m_dW; }
+    Tensor const &dW(void) const { return *m_dW; }
+
+    auto lock_W(void)             { return m_W->Lock<BT>(); }
+    auto lock_W_const(void) const { return m_W->LockConst<BT>(); }
+    auto lock_dW(void)             { return m_dW->Lock<BT>(); }
+    auto lock_dW_const(void) const { return m_dW->LockConst<BT>(); }
+
+
+   /**
+     * @brief  入力のshape設定
+     * @detail 入力のshape設定
+     * @param shape 新しいshape
+     * @return なし
+     */
+    indices_t SetInputShape(indices_t shape)
+    {
+        // 設定済みなら何もしない
+        if ( shape == this->GetInputShape() ) {
+            return this->GetOutputShape();
+        }
+
+        // 形状設定
+        m_input_shape = shape;
+        m_input_node_size = GetShapeSize(shape);
+
+        // パラメータ初期化
+        m_W->Resize ({m_input_node_size, m_output_node_size}, DataType<BT>::type);  m_W->InitNormalDistribution(0.0, m_initialize_std, m_mt());
+        m_dW->Resize({m_input_node_size, m_output_node_size}, DataType<BT>::type);  m_dW->FillZero();
+
+        return m_output_shape;
+    }
+
+   /**
+     * @brief  出力のshape設定
+     * @detail 出力のshape設定
+     *         出力ノード数が変わらない限りshpeは自由
+     * @param shape 新しいshape
+     * @return なし
+     */
+    void SetOutputShape(indices_t const &shape)
+    {
+        BB_ASSERT(GetShapeSize(shape) == m_output_node_size);
+        m_output_shape = shape;
+    }
+
+    /**
+     * @brief  入力形状取得
+     * @detail 入力形状を取得する
+     * @return 入力形状を返す
+     */
+    indices_t GetInputShape(void) const
+    {
+        return m_input_shape;
+    }
+
+    /**
+     * @brief  出力形状取得
+     * @detail 出力形状を取得する
+     * @return 出力形状を返す
+     */
+    indices_t GetOutputShape(void) const
+    {
+        return m_output_shape;
+    }
+
+
+    Variables GetParameters(void)
+    {
+        Variables parameters;
+        if ( !this->m_parameter_lock ) {
+            parameters.PushBack(m_W);
+        }
+        return parameters;
+    }
+
+    Variables GetGradients(void)
+    {
+        Variables gradients;
+        if ( !this->m_parameter_lock ) {
+            gradients.PushBack(m_dW);
+        }
+        return gradients;
+    }
+
+
+protected:
+    // sign(W) を入力方向に 64bit 単位で詰める (W>=0 で 1、入力ノードの端数は 0)
+    std::vector<std::uint64_t> PackWeight(index_t input_word_size) const
+    {
+        std::vector<std::uint64_t> w_bits(m_output_node_size * input_word_size, 0);
+        auto W_ptr  = lock_W_const();
+        auto W_addr = W_ptr.GetAddr();
+        ParallelFor(0, m_output_node_size, [&](index_t output_node) {
+            BT const      *W_row = &W_addr[output_node * m_input_node_size];
+            std::uint64_t *w_row = &w_bits[output_node * input_word_size];
+            for ( index_t input_node = 0; input_node < m_input_node_size; ++input_node ) {
+                w_row[input_node / 64] |= ((std::uint64_t)(W_row[input_node] >= (BT)0) << (input_node % 64));
+            }
+        });
+        return w_bits;
+    }
+
+    // 64フレーム分の入力を 64bit 単位で詰めてから転置し、フレーム毎の入力ビット列 x_bits(frame, word) を作る
+    template<typename XPtr>
+    void PackInputBlock(XPtr const &x_ptr, index_t frame_block, index_t frame_size, index_t input_word_size, std::uint64_t *x_bits) const
+    {
+        index_t frame_base = frame_block * 64;
+        index_t frame_end  = std::min(frame_base + 64, frame_size);
+
+        std::uint64_t a[64];
+        for ( index_t word = 0; word < input_word_size; ++word ) {
+            for ( index_t i = 0; i < 64; ++i ) {
+                index_t input_node = word * 64 + i;
+                std::uint64_t bits = 0;
+                if ( input_node < m_input_node_size ) {
+                    if ( DataType<FT>::type == BB_TYPE_BIT ) {
+                        // Bit はそのまま 64フレーム分を読む(有効フレーム外のビットは出力しないので不問)
+                        bits = ((std::uint64_t const *)x_ptr.GetAddr(input_node))[frame_block];
+                    }
+                    else {
+                        for ( index_t frame = frame_base; frame < frame_end; ++frame ) {
+                            if ( (BT)x_ptr.Get(frame, input_node) > (BT)0 ) {
+                                bits |= ((std::uint64_t)1 << (frame - frame_base));
+                            }
+                        }
+                    }
+                }
+                a[i] = bits;
+            }
+
+            BinaryDense_Transpose64(a);
+
+            for ( index_t i = 0; i < 64; ++i ) {
+                x_bits[i * input_word_size + word] = a[i];
+            }
+        }
+    }
+
+public:
+    FrameBuffer Forward(FrameBuffer x_buf, bool train = true)
+    {
+        // SetInputShpaeされていなければ初回に設定
+        if (x_buf.GetNodeSize() != m_input_node_size) {
+            SetInputShape(x_buf.GetShape());
+        }
+
+        // 前回の backward 後の重みをクリップ
+        if ( m_flagClamp ) {
+            m_W->Clamp((BT)-1.0, (BT)+1.0);
+            m_flagClamp = false;
+        }
+
+        // backwardの為に保存
+        if ( train ) {
+            m_x_buf = x_buf;
+        }
+
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     *         backward 後の重みのクリップが残っている場合は排他して通常の処理を呼ぶ
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        if ( m_flagClamp ) {
+            return Model::Forward(x_buf, ctx);
+        }
+
+        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
+        BB_ASSERT(x_buf.GetNodeSize() == m_input_node_size);
+
+        // 出力を設定
+        FrameBuffer y_buf(x_buf.GetFrameSize(), m_output_shape, DataType<BT>::type);
+
+        index_t frame_size       = x_buf.GetFrameSize();
+        index_t frame_block_size = (frame_size + 63) / 64;
+        index_t input_word_size  = (m_input_node_size + 63) / 64;
+        BT      input_node_size  = (BT)m_input_node_size;
+
+        auto w_bits = PackWeight(input_word_size);
+
+        auto x_ptr = x_buf.LockConst<FT>();
+        auto y_ptr = y_buf.Lock<BT>(true);
+
+        static SimdKernel forward_kernel("BinaryDense::Forward", {SimdLevel::AVX2});
+        if ( m_host_simd && forward_kernel.Select() >= SimdLevel::AVX2 ) {
+            // popcnt命令版
+            ParallelFor(0, frame_block_size, [&](index_t frame_block) {
+                std::vector<std::uint64_t> x_bits(64 * input_word_size);
+                PackInputBlock(x_ptr, frame_block, frame_size, input_word_size, &x_bits[0]);
+
+                index_t frame_base  = frame_block * 64;
+                index_t frame_count = std::min((index_t)64, frame_size - frame_base);
+                for ( index_t output_node = 0; output_node < m_output_node_size; ++output_node ) {
+                    std::uint64_t const *w_row  = &w_bits[output_node * input_word_size];
+                    BT                  *y_addr = y_ptr.GetAddr(output_node);
+                    // x_bits は64フレーム分あるので端数フレームもまとめて計算し、有効分だけ書き込む
+                    for ( index_t i = 0; i < frame_count; i += 4 ) {
+                        int count[4];
+                        BinaryDense_XorPopcount4_Popcnt(w_row, &x_bits[i * input_word_size], input_word_size, input_word_size, count);
+                        for ( index_t j = 0; j < 4 && i + j < frame_count; ++j ) {
+                            y_addr[frame_base + i + j] = input_node_size - (BT)(2 * count[j]);
+                        }
+                    }
+                }
+            });
+
+            return y_buf;
+        }
+
+        {
+            // 汎用版
+            ParallelFor(0, frame_block_size, [&](index_t frame_block) {
+                std::vector<std::uint64_t> x_bits(64 * input_word_size);
+                PackInputBlock(x_ptr, frame_block, frame_size, input_word_size, &x_bits[0]);
+
+                index_t frame_base  = frame_block * 64;
+                index_t frame_count = std::min((index_t)64, frame_size - frame_base);
+                for ( index_t output_node = 0; output_node < m_output_node_size; ++output_node ) {
+                    std::uint64_t const *w_row = &w_bits[output_node * input_word_size];
+                    for ( index_t i = 0; i < frame_count; ++i ) {
+                        int count = BinaryDense_XorPopcount(w_row, &x_bits[i * input_word_size], input_word_size);
+                        y_ptr.Set(frame_base + i, output_node, input_node_size - (BT)(2 * count));
+                    }
+                }
+            });
+
+            return y_buf;
+        }
+    }
+
+
+    FrameBuffer Backward(FrameBuffer dy_buf)
+    {
+        BB_ASSERT(dy_buf.GetType() == DataType<BT>::type);
+
+        // フレーム数
+        index_t frame_size = dy_buf.GetFrameSize();
+
+        // forward時保存破棄
+        FrameBuffer x_buf = m_x_buf;
+        m_x_buf = FrameBuffer();
+
+        FrameBuffer dx_buf(frame_size, m_input_shape, DataType<BT>::type);
+
+        // 次の forward で W をクリップ
+        m_flagClamp = true;
+
+        auto x_ptr  = x_buf.LockConst<FT>();
+        auto dy_ptr = dy_buf.LockConst<BT>();
+        auto dx_ptr = dx_buf.Lock<BT>(true);
+        auto W_ptr  = lock_W_const();
+        auto dW_ptr = lock_dW();
+
+        // 2値化した重み sign(W)(output, input) と入力 sign(x)(input, frame)
+        std::vector<BT> w_sign(m_output_node_size * m_input_node_size);
+        std::vector<BT> x_sign(m_input_node_size * frame_size);
+        ParallelFor(0, m_output_node_size, [&](index_t output_node) {
+            BT const *W_row = &W_ptr.GetAddr()[output_node * m_input_node_size];
+            for ( index_t input_node = 0; input_node < m_input_node_size; ++input_node ) {
+                w_sign[output_node * m_input_node_size + input_node] = W_row[input_node] >= (BT)0 ? (BT)+1 : (BT)-1;
+            }
+        });
+        ParallelFor(0, m_input_node_size, [&](index_t input_node) {
+            for ( index_t frame = 0; frame < frame_size; ++frame ) {
+                x_sign[input_node * frame_size + frame] = (BT)x_ptr.Get(frame, input_node) > (BT)0 ? (BT)+1 : (BT)-1;
+            }
+        });
+
+        if ( DataType<BT>::type == BB_TYPE_FP32 && m_host_simd ) {
+            // GEMM版
+            index_t dy_frame_stride = dy_buf.GetFrameStride() / sizeof(float);
+            index_t dx_frame_stride = dx_buf.GetFrameStride() / sizeof(float);
+
+            // dx(input, frame) = sign(W)^T(input, node) * dy(node, frame)
+            simd_fp32_Gemm(m_input_node_size, frame_size, m_output_node_size,
+                    (float const *)&w_sign[0], 1, m_input_node_size,
+                    (float const *)dy_ptr.GetAddr(), dy_frame_stride, 1,
+                    0.0f, (float *)dx_ptr.GetAddr(), dx_frame_stride);
+
+            // dW(node, input) += dy(node, frame) * sign(x)^T(frame, input)
+            simd_fp32_Gemm(m_output_node_size, m_input_node_size, frame_size,
+                    (float const *)dy_ptr.GetAddr(), dy_frame_stride, 1,
+                    (float const *)&x_sign[0], 1, frame_size,
+                    1.0f, (float *)&dW_ptr[0], m_input_node_size);
+        }
+        else {
+            // 汎用版
+            ParallelFor(0, m_input_node_size, [&](index_t input_node) {
+                for ( index_t frame = 0; frame < frame_size; ++frame ) {
+                    BT dx = 0;
+                    for ( index_t output_node = 0; output_node < m_output_node_size; ++output_node ) {
+                        dx += w_sign[output_node * m_input_node_size + input_node] * dy_ptr.Get(frame, output_node);
+                    }
+                    dx_ptr.Set(frame, input_node, dx);
+                }
+            });
+
+            ParallelFor(0, m_output_node_size, [&](index_t output_node) {
+                for ( index_t frame = 0; frame < frame_size; ++frame ) {
+                    BT grad = dy_ptr.Get(frame, output_node);
+                    for ( index_t input_node = 0; input_node < m_input_node_size; ++input_node ) {
+                        dW_ptr(output_node, input_node) += grad * x_sign[input_node * frame_size + frame];
+                    }
+                }
+            });
+        }
+
+        // 実数入力は hardtanh の STE として |x|>1 の勾配を落とす
+        if ( DataType<FT>::type != BB_TYPE_BIT ) {
+            ParallelFor(0, m_input_node_size, [&](index_t input_node) {
+                for ( index_t frame = 0; frame < frame_size; ++frame ) {
+                    BT x = (BT)x_ptr.Get(frame, input_node);
+                    if ( x < (BT)-1 || x > (BT)+1 ) {
+                        dx_ptr.Set(frame, input_node, (BT)0);
+                    }
+                }
+            });
+        }
+
+        return dx_buf;
+    }
+
+
+public:
+    // Serialize
+    void Save(std::ostream &os) const
+    {
+        SaveIndices(os, m_input_shape);
+        SaveIndices(os, m_output_shape);
+        m_W->Save(os);
+    }
+
+    void Load(std::istream &is)
+    {
+        m_input_shape  = bb::LoadIndices(is);
+        m_output_shape = bb::LoadIndices(is);
+        m_input_node_size  = GetShapeSize(m_input_shape);
+        m_output_node_size = GetShapeSize(m_output_shape);
+        m_W->Load(is);
+        m_dW->Resize({m_input_node_size, m_output_node_size}, DataType<BT>::type);  m_dW->FillZero();
+    }
+
+
+#ifdef BB_WITH_CEREAL
+    template <class Archive>
+    void save(Archive& archive, std::uint32_t const version) const
+    {
+        _super::save(archive, version);
+        archive(cereal::make_nvp("input_shape",      m_input_shape));
+        archive(cereal::make_nvp("output_shape",     m_output_shape));
+        archive(cereal::make_nvp("W",                *m_W));
+    }
+
+    template <class Archive>
+    void load(Archive& archive, std::uint32_t const version)
+    {
+        _super::load(archive, version);
+        archive(cereal::make_nvp("input_shape",      m_input_shape));
+        archive(cereal::make_nvp("output_shape",     m_output_shape));
+
+        m_input_node_size  = GetShapeSize(m_input_shape);
+        m_output_node_size = GetShapeSize(m_output_shape);
+
+        archive(cereal::make_nvp("W",                *m_W));
+        m_dW->Resize({m_input_node_size, m_output_node_size}, DataType<BT>::type);  m_dW->FillZero();
+    }
+
+    void Save(cereal::JSONOutputArchive& archive) const
+    {
+        archive(cereal::make_nvp("BinaryDense", *this));
+    }
+
+    void Load(cereal::JSONInputArchive& archive)
+    {
+        archive(cereal::make_nvp("BinaryDense", *this));
+    }
+#endif
+};
+
+
+}
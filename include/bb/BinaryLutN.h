@@ -13,6 +13,7 @@
 #include <array>
 #include <vector>
 #include "bb/LutLayer.h"
+#include "bb/BinaryLutSimd.h"
 
 
 namespace bb {
@@ -110,6 +111,7 @@ public:
     }
 
     std::string GetClassName(void) const { return "BinaryLutN"; }
+    bool IsForwardReplayable(void) const { return true; }
 
     auto lock_InputIndex(void)             { return m_input_index.Lock(); }
     auto lock_InputIndex_const(void) const { return m_input_index.LockConst(); }
@@ -130,6 +132,20 @@ public:
         ptr(node, input_index) = (std::int32_t)input_node;
     }
 
+    void SetNodeConnectionTable(std::vector<index_t> const &table, std::vector<index_t> const &offset)
+    {
+        index_t output_node_size = (index_t)offset.size() - 1;
+        BB_ASSERT(output_node_size * N == m_input_index.GetSize());
+
+        auto ptr = lock_InputIndex();
+        ParallelFor(0, output_node_size, [&](index_t node) {
+            BB_DEBUG_ASSERT(offset[node + 1] - offset[node] == N);
+            for ( index_t i = 0; i < N; ++i ) {
+                ptr(node, i) = (std::int32_t)table[(size_t)(offset[node] + i)];
+            }
+        });
+    }
+
     index_t GetNodeConnectionIndex(index_t node, index_t input_index) const
     {
         BB_ASSERT(node >= 0 && node < GetShapeSize(m_output_shape));
@@ -138,6 +154,14 @@ public:
         auto ptr = lock_InputIndex_const();
         return (index_t)ptr(node, input_index);
     }
+
+    bool PermuteNodes(std::vector<index_t> const &order)
+    {
+        BB_ASSERT((index_t)order.size() == GetShapeSize(m_output_shape));
+        Tensor_PermuteRows(m_input_index, order);
+        Tensor_PermuteRows(m_table, order);
+        return true;
+    }
     
     // LUT操作の定義
     int GetLutTableSize(index_t node) const
@@ -184,6 +208,21 @@ public:
     */
 
 
+    // LUTテーブルをランダムに初期化 (ノード毎に独立した系列で並列に生成する)
+    void InitializeLutTable(std::uint64_t seed)
+    {
+        index_t node_size = GetShapeSize(m_output_shape);
+        std::uint64_t mask = (m_table_size < m_table_bits) ? (((std::uint64_t)1 << m_table_size) - 1) : 0xffffffffULL;
+
+        auto ptr = m_table.Lock(true);
+        ParallelFor(0, node_size, [&](index_t node) {
+            for ( int i = 0; i < m_table_unit; ++i ) {
+                auto bits = ConnectionTable_MakeSeed(seed, (std::uint64_t)(node * m_table_unit + i)) & mask;
+                ptr(node, i) = (std::int32_t)(std::uint32_t)bits;
+            }
+        });
+    }
+
    /**
      * @brief  入力のshape設定
      * @detail 入力のshape設定
@@ -245,30 +284,20 @@ public:
     
 
 private:
-    template<int LUT, int VAL>
-    inline __m256i lut_mask_unit(__m256i& val, __m256i& lut)
+    // ビットスライス版(N<=8)
+    template <int M = N, typename std::enable_if<(M <= 8), int>::type = 0>
+    void ForwardBitSlice(FrameBuffer x_buf, FrameBuffer y_buf) const
     {
-        if ((LUT & (1 << VAL)) == 0) {
-            return _mm256_andnot_si256(val, lut);
-        }
-        else {
-            return _mm256_and_si256(val, lut);
-        }
+        simd_bit_BinaryLutN_Forward<N>(x_buf, y_buf, m_input_index, m_table);
     }
-    
-    template<int LUT>
-    inline void lut6_mask(__m256i& msk, __m256i lut, __m256i val[6])
+
+    template <int M = N, typename std::enable_if<(M > 8), int>::type = 0>
+    void ForwardBitSlice(FrameBuffer x_buf, FrameBuffer y_buf) const
     {
-        lut = lut_mask_unit<LUT, 0>(val[0], lut);
-        lut = lut_mask_unit<LUT, 1>(val[1], lut);
-        lut = lut_mask_unit<LUT, 2>(val[2], lut);
-        lut = lut_mask_unit<LUT, 3>(val[3], lut);
-        lut = lut_mask_unit<LUT, 4>(val[4], lut);
-        lut = lut_mask_unit<LUT, 5>(val[5], lut);
-        msk = _mm256_or_si256(msk, lut);
+        BB_ASSERT(0);
     }
 
-    inline bool GetLutTableFromPtr(Tensor_<std::int32_t>::ConstPtr ptr, index_t node, int index)
+    inline bool GetLutTableFromPtr(Tensor_<std::int32_t>::ConstPtr ptr, index_t node, int index) const
     {
         auto idx = index / m_table_bits;
         auto bit = index % m_table_bits;
@@ -276,15 +305,29 @@ private:
     }
 
 public:
-    FrameBuffer Forward(FrameBuffer x_buf, bool train = true)
+    FrameBuffer Forward(FrameBuffer x_buf, bool /*train*/ = true)
     {
-        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
-
         // SetInputShpaeされていなければ初回に設定
         if (x_buf.GetShape() != m_input_shape) {
             SetInputShape(x_buf.GetShape());
         }
-        
+
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
+        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
+        BB_ASSERT(x_buf.GetShape() == m_input_shape);
+
         // 出力を設定
         FrameBuffer y_buf(x_buf.GetFrameSize(), m_output_shape, DataType<FT>::type);
 
@@ -311,116 +354,9 @@ public:
         }
 #endif
 
-        if ( N == 6 && DataType<FT>::type == BB_TYPE_BIT && m_host_simd ) {
-            auto x_ptr = x_buf.LockConst<Bit>();
-            auto y_ptr = y_buf.Lock<Bit>(true);
-
-            auto input_index_ptr = m_input_index.LockConst();
-            auto table_ptr       = m_table.LockConst();
-
-            index_t node_size  = y_buf.GetNodeSize();
-            index_t frame_size = y_buf.GetFrameStride() / sizeof(__m256i);
-
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
-                __m256i*    x_addr[6];
-                __m256i*    y_addr;
-                __m256i     x[6];
-
-                x_addr[0] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 0));
-                x_addr[1] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 1));
-                x_addr[2] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 2));
-                x_addr[3] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 3));
-                x_addr[4] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 4));
-                x_addr[5] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 5));
-                y_addr    = (__m256i*)y_ptr.GetAddr(node);
-
-                char    table[64];
-                std::int32_t t0 = table_ptr(node, 0);
-                std::int32_t t1 = table_ptr(node, 1);
-                for (int i = 0; i < 32; ++i) { table[i]    = (t0 & (1 << i)) ? -1 : 0; }
-                for (int i = 0; i < 32; ++i) { table[i+32] = (t1 & (1 << i)) ? -1 : 0; }
-
-                for (index_t frame = 0; frame < frame_size; ++frame) {
-                    // input
-                    x[0] = _mm256_loadu_si256(&x_addr[0][frame]);
-                    x[1] = _mm256_loadu_si256(&x_addr[1][frame]);
-                    x[2] = _mm256_loadu_si256(&x_addr[2][frame]);
-                    x[3] = _mm256_loadu_si256(&x_addr[3][frame]);
-                    x[4] = _mm256_loadu_si256(&x_addr[4][frame]);
-                    x[5] = _mm256_loadu_si256(&x_addr[5][frame]);
-
-                    // LUT
-                    __m256i y = _mm256_set1_epi8(0);
-                    lut6_mask< 0>(y, _mm256_set1_epi8(table[0]), x);
-                    lut6_mask< 1>(y, _mm256_set1_epi8(table[1]), x);
-                    lut6_mask< 2>(y, _mm256_set1_epi8(table[2]), x);
-                    lut6_mask< 3>(y, _mm256_set1_epi8(table[3]), x);
-                    lut6_mask< 4>(y, _mm256_set1_epi8(table[4]), x);
-                    lut6_mask< 5>(y, _mm256_set1_epi8(table[5]), x);
-                    lut6_mask< 6>(y, _mm256_set1_epi8(table[6]), x);
-                    lut6_mask< 7>(y, _mm256_set1_epi8(table[7]), x);
-                    lut6_mask< 8>(y, _mm256_set1_epi8(table[8]), x);
-                    lut6_mask< 9>(y, _mm256_set1_epi8(table[9]), x);
-                    lut6_mask<10>(y, _mm256_set1_epi8(table[10]), x);
-                    lut6_mask<11>(y, _mm256_set1_epi8(table[11]), x);
-                    lut6_mask<12>(y, _mm256_set1_epi8(table[12]), x);
-                    lut6_mask<13>(y, _mm256_set1_epi8(table[13]), x);
-                    lut6_mask<14>(y, _mm256_set1_epi8(table[14]), x);
-                    lut6_mask<15>(y, _mm256_set1_epi8(table[15]), x);
-                    lut6_mask<16>(y, _mm256_set1_epi8(table[16]), x);
-                    lut6_mask<17>(y, _mm256_set1_epi8(table[17]), x);
-                    lut6_mask<18>(y, _mm256_set1_epi8(table[18]), x);
-                    lut6_mask<19>(y, _mm256_set1_epi8(table[19]), x);
-                    lut6_mask<20>(y, _mm256_set1_epi8(table[20]), x);
-                    lut6_mask<21>(y, _mm256_set1_epi8(table[21]), x);
-                    lut6_mask<22>(y, _mm256_set1_epi8(table[22]), x);
-                    lut6_mask<23>(y, _mm256_set1_epi8(table[23]), x);
-                    lut6_mask<24>(y, _mm256_set1_epi8(table[24]), x);
-                    lut6_mask<25>(y, _mm256_set1_epi8(table[25]), x);
-                    lut6_mask<26>(y, _mm256_set1_epi8(table[26]), x);
-                    lut6_mask<27>(y, _mm256_set1_epi8(table[27]), x);
-                    lut6_mask<28>(y, _mm256_set1_epi8(table[28]), x);
-                    lut6_mask<29>(y, _mm256_set1_epi8(table[29]), x);
-                    lut6_mask<30>(y, _mm256_set1_epi8(table[30]), x);
-                    lut6_mask<31>(y, _mm256_set1_epi8(table[31]), x);
-                    lut6_mask<32>(y, _mm256_set1_epi8(table[32]), x);
-                    lut6_mask<33>(y, _mm256_set1_epi8(table[33]), x);
-                    lut6_mask<34>(y, _mm256_set1_epi8(table[34]), x);
-                    lut6_mask<35>(y, _mm256_set1_epi8(table[35]), x);
-                    lut6_mask<36>(y, _mm256_set1_epi8(table[36]), x);
-                    lut6_mask<37>(y, _mm256_set1_epi8(table[37]), x);
-                    lut6_mask<38>(y, _mm256_set1_epi8(table[38]), x);
-                    lut6_mask<39>(y, _mm256_set1_epi8(table[39]), x);
-                    lut6_mask<40>(y, _mm256_set1_epi8(table[40]), x);
-                    lut6_mask<41>(y, _mm256_set1_epi8(table[41]), x);
-                    lut6_mask<42>(y, _mm256_set1_epi8(table[42]), x);
-                    lut6_mask<43>(y, _mm256_set1_epi8(table[43]), x);
-                    lut6_mask<44>(y, _mm256_set1_epi8(table[44]), x);
-                    lut6_mask<45>(y, _mm256_set1_epi8(table[45]), x);
-                    lut6_mask<46>(y, _mm256_set1_epi8(table[46]), x);
-                    lut6_mask<47>(y, _mm256_set1_epi8(table[47]), x);
-                    lut6_mask<48>(y, _mm256_set1_epi8(table[48]), x);
-                    lut6_mask<49>(y, _mm256_set1_epi8(table[49]), x);
-                    lut6_mask<50>(y, _mm256_set1_epi8(table[50]), x);
-                    lut6_mask<51>(y, _mm256_set1_epi8(table[51]), x);
-                    lut6_mask<52>(y, _mm256_set1_epi8(table[52]), x);
-                    lut6_mask<53>(y, _mm256_set1_epi8(table[53]), x);
-                    lut6_mask<54>(y, _mm256_set1_epi8(table[54]), x);
-                    lut6_mask<55>(y, _mm256_set1_epi8(table[55]), x);
-                    lut6_mask<56>(y, _mm256_set1_epi8(table[56]), x);
-                    lut6_mask<57>(y, _mm256_set1_epi8(table[57]), x);
-                    lut6_mask<58>(y, _mm256_set1_epi8(table[58]), x);
-                    lut6_mask<59>(y, _mm256_set1_epi8(table[59]), x);
-                    lut6_mask<60>(y, _mm256_set1_epi8(table[60]), x);
-                    lut6_mask<61>(y, _mm256_set1_epi8(table[61]), x);
-                    lut6_mask<62>(y, _mm256_set1_epi8(table[62]), x);
-                    lut6_mask<63>(y, _mm256_set1_epi8(table[63]), x);
-
-                    _mm256_storeu_si256(&y_addr[frame], y);
-                }
-            }
-
+        if ( N <= 8 && DataType<FT>::type == BB_TYPE_BIT && m_host_simd ) {
+            // ビットスライス版
+            ForwardBitSlice(x_buf, y_buf);
             return y_buf;
         }
 
@@ -435,8 +371,7 @@ public:
             index_t frame_size = x_buf.GetFrameSize();
             index_t node_size  = this->GetOutputNodeSize();
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     int index = 0;
                     int mask  = 1;
@@ -449,7 +384,7 @@ public:
                     auto y = GetLutTableFromPtr(table_ptr, node, index);
                     y_ptr.Set(frame, node, y);
                 }
-            }
+            });
 
             return y_buf;
         }
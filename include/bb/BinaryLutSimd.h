@@ -0,0 +1,271 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <string>
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+#include "bb/FrameBuffer.h"
+#include "bb/Tensor.h"
+#include "bb/ThreadPool.h"
+
+
+namespace bb {
+
+
+// [BinaryLutN のビットスライス演算]
+//  フレーム方向にパックされたビット列をそのまま論理演算し、
+//  LUT をシャノン展開(入力 x[k] によるマルチプレクサの木)で評価する
+//   ・汎用版/AVX2版 : 最下段 x[0] は LUT の2ビットから {0, ~x0, x0, ~0} を選ぶだけで
+//                     以降は f = lo ^ (x[k] & (lo ^ hi)) で 2^(N-1)-1 回の選択を行う
+//   ・AVX-512版     : x[0..2] の3入力部分関数を VPTERNLOG 1命令で評価し
+//                     (即値は LUT の8ビットそのもの)、上位段の選択も VPTERNLOG で行う
+//  使用する命令セットは実行時に CPU を判定して選択する
+
+
+// 最下段の選択コード(LUT の 2j, 2j+1 ビット目)
+template <int N>
+inline void simd_bit_BinaryLutN_MakeSelect(std::int32_t const *table, std::uint8_t *sel)
+{
+    for ( int j = 0; j < (1 << (N-1)); ++j ) {
+        int t0 = (table[(2*j+0) / 32] >> ((2*j+0) % 32)) & 1;
+        int t1 = (table[(2*j+1) / 32] >> ((2*j+1) % 32)) & 1;
+        sel[j] = (std::uint8_t)(t0 | (t1 << 1));
+    }
+}
+
+// 3入力部分関数の真理値表(VPTERNLOG の即値)
+template <int N>
+inline void simd_bit_BinaryLutN_MakeLeafImm(std::int32_t const *table, std::uint8_t *imm)
+{
+    if ( N < 3 ) {
+        // 不足する上位入力は無関係として真理値表を複製する
+        int t = table[0] & ((1 << (1 << N)) - 1);
+        if ( N == 1 ) { t |= (t << 2); }
+        imm[0] = (std::uint8_t)(t | (t << 4));
+        return;
+    }
+    // N < 3 は上で返っているが、シフト量が負にならないよう定数式側でもクランプする
+    int const leaf_size = (1 << (N >= 3 ? N-3 : 0));
+    for ( int j = 0; j < leaf_size; ++j ) {
+        imm[j] = (std::uint8_t)((table[j / 4] >> ((j % 4) * 8)) & 0xff);
+    }
+}
+
+
+// 汎用版(64bit単位)
+template <int N>
+inline void simd_bit_BinaryLutN_Row_u64(std::uint8_t const * const x_addr[], std::uint8_t *y_addr, index_t byte_size, std::uint8_t const *sel)
+{
+    index_t size = byte_size / 8;
+    for ( index_t i = 0; i < size; ++i ) {
+        std::uint64_t x[N];
+        for ( int k = 0; k < N; ++k ) {
+            x[k] = ((std::uint64_t const *)x_addr[k])[i];
+        }
+
+        std::uint64_t const base[4] = { 0, ~x[0], x[0], ~(std::uint64_t)0 };
+        std::uint64_t g[1 << (N-1)];
+        for ( int j = 0; j < (1 << (N-1)); ++j ) {
+            g[j] = base[sel[j]];
+        }
+        for ( int k = 1; k < N; ++k ) {
+            for ( int j = 0; j < (1 << (N-1-k)); ++j ) {
+                g[j] = g[2*j] ^ (x[k] & (g[2*j] ^ g[2*j+1]));
+            }
+        }
+        ((std::uint64_t *)y_addr)[i] = g[0];
+    }
+}
+
+
+// AVX2版(256bit単位)
+template <int N>
+BB_TARGET_AVX2
+inline void simd_bit_BinaryLutN_Row_avx2(std::uint8_t const * const x_addr[], std::uint8_t *y_addr, index_t byte_size, std::uint8_t const *sel)
+{
+    index_t size = byte_size / 32;
+    for ( index_t i = 0; i < size; ++i ) {
+        __m256i x[N];
+        for ( int k = 0; k < N; ++k ) {
+            x[k] = _mm256_loadu_si256((__m256i const *)x_addr[k] + i);
+        }
+
+        __m256i const zero = _mm256_setzero_si256();
+        __m256i const ones = _mm256_cmpeq_epi8(zero, zero);
+        __m256i const base[4] = { zero, _mm256_xor_si256(x[0], ones), x[0], ones };
+        __m256i g[1 << (N-1)];
+        for ( int j = 0; j < (1 << (N-1)); ++j ) {
+            g[j] = base[sel[j]];
+        }
+        for ( int k = 1; k < N; ++k ) {
+            for ( int j = 0; j < (1 << (N-1-k)); ++j ) {
+                __m256i d = _mm256_xor_si256(g[2*j], g[2*j+1]);
+                g[j] = _mm256_xor_si256(g[2*j], _mm256_and_si256(x[k], d));
+            }
+        }
+        _mm256_storeu_si256((__m256i *)y_addr + i, g[0]);
+    }
+}
+
+
+// AVX-512版
+typedef void (*simd_bit_TernaryLogicFunc)(void const *a, void const *b, void const *c, void *dst, int size);
+
+template <int IMM>
+BB_TARGET_AVX512
+void simd_bit_TernaryLogic_avx512(void const *a, void const *b, void const *c, void *dst, int size)
+{
+    for ( int i = 0; i < size; ++i ) {
+        ((__m512i *)dst)[i] = _mm512_ternarylogic_epi64(((__m512i const *)a)[i], ((__m512i const *)b)[i], ((__m512i const *)c)[i], IMM);
+    }
+}
+
+template <int... IMM>
+inline std::array<simd_bit_TernaryLogicFunc, sizeof...(IMM)> simd_bit_MakeTernaryLogicTable(std::integer_sequence<int, IMM...>)
+{
+    return {{ &simd_bit_TernaryLogic_avx512<IMM>... }};
+}
+
+// 即値(真理値表)から VPTERNLOG 関数を引くテーブル
+inline simd_bit_TernaryLogicFunc const *simd_bit_GetTernaryLogicTable(void)
+{
+    static auto const table = simd_bit_MakeTernaryLogicTable(std::make_integer_sequence<int, 256>());
+    return table.data();
+}
+
+template <int N>
+BB_TARGET_AVX512
+inline void simd_bit_BinaryLutN_Row_avx512(std::uint8_t const * const x_addr[], std::uint8_t *y_addr, index_t byte_size,
+                                           std::uint8_t const *imm, simd_bit_TernaryLogicFunc const *logic_table)
+{
+    int const   X = (N < 3) ? 3 : N;                    // 入力数(3未満は上位入力を複製)
+    int const   L = (N <= 3) ? 1 : (1 << (N-3));        // 3入力部分関数の数
+    int const   B = 8;                                  // ブロック内の512bitワード数
+
+    __m512i     x[X][B];
+    __m512i     g[L][B];
+
+    index_t word_size = (byte_size + 63) / 64;
+    for ( index_t word = 0; word < word_size; word += B ) {
+        int n = (int)std::min((index_t)B, word_size - word);
+
+        // 入力読込み(末尾は256bit境界なのでマスク付き)
+        for ( int b = 0; b < n; ++b ) {
+            index_t   offset = (word + b) * 64;
+            __mmask8  mask   = (byte_size - offset >= 64) ? (__mmask8)0xff : (__mmask8)((1 << ((byte_size - offset) / 8)) - 1);
+            for ( int k = 0; k < N; ++k ) {
+                x[k][b] = _mm512_maskz_loadu_epi64(mask, x_addr[k] + offset);
+            }
+            for ( int k = N; k < X; ++k ) {
+                x[k][b] = x[N-1][b];
+            }
+        }
+
+        // 最下段 x[0..2] の部分関数
+        for ( int j = 0; j < L; ++j ) {
+            logic_table[imm[j]](x[2], x[1], x[0], g[j], n);
+        }
+
+        // 上位段の選択 (x[k] ? hi : lo)
+        for ( int k = 3; k < N; ++k ) {
+            for ( int j = 0; j < (1 << (N-1-k)); ++j ) {
+                for ( int b = 0; b < n; ++b ) {
+                    g[j][b] = _mm512_ternarylogic_epi64(x[k][b], g[2*j+1][b], g[2*j][b], 0xca);
+                }
+            }
+        }
+
+        for ( int b = 0; b < n; ++b ) {
+            index_t   offset = (word + b) * 64;
+            __mmask8  mask   = (byte_size - offset >= 64) ? (__mmask8)0xff : (__mmask8)((1 << ((byte_size - offset) / 8)) - 1);
+            _mm512_mask_storeu_epi64(y_addr + offset, mask, g[0][b]);
+        }
+    }
+}
+
+
+/**
+ * @brief  BinaryLutN のビットスライス forward
+ * @detail 実行時に CPU を判定して AVX-512/AVX2/汎用版を選択する
+ * @param  x_buf        入力(Bit)
+ * @param  y_buf        出力(Bit)
+ * @param  input_index  入力インデックス (node, N)
+ * @param  table        LUT テーブル (node, ceil(2^N/32))
+ */
+template <int N>
+inline void simd_bit_BinaryLutN_Forward
+    (
+        FrameBuffer                         x_buf,
+        FrameBuffer                         y_buf,
+        Tensor_<std::int32_t> const         &input_index,
+        Tensor_<std::int32_t> const         &table
+    )
+{
+    static_assert(N >= 1 && N <= 8, "BinaryLutN SIMD : N must be 1 to 8");
+
+    auto x_ptr           = x_buf.LockMemoryConst();
+    auto y_ptr           = y_buf.LockMemory(true);
+    auto input_index_ptr = input_index.LockConst();
+    auto table_ptr       = table.LockConst();
+
+    auto x_addr_base = (std::uint8_t const *)x_ptr.GetAddr();
+    auto y_addr_base = (std::uint8_t       *)y_ptr.GetAddr();
+    auto table_addr  = (std::int32_t const *)table_ptr.GetAddr();
+
+    index_t node_size    = y_buf.GetNodeSize();
+    index_t frame_stride = y_buf.GetFrameStride();
+    index_t table_unit   = ((1 << N) + 31) / 32;
+
+    BB_ASSERT(x_buf.GetFrameStride() == frame_stride);
+
+    static SimdKernel kernel("BinaryLutN<" + std::to_string(N) + ">", {SimdLevel::AVX2, SimdLevel::AVX512});
+    auto level = kernel.Select();
+    bool use_avx512 = (level >= SimdLevel::AVX512);
+    bool use_avx2   = (level >= SimdLevel::AVX2);
+    simd_bit_TernaryLogicFunc const *logic_table = use_avx512 ? simd_bit_GetTernaryLogicTable() : nullptr;
+
+    ParallelFor(0, node_size, [&](index_t node) {
+        std::uint8_t const *x_addr[N];
+        for ( int k = 0; k < N; ++k ) {
+            x_addr[k] = x_addr_base + frame_stride * input_index_ptr(node, k);
+        }
+        std::uint8_t        *y_addr   = y_addr_base + frame_stride * node;
+        std::int32_t const  *node_tbl = table_addr + table_unit * node;
+
+        if ( use_avx512 ) {
+            std::uint8_t imm[(N <= 3) ? 1 : (1 << (N-3))];
+            simd_bit_BinaryLutN_MakeLeafImm<N>(node_tbl, imm);
+            simd_bit_BinaryLutN_Row_avx512<N>(x_addr, y_addr, frame_stride, imm, logic_table);
+        }
+        else {
+            std::uint8_t sel[1 << (N-1)];
+            simd_bit_BinaryLutN_MakeSelect<N>(node_tbl, sel);
+            if ( use_avx2 ) {
+                simd_bit_BinaryLutN_Row_avx2<N>(x_addr, y_addr, frame_stride, sel);
+            }
+            else {
+                simd_bit_BinaryLutN_Row_u64<N>(x_addr, y_addr, frame_stride, sel);
+            }
+        }
+    });
+}
+
+
+}
+
+
+// end of file
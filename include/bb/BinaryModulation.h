@@ -11,6 +11,9 @@
 #pragma once
 
 
+#include <atomic>
+#include <limits>
+
 #include "bb/Model.h"
 #include "bb/RealToBinary.h"
 #include "bb/BinaryToReal.h"
@@ -36,6 +39,14 @@ protected:
 
     typename RealToBinary<BinType, RealType>::create_t  m_training_create;
     typename RealToBinary<BinType, RealType>::create_t  m_inference_create;
+
+    // 段階推論(anytime)設定
+    index_t                                             m_anytime_stage_size = 0;
+    index_t                                             m_anytime_min_stage  = 1;
+    RealType                                            m_anytime_margin     = (RealType)0.5;
+    bool                                                m_anytime_exact      = false;
+    mutable std::atomic<std::int64_t>                   m_anytime_sample_count{0};
+    mutable std::atomic<std::int64_t>                   m_anytime_frame_count{0};
     
 public:
     struct create_t
@@ -54,6 +65,11 @@ public:
         bool                                        inference_framewise       = true;
         RealType                                    inference_input_range_lo  = (RealType)0.0;
         RealType                                    inference_input_range_hi  = (RealType)1.0;
+
+        index_t                                     inference_anytime_stage_size = 0;               //< 推論時に変調を分けて段階実行する段数(1以下で無効)
+        RealType                                    inference_anytime_margin     = (RealType)0.5;   //< 打ち切る出力1位と2位の差
+        index_t                                     inference_anytime_min_stage  = 1;               //< 打ち切り判定を始める段数
+        bool                                        inference_anytime_exact      = false;           //< 1位が入れ替わり得ない場合のみ打ち切るか
     };
 
 protected:
@@ -71,6 +87,9 @@ protected:
         m_inference_create.input_range_lo  = create.inference_input_range_lo;
         m_inference_create.input_range_hi  = create.inference_input_range_hi;
 
+        SetAnytimeInference(create.inference_anytime_stage_size, create.inference_anytime_margin,
+                                create.inference_anytime_min_stage, create.inference_anytime_exact);
+
         m_training = true;
         m_modulation_size = create.training_modulation_size;
         m_real2bin = RealToBinary<BinType, RealType>::Create(m_training_create);
@@ -160,6 +179,45 @@ public:
     }
 
 
+    /**
+     * @brief  段階推論(anytime)設定
+     * @detail 推論時に変調フレームを stage_size 段に分けて順に実行し、
+     *         各段の後で復調した出力の1位と2位の差が margin 以上になったサンプルは打ち切る
+     *         各段は閾値を飛び飛びに選ぶので、途中でも全範囲を粗く変調した結果になる
+     *         exact 指定時は残りの変調で1位が入れ替わり得ない場合のみ打ち切る(判定結果は全変調時と一致)
+     *         内部レイヤーの出力は0/1であることを前提とする
+     *         閾値を乱数で生成する場合は無効、出力ノードが1つの場合は打ち切らない
+     * @param  stage_size 段数(1以下で無効)
+     * @param  margin     打ち切る出力1位と2位の差
+     * @param  min_stage  打ち切り判定を始める段数
+     * @param  exact      1位が確定した場合のみ打ち切るか
+     */
+    void SetAnytimeInference(index_t stage_size, RealType margin = (RealType)0.5, index_t min_stage = 1, bool exact = false)
+    {
+        m_anytime_stage_size = stage_size;
+        m_anytime_margin     = margin;
+        m_anytime_min_stage  = std::max(min_stage, (index_t)1);
+        m_anytime_exact      = exact;
+    }
+
+    /**
+     * @brief  段階推論の平均変調数取得
+     * @detail 段階推論で1サンプルあたりに実行した変調フレーム数の平均
+     * @return 平均変調数(未実行なら0)
+     */
+    double GetAnytimeAverageModulationSize(void) const
+    {
+        std::int64_t samples = m_anytime_sample_count.load();
+        return samples > 0 ? (double)m_anytime_frame_count.load() / (double)samples : 0.0;
+    }
+
+    void ResetAnytimeStatistics(void)
+    {
+        m_anytime_sample_count = 0;
+        m_anytime_frame_count  = 0;
+    }
+
+
     /**
      * @brief  コマンドを送る
      * @detail コマンドを送る
@@ -277,12 +335,50 @@ public:
             m_bin2real->SetModulationSize(m_inference_create.modulation_size);
         }
 
+        // 段階推論
+        if ( !train && IsAnytimeEnabled() ) {
+            SetInputShape(x_buf.GetShape());
+            InferenceContext ctx;
+            return ForwardAnytime(x_buf, ctx);
+        }
+
         x_buf = m_real2bin->Forward(x_buf, train);
         x_buf = m_layer->Forward(x_buf, train);
         x_buf = m_bin2real->Forward(x_buf, train);
         return x_buf;
     }
 
+   /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     *         学習用の変調設定のままの場合は初回のみ排他して推論用に切り替える
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        // bypass
+        if ( !m_binary_mode ) {
+            return m_layer->Forward(x_buf, ctx);
+        }
+
+        // change mode
+        if ( m_training ) {
+            return Model::Forward(x_buf, ctx);
+        }
+
+        // 段階推論
+        if ( IsAnytimeEnabled() ) {
+            return ForwardAnytime(x_buf, ctx);
+        }
+
+        x_buf = m_real2bin->Forward(x_buf, ctx);
+        x_buf = m_layer->Forward(x_buf, ctx);
+        x_buf = m_bin2real->Forward(x_buf, ctx);
+        return x_buf;
+    }
+
    /**
      * @brief  backward演算
      * @detail backward演算を行う
@@ -302,6 +398,169 @@ public:
     }
     
 protected:
+    bool IsAnytimeEnabled(void) const
+    {
+        return m_anytime_stage_size > 1 && m_inference_create.value_generator == nullptr;
+    }
+
+    // 段階推論の本体
+    //  変調番号 i (閾値 lo + step * (i+1)) を i % stage_size で段に分け、
+    //  未確定のサンプルだけを変調して内部レイヤーに通し、復調値を積算していく
+    FrameBuffer ForwardAnytime(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
+        BB_ASSERT(x_buf.GetShape() == m_real2bin->GetInputShape());
+
+        index_t frame_size       = x_buf.GetFrameSize();
+        index_t input_node_size  = x_buf.GetNodeSize();
+        index_t mid_node_size    = GetShapeSize(m_bin2real->GetInputShape());
+        index_t output_node_size = GetShapeSize(m_bin2real->GetOutputShape());
+        index_t fold_node_size   = std::max(mid_node_size, output_node_size);
+        index_t modulation_size  = m_inference_create.modulation_size;
+        index_t stage_size       = std::min(m_anytime_stage_size, modulation_size);
+
+        // 閾値(通常の推論と同じ等間隔の固定閾値)
+        RealType range_lo = m_inference_create.input_range_lo;
+        RealType range_hi = m_inference_create.input_range_hi;
+        RealType th_step  = (range_hi - range_lo) / (RealType)(modulation_size + 1);
+
+        // 出力ノード毎の1変調あたりの積算数(BinaryToRealの平均と同じ数え方)
+        std::vector<index_t> fold_count(output_node_size, 0);
+        for ( index_t node = 0; node < fold_node_size; ++node ) {
+            fold_count[node % output_node_size]++;
+        }
+
+        std::vector<RealType>   sum_table(frame_size * output_node_size, (RealType)0);
+        std::vector<index_t>    mod_count(frame_size, 0);
+        std::vector<index_t>    active(frame_size);
+        for ( index_t frame = 0; frame < frame_size; ++frame ) {
+            active[frame] = frame;
+        }
+
+        FrameBuffer y_buf(frame_size, m_bin2real->GetOutputShape(), DataType<RealType>::type);
+        auto x_ptr = x_buf.LockConst<RealType>();
+        auto y_ptr = y_buf.Lock<RealType>(true);
+
+        // 確定したサンプルの出力
+        auto output_frame = [&](index_t frame) {
+            for ( index_t node = 0; node < output_node_size; ++node ) {
+                index_t n = mod_count[frame] * fold_count[node];
+                y_ptr.Set(frame, node, sum_table[frame * output_node_size + node] / (RealType)n);
+            }
+        };
+
+        std::int64_t total_frames = 0;
+        for ( index_t stage = 0; stage < stage_size && !active.empty(); ++stage ) {
+            std::vector<RealType> th_table;
+            for ( index_t i = stage; i < modulation_size; i += stage_size ) {
+                th_table.push_back(range_lo + (th_step * (RealType)(i + 1)));
+            }
+            index_t stage_mod_size = (index_t)th_table.size();
+            index_t active_size    = (index_t)active.size();
+
+            // 未確定サンプルのみ変調
+            FrameBuffer bin_buf(active_size * stage_mod_size, m_real2bin->GetInputShape(), DataType<BinType>::type);
+            {
+                auto bin_ptr = bin_buf.Lock<BinType>();
+                ParallelFor(0, input_node_size, [&](index_t node) {
+                    for ( index_t pos = 0; pos < active_size; ++pos ) {
+                        RealType x = x_ptr.Get(active[pos], node);
+                        for ( index_t i = 0; i < stage_mod_size; ++i ) {
+                            bin_ptr.Set(pos * stage_mod_size + i, node, (x > th_table[i]) ? (BinType)1 : (BinType)0);
+                        }
+                    }
+                });
+            }
+            total_frames += active_size * stage_mod_size;
+
+            // 内部レイヤー実行
+            auto mid_buf = m_layer->Forward(bin_buf, ctx);
+            BB_ASSERT(mid_buf.GetFrameSize() == active_size * stage_mod_size);
+
+            // 復調値の積算と打ち切り判定
+            bool last_stage = (stage + 1 >= stage_size);
+            bool judge      = !last_stage && (stage + 1) >= m_anytime_min_stage && output_node_size > 1;
+            index_t rest_mod_size = 0;
+            for ( index_t s = stage + 1; s < stage_size; ++s ) {
+                rest_mod_size += (modulation_size - s + stage_size - 1) / stage_size;
+            }
+
+            std::vector<char> decided(active_size, 0);
+            {
+                auto mid_ptr = mid_buf.LockConst<BinType>();
+                ParallelFor(0, active_size, [&](index_t pos) {
+                    index_t  frame = active[pos];
+                    RealType *sum  = &sum_table[frame * output_node_size];
+                    for ( index_t node = 0; node < fold_node_size; ++node ) {
+                        for ( index_t i = 0; i < stage_mod_size; ++i ) {
+                            sum[node % output_node_size] += (RealType)mid_ptr.Get(pos * stage_mod_size + i, node);
+                        }
+                    }
+                    mod_count[frame] += stage_mod_size;
+
+                    if ( last_stage ) {
+                        decided[pos] = 1;
+                    }
+                    else if ( judge ) {
+                        decided[pos] = IsAnytimeDecided(sum, &fold_count[0], output_node_size, mod_count[frame], rest_mod_size) ? 1 : 0;
+                    }
+                    if ( decided[pos] ) {
+                        output_frame(frame);
+                    }
+                });
+            }
+
+            std::vector<index_t> next_active;
+            for ( index_t pos = 0; pos < active_size; ++pos ) {
+                if ( !decided[pos] ) {
+                    next_active.push_back(active[pos]);
+                }
+            }
+            active.swap(next_active);
+        }
+
+        m_anytime_sample_count += frame_size;
+        m_anytime_frame_count  += total_frames;
+
+        return y_buf;
+    }
+
+    // 打ち切り判定
+    bool IsAnytimeDecided(RealType const *sum, index_t const *fold_count, index_t output_node_size, index_t mod_count, index_t rest_mod_size) const
+    {
+        index_t top = 0;
+        for ( index_t node = 1; node < output_node_size; ++node ) {
+            if ( sum[node] * (RealType)fold_count[top] > sum[top] * (RealType)fold_count[node] ) {
+                top = node;
+            }
+        }
+
+        if ( m_anytime_exact ) {
+            // 残りの変調が全て1位に0、他に1を加えても順位が変わらないか
+            index_t  total_mod = mod_count + rest_mod_size;
+            RealType top_min   = sum[top] / (RealType)(total_mod * fold_count[top]);
+            for ( index_t node = 0; node < output_node_size; ++node ) {
+                if ( node != top ) {
+                    RealType max_v = (sum[node] + (RealType)(rest_mod_size * fold_count[node])) / (RealType)(total_mod * fold_count[node]);
+                    if ( max_v >= top_min ) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // 現時点の平均で1位と2位の差を見る
+        RealType top_v    = sum[top] / (RealType)(mod_count * fold_count[top]);
+        RealType second_v = std::numeric_limits<RealType>::lowest();
+        for ( index_t node = 0; node < output_node_size; ++node ) {
+            if ( node != top ) {
+                second_v = std::max(second_v, sum[node] / (RealType)(mod_count * fold_count[node]));
+            }
+        }
+        return (top_v - second_v) >= m_anytime_margin;
+    }
+
     /**
      * @brief  モデルの情報を表示
      * @detail モデルの情報を表示する
@@ -319,6 +578,9 @@ protected:
         else {
             os << indent << " training  modulation size : " << m_training_create.modulation_size  << std::endl;
             os << indent << " inference modulation size : " << m_inference_create.modulation_size << std::endl;
+            if ( m_anytime_stage_size > 1 ) {
+                os << indent << " anytime stage size        : " << m_anytime_stage_size << std::endl;
+            }
 
             // 子レイヤーの表示
             if ( m_binary_mode ) {
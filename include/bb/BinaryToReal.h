@@ -99,6 +99,7 @@ public:
     }
 
     std::string GetClassName(void) const { return "BinaryToReal"; }
+    bool IsForwardReplayable(void) const { return true; }
 
     
     void SetModulationSize(index_t modulation_size)
@@ -160,13 +161,31 @@ public:
             return x_buf;
         }
 
-        BB_ASSERT(x_buf.GetType() == DataType<BinType>::type);
-
         // SetInputShpaeされていなければ初回に設定
         if (x_buf.GetShape() != m_input_shape) {
             SetInputShape(x_buf.GetShape());
         }
 
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
+        if ( typeid(BinType) == typeid(RealType) && !m_binary_mode ) {
+            return x_buf;
+        }
+
+        BB_ASSERT(x_buf.GetType() == DataType<BinType>::type);
+        BB_ASSERT(x_buf.GetShape() == m_input_shape);
+
         // 戻り値の型を設定
         BB_ASSERT(x_buf.GetFrameSize() % m_modulation_size == 0);
         FrameBuffer y_buf(x_buf.GetFrameSize() / m_modulation_size, m_output_shape, DataType<RealType>::type);
@@ -217,13 +217,12 @@ public:
             auto y_ptr     = m_y_buf.Lock<FT>();
             auto param_ptr = m_param->Lock<BT>();
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < input_node_size; ++node) {
+            ParallelFor(0, input_node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto x = x_ptr.Get(frame, node);
                     y_ptr.Set(frame, node, x);
                 }
-            }
+            });
 
             index_t coeff_size = output_node_size - input_node_size;
             if ( DataType<FT>::type == BB_TYPE_BIT ) {
@@ -236,13 +235,12 @@ public:
                 }
             }
             else {
-                #pragma omp parallel for
-                for (index_t i = 0; i < coeff_size; ++i) {
+                ParallelFor(0, coeff_size, [&](index_t i) {
                     auto coeff = param_ptr[i];
                     for (index_t frame = 0; frame < frame_size; ++frame) {
                         y_ptr.Set(frame, input_node_size + i, (FT)coeff);
                     }
-                }
+                });
             }
 
             return m_y_buf;
@@ -292,23 +290,21 @@ public:
             auto dx_ptr   = m_dx_buf.Lock<BT>();
             auto grad_ptr = m_grad->Lock<BT>();
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < input_node_size; ++node) {
+            ParallelFor(0, input_node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto dy = dy_ptr.Get(frame, node);
                     dx_ptr.Set(frame, node, dy);
                 }
-            }
+            });
 
             index_t coeff_size = output_node_size - input_node_size;
-            #pragma omp parallel for
-            for (index_t i = 0; i < coeff_size; ++i) {
+            ParallelFor(0, coeff_size, [&](index_t i) {
                 BT dy = 0;
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     dy += dy_ptr.Get(frame, input_node_size + i);
                 }
                 grad_ptr[i] += dy / (BT)frame_size;
-            }
+            });
 
             return m_dx_buf;
         }
@@ -14,6 +14,7 @@
 
 #include "bb/ShuffleSet.h"
 #include "bb/Utility.h"
+#include "bb/ThreadPool.h"
 
 
 #if BB_WITH_CEREAL
@@ -26,6 +27,184 @@
 
 namespace bb {
 
+// 接続テーブル生成用の乱数種 (基準の種と番号から独立した系列を作る)
+inline std::uint64_t ConnectionTable_MakeSeed(std::uint64_t seed, std::uint64_t index)
+{
+    std::uint64_t z = seed + (index + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief  接続テーブルの生成
+ * @detail 出力ノード node の i 番目の接続先を table[offset[node] + i] に生成する
+ *         出力ノード(もしくはノードのまとまり)毎に種を分けて並列に生成するので
+ *         スレッド数に依らず同じ結果となる
+ *         ・random    : 入力ノード数分の接続をまとめて1つの ShuffleSet から配る
+ *         ・pointwise : 位置(x, y)毎にチャネル方向の ShuffleSet から配る
+ *         ・depthwise : チャネル毎に平面方向の ShuffleSet から配る
+ *         ・gauss     : 出力位置に対応する入力位置を中心にガウス分布で選ぶ
+ *         ・serial    : 連番
+ * @param  table         接続先(出力)
+ * @param  offset        出力ノード毎の先頭位置 (出力ノード数+1 個)
+ * @param  input_shape   入力形状
+ * @param  output_shape  出力形状
+ * @param  seed          乱数種
+ * @param  connection    接続ルール
+ */
+inline void ConnectionTable_MakeTable
+    (
+        std::vector<index_t>        &table,
+        std::vector<index_t> const  &offset,
+        indices_t const             &input_shape,
+        indices_t const             &output_shape,
+        std::uint64_t               seed,
+        std::string                 connection = ""
+    )
+{
+    auto input_node_size  = GetShapeSize(input_shape);
+    auto output_node_size = GetShapeSize(output_shape);
+
+    BB_ASSERT((index_t)offset.size() == output_node_size + 1);
+    table.resize((size_t)offset[output_node_size]);
+
+    auto argv = SplitString(connection);
+
+    if (argv.size() > 0 && argv[0] == "pointwise") {
+        BB_ASSERT(input_shape.size() == 3);
+        BB_ASSERT(output_shape.size() == 3);
+        BB_ASSERT(input_shape[0] == output_shape[0]);
+        BB_ASSERT(input_shape[1] == output_shape[1]);
+        ParallelFor(0, output_shape[0] * output_shape[1], [&](index_t xy) {
+            index_t x = xy % output_shape[0];
+            index_t y = xy / output_shape[0];
+
+            // 接続先をシャッフル
+            ShuffleSet<index_t> ss(input_shape[2], ConnectionTable_MakeSeed(seed, xy));
+            for (index_t c = 0; c < output_shape[2]; ++c) {
+                // 入力をランダム接続
+                index_t output_node = GetShapeIndex({x, y, c}, output_shape);
+                index_t size        = offset[output_node + 1] - offset[output_node];
+                index_t *set        = &table[(size_t)offset[output_node]];
+                ss.GetRandomSet(size, set);
+                for (index_t i = 0; i < size; ++i) {
+                    set[i] = GetShapeIndex({x, y, set[i]}, input_shape);
+                }
+            }
+        });
+        return;
+    }
+
+    if (argv.size() > 0 && argv[0] == "depthwise") {
+        BB_ASSERT(input_shape.size() == 3);
+        BB_ASSERT(output_shape.size() == 3);
+        BB_ASSERT(input_shape[2] == output_shape[2]);
+        ParallelFor(0, output_shape[2], [&](index_t c) {
+            // 接続先をシャッフル
+            ShuffleSet<index_t> ss(input_shape[0] * input_shape[1], ConnectionTable_MakeSeed(seed, c));
+            for (index_t y = 0; y < output_shape[1]; ++y) {
+                for (index_t x = 0; x < output_shape[0]; ++x) {
+                    // 入力をランダム接続
+                    index_t output_node = GetShapeIndex({x, y, c}, output_shape);
+                    index_t size        = offset[output_node + 1] - offset[output_node];
+                    index_t *set        = &table[(size_t)offset[output_node]];
+                    ss.GetRandomSet(size, set);
+                    for (index_t i = 0; i < size; ++i) {
+                        index_t iy = set[i] / input_shape[0];
+                        index_t ix = set[i] % input_shape[0];
+                        set[i] = GetShapeIndex({ix, iy, c}, input_shape);
+                        BB_DEBUG_ASSERT(set[i] >= 0 && set[i] < input_node_size);
+                    }
+                }
+            }
+        });
+        return;
+    }
+
+    if ( argv.size() > 0 && argv[0] == "gauss" ) {
+        // ガウス分布で結線
+        int n = (int)input_shape.size();
+        BB_ASSERT((int)output_shape.size() == n);
+        std::vector<double> step(n);
+        std::vector<double> sigma(n);
+        for (int i = 0; i < n; ++i) {
+            step[i]  = (double)(input_shape[i] - 1) / (double)(output_shape[i] - 1);
+            sigma[i] = (double)input_shape[i] / (double)output_shape[i];
+        }
+
+        ParallelFor(0, output_node_size, [&](index_t output_node) {
+            std::mt19937_64                     mt(ConnectionTable_MakeSeed(seed, output_node));
+            std::normal_distribution<double>    norm_dist(0.0, 1.0);
+
+            // 入力の参照基準位置算出
+            auto output_index = GetShapeIndices(output_node, output_shape);
+            std::vector<double> input_offset(n);
+            for (int i = 0; i < n; ++i) {
+                input_offset[i] = output_index[i] * step[i];
+            }
+
+            index_t size = offset[output_node + 1] - offset[output_node];
+            index_t *set = &table[(size_t)offset[output_node]];
+            std::vector<double> input_position(n);
+            for ( index_t i = 0; i < size; ++i ) {
+                for ( ; ; ) {
+                    for ( int j = 0; j < n; ++j ) {
+                        input_position[j] = input_offset[j] + norm_dist(mt) * sigma[j];
+                    }
+                    auto input_index = RegurerlizeIndices(input_position, input_shape);
+                    auto input_node  = GetShapeIndex(input_index, input_shape);
+                    if ( std::find(set, set + i, input_node) == set + i ) {
+                        set[i] = input_node;
+                        break;
+                    }
+                }
+            }
+        });
+        return;
+    }
+
+    if ( argv.size() > 0 && argv[0] == "serial" ) {
+        // 連番結線
+        ParallelFor(0, output_node_size, [&](index_t output_node) {
+            for ( index_t i = offset[output_node]; i < offset[output_node + 1]; ++i ) {
+                table[(size_t)i] = i % input_node_size;
+            }
+        });
+        return;
+    }
+
+    if ( argv.size() == 0 || argv[0] == "random" ) {
+        // ランダム結線
+        // 入力ノード数分の接続をまとめて1つの ShuffleSet から配ることで、
+        // まとまりの中では各入力がほぼ均等に使われるようにする
+        index_t total      = offset[output_node_size];
+        index_t block_size = 1;
+        if ( total > 0 ) {
+            index_t avg_size = std::max((index_t)1, total / output_node_size);
+            block_size = std::max((index_t)1, (input_node_size + avg_size - 1) / avg_size);
+        }
+        index_t block_count = (output_node_size + block_size - 1) / block_size;
+
+        ParallelFor(0, block_count, [&](index_t block) {
+            // 接続先をシャッフル
+            ShuffleSet<index_t> ss(input_node_size, ConnectionTable_MakeSeed(seed, block));
+            index_t node_begin = block * block_size;
+            index_t node_end   = std::min(node_begin + block_size, output_node_size);
+            for (index_t node = node_begin; node < node_end; ++node) {
+                // 入力をランダム接続
+                index_t size = offset[node + 1] - offset[node];
+                ss.GetRandomSet(size, &table[(size_t)offset[node]]);
+            }
+        });
+        return;
+    }
+
+    std::cout << "unknown connection rule : \"" << argv[0] <<  "\"" << std::endl;
+    BB_ASSERT(0);
+}
+
+
 // 接続テーブル
 class ConnectionTable
 {
@@ -111,141 +290,35 @@ public:
     index_t   GetInputNodeSize(void)  const { return GetShapeSize(GetInputShape());  }
     index_t   GetOutputNodeSize(void) const { return GetShapeSize(GetOutputShape());  }
 
-    // Initialize connection
-    void InitializeConnection(std::uint64_t seed, std::string connection = "")
+    /**
+     * @brief  接続の一括設定
+     * @detail 出力ノード node の i 番目の接続を table[offset[node] + i] に設定する
+     *         派生クラスでまとめて書き込めるならオーバーライドする
+     */
+    virtual void SetInputConnectionTable(std::vector<index_t> const &table, std::vector<index_t> const &offset)
     {
-        auto input_shape  = this->GetInputShape();
-        auto output_shape = this->GetOutputShape();
-
-        auto input_node_size  = GetShapeSize(input_shape);
-        auto output_node_size = GetShapeSize(output_shape);
-
-        auto argv = SplitString(connection);
-
-        if (argv.size() > 0 && argv[0] == "pointwise") {
-            BB_ASSERT(input_shape.size() == 3);
-            BB_ASSERT(output_shape.size() == 3);
-            BB_ASSERT(input_shape[0] == output_shape[0]);
-            BB_ASSERT(input_shape[1] == output_shape[1]);
-            std::mt19937_64 mt(seed);
-            for (index_t y = 0; y < output_shape[1]; ++y) {
-                for (index_t x = 0; x < output_shape[0]; ++x) {
-                    // shuffle index
-                    ShuffleSet<index_t> ss(input_shape[2], mt());
-                    for (index_t c = 0; c < output_shape[2]; ++c) {
-                        // random connection
-                        index_t  input_size = GetInputConnectionSize({x, y, c});
-                        auto random_set = ss.GetRandomSet(input_size);
-                        for (index_t i = 0; i < input_size; ++i) {
-                            SetInputConnection({x, y, c}, i, {x, y, random_set[i]});
-                        }
-                    }
-                }
-            }
-            return;
-        }
-
-        if (argv.size() > 0 && argv[0] == "depthwise") {
-            BB_ASSERT(input_shape.size() == 3);
-            BB_ASSERT(output_shape.size() == 3);
-            BB_ASSERT(input_shape[2] == output_shape[2]);
-            std::mt19937_64 mt(seed);
-            for (index_t c = 0; c < output_shape[2]; ++c) {
-                // shuffle index
-                ShuffleSet<index_t> ss(input_shape[0] * input_shape[1], mt());
-                for (index_t y = 0; y < output_shape[1]; ++y) {
-                    for (index_t x = 0; x < output_shape[0]; ++x) {
-                        // random connection
-                        index_t  input_size = GetInputConnectionSize({x, y, c});
-                        auto random_set = ss.GetRandomSet(input_size);
-                        for (index_t i = 0; i < input_size; ++i) {
-                            index_t iy = random_set[i] / input_shape[0];
-                            index_t ix = random_set[i] % input_shape[0];
-
-                            index_t output_node = GetShapeIndex({x, y, c}, output_shape);
-                            index_t input_node  = GetShapeIndex({ix, iy, c}, input_shape);
-
-                            BB_ASSERT(output_node >= 0 && output_node < output_node_size);
-                            BB_ASSERT(input_node  >= 0 && input_node  < input_node_size);
-                            SetInputConnection(output_node, i, input_node);
-                        }
-                    }
-                }
+        index_t output_node_size = (index_t)offset.size() - 1;
+        for ( index_t node = 0; node < output_node_size; ++node ) {
+            for ( index_t i = offset[node]; i < offset[node + 1]; ++i ) {
+                SetInputConnection(node, i - offset[node], table[(size_t)i]);
             }
-            return;
-        }
-
-        if ( argv.size() > 0 && argv[0] == "gauss" ) {
-            // ガウス分布で結線
-            int n = (int)input_shape.size();
-            std::vector<double> step(n);
-            std::vector<double> sigma(n);
-            for (int i = 0; i < n; ++i) {
-                step[i]  = (double)(input_shape[i] - 1) / (double)(output_shape[i] - 1);
-                sigma[i] = (double)input_shape[i] / (double)output_shape[i];
-            }
-
-            std::mt19937_64                     mt(seed);
-            std::normal_distribution<double>    norm_dist(0.0, 1.0);
-            indices_t           output_index(n, 0);
-            do {
-                // 入力の参照基準位置算出
-                std::vector<double> input_offset(n);
-                for (int i = 0; i < n; ++i) {
-                    input_offset[i] = output_index[i] * step[i];
-                }
-
-                auto output_node = GetShapeIndex(output_index, output_shape);
-                auto m = GetInputConnectionSize(output_node);
-                std::set<index_t>   s;
-                std::vector<double> input_position(n);
-                for ( int i = 0; i < m; ++i ) {
-                    for ( ; ; ) {
-                        for ( int j = 0; j < n; ++j ) {
-                            input_position[j] = input_offset[j] + norm_dist(mt) * sigma[j];
-                        }
-                        auto input_index = RegurerlizeIndices(input_position, input_shape);
-                        auto input_node  = GetShapeIndex(input_index, input_shape);
-                        if ( s.count(input_node) == 0 ){
-                            SetInputConnection(output_node, i, input_node);
-                            s.insert(input_node);
-                            break;
-                        }
-                    }
-                }
-            } while ( GetNextIndices(output_index, output_shape) );
-            return;
         }
+    }
 
-        if ( argv.size() > 0 && argv[0] == "serial" ) {
-            // 連番結線
-            index_t input_node = 0;
-            for ( index_t output_node = 0; output_node < output_node_size; ++output_node ) {
-                index_t m = GetInputConnectionSize(output_node);
-                for ( index_t i = 0; i < m; ++i ) {
-                    SetInputConnection(output_node, i, input_node % input_node_size);
-                    ++input_node;
-                }
-            }
-            return;
-        }
+    // Initialize connection
+    void InitializeConnection(std::uint64_t seed, std::string connection = "")
+    {
+        auto output_node_size = GetShapeSize(this->GetOutputShape());
 
-        if ( argv.size() == 0 || argv[0] == "random" ) {
-            // ランダム結線
-            ShuffleSet<index_t> ss(input_node_size, seed);    // 接続先をシャッフル
-            for (index_t node = 0; node < output_node_size; ++node) {
-                // 入力をランダム接続
-                index_t  input_size = GetInputConnectionSize(node);
-                auto random_set = ss.GetRandomSet(input_size);
-                for (index_t i = 0; i < input_size; ++i) {
-                    SetInputConnection(node, i, random_set[i]);
-                }
-            }
-            return;
+        std::vector<index_t> offset(output_node_size + 1);
+        offset[0] = 0;
+        for ( index_t node = 0; node < output_node_size; ++node ) {
+            offset[node + 1] = offset[node] + GetInputConnectionSize(node);
         }
 
-        std::cout << "unknown connection rule : \"" << argv[0] <<  "\"" << std::endl;
-        BB_ASSERT(0);
+        std::vector<index_t> table;
+        ConnectionTable_MakeTable(table, offset, this->GetInputShape(), this->GetOutputShape(), seed, connection);
+        SetInputConnectionTable(table, offset);
     }
 };
 
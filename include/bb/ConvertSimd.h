@@ -0,0 +1,451 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+
+
+namespace bb {
+
+
+// [FrameBuffer 用の型変換/転置カーネル]
+//  ・行変換 : 1ノード分(フレーム方向に連続)の型変換
+//       fp32 -> bit   : cmp + movemask で 8フレームを1バイトに詰める
+//       bit  -> fp32  : 1バイトをブロードキャストしてビット位置の比較で 0/1 に展開
+//       uint8 -> fp32 : 整数拡張 + 変換 + スケーリング
+//       fp32 <-> fp16 : F16C (vcvtps2ph / vcvtph2ps)
+//  ・転置 : サンプル優先 rows[frame][node] とノード優先 [node][frame] の変換
+//       8x8 のブロックをレジスタ上で転置する(呼び出し側でノード/フレームを
+//       キャッシュに収まる大きさに区切って並列化する)
+//  端数は汎用版と同じ式で1要素ずつ処理するので、結果は汎用版と一致する
+
+
+// ---------------------------------
+//  fp16 (IEEE754 binary16) 変換
+// ---------------------------------
+
+// fp32 -> fp16 (最近接偶数丸め)
+inline std::uint16_t Fp32ToFp16(float f)
+{
+    std::uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+
+    std::uint32_t sign = (x >> 16) & 0x8000;
+    std::uint32_t absx = x & 0x7fffffff;
+
+    // inf / nan
+    if ( absx >= 0x7f800000 ) {
+        return (std::uint16_t)(sign | 0x7c00 | (absx > 0x7f800000 ? 0x0200 : 0));
+    }
+
+    // オーバーフロー
+    if ( absx >= 0x477ff000 ) {
+        return (std::uint16_t)(sign | 0x7c00);
+    }
+
+    // 非正規化数
+    if ( absx < 0x38800000 ) {
+        if ( absx < 0x33000000 ) {
+            return (std::uint16_t)sign;
+        }
+        std::uint32_t e     = absx >> 23;
+        std::uint32_t m     = (absx & 0x007fffff) | 0x00800000;
+        std::uint32_t shift = 126 - e;
+        std::uint32_t h     = m >> shift;
+        std::uint32_t rem   = m & ((1u << shift) - 1);
+        std::uint32_t half  = 1u << (shift - 1);
+        if ( rem > half || (rem == half && (h & 1)) ) { ++h; }
+        return (std::uint16_t)(sign | h);
+    }
+
+    // 正規化数 (指数のバイアスを 127 から 15 に付け替え)
+    std::uint32_t h   = (absx - 0x38000000) >> 13;
+    std::uint32_t rem = absx & 0x1fff;
+    if ( rem > 0x1000 || (rem == 0x1000 && (h & 1)) ) { ++h; }
+    return (std::uint16_t)(sign | h);
+}
+
+// fp16 -> fp32
+inline float Fp16ToFp32(std::uint16_t h)
+{
+    std::uint32_t sign = (std::uint32_t)(h & 0x8000) << 16;
+    std::uint32_t e    = (h >> 10) & 0x1f;
+    std::uint32_t m    = h & 0x03ff;
+
+    std::uint32_t x;
+    if ( e == 0x1f ) {
+        x = sign | 0x7f800000 | (m << 13);
+    }
+    else if ( e == 0 ) {
+        if ( m == 0 ) {
+            x = sign;
+        }
+        else {
+            // 非正規化数は正規化し直す
+            e = 113;
+            while ( (m & 0x0400) == 0 ) {
+                m <<= 1;
+                --e;
+            }
+            x = sign | (e << 23) | ((m & 0x03ff) << 13);
+        }
+    }
+    else {
+        x = sign | ((e + 112) << 23) | (m << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+
+// ---------------------------------
+//  行変換 (size フレーム分)
+// ---------------------------------
+
+// fp32 -> bit
+inline void simd_fp32_ConvertToBit(float const *src, std::uint8_t *dst, index_t size)
+{
+    for ( index_t i = 0; i < size; i += 8 ) {
+        index_t n = std::min((index_t)8, size - i);
+        int     b = 0;
+        for ( index_t j = 0; j < n; ++j ) {
+            if ( src[i + j] > 0 ) { b |= (1 << j); }
+        }
+        dst[i / 8] = (std::uint8_t)b;
+    }
+}
+
+BB_TARGET_AVX2 inline void simd_fp32_ConvertToBit_avx2(float const *src, std::uint8_t *dst, index_t size)
+{
+    __m256  zero = _mm256_setzero_ps();
+    index_t i    = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+        __m256 x = _mm256_loadu_ps(&src[i]);
+        dst[i / 8] = (std::uint8_t)_mm256_movemask_ps(_mm256_cmp_ps(x, zero, _CMP_GT_OQ));
+    }
+    if ( i < size ) {
+        simd_fp32_ConvertToBit(&src[i], &dst[i / 8], size - i);
+    }
+}
+
+// bit -> fp32
+inline void simd_bit_ConvertToFp32(std::uint8_t const *src, float *dst, index_t size)
+{
+    for ( index_t i = 0; i < size; ++i ) {
+        dst[i] = ((src[i / 8] >> (i % 8)) & 1) ? 1.0f : 0.0f;
+    }
+}
+
+BB_TARGET_AVX2 inline void simd_bit_ConvertToFp32_avx2(std::uint8_t const *src, float *dst, index_t size)
+{
+    __m256i mask = _mm256_set_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    __m256  one  = _mm256_set1_ps(1.0f);
+    index_t i    = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+        __m256i b = _mm256_and_si256(_mm256_set1_epi32(src[i / 8]), mask);
+        __m256i m = _mm256_cmpeq_epi32(b, mask);
+        _mm256_storeu_ps(&dst[i], _mm256_and_ps(_mm256_castsi256_ps(m), one));
+    }
+    for ( ; i < size; ++i ) {
+        dst[i] = ((src[i / 8] >> (i % 8)) & 1) ? 1.0f : 0.0f;
+    }
+}
+
+// uint8 -> fp32 (スケーリング付き)
+inline void simd_uint8_ConvertToFp32(std::uint8_t const *src, float *dst, index_t size, float scale)
+{
+    for ( index_t i = 0; i < size; ++i ) {
+        dst[i] = (float)src[i] * scale;
+    }
+}
+
+BB_TARGET_AVX2 inline void simd_uint8_ConvertToFp32_avx2(std::uint8_t const *src, float *dst, index_t size, float scale)
+{
+    __m256  s = _mm256_set1_ps(scale);
+    index_t i = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+        __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)&src[i]));
+        _mm256_storeu_ps(&dst[i], _mm256_mul_ps(_mm256_cvtepi32_ps(x), s));
+    }
+    for ( ; i < size; ++i ) {
+        dst[i] = (float)src[i] * scale;
+    }
+}
+
+// fp32 -> fp16
+inline void simd_fp32_ConvertToFp16(float const *src, std::uint16_t *dst, index_t size)
+{
+    for ( index_t i = 0; i < size; ++i ) {
+        dst[i] = Fp32ToFp16(src[i]);
+    }
+}
+
+BB_TARGET_AVX2_F16C inline void simd_fp32_ConvertToFp16_f16c(float const *src, std::uint16_t *dst, index_t size)
+{
+    index_t i = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(&src[i]), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128((__m128i *)&dst[i], h);
+    }
+    for ( ; i < size; ++i ) {
+        dst[i] = Fp32ToFp16(src[i]);
+    }
+}
+
+// fp16 -> fp32
+inline void simd_fp16_ConvertToFp32(std::uint16_t const *src, float *dst, index_t size)
+{
+    for ( index_t i = 0; i < size; ++i ) {
+        dst[i] = Fp16ToFp32(src[i]);
+    }
+}
+
+BB_TARGET_AVX2_F16C inline void simd_fp16_ConvertToFp32_f16c(std::uint16_t const *src, float *dst, index_t size)
+{
+    index_t i = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+        __m128i h = _mm_loadu_si128((__m128i const *)&src[i]);
+        _mm256_storeu_ps(&dst[i], _mm256_cvtph_ps(h));
+    }
+    for ( ; i < size; ++i ) {
+        dst[i] = Fp16ToFp32(src[i]);
+    }
+}
+
+
+// ---------------------------------
+//  転置
+// ---------------------------------
+
+// 8x8 の転置 (r[i] の j 番目と r[j] の i 番目を入れ替える)
+BB_TARGET_AVX2 inline void simd_fp32_Transpose8x8_avx2(__m256 r[8])
+{
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// 8要素を fp32 として読む
+BB_TARGET_AVX2 inline __m256 simd_LoadFp32x8_avx2(float const *p)
+{
+    return _mm256_loadu_ps(p);
+}
+
+BB_TARGET_AVX2 inline __m256 simd_LoadFp32x8_avx2(std::uint8_t const *p)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)p)));
+}
+
+
+// rows[frame][node] -> dst[node * dst_stride + frame] の 8x8 ブロック
+template<typename VecType>
+BB_TARGET_AVX2 inline void simd_fp32_TransposeFromRows8x8_avx2(VecType const * const *rows, index_t frame, index_t node, float *dst, index_t dst_stride, __m256 scale)
+{
+    __m256 r[8];
+    for ( int i = 0; i < 8; ++i ) {
+        r[i] = _mm256_mul_ps(simd_LoadFp32x8_avx2(&rows[frame + i][node]), scale);
+    }
+    simd_fp32_Transpose8x8_avx2(r);
+    for ( int i = 0; i < 8; ++i ) {
+        _mm256_storeu_ps(&dst[(node + i) * dst_stride + frame], r[i]);
+    }
+}
+
+// rows[frame][node] -> dst[node * dst_stride + frame] (fp32、scale 倍して格納)
+// ノード側の行は 16フレーム(64byte)ずつまとめて書く
+// (ストライドが 2のべき乗だと同じキャッシュセットに集中するので、ラインを使い切ってから次へ進む)
+template<typename VecType>
+BB_TARGET_AVX2 inline void simd_fp32_TransposeFromRows_avx2(VecType const * const *rows, index_t frame_begin, index_t frame_end,
+                index_t node_begin, index_t node_end, float *dst, index_t dst_stride, float scale)
+{
+    __m256  s = _mm256_set1_ps(scale);
+    index_t frame = frame_begin;
+    for ( ; frame + 16 <= frame_end; frame += 16 ) {
+        index_t node = node_begin;
+        for ( ; node + 8 <= node_end; node += 8 ) {
+            simd_fp32_TransposeFromRows8x8_avx2<VecType>(rows, frame,     node, dst, dst_stride, s);
+            simd_fp32_TransposeFromRows8x8_avx2<VecType>(rows, frame + 8, node, dst, dst_stride, s);
+        }
+        for ( ; node < node_end; ++node ) {
+            for ( index_t i = 0; i < 16; ++i ) {
+                dst[node * dst_stride + frame + i] = (float)rows[frame + i][node] * scale;
+            }
+        }
+    }
+    for ( ; frame + 8 <= frame_end; frame += 8 ) {
+        index_t node = node_begin;
+        for ( ; node + 8 <= node_end; node += 8 ) {
+            simd_fp32_TransposeFromRows8x8_avx2<VecType>(rows, frame, node, dst, dst_stride, s);
+        }
+        for ( ; node < node_end; ++node ) {
+            for ( index_t i = 0; i < 8; ++i ) {
+                dst[node * dst_stride + frame + i] = (float)rows[frame + i][node] * scale;
+            }
+        }
+    }
+    for ( ; frame < frame_end; ++frame ) {
+        for ( index_t node = node_begin; node < node_end; ++node ) {
+            dst[node * dst_stride + frame] = (float)rows[frame][node] * scale;
+        }
+    }
+}
+
+// rows[frame][node] -> bit (dst はフレーム0のバイト位置、frame_begin は 8 の倍数)
+BB_TARGET_AVX2 inline void simd_bit_TransposeFromRows_avx2(float const * const *rows, index_t frame_begin, index_t frame_end,
+                index_t node_begin, index_t node_end, std::uint8_t *dst, index_t dst_stride, float scale)
+{
+    __m256  s    = _mm256_set1_ps(scale);
+    __m256  zero = _mm256_setzero_ps();
+    index_t frame = frame_begin;
+    for ( ; frame + 8 <= frame_end; frame += 8 ) {
+        index_t node = node_begin;
+        for ( ; node + 8 <= node_end; node += 8 ) {
+            __m256 r[8];
+            for ( int i = 0; i < 8; ++i ) {
+                r[i] = _mm256_mul_ps(_mm256_loadu_ps(&rows[frame + i][node]), s);
+            }
+            simd_fp32_Transpose8x8_avx2(r);
+            for ( int i = 0; i < 8; ++i ) {
+                dst[(node + i) * dst_stride + frame / 8] = (std::uint8_t)_mm256_movemask_ps(_mm256_cmp_ps(r[i], zero, _CMP_GT_OQ));
+            }
+        }
+        for ( ; node < node_end; ++node ) {
+            int b = 0;
+            for ( index_t i = 0; i < 8; ++i ) {
+                if ( rows[frame + i][node] * scale > 0 ) { b |= (1 << i); }
+            }
+            dst[node * dst_stride + frame / 8] = (std::uint8_t)b;
+        }
+    }
+    for ( ; frame < frame_end; ++frame ) {
+        for ( index_t node = node_begin; node < node_end; ++node ) {
+            std::uint8_t &d   = dst[node * dst_stride + frame / 8];
+            std::uint8_t  bit = (std::uint8_t)(1 << (frame % 8));
+            d = (rows[frame][node] * scale > 0) ? (std::uint8_t)(d | bit) : (std::uint8_t)(d & ~bit);
+        }
+    }
+}
+
+// src[node * src_stride + frame] (fp32) -> rows[frame][node] の 8x8 ブロック
+BB_TARGET_AVX2 inline void simd_fp32_TransposeToRows8x8_avx2(float const *src, index_t src_stride, index_t frame, index_t node, float * const *rows)
+{
+    __m256 r[8];
+    for ( int i = 0; i < 8; ++i ) {
+        r[i] = _mm256_loadu_ps(&src[(node + i) * src_stride + frame]);
+    }
+    simd_fp32_Transpose8x8_avx2(r);
+    for ( int i = 0; i < 8; ++i ) {
+        _mm256_storeu_ps(&rows[frame + i][node], r[i]);
+    }
+}
+
+// src[node * src_stride + frame] (fp32) -> rows[frame][node]
+// ノード側の行は 16フレーム(64byte)ずつまとめて読む
+BB_TARGET_AVX2 inline void simd_fp32_TransposeToRows_avx2(float const *src, index_t src_stride, index_t frame_begin, index_t frame_end,
+                index_t node_begin, index_t node_end, float * const *rows)
+{
+    index_t frame = frame_begin;
+    for ( ; frame + 16 <= frame_end; frame += 16 ) {
+        index_t node = node_begin;
+        for ( ; node + 8 <= node_end; node += 8 ) {
+            simd_fp32_TransposeToRows8x8_avx2(src, src_stride, frame,     node, rows);
+            simd_fp32_TransposeToRows8x8_avx2(src, src_stride, frame + 8, node, rows);
+        }
+        for ( ; node < node_end; ++node ) {
+            for ( index_t i = 0; i < 16; ++i ) {
+                rows[frame + i][node] = src[node * src_stride + frame + i];
+            }
+        }
+    }
+    for ( ; frame + 8 <= frame_end; frame += 8 ) {
+        index_t node = node_begin;
+        for ( ; node + 8 <= node_end; node += 8 ) {
+            simd_fp32_TransposeToRows8x8_avx2(src, src_stride, frame, node, rows);
+        }
+        for ( ; node < node_end; ++node ) {
+            for ( index_t i = 0; i < 8; ++i ) {
+                rows[frame + i][node] = src[node * src_stride + frame + i];
+            }
+        }
+    }
+    for ( ; frame < frame_end; ++frame ) {
+        for ( index_t node = node_begin; node < node_end; ++node ) {
+            rows[frame][node] = src[node * src_stride + frame];
+        }
+    }
+}
+
+// bit (src はフレーム0のバイト位置、frame_begin は 8 の倍数) -> rows[frame][node] (0/1)
+BB_TARGET_AVX2 inline void simd_bit_TransposeToRows_avx2(std::uint8_t const *src, index_t src_stride, index_t frame_begin, index_t frame_end,
+                index_t node_begin, index_t node_end, float * const *rows)
+{
+    __m256i mask = _mm256_set_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    __m256  one  = _mm256_set1_ps(1.0f);
+    index_t frame = frame_begin;
+    for ( ; frame + 8 <= frame_end; frame += 8 ) {
+        index_t node = node_begin;
+        for ( ; node + 8 <= node_end; node += 8 ) {
+            __m256 r[8];
+            for ( int i = 0; i < 8; ++i ) {
+                __m256i b = _mm256_and_si256(_mm256_set1_epi32(src[(node + i) * src_stride + frame / 8]), mask);
+                r[i] = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(b, mask)), one);
+            }
+            simd_fp32_Transpose8x8_avx2(r);
+            for ( int i = 0; i < 8; ++i ) {
+                _mm256_storeu_ps(&rows[frame + i][node], r[i]);
+            }
+        }
+        for ( ; node < node_end; ++node ) {
+            for ( index_t i = 0; i < 8; ++i ) {
+                rows[frame + i][node] = ((src[node * src_stride + (frame + i) / 8] >> ((frame + i) % 8)) & 1) ? 1.0f : 0.0f;
+            }
+        }
+    }
+    for ( ; frame < frame_end; ++frame ) {
+        for ( index_t node = node_begin; node < node_end; ++node ) {
+            rows[frame][node] = ((src[node * src_stride + frame / 8] >> (frame % 8)) & 1) ? 1.0f : 0.0f;
+        }
+    }
+}
+
+
+}
+
+
+// end of file
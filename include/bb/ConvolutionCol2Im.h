@@ -74,6 +74,7 @@ public:
     }
     
     std::string GetClassName(void) const { return "ConvolutionCol2Im"; }
+    bool IsForwardReplayable(void) const { return true; }
 
     int GetChannel(void) const { return m_c_size; }
     int GetHeight(void)  const { return m_h_size; }
@@ -123,6 +124,19 @@ public:
 
 
     FrameBuffer Forward(FrameBuffer x_buf, bool train=true)
+    {
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
     {
         BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
 
@@ -185,15 +199,14 @@ public:
             auto hw_size = m_h_size * m_w_size;
 
             for (index_t c = 0; c < m_c_size; ++c) {
-                #pragma omp parallel for
-                for (index_t xy = 0; xy < hw_size; ++xy) {
+                ParallelFor(0, hw_size, [&](index_t xy) {
                     for ( index_t output_frame = 0; output_frame < output_frame_size; ++output_frame ) {
                         index_t output_node = c * hw_size + xy;
                         index_t input_frame = output_frame * hw_size + xy;
                         index_t input_node  = c;
                         y_ptr.Set(output_frame, output_node, x_ptr.Get(input_frame, input_node));
                     }
-                }
+                });
             }
             return y_buf;
         }
@@ -206,12 +219,11 @@ public:
             for (index_t output_frame = 0; output_frame < output_frame_size; ++output_frame) {
                 for (index_t y = 0; y < m_h_size; ++y) {
                     for (index_t x = 0; x < m_w_size; ++x) {
-                        #pragma omp parallel for
-                        for (index_t c = 0; c < m_c_size; ++c) {
+                        ParallelFor(0, m_c_size, [&](index_t c) {
                             index_t input_node = c;
                             index_t output_node = (c*m_h_size + y)*m_w_size + x;
                             y_ptr.Set(output_frame, output_node, x_ptr.Get(input_frame, input_node));
-                        }
+                        });
                         ++input_frame;
                     }
                 }
@@ -259,8 +271,7 @@ public:
             auto hw_size = m_h_size * m_w_size;
 
             for (index_t c = 0; c < m_c_size; ++c) {
-                #pragma omp parallel for
-                for (index_t xy = 0; xy < hw_size; ++xy) {
+                ParallelFor(0, hw_size, [&](index_t xy) {
                     for (index_t output_frame = 0; output_frame < output_frame_size; ++output_frame) {
                         index_t output_node = c * hw_size + xy;
                         index_t input_frame = output_frame * hw_size + xy;
@@ -268,7 +279,7 @@ public:
 
                         dx_ptr.Set(input_frame, input_node, dy_ptr.Get(output_frame, output_node));
                     }
-                }
+                });
             }
 
             return dx_buf;
@@ -283,12 +294,11 @@ public:
             for (index_t output_frame = 0; output_frame < output_frame_size; ++output_frame) {
                 for (index_t y = 0; y < m_h_size; ++y) {
                     for (index_t x = 0; x < m_w_size; ++x) {
-                        #pragma omp parallel for
-                        for (index_t c = 0; c < m_c_size; ++c) {
+                        ParallelFor(0, m_c_size, [&](index_t c) {
                             index_t output_node = (c*m_h_size + y)*m_w_size + x;
                             index_t input_node = c;
                             dx_ptr.Set(input_frame, input_node, dy_ptr.Get(output_frame, output_node));
-                        }
+                        });
                         ++input_frame;
                     }
                 }
@@ -107,6 +107,7 @@ public:
     }
 
     std::string GetClassName(void) const { return "ConvolutionIm2Col"; }
+    bool IsForwardReplayable(void) const { return true; }
 
 
     /**
@@ -188,7 +189,7 @@ protected:
     }
 
 
-    inline bool Border(int border_mode, index_t &x, index_t &y, index_t w, index_t h)
+    inline bool Border(int border_mode, index_t &x, index_t &y, index_t w, index_t h) const
     {
         switch ( border_mode ) {
         case BB_BORDER_REFLECT:
@@ -229,8 +230,6 @@ public:
 
     FrameBuffer Forward(FrameBuffer x_buf, bool train = true)
     {
-        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
-
         // SetInputShpaeされていなければ初回に設定
         if ( x_buf.GetShape() != m_input_shape ) {
             SetInputShape(x_buf.GetShape());
@@ -240,8 +239,28 @@ public:
         m_input_frame_size = x_buf.GetFrameSize();
         m_output_frame_size = m_input_frame_size * m_output_h_size * m_output_w_size;
 
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
+        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
+        BB_ASSERT(x_buf.GetShape() == m_input_shape);
+
+        // 出力Frameサイズ計算
+        index_t input_frame_size  = x_buf.GetFrameSize();
+        index_t output_frame_size = input_frame_size * m_output_h_size * m_output_w_size;
+
         // 出力形状設定
-        FrameBuffer y_buf(m_output_frame_size, m_output_shape, x_buf.GetType());
+        FrameBuffer y_buf(output_frame_size, m_output_shape, x_buf.GetType());
         
 #ifdef BB_WITH_CUDA
         if ( DataType<FT>::type == BB_TYPE_FP32 && !m_host_only && x_buf.IsDeviceAvailable() && y_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
@@ -255,7 +274,7 @@ public:
                     (int          )m_y_stride,
                     (int          )m_x_offset,
                     (int          )m_y_offset,
-                    (int          )m_input_frame_size,
+                    (int          )input_frame_size,
                     (int          )x_buf.GetFrameStride() / sizeof(float),
                     (int          )m_input_w_size,
                     (int          )m_input_h_size,
@@ -285,7 +304,7 @@ public:
                     (int        )m_y_stride,
                     (int        )m_x_offset,
                     (int        )m_y_offset,
-                    (int        )m_input_frame_size,
+                    (int        )input_frame_size,
                     (int        )x_buf.GetFrameStride() / sizeof(int),
                     (int        )m_input_w_size,
                     (int        )m_input_h_size,
@@ -309,35 +328,32 @@ public:
             auto x_ptr = x_buf.LockConst<FT>();
             auto y_ptr = y_buf.Lock<FT>(true);
 
-            for (index_t c = 0; c < m_input_c_size; ++c ) {
-                #pragma omp parallel for
-                for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
-                    #pragma omp parallel for
-                    for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
-                        for ( index_t output_frame = 0; output_frame < output_frame_size; ++output_frame ) {
-                            index_t input_frame = output_frame / output_size;
-                            index_t f           = output_frame % output_size;
-                            index_t iy = (f / m_output_w_size) * m_y_stride - m_y_offset + fy;
-                            index_t ix = (f % m_output_w_size) * m_x_stride - m_x_offset + fx;
-
-                            FT in_sig = m_border_value;
-                            if ( iy >= 0 && iy < m_input_h_size && ix >= 0 && ix < m_input_w_size ) {
-                                index_t input_node  = (c * m_input_h_size  + iy) * m_input_w_size  + ix;
-                                in_sig = x_ptr.Get(input_frame, input_node);
-                            }
-                            else {
-                              if ( Border(m_border_mode, ix, iy, m_input_w_size, m_input_h_size) ) {
-                                    index_t input_node = (c * m_input_h_size  + iy) * m_input_w_size  + ix;
-                                    in_sig = x_ptr.Get(input_frame, input_node);
-                                }
-                            }
-
-                            index_t output_node = (c * m_filter_h_size + fy) * m_filter_w_size + fx;    
-                            y_ptr.Set(output_frame, output_node, in_sig);
+            // 出力ノード(c, fy, fx)単位で1段の並列ループにまとめる
+            ParallelFor(0, m_input_c_size * m_filter_h_size * m_filter_w_size, [&](index_t output_node) {
+                index_t c  = output_node / (m_filter_h_size * m_filter_w_size);
+                index_t fy = (output_node / m_filter_w_size) % m_filter_h_size;
+                index_t fx = output_node % m_filter_w_size;
+                for ( index_t output_frame = 0; output_frame < output_frame_size; ++output_frame ) {
+                    index_t input_frame = output_frame / output_size;
+                    index_t f           = output_frame % output_size;
+                    index_t iy = (f / m_output_w_size) * m_y_stride - m_y_offset + fy;
+                    index_t ix = (f % m_output_w_size) * m_x_stride - m_x_offset + fx;
+
+                    FT in_sig = m_border_value;
+                    if ( iy >= 0 && iy < m_input_h_size && ix >= 0 && ix < m_input_w_size ) {
+                        index_t input_node  = (c * m_input_h_size  + iy) * m_input_w_size  + ix;
+                        in_sig = x_ptr.Get(input_frame, input_node);
+                    }
+                    else {
+                      if ( Border(m_border_mode, ix, iy, m_input_w_size, m_input_h_size) ) {
+                            index_t input_node = (c * m_input_h_size  + iy) * m_input_w_size  + ix;
+                            in_sig = x_ptr.Get(input_frame, input_node);
                         }
                     }
+
+                    y_ptr.Set(output_frame, output_node, in_sig);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -386,35 +402,32 @@ public:
             index_t iy_limit = (m_output_h_size - 1) * m_y_stride;
             index_t ix_limit = (m_output_w_size - 1) * m_x_stride;
 
-            for (index_t c = 0; c < m_input_c_size; ++c) {
-                #pragma omp parallel for
-                for (index_t y = 0; y < m_input_h_size; ++y ) {
-                    #pragma omp parallel for
-                    for (index_t x = 0; x < m_input_w_size; ++x ) {
-                        index_t input_node = (c * m_input_h_size + y) * m_input_w_size + x;
-                        index_t x_align = x % m_x_stride;
-                        index_t y_align = y % m_y_stride;
-                        for ( index_t input_frame = 0; input_frame < m_input_frame_size; ++input_frame ) {
-                            BT dx = 0; // dx_ptr.Get(input_frame, input_node);
-                            float dy = 0;
-                            for (index_t fy = y_align; fy < m_filter_h_size; fy += m_y_stride ) {
-                                index_t iy = y - fy + m_y_offset;
-                                if ( iy >= 0 && iy <= iy_limit ) {
-                                    for (index_t fx = x_align; fx < m_filter_w_size; fx += m_x_stride) {
-                                        index_t ix = x - fx + m_x_offset;
-                                        if ( ix >= 0 && ix <= ix_limit ) {
-                                            index_t output_frame = (input_frame * m_output_h_size + (iy/m_y_stride)) * m_output_w_size + (ix/m_x_stride);
-                                            index_t output_node  = (c * m_filter_h_size + fy) * m_filter_w_size + fx;
-                                            dy += dy_ptr.Get(output_frame, output_node);
-                                        }
-                                    }
+            // 入力ノード(c, y, x)単位で1段の並列ループにまとめる
+            ParallelFor(0, m_input_c_size * m_input_h_size * m_input_w_size, [&](index_t input_node) {
+                index_t c = input_node / (m_input_h_size * m_input_w_size);
+                index_t y = (input_node / m_input_w_size) % m_input_h_size;
+                index_t x = input_node % m_input_w_size;
+                index_t x_align = x % m_x_stride;
+                index_t y_align = y % m_y_stride;
+                for ( index_t input_frame = 0; input_frame < m_input_frame_size; ++input_frame ) {
+                    BT dx = 0; // dx_ptr.Get(input_frame, input_node);
+                    float dy = 0;
+                    for (index_t fy = y_align; fy < m_filter_h_size; fy += m_y_stride ) {
+                        index_t iy = y - fy + m_y_offset;
+                        if ( iy >= 0 && iy <= iy_limit ) {
+                            for (index_t fx = x_align; fx < m_filter_w_size; fx += m_x_stride) {
+                                index_t ix = x - fx + m_x_offset;
+                                if ( ix >= 0 && ix <= ix_limit ) {
+                                    index_t output_frame = (input_frame * m_output_h_size + (iy/m_y_stride)) * m_output_w_size + (ix/m_x_stride);
+                                    index_t output_node  = (c * m_filter_h_size + fy) * m_filter_w_size + fx;
+                                    dy += dy_ptr.Get(output_frame, output_node);
                                 }
                             }
-                            dx_ptr.Set(input_frame, input_node, dx + dy);
                         }
                     }
+                    dx_ptr.Set(input_frame, input_node, dx + dy);
                 }
-            }
+            });
 
             return dx_buf;
         }
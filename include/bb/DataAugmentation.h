@@ -0,0 +1,478 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <climits>
+
+#include "bb/Manager.h"
+#include "bb/Activation.h"
+#include "bb/SimdSupport.h"
+
+
+namespace bb {
+
+
+// [DataAugmentation]
+//  画像(shape = {w, h} or {w, h, c})のランダムなアフィン変換(移動/回転/拡大縮小/反転/クロップ)、
+//  ネガポジ反転、ガウスノイズ付加をミニバッチ毎に行うレイヤー
+//  ・ネットの先頭に置き、train=true の Forward のみ処理する(推論時は素通し)
+//  ・出力画素から逆変換した座標をバイリニア補間でサンプリングする
+//  ・FrameBuffer はノード(画素)毎にフレームが連続しているので、8フレームを1ベクトルとして
+//    フレーム毎に異なる座標を AVX2 の gather で読み出し、出力は連続書き込みとなる
+//  ・フレーム毎のパラメータは Forward 開始時に逐次生成するのでスレッド数に依らず再現する
+//  ・Backward は dy をそのまま返す(入力側の勾配は使用しない前提)
+
+
+// フレーム毎の変換パラメータ(出力座標 -> 入力座標 と 値の gain/bias)
+struct DataAugmentationParam
+{
+    float   m00 = 1.0f, m01 = 0.0f, m02 = 0.0f;
+    float   m10 = 0.0f, m11 = 1.0f, m12 = 0.0f;
+    float   gain = 1.0f;
+    float   bias = 0.0f;
+    bool    noise = false;
+};
+
+
+// 汎用版 (フレーム範囲 [frame_begin, frame_end) を処理)
+inline void DataAugmentation_Sample_fp32
+    (
+        float const                     *x_addr,
+        float                           *y_addr,
+        index_t                         stride,
+        DataAugmentationParam const     *param,
+        index_t                         frame_begin,
+        index_t                         frame_end,
+        int                             w,
+        int                             h,
+        int                             c,
+        bool                            replicate,
+        float                           border
+    )
+{
+    for ( index_t frame = frame_begin; frame < frame_end; ++frame ) {
+        auto const &p = param[frame];
+        for ( int ch = 0; ch < c; ++ch ) {
+            for ( int y = 0; y < h; ++y ) {
+                for ( int x = 0; x < w; ++x ) {
+                    float sx = p.m00 * (float)x + (p.m01 * (float)y + p.m02);
+                    float sy = p.m10 * (float)x + (p.m11 * (float)y + p.m12);
+                    sx = std::min(std::max(sx, -2.0f), (float)(w + 1));
+                    sy = std::min(std::max(sy, -2.0f), (float)(h + 1));
+
+                    float x0f = std::floor(sx);
+                    float y0f = std::floor(sy);
+                    float fx  = sx - x0f;
+                    float fy  = sy - y0f;
+                    int   x0  = (int)x0f;
+                    int   y0  = (int)y0f;
+
+                    float v[2][2];
+                    for ( int dy = 0; dy < 2; ++dy ) {
+                        for ( int dx = 0; dx < 2; ++dx ) {
+                            int xx = x0 + dx;
+                            int yy = y0 + dy;
+                            bool valid = (xx >= 0 && xx < w && yy >= 0 && yy < h);
+                            xx = std::min(std::max(xx, 0), w - 1);
+                            yy = std::min(std::max(yy, 0), h - 1);
+                            v[dy][dx] = x_addr[((index_t)(ch * h + yy) * w + xx) * stride + frame];
+                            if ( !replicate && !valid ) {
+                                v[dy][dx] = border;
+                            }
+                        }
+                    }
+
+                    float top = v[0][0] + fx * (v[0][1] - v[0][0]);
+                    float bot = v[1][0] + fx * (v[1][1] - v[1][0]);
+                    float val = top + fy * (bot - top);
+                    y_addr[((index_t)(ch * h + y) * w + x) * stride + frame] = val * p.gain + p.bias;
+                }
+            }
+        }
+    }
+}
+
+
+// AVX2版 (frame_begin から8フレーム)
+BB_TARGET_AVX2
+inline void DataAugmentation_Sample8_fp32_avx2
+    (
+        float const                     *x_addr,
+        float                           *y_addr,
+        index_t                         stride,
+        DataAugmentationParam const     *param,
+        index_t                         frame_begin,
+        int                             w,
+        int                             h,
+        int                             c,
+        bool                            replicate,
+        float                           border
+    )
+{
+    float m00[8], m01[8], m02[8], m10[8], m11[8], m12[8], gain[8], bias[8];
+    for ( int i = 0; i < 8; ++i ) {
+        auto const &p = param[frame_begin + i];
+        m00[i] = p.m00; m01[i] = p.m01; m02[i] = p.m02;
+        m10[i] = p.m10; m11[i] = p.m11; m12[i] = p.m12;
+        gain[i] = p.gain; bias[i] = p.bias;
+    }
+    __m256  v_m00  = _mm256_loadu_ps(m00);
+    __m256  v_m01  = _mm256_loadu_ps(m01);
+    __m256  v_m02  = _mm256_loadu_ps(m02);
+    __m256  v_m10  = _mm256_loadu_ps(m10);
+    __m256  v_m11  = _mm256_loadu_ps(m11);
+    __m256  v_m12  = _mm256_loadu_ps(m12);
+    __m256  v_gain = _mm256_loadu_ps(gain);
+    __m256  v_bias = _mm256_loadu_ps(bias);
+
+    __m256  v_min    = _mm256_set1_ps(-2.0f);
+    __m256  v_xmax   = _mm256_set1_ps((float)(w + 1));
+    __m256  v_ymax   = _mm256_set1_ps((float)(h + 1));
+    __m256  v_border = _mm256_set1_ps(border);
+    __m256i v_zero   = _mm256_setzero_si256();
+    __m256i v_one    = _mm256_set1_epi32(1);
+    __m256i v_w1     = _mm256_set1_epi32(w - 1);
+    __m256i v_h1     = _mm256_set1_epi32(h - 1);
+    __m256i v_w      = _mm256_set1_epi32(w);
+    __m256i v_stride = _mm256_set1_epi32((int)stride);
+    __m256i v_lane   = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    float const *x_base = x_addr + frame_begin;
+    float       *y_base = y_addr + frame_begin;
+
+    for ( int y = 0; y < h; ++y ) {
+        __m256 v_y   = _mm256_set1_ps((float)y);
+        __m256 sx_y  = _mm256_add_ps(_mm256_mul_ps(v_m01, v_y), v_m02);
+        __m256 sy_y  = _mm256_add_ps(_mm256_mul_ps(v_m11, v_y), v_m12);
+        for ( int x = 0; x < w; ++x ) {
+            __m256 v_x = _mm256_set1_ps((float)x);
+            __m256 sx  = _mm256_add_ps(_mm256_mul_ps(v_m00, v_x), sx_y);
+            __m256 sy  = _mm256_add_ps(_mm256_mul_ps(v_m10, v_x), sy_y);
+            sx = _mm256_min_ps(_mm256_max_ps(sx, v_min), v_xmax);
+            sy = _mm256_min_ps(_mm256_max_ps(sy, v_min), v_ymax);
+
+            __m256  x0f = _mm256_floor_ps(sx);
+            __m256  y0f = _mm256_floor_ps(sy);
+            __m256  fx  = _mm256_sub_ps(sx, x0f);
+            __m256  fy  = _mm256_sub_ps(sy, y0f);
+            __m256i x0  = _mm256_cvttps_epi32(x0f);
+            __m256i y0  = _mm256_cvttps_epi32(y0f);
+            __m256i x1  = _mm256_add_epi32(x0, v_one);
+            __m256i y1  = _mm256_add_epi32(y0, v_one);
+
+            // 範囲内判定 (0 <= v <= max  <=>  !(v < 0) && !(v > max))
+            __m256i x0_ok = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(v_zero, x0), _mm256_cmpgt_epi32(x0, v_w1)), _mm256_cmpeq_epi32(v_zero, v_zero));
+            __m256i x1_ok = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(v_zero, x1), _mm256_cmpgt_epi32(x1, v_w1)), _mm256_cmpeq_epi32(v_zero, v_zero));
+            __m256i y0_ok = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(v_zero, y0), _mm256_cmpgt_epi32(y0, v_h1)), _mm256_cmpeq_epi32(v_zero, v_zero));
+            __m256i y1_ok = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(v_zero, y1), _mm256_cmpgt_epi32(y1, v_h1)), _mm256_cmpeq_epi32(v_zero, v_zero));
+
+            x0 = _mm256_min_epi32(_mm256_max_epi32(x0, v_zero), v_w1);
+            x1 = _mm256_min_epi32(_mm256_max_epi32(x1, v_zero), v_w1);
+            y0 = _mm256_min_epi32(_mm256_max_epi32(y0, v_zero), v_h1);
+            y1 = _mm256_min_epi32(_mm256_max_epi32(y1, v_zero), v_h1);
+
+            for ( int ch = 0; ch < c; ++ch ) {
+                __m256i row0 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(ch * h), y0), v_w);
+                __m256i row1 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(ch * h), y1), v_w);
+                __m256i i00  = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(row0, x0), v_stride), v_lane);
+                __m256i i01  = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(row0, x1), v_stride), v_lane);
+                __m256i i10  = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(row1, x0), v_stride), v_lane);
+                __m256i i11  = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(row1, x1), v_stride), v_lane);
+
+                __m256 v00 = _mm256_i32gather_ps(x_base, i00, 4);
+                __m256 v01 = _mm256_i32gather_ps(x_base, i01, 4);
+                __m256 v10 = _mm256_i32gather_ps(x_base, i10, 4);
+                __m256 v11 = _mm256_i32gather_ps(x_base, i11, 4);
+                if ( !replicate ) {
+                    v00 = _mm256_blendv_ps(v_border, v00, _mm256_castsi256_ps(_mm256_and_si256(y0_ok, x0_ok)));
+                    v01 = _mm256_blendv_ps(v_border, v01, _mm256_castsi256_ps(_mm256_and_si256(y0_ok, x1_ok)));
+                    v10 = _mm256_blendv_ps(v_border, v10, _mm256_castsi256_ps(_mm256_and_si256(y1_ok, x0_ok)));
+                    v11 = _mm256_blendv_ps(v_border, v11, _mm256_castsi256_ps(_mm256_and_si256(y1_ok, x1_ok)));
+                }
+
+                __m256 top = _mm256_add_ps(v00, _mm256_mul_ps(fx, _mm256_sub_ps(v01, v00)));
+                __m256 bot = _mm256_add_ps(v10, _mm256_mul_ps(fx, _mm256_sub_ps(v11, v10)));
+                __m256 val = _mm256_add_ps(top, _mm256_mul_ps(fy, _mm256_sub_ps(bot, top)));
+                val = _mm256_add_ps(_mm256_mul_ps(val, v_gain), v_bias);
+
+                index_t node = ((index_t)(ch * h + y) * w + x);
+                _mm256_storeu_ps(y_base + node * stride, val);
+            }
+        }
+    }
+}
+
+
+// DataAugmentation
+template <typename FT = float>
+class DataAugmentation : public Activation
+{
+protected:
+    float                               m_shift_x_range    = 0.0f;     //< 移動量(幅に対する比率)
+    float                               m_shift_y_range    = 0.0f;     //< 移動量(高さに対する比率)
+    float                               m_rotation_range   = 0.0f;     //< 回転角(度)
+    float                               m_scale_range      = 0.0f;     //< 拡大縮小率
+    float                               m_flip_x_rate      = 0.0f;     //< 左右反転の確率
+    float                               m_flip_y_rate      = 0.0f;     //< 上下反転の確率
+    int                                 m_crop_padding     = 0;        //< パディング後ランダムクロップ(整数移動)の画素数
+    float                               m_neg_rate         = 0.0f;     //< ネガポジ反転の確率
+    float                               m_noise_stddev     = 0.0f;     //< ガウスノイズの標準偏差
+    float                               m_rate             = 1.0f;     //< 変換を行うフレームの割合
+    bool                                m_border_replicate = false;    //< 範囲外を端の画素で埋めるか
+    float                               m_border_value     = 0.0f;     //< 範囲外の値
+
+    bool                                m_host_only = false;
+    std::mt19937_64                     m_mt;
+    std::vector<DataAugmentationParam>  m_param;
+
+    FrameBuffer                         m_y_buf;
+
+public:
+    struct create_t
+    {
+        float           shift_x_range    = 0.0f;
+        float           shift_y_range    = 0.0f;
+        float           rotation_range   = 0.0f;
+        float           scale_range      = 0.0f;
+        float           flip_x_rate      = 0.0f;
+        float           flip_y_rate      = 0.0f;
+        int             crop_padding     = 0;
+        float           neg_rate         = 0.0f;
+        float           noise_stddev     = 0.0f;
+        float           rate             = 1.0f;
+        bool            border_replicate = false;
+        float           border_value     = 0.0f;
+        std::uint64_t   seed             = 1;
+    };
+
+protected:
+    DataAugmentation(create_t const &create)
+    {
+        m_shift_x_range    = create.shift_x_range;
+        m_shift_y_range    = create.shift_y_range;
+        m_rotation_range   = create.rotation_range;
+        m_scale_range      = create.scale_range;
+        m_flip_x_rate      = create.flip_x_rate;
+        m_flip_y_rate      = create.flip_y_rate;
+        m_crop_padding     = create.crop_padding;
+        m_neg_rate         = create.neg_rate;
+        m_noise_stddev     = create.noise_stddev;
+        m_rate             = create.rate;
+        m_border_replicate = create.border_replicate;
+        m_border_value     = create.border_value;
+        m_mt.seed(create.seed);
+    }
+
+    /**
+     * @brief  コマンド処理
+     * @detail コマンド処理
+     * @param  args   コマンド
+     */
+    void CommandProc(std::vector<std::string> args)
+    {
+        // HostOnlyモード設定
+        if (args.size() == 2 && args[0] == "host_only")
+        {
+            m_host_only = EvalBool(args[1]);
+        }
+    }
+
+    // フレーム毎のパラメータ生成
+    void MakeParam(index_t frame_size, int w, int h)
+    {
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> dist_rate(0.0f, 1.0f);
+        std::uniform_int_distribution<int>    dist_crop(-m_crop_padding, m_crop_padding);
+
+        float cx = (float)(w - 1) * 0.5f;
+        float cy = (float)(h - 1) * 0.5f;
+
+        m_param.resize(frame_size);
+        for ( index_t frame = 0; frame < frame_size; ++frame ) {
+            auto &p = m_param[frame];
+            p = DataAugmentationParam();
+            if ( dist_rate(m_mt) >= m_rate ) {
+                continue;
+            }
+
+            float tx    = dist(m_mt) * m_shift_x_range * (float)w + (float)dist_crop(m_mt);
+            float ty    = dist(m_mt) * m_shift_y_range * (float)h + (float)dist_crop(m_mt);
+            float theta = dist(m_mt) * m_rotation_range * (float)(3.14159265358979 / 180.0);
+            float scale = 1.0f + dist(m_mt) * m_scale_range;
+            float sx    = (dist_rate(m_mt) < m_flip_x_rate) ? -1.0f : 1.0f;
+            float sy    = (dist_rate(m_mt) < m_flip_y_rate) ? -1.0f : 1.0f;
+            bool  neg   = (dist_rate(m_mt) < m_neg_rate);
+
+            // 出力座標 -> 入力座標 : src = c + F * S^-1 * R^-1 * (dst - c - t)
+            float cs = std::cos(theta) / scale;
+            float sn = std::sin(theta) / scale;
+            float ox = cx + tx;
+            float oy = cy + ty;
+            p.m00 = sx * cs;
+            p.m01 = sx * sn;
+            p.m02 = cx - sx * (cs * ox + sn * oy);
+            p.m10 = sy * -sn;
+            p.m11 = sy * cs;
+            p.m12 = cy - sy * (-sn * ox + cs * oy);
+            p.gain  = neg ? -1.0f : 1.0f;
+            p.bias  = neg ? 1.0f : 0.0f;
+            p.noise = (m_noise_stddev > 0.0f);
+        }
+    }
+
+public:
+    ~DataAugmentation() {}
+
+    static std::shared_ptr<DataAugmentation> Create(create_t const &create)
+    {
+        return std::shared_ptr<DataAugmentation>(new DataAugmentation(create));
+    }
+
+    static std::shared_ptr<DataAugmentation> CreateEx(
+                float           shift_x_range    = 0.0f,
+                float           shift_y_range    = 0.0f,
+                float           rotation_range   = 0.0f,
+                float           scale_range      = 0.0f,
+                float           flip_x_rate      = 0.0f,
+                float           flip_y_rate      = 0.0f,
+                int             crop_padding     = 0,
+                float           neg_rate         = 0.0f,
+                float           noise_stddev     = 0.0f,
+                float           rate             = 1.0f,
+                bool            border_replicate = false,
+                float           border_value     = 0.0f,
+                std::uint64_t   seed             = 1)
+    {
+        create_t create;
+        create.shift_x_range    = shift_x_range;
+        create.shift_y_range    = shift_y_range;
+        create.rotation_range   = rotation_range;
+        create.scale_range      = scale_range;
+        create.flip_x_rate      = flip_x_rate;
+        create.flip_y_rate      = flip_y_rate;
+        create.crop_padding     = crop_padding;
+        create.neg_rate         = neg_rate;
+        create.noise_stddev     = noise_stddev;
+        create.rate             = rate;
+        create.border_replicate = border_replicate;
+        create.border_value     = border_value;
+        create.seed             = seed;
+        return Create(create);
+    }
+
+    std::string GetClassName(void) const { return "DataAugmentation"; }
+
+
+    // ノード単位でのForward計算
+    std::vector<double> ForwardNode(index_t /*node*/, std::vector<double> x_vec) const
+    {
+        return x_vec;
+    }
+
+
+    /**
+     * @brief  forward演算
+     * @detail 学習時のみ変換を行う
+     * @param  x     入力データ (shape = {w, h} or {w, h, c})
+     * @param  train 学習時にtrueを指定
+     * @return forward演算結果
+     */
+    inline FrameBuffer Forward(FrameBuffer x_buf, bool train = true)
+    {
+        if ( !train ) {
+            return x_buf;
+        }
+
+        BB_ASSERT(x_buf.GetType() == BB_TYPE_FP32);
+
+        auto shape = x_buf.GetShape();
+        BB_ASSERT(shape.size() == 2 || shape.size() == 3);
+        int w = (int)shape[0];
+        int h = (int)shape[1];
+        int c = shape.size() >= 3 ? (int)shape[2] : 1;
+
+        index_t frame_size = x_buf.GetFrameSize();
+        index_t node_size  = x_buf.GetNodeSize();
+        index_t stride     = x_buf.GetFrameStride() / (index_t)sizeof(float);
+
+        m_y_buf.ResizeLike(x_buf);
+        MakeParam(frame_size, w, h);
+
+        // ノイズ用の乱数はフレームブロック単位で系列を分ける
+        index_t const block      = 8;
+        index_t       block_size = (frame_size + block - 1) / block;
+        std::vector<std::uint64_t> block_seed(block_size);
+        for ( auto &seed : block_seed ) {
+            seed = m_mt();
+        }
+
+        auto x_ptr = x_buf.LockMemoryConst();
+        auto y_ptr = m_y_buf.LockMemory(true);
+        auto x_addr = (float const *)x_ptr.GetAddr();
+        auto y_addr = (float       *)y_ptr.GetAddr();
+
+        static SimdKernel kernel("DataAugmentation", {SimdLevel::AVX2});
+        bool use_avx2 = (kernel.Select() >= SimdLevel::AVX2) && (node_size * stride < (index_t)INT_MAX);
+
+        bool  replicate = m_border_replicate;
+        float border    = m_border_value;
+        float stddev    = m_noise_stddev;
+        auto  param     = m_param.data();
+
+        ParallelFor(0, block_size, [&](index_t blk) {
+            index_t frame_begin = blk * block;
+            index_t frame_end   = std::min(frame_begin + block, frame_size);
+            if ( use_avx2 && frame_end - frame_begin == block ) {
+                DataAugmentation_Sample8_fp32_avx2(x_addr, y_addr, stride, param, frame_begin, w, h, c, replicate, border);
+            }
+            else {
+                DataAugmentation_Sample_fp32(x_addr, y_addr, stride, param, frame_begin, frame_end, w, h, c, replicate, border);
+            }
+
+            // ガウスノイズ
+            if ( stddev > 0.0f ) {
+                std::mt19937_64                 mt(block_seed[blk]);
+                std::normal_distribution<float> dist(0.0f, stddev);
+                for ( index_t node = 0; node < node_size; ++node ) {
+                    for ( index_t frame = frame_begin; frame < frame_end; ++frame ) {
+                        float n = dist(mt);
+                        if ( param[frame].noise ) {
+                            y_addr[node * stride + frame] += n;
+                        }
+                    }
+                }
+            }
+        });
+
+        return m_y_buf;
+    }
+
+
+   /**
+     * @brief  backward演算
+     * @detail 入力側の勾配は使用しない前提で dy をそのまま返す
+     * @return backward演算結果
+     */
+    inline FrameBuffer Backward(FrameBuffer dy_buf)
+    {
+        return dy_buf;
+    }
+};
+
+
+}
+
+
+// end of file
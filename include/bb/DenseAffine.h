@@ -14,6 +14,7 @@
 
 #include "bb/DataType.h"
 #include "bb/Model.h"
+#include "bb/GemmSimd.h"
 
 #ifdef BB_WITH_CUDA
 #include "cuda_runtime.h"
@@ -35,6 +36,7 @@ class DenseAffine : public Model
 protected:
     bool                        m_binary_mode = false;
     bool                        m_host_only = false;
+    bool                        m_host_simd = true;
 
     T                           m_initialize_std = (T)0.01;
     std::string                 m_initializer = "he";
@@ -105,6 +107,12 @@ protected:
         {
             m_host_only = EvalBool(args[1]);
         }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
     }
 
 
@@ -154,6 +162,7 @@ public:
 
 
     std::string GetClassName(void) const { return "DenseAffine"; }
+    bool IsForwardReplayable(void) const { return true; }
     
     Tensor       &W(void)       { return *m_W; }
     Tensor const &W(void) const { return *m_W; }
@@ -270,6 +279,24 @@ public:
             m_x_buf = x_buf;
         }
 
+        // SetInputShpaeされていなければ初回に設定
+        if (x_buf.GetNodeSize() != m_input_node_size) {
+            SetInputShape(x_buf.GetShape());
+        }
+
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
         // 型合わせ
         if ( x_buf.GetType() != DataType<T>::type ) {
              x_buf = x_buf.ConvertTo(DataType<T>::type);
@@ -277,11 +304,6 @@ public:
         
         BB_ASSERT(x_buf.GetType() == DataType<T>::type);
         BB_ASSERT(x_buf.GetNodeSize() == m_input_node_size);
-        
-        // SetInputShpaeされていなければ初回に設定
-        if (x_buf.GetNodeSize() != m_input_node_size) {
-            SetInputShape(x_buf.GetShape());
-        }
 
         // 出力を設定
         FrameBuffer y_buf(x_buf.GetFrameSize(), m_output_shape, DataType<T>::type);
@@ -327,7 +349,33 @@ public:
         }
 #endif
 
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd ) {
+            // GEMM版  y(node, frame) = b(node) + W(node, input) * x(input, frame)
+            auto frame_size = x_buf.GetFrameSize();
+
+            auto x_ptr = x_buf.LockConst<float>();
+            auto y_ptr = y_buf.Lock<float>(true);
+            auto W_ptr = m_W->LockConst<float>();
+            auto b_ptr = m_b->LockConst<float>();
+
+            index_t x_frame_stride = x_buf.GetFrameStride() / sizeof(float);
+            index_t y_frame_stride = y_buf.GetFrameStride() / sizeof(float);
+            float       *y_addr    = y_ptr.GetAddr();
+
+            ParallelFor(0, m_output_node_size, [&](index_t output_node) {
+                std::fill(&y_addr[output_node * y_frame_stride], &y_addr[output_node * y_frame_stride] + frame_size, b_ptr(output_node));
+            });
+
+            simd_fp32_Gemm(m_output_node_size, frame_size, m_input_node_size,
+                    W_ptr.GetAddr(), m_input_node_size, 1,
+                    x_ptr.GetAddr(), x_frame_stride, 1,
+                    1.0f, y_addr, y_frame_stride);
+
+            return y_buf;
+        }
+
         {
+            // 汎用版
             auto frame_size   = x_buf.GetFrameSize();
 
             auto x_ptr = x_buf.LockConst<T>();
@@ -335,15 +383,14 @@ public:
             auto W_ptr = lock_W_const();
             auto b_ptr = lock_b_const();
 
-            #pragma omp parallel for
-            for (index_t frame = 0; frame < frame_size; ++frame) {
+            ParallelFor(0, frame_size, [&](index_t frame) {
                 for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
                     y_ptr.Set(frame, output_node, b_ptr(output_node));
                     for (index_t input_node = 0; input_node < m_input_node_size; ++input_node) {
                         y_ptr.Add(frame, output_node, x_ptr.Get(frame, input_node) * W_ptr(output_node, input_node));
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -432,28 +479,75 @@ public:
         }
 #endif
 
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd ) {
+            // GEMM版
+            auto x_ptr  = x_buf.LockConst<float>();
+            auto dy_ptr = dy_buf.LockConst<float>();
+            auto dx_ptr = dx_buf.Lock<float>(true);
+            auto W_ptr  = m_W->LockConst<float>();
+            auto dW_ptr = m_dW->Lock<float>();
+            auto db_ptr = m_db->Lock<float>();
+
+            index_t x_frame_stride  = x_buf.GetFrameStride()  / sizeof(float);
+            index_t dy_frame_stride = dy_buf.GetFrameStride() / sizeof(float);
+            index_t dx_frame_stride = dx_buf.GetFrameStride() / sizeof(float);
+            float const *dy_addr    = dy_ptr.GetAddr();
+
+            // db(node) += Σ dy(node, frame)
+            ParallelFor(0, m_output_node_size, [&](index_t output_node) {
+                float const *dy_row = &dy_addr[output_node * dy_frame_stride];
+                float sum = 0;
+                for ( index_t frame = 0; frame < frame_size; ++frame ) {
+                    sum += dy_row[frame];
+                }
+                db_ptr(output_node) += sum;
+            });
+
+            // dx(input, frame) = W^T(input, node) * dy(node, frame)
+            simd_fp32_Gemm(m_input_node_size, frame_size, m_output_node_size,
+                    W_ptr.GetAddr(), 1, m_input_node_size,
+                    dy_addr, dy_frame_stride, 1,
+                    0.0f, dx_ptr.GetAddr(), dx_frame_stride);
+
+            // dW(node, input) += dy(node, frame) * x^T(frame, input)
+            simd_fp32_Gemm(m_output_node_size, m_input_node_size, frame_size,
+                    dy_addr, dy_frame_stride, 1,
+                    x_ptr.GetAddr(), 1, x_frame_stride,
+                    1.0f, &dW_ptr[0], m_input_node_size);
+
+            return dx_buf;
+        }
+
         {
+            // 汎用版
             dx_buf.FillZero();
 
             auto x_ptr  = x_buf.LockConst<T>();
             auto dy_ptr = dy_buf.LockConst<T>();
             auto dx_ptr = dx_buf.Lock<T>();
             auto W_ptr  = lock_W_const();
-            auto b_ptr  = lock_b_const();
             auto dW_ptr = lock_dW();
             auto db_ptr = lock_db();
 
-            #pragma omp parallel for
-            for (index_t frame = 0; frame < frame_size; ++frame) {
+            // dx はフレーム毎、dW/db はノード毎に分けて並列化(書込みの競合を避ける)
+            ParallelFor(0, frame_size, [&](index_t frame) {
                 for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
                     auto grad = dy_ptr.Get(frame, output_node);
-                    db_ptr(output_node) += grad;
                     for (index_t input_node = 0; input_node < m_input_node_size; ++input_node) {
                         dx_ptr.Add(frame, input_node, grad * W_ptr(output_node, input_node));
+                    }
+                }
+            });
+
+            ParallelFor(0, m_output_node_size, [&](index_t output_node) {
+                for (index_t frame = 0; frame < frame_size; ++frame) {
+                    auto grad = dy_ptr.Get(frame, output_node);
+                    db_ptr(output_node) += grad;
+                    for (index_t input_node = 0; input_node < m_input_node_size; ++input_node) {
                         dW_ptr(output_node, input_node) += grad * x_ptr.Get(frame, input_node);
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
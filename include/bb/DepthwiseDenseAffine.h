@@ -14,6 +14,7 @@
 
 #include "bb/DataType.h"
 #include "bb/Model.h"
+#include "bb/SimdSupport.h"
 
 #ifdef BB_WITH_CUDA
 #include "cuda_runtime.h"
@@ -35,6 +36,7 @@ class DepthwiseDenseAffine : public Model
 protected:
     bool                        m_binary_mode = false;
     bool                        m_host_only = false;
+    bool                        m_host_simd = true;
 
     T                           m_initialize_std = (T)0.01;
     std::string                 m_initializer = "he";
@@ -106,6 +108,12 @@ protected:
         {
             m_host_only = EvalBool(args[1]);
         }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
     }
 
 
@@ -155,6 +163,7 @@ public:
 
 
     std::string GetClassName(void) const { return "DepthwiseDenseAffine"; }
+    bool IsForwardReplayable(void) const { return true; }
     
     Tensor       &W(void)       { return *m_W; }
     Tensor const &W(void) const { return *m_W; }
@@ -334,7 +343,61 @@ public:
         }
 #endif
 
+        static SimdKernel forward_kernel("DepthwiseDenseAffine::Forward", {SimdLevel::AVX2});
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && forward_kernel.Select() >= SimdLevel::AVX2 ) {
+            // SIMD版 (ノード毎に 32フレーム分の累積をレジスタに保持して入力点方向に積和)
+            auto frame_size = x_buf.GetFrameSize();
+
+            auto x_ptr = x_buf.LockConst<float>();
+            auto y_ptr = y_buf.Lock<float>(true);
+            auto W_ptr = m_W->LockConst<float>();
+            auto b_ptr = m_b->LockConst<float>();
+
+            index_t points_size = m_input_points_size;
+
+            ParallelFor(0, m_output_node_size, [&](index_t output_node) BB_TARGET_AVX2 {
+                float const *W_row  = &W_ptr.GetAddr()[output_node * points_size];
+                float       *y_addr = y_ptr.GetAddr(output_node);
+                __m256       bias   = _mm256_set1_ps(b_ptr(output_node));
+
+                index_t frame = 0;
+                for ( ; frame + 32 <= frame_size; frame += 32 ) {
+                    __m256 acc0 = bias, acc1 = bias, acc2 = bias, acc3 = bias;
+                    for ( index_t p = 0; p < points_size; ++p ) {
+                        float const *x_addr = x_ptr.GetAddr(output_node * points_size + p) + frame;
+                        __m256 w = _mm256_set1_ps(W_row[p]);
+                        acc0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(&x_addr[0]),  acc0);
+                        acc1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(&x_addr[8]),  acc1);
+                        acc2 = _mm256_fmadd_ps(w, _mm256_loadu_ps(&x_addr[16]), acc2);
+                        acc3 = _mm256_fmadd_ps(w, _mm256_loadu_ps(&x_addr[24]), acc3);
+                    }
+                    _mm256_storeu_ps(&y_addr[frame + 0],  acc0);
+                    _mm256_storeu_ps(&y_addr[frame + 8],  acc1);
+                    _mm256_storeu_ps(&y_addr[frame + 16], acc2);
+                    _mm256_storeu_ps(&y_addr[frame + 24], acc3);
+                }
+                for ( ; frame + 8 <= frame_size; frame += 8 ) {
+                    __m256 acc = bias;
+                    for ( index_t p = 0; p < points_size; ++p ) {
+                        float const *x_addr = x_ptr.GetAddr(output_node * points_size + p) + frame;
+                        acc = _mm256_fmadd_ps(_mm256_set1_ps(W_row[p]), _mm256_loadu_ps(x_addr), acc);
+                    }
+                    _mm256_storeu_ps(&y_addr[frame], acc);
+                }
+                for ( ; frame < frame_size; ++frame ) {
+                    float acc = b_ptr(output_node);
+                    for ( index_t p = 0; p < points_size; ++p ) {
+                        acc += W_row[p] * x_ptr.GetAddr(output_node * points_size + p)[frame];
+                    }
+                    y_addr[frame] = acc;
+                }
+            });
+
+            return y_buf;
+        }
+
         {
+            // 汎用版
             auto frame_size   = x_buf.GetFrameSize();
 
             auto x_ptr = x_buf.LockConst<T>();
@@ -342,15 +405,14 @@ public:
             auto W_ptr = lock_W_const();
             auto b_ptr = lock_b_const();
 
-            #pragma omp parallel for
-            for (index_t frame = 0; frame < frame_size; ++frame) {
+            ParallelFor(0, frame_size, [&](index_t frame) {
                 for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
                     y_ptr.Set(frame, output_node, b_ptr(output_node));
                     for (index_t input_point = 0; input_point < m_input_points_size; ++input_point) {
                         y_ptr.Add(frame, output_node, x_ptr.Get(frame, output_node * m_input_points_size + input_point) * W_ptr(output_node, input_point));
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -443,7 +505,70 @@ public:
         }
 #endif
 
+        static SimdKernel backward_kernel("DepthwiseDenseAffine::Backward", {SimdLevel::AVX2});
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && backward_kernel.Select() >= SimdLevel::AVX2 ) {
+            // SIMD版 (ノード毎に独立なので dW/db の書込みも競合しない)
+            auto x_ptr  = x_buf.LockConst<float>();
+            auto dy_ptr = dy_buf.LockConst<float>();
+            auto dx_ptr = dx_buf.Lock<float>(true);
+            auto W_ptr  = m_W->LockConst<float>();
+            auto dW_ptr = m_dW->Lock<float>();
+            auto db_ptr = m_db->Lock<float>();
+
+            index_t points_size = m_input_points_size;
+            float  *dW_addr     = &dW_ptr[0];
+
+            ParallelFor(0, m_output_node_size, [&](index_t output_node) BB_TARGET_AVX2 {
+                float const *W_row   = &W_ptr.GetAddr()[output_node * points_size];
+                float       *dW_row  = &dW_addr[output_node * points_size];
+                float const *dy_addr = dy_ptr.GetAddr(output_node);
+
+                // db
+                {
+                    __m256 acc = _mm256_setzero_ps();
+                    index_t frame = 0;
+                    for ( ; frame + 8 <= frame_size; frame += 8 ) {
+                        acc = _mm256_add_ps(acc, _mm256_loadu_ps(&dy_addr[frame]));
+                    }
+                    float sum = bb_mm256_cvtss_f32(bb_mm256_hsum_ps(acc));
+                    for ( ; frame < frame_size; ++frame ) {
+                        sum += dy_addr[frame];
+                    }
+                    db_ptr(output_node) += sum;
+                }
+
+                for ( index_t p = 0; p < points_size; ++p ) {
+                    index_t      input_node = output_node * points_size + p;
+                    float const *x_addr     = x_ptr.GetAddr(input_node);
+                    float       *dx_addr    = dx_ptr.GetAddr(input_node);
+                    __m256       w          = _mm256_set1_ps(W_row[p]);
+
+                    // dx = W * dy,  dW += Σ dy * x
+                    __m256 acc0 = _mm256_setzero_ps();
+                    __m256 acc1 = _mm256_setzero_ps();
+                    index_t frame = 0;
+                    for ( ; frame + 16 <= frame_size; frame += 16 ) {
+                        __m256 dy0 = _mm256_loadu_ps(&dy_addr[frame + 0]);
+                        __m256 dy1 = _mm256_loadu_ps(&dy_addr[frame + 8]);
+                        _mm256_storeu_ps(&dx_addr[frame + 0], _mm256_mul_ps(w, dy0));
+                        _mm256_storeu_ps(&dx_addr[frame + 8], _mm256_mul_ps(w, dy1));
+                        acc0 = _mm256_fmadd_ps(dy0, _mm256_loadu_ps(&x_addr[frame + 0]), acc0);
+                        acc1 = _mm256_fmadd_ps(dy1, _mm256_loadu_ps(&x_addr[frame + 8]), acc1);
+                    }
+                    float sum = bb_mm256_cvtss_f32(bb_mm256_hsum_ps(_mm256_add_ps(acc0, acc1)));
+                    for ( ; frame < frame_size; ++frame ) {
+                        dx_addr[frame] = W_row[p] * dy_addr[frame];
+                        sum += dy_addr[frame] * x_addr[frame];
+                    }
+                    dW_row[p] += sum;
+                }
+            });
+
+            return dx_buf;
+        }
+
         {
+            // 汎用版
             dx_buf.FillZero();
 
             auto x_ptr  = x_buf.LockConst<T>();
@@ -454,9 +579,9 @@ public:
             auto dW_ptr = lock_dW();
             auto db_ptr = lock_db();
 
-            #pragma omp parallel for
-            for (index_t frame = 0; frame < frame_size; ++frame) {
-                for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
+            // ノード毎に並列化(dW/db の書込みの競合を避ける)
+            ParallelFor(0, m_output_node_size, [&](index_t output_node) {
+                for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto grad = dy_ptr.Get(frame, output_node);
                     db_ptr(output_node) += grad;
                     for (index_t input_point = 0; input_point < m_input_points_size; ++input_point) {
@@ -464,7 +589,7 @@ public:
                         dW_ptr(output_node, input_point) += grad * x_ptr.Get(frame, output_node * m_input_points_size + input_point);
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
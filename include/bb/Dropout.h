@@ -72,7 +72,7 @@ public:
         create_t create;
         create.rate = rate;
         create.seed = seed;
-        return Create(&create);
+        return Create(create);
     }
 
     static std::shared_ptr<Dropout> CreateEx(double rate=0.5, std::uint64_t seed=1)
@@ -124,8 +124,7 @@ public:
                     mask_ptr[node] = (dist(m_mt) > m_rate) ? 0xff : 0;
                 }
 
-                #pragma omp parallel for
-                for (index_t node = 0; node < node_size; ++node) {
+                ParallelFor(0, node_size, [&](index_t node) {
                     if (mask_ptr[node] != 0) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
                             y_ptr.Set(frame, node, x_ptr.Get(frame, node));
@@ -136,15 +135,14 @@ public:
                             y_ptr.Set(frame, node, (FT)0);
                         }
                     }
-                }
+                });
             }
             else {
-                #pragma omp parallel for
-                for (index_t node = 0; node < node_size; ++node) {
+                ParallelFor(0, node_size, [&](index_t node) {
                     for (index_t frame = 0; frame < frame_size; ++frame) {
                         y_ptr.Set(frame, node, x_ptr.Get(frame, node) * (FT)(1.0 - m_rate));
                     }
-                }
+                });
             }
         }
 
@@ -173,8 +171,7 @@ public:
             auto dx_ptr = m_dx_buf.Lock<BT>(true);
             auto mask_ptr = m_mask.LockConst();
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 if ( mask_ptr[node] != 0 ) {
                     for (index_t frame = 0; frame < frame_size; ++frame) {
                         dx_ptr.Set(frame, node, dy_ptr.Get(frame, node));
@@ -185,7 +182,7 @@ public:
                         dx_ptr.Set(frame, node, 0);
                     }
                 }
-            }
+            });
 
             return m_dx_buf;
         }
@@ -0,0 +1,338 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "bb/Model.h"
+#include "bb/InferenceContext.h"
+
+
+namespace bb {
+
+
+/**
+ * @brief   動的バッチ化による推論実行
+ * @details 複数スレッドから投入された推論要求を1つの FrameBuffer にまとめて
+ *          Forward し、結果を要求毎に切り出して返す
+ *          最初の要求から max_delay 経過するか、max_batch_size フレーム
+ *          溜まった時点でまとめて実行する
+ *          推論は Forward(x_buf, ctx) を使うのでモデルは変更しない
+ */
+class DynamicBatcher
+{
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    struct create_t
+    {
+        std::shared_ptr<Model>  net;                        //< 推論するモデル
+        index_t                 max_batch_size = 256;       //< 1回にまとめる最大フレーム数
+        double                  max_delay      = 0.001;     //< 最初の要求からの最大待ち時間[s]
+    };
+
+    /**
+     * @brief  統計情報
+     */
+    struct Statistics
+    {
+        std::uint64_t   request_count = 0;      //< 処理した要求数
+        std::uint64_t   batch_count   = 0;      //< Forward の実行回数
+        std::uint64_t   frame_count   = 0;      //< 処理したフレーム数
+        double          total_latency = 0;      //< 要求の投入から完了までの時間の合計[s]
+        double          max_latency   = 0;      //< 要求の投入から完了までの最大時間[s]
+        double          forward_time  = 0;      //< Forward の実行時間の合計[s]
+        double          elapsed_time  = 0;      //< 計測開始からの経過時間[s]
+
+        double AverageLatency(void)    const { return request_count > 0 ? total_latency / (double)request_count : 0.0; }
+        double AverageBatchSize(void)  const { return batch_count > 0 ? (double)frame_count / (double)batch_count : 0.0; }
+        double FrameThroughput(void)   const { return elapsed_time > 0 ? (double)frame_count / elapsed_time : 0.0; }
+        double RequestThroughput(void) const { return elapsed_time > 0 ? (double)request_count / elapsed_time : 0.0; }
+    };
+
+protected:
+    struct Request
+    {
+        FrameBuffer                 x_buf;
+        std::promise<FrameBuffer>   promise;
+        clock_t::time_point         submit_time;
+    };
+
+    std::shared_ptr<Model>          m_net;
+    index_t                         m_max_batch_size = 256;
+    clock_t::duration               m_max_delay;
+
+    std::mutex                      m_mutex;
+    std::condition_variable         m_cv;
+    std::deque<Request>             m_queue;
+    index_t                         m_queued_frames = 0;
+    bool                            m_stop = false;
+    std::thread                     m_thread;
+
+    std::mutex                      m_stat_mutex;
+    Statistics                      m_stat;
+    clock_t::time_point             m_stat_start;
+
+protected:
+    DynamicBatcher(create_t const &create)
+    {
+        BB_ASSERT(create.net);
+        BB_ASSERT(create.max_batch_size > 0);
+
+        m_net            = create.net;
+        m_max_batch_size = create.max_batch_size;
+        m_max_delay      = std::chrono::duration_cast<clock_t::duration>(std::chrono::duration<double>(std::max(0.0, create.max_delay)));
+        m_stat_start     = clock_t::now();
+
+        m_thread = std::thread(&DynamicBatcher::WorkerMain, this);
+    }
+
+public:
+    ~DynamicBatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    static std::shared_ptr<DynamicBatcher> Create(create_t const &create)
+    {
+        return std::shared_ptr<DynamicBatcher>(new DynamicBatcher(create));
+    }
+
+    static std::shared_ptr<DynamicBatcher> Create(std::shared_ptr<Model> net, index_t max_batch_size = 256, double max_delay = 0.001)
+    {
+        create_t create;
+        create.net            = net;
+        create.max_batch_size = max_batch_size;
+        create.max_delay      = max_delay;
+        return Create(create);
+    }
+
+    std::string GetClassName(void) const { return "DynamicBatcher"; }
+
+    std::shared_ptr<Model> GetModel(void) const { return m_net; }
+
+    /**
+     * @brief  推論要求の投入
+     * @detail 要求をキューに積み、結果を future で返す
+     *         要求に含まれるフレーム数は任意(max_batch_size を超える要求は単独で実行する)
+     * @param  x_buf 入力データ
+     * @return 推論結果の future
+     */
+    std::future<FrameBuffer> Submit(FrameBuffer x_buf)
+    {
+        Request req;
+        req.x_buf       = x_buf;
+        req.submit_time = clock_t::now();
+        auto future = req.promise.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            BB_ASSERT(!m_stop);
+            m_queued_frames += x_buf.GetFrameSize();
+            m_queue.push_back(std::move(req));
+        }
+        m_cv.notify_all();
+
+        return future;
+    }
+
+    /**
+     * @brief  推論実行
+     * @detail 要求を投入して結果が出るまで待つ
+     * @param  x_buf 入力データ
+     * @return 推論結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf)
+    {
+        return Submit(x_buf).get();
+    }
+
+    /**
+     * @brief  統計情報の取得
+     * @return 統計情報
+     */
+    Statistics GetStatistics(void)
+    {
+        std::lock_guard<std::mutex> lock(m_stat_mutex);
+        Statistics stat = m_stat;
+        stat.elapsed_time = std::chrono::duration<double>(clock_t::now() - m_stat_start).count();
+        return stat;
+    }
+
+    /**
+     * @brief  統計情報のリセット
+     */
+    void ResetStatistics(void)
+    {
+        std::lock_guard<std::mutex> lock(m_stat_mutex);
+        m_stat       = Statistics();
+        m_stat_start = clock_t::now();
+    }
+
+    /**
+     * @brief  統計情報の文字列取得
+     * @return 統計情報を示す文字列
+     */
+    std::string GetStatisticsString(void)
+    {
+        auto stat = GetStatistics();
+        std::stringstream ss;
+        ss << "requests           : " << stat.request_count << std::endl;
+        ss << "batches            : " << stat.batch_count << std::endl;
+        ss << "frames             : " << stat.frame_count << std::endl;
+        ss << "average batch size : " << stat.AverageBatchSize() << std::endl;
+        ss << "average latency    : " << stat.AverageLatency() * 1000.0 << " [ms]" << std::endl;
+        ss << "max latency        : " << stat.max_latency * 1000.0 << " [ms]" << std::endl;
+        ss << "forward time       : " << stat.forward_time << " [s]" << std::endl;
+        ss << "throughput         : " << stat.FrameThroughput() << " [frames/s], "
+                                      << stat.RequestThroughput() << " [requests/s]" << std::endl;
+        return ss.str();
+    }
+
+protected:
+    // 同じバッチにまとめられるか
+    static bool IsBatchable(FrameBuffer const &a, FrameBuffer const &b)
+    {
+        return a.GetType() == b.GetType() && a.GetShape() == b.GetShape();
+    }
+
+    void WorkerMain(void)
+    {
+        InferenceContext ctx;
+        for ( ; ; ) {
+            std::vector<Request>    batch;
+            index_t                 frame_size = 0;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&]{ return m_stop || !m_queue.empty(); });
+                if ( m_queue.empty() ) {
+                    break;  // 停止要求かつ処理待ち無し
+                }
+
+                // 最初の要求から max_delay までは後続の要求を待つ
+                auto deadline = m_queue.front().submit_time + m_max_delay;
+                while ( !m_stop && m_queued_frames < m_max_batch_size ) {
+                    if ( m_cv.wait_until(lock, deadline) == std::cv_status::timeout ) {
+                        break;
+                    }
+                }
+
+                // 先頭から形状の揃った要求を max_batch_size までまとめる
+                while ( !m_queue.empty() ) {
+                    auto &req = m_queue.front();
+                    if ( !batch.empty() && (frame_size + req.x_buf.GetFrameSize() > m_max_batch_size
+                                                || !IsBatchable(batch[0].x_buf, req.x_buf)) ) {
+                        break;
+                    }
+                    frame_size += req.x_buf.GetFrameSize();
+                    batch.push_back(std::move(req));
+                    m_queue.pop_front();
+                }
+                m_queued_frames -= frame_size;
+            }
+
+            RunBatch(batch, frame_size, ctx);
+        }
+    }
+
+    void RunBatch(std::vector<Request> &batch, index_t frame_size, InferenceContext &ctx)
+    {
+        std::vector<FrameBuffer>    y_bufs;
+        std::exception_ptr          exception;
+
+        auto forward_start = clock_t::now();
+        try {
+            // 入力をフレーム方向に連結
+            FrameBuffer x_buf;
+            if ( batch.size() == 1 ) {
+                x_buf = batch[0].x_buf;
+            }
+            else {
+                x_buf = FrameBuffer(frame_size, batch[0].x_buf.GetShape(), batch[0].x_buf.GetType());
+                index_t offset = 0;
+                for ( auto &req : batch ) {
+                    index_t size = req.x_buf.GetFrameSize();
+                    req.x_buf.CopyTo(x_buf, size, 0, offset);
+                    offset += size;
+                }
+            }
+
+            auto y_buf = m_net->Forward(x_buf, ctx);
+            if ( y_buf.GetFrameSize() != frame_size ) {
+                // 要求元にエラーとして返す
+                throw std::runtime_error("DynamicBatcher : output frame size mismatch");
+            }
+
+            // 結果を要求毎に切り出す
+            //  部分範囲の FrameRange はコピーを返すのでそのまま使い、
+            //  全範囲でビューが返った場合だけ(出力を使い回すレイヤーもあるので)複製する
+            index_t offset = 0;
+            for ( auto &req : batch ) {
+                index_t size = req.x_buf.GetFrameSize();
+                auto req_y_buf = y_buf.FrameRange(size, offset);
+                if ( req_y_buf.IsView() ) {
+                    req_y_buf = req_y_buf.Clone();
+                }
+                y_bufs.push_back(req_y_buf);
+                offset += size;
+            }
+        }
+        catch (...) {
+            exception = std::current_exception();
+        }
+
+        // 統計更新(結果を返す前に反映しておく)
+        {
+            auto now = clock_t::now();
+            std::lock_guard<std::mutex> lock(m_stat_mutex);
+            m_stat.batch_count   += 1;
+            m_stat.frame_count   += frame_size;
+            m_stat.forward_time  += std::chrono::duration<double>(now - forward_start).count();
+            for ( auto &req : batch ) {
+                double latency = std::chrono::duration<double>(now - req.submit_time).count();
+                m_stat.request_count += 1;
+                m_stat.total_latency += latency;
+                m_stat.max_latency    = std::max(m_stat.max_latency, latency);
+            }
+        }
+
+        // 結果を返す
+        for ( size_t i = 0; i < batch.size(); ++i ) {
+            if ( exception ) {
+                batch[i].promise.set_exception(exception);
+            }
+            else {
+                batch[i].promise.set_value(y_bufs[i]);
+            }
+        }
+    }
+};
+
+
+}
+
+
+// end of file
@@ -0,0 +1,314 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+
+#include "bb/Sequential.h"
+#include "bb/LutLayer.h"
+
+
+namespace bb {
+
+
+// [ExportCpp]
+//  LUT-Network の C++ ソース出力(CPU 向けの ExportVerilog 相当)
+//  ・BinaryLutN 等の LutLayer の直列接続を、フレーム方向にビットパックしたワードに対する
+//    ビット演算の直線コードに変換する(真理値表と接続は定数として埋め込む)
+//  ・生成コードは BinaryBrain に依存しない (u64 版は標準 C++ のみ、avx2 版は immintrin.h)
+//  ・1 回の呼び出しで u64 版は 64 フレーム、avx2 版は 256 フレームを処理する
+//  ・ワード内のフレーム配置は FrameBuffer の Bit 型と同じ(下位ビットが若いフレーム)
+//  SparseLutN などは BinaryLutN::ImportLayer() でテーブル化してから出力すること
+//
+//  生成される関数
+//    void <name>_scratch(word_t const *in_data, word_t *out_data, word_t *scratch);
+//        in_data[input_node], out_data[output_node]
+//        中間層の作業領域 scratch[<name>_scratch_words] は呼び出し側が用意する
+//        (スレッド毎のコンテキストで使い回せる。word_t のアライメントで確保すること)
+//        作業領域は隣り合う2層分だけを交互に使う
+//    void <name>_frames_scratch(word_t const *in_data, size_t in_stride, word_t *out_data, size_t out_stride, size_t word_size,
+//                               word_t *scratch, word_t *in_buf, word_t *out_buf);
+//        in_data[input_node * in_stride + word] の形で word_size ワード分を処理する
+//        (FrameBuffer の Bit 型のメモリをそのまま渡せる。in_data/out_data のアライメントは不問)
+//        in_buf[<name>_input_words], out_buf[<name>_output_words] は scratch と同様に用意する
+//    void <name>(word_t const *in_data, word_t *out_data);
+//    void <name>_frames(word_t const *in_data, size_t in_stride, word_t *out_data, size_t out_stride, size_t word_size);
+//        作業領域をスタックに取る版
+//        スタック使用量が stack_limit バイトを超える大きなネットでは生成しない
+//        (その場合は _scratch / _frames_scratch 版を使う)
+
+
+// 真理値表をマルチプレクサ木の式に変換する(定数の枝は簡約する)
+inline std::string ExportCpp_LutExpression(std::vector<bool> const &table, std::vector<std::string> const &inputs, int var, int offset)
+{
+    int size = (1 << (var + 1));
+    bool all0 = true;
+    bool all1 = true;
+    for ( int i = 0; i < size; ++i ) {
+        if ( table[offset + i] ) { all0 = false; } else { all1 = false; }
+    }
+    if ( all0 ) { return "bb_zero()"; }
+    if ( all1 ) { return "bb_ones()"; }
+
+    auto const &s = inputs[var];
+    if ( var == 0 ) {
+        // 定数でない1入力関数
+        return table[offset] ? "bb_not(" + s + ")" : s;
+    }
+
+    auto lo = ExportCpp_LutExpression(table, inputs, var - 1, offset);
+    auto hi = ExportCpp_LutExpression(table, inputs, var - 1, offset + size / 2);
+    if ( lo == hi )          { return lo; }
+    if ( lo == "bb_zero()" && hi == "bb_ones()" ) { return s; }
+    if ( lo == "bb_ones()" && hi == "bb_zero()" ) { return "bb_not(" + s + ")"; }
+    if ( lo == "bb_zero()" ) { return "bb_and(" + s + ", " + hi + ")"; }
+    if ( hi == "bb_zero()" ) { return "bb_andnot(" + s + ", " + lo + ")"; }
+    if ( lo == "bb_ones()" ) { return "bb_or(bb_not(" + s + "), " + hi + ")"; }
+    if ( hi == "bb_ones()" ) { return "bb_or(" + s + ", " + lo + ")"; }
+    return "bb_mux(" + s + ", " + lo + ", " + hi + ")";
+}
+
+
+/**
+ * @brief  LUT-Network の C++ ソース出力
+ * @detail layers[i] の出力が layers[i+1] の入力に直結していること
+ * @param  os         出力先
+ * @param  func_name  生成する関数名
+ * @param  layers     LutLayer 列
+ * @param  simd       "u64" (64フレーム/ワード) もしくは "avx2" (256フレーム/ワード)
+ * @param  stack_limit 作業領域をスタックに取る版を生成するスタック使用量の上限[byte]
+ */
+template <typename FT = Bit, typename BT = float>
+void ExportCpp_LutLayers(std::ostream& os, std::string func_name, std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers, std::string simd = "u64", size_t stack_limit = 64 * 1024)
+{
+    BB_ASSERT(!layers.empty());
+    BB_ASSERT(simd == "u64" || simd == "avx2");
+
+    int layer_size = (int)layers.size();
+    std::string word_t = func_name + "_word_t";
+
+    index_t input_node_size  = layers.front()->GetInputNodeSize();
+    index_t output_node_size = layers.back()->GetOutputNodeSize();
+
+    os <<
+        "// ---------------------------------------------------------------------------\n"
+        "//  " << func_name << " : generated by BinaryBrain ExportCpp\n"
+        "//    input  nodes : " << input_node_size  << "\n"
+        "//    output nodes : " << output_node_size << "\n"
+        "//    layers       : " << layer_size       << "\n"
+        "// ---------------------------------------------------------------------------\n"
+        "\n"
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n"
+        "#include <string.h>\n";
+
+    // ワード演算の定義
+    std::string ns = func_name + "_ops";
+    if ( simd == "avx2" ) {
+        os <<
+            "#include <immintrin.h>\n"
+            "\n"
+            "typedef __m256i " << word_t << ";\n"
+            "\n"
+            "#if defined(__GNUC__) && !defined(__AVX2__)\n"
+            "#define BB_EXPORT_TARGET __attribute__((target(\"avx2\")))\n"
+            "#else\n"
+            "#define BB_EXPORT_TARGET\n"
+            "#endif\n"
+            "\n"
+            "namespace " << ns << " {\n"
+            "typedef " << word_t << " word_t;\n"
+            "BB_EXPORT_TARGET static inline word_t bb_zero(void)                        { return _mm256_setzero_si256(); }\n"
+            "BB_EXPORT_TARGET static inline word_t bb_ones(void)                        { return _mm256_set1_epi32(-1); }\n"
+            "BB_EXPORT_TARGET static inline word_t bb_not(word_t a)                     { return _mm256_xor_si256(a, bb_ones()); }\n"
+            "BB_EXPORT_TARGET static inline word_t bb_and(word_t a, word_t b)           { return _mm256_and_si256(a, b); }\n"
+            "BB_EXPORT_TARGET static inline word_t bb_andnot(word_t a, word_t b)        { return _mm256_andnot_si256(a, b); }\n"
+            "BB_EXPORT_TARGET static inline word_t bb_or(word_t a, word_t b)            { return _mm256_or_si256(a, b); }\n"
+            "BB_EXPORT_TARGET static inline word_t bb_mux(word_t s, word_t a, word_t b) { return _mm256_xor_si256(a, _mm256_and_si256(s, _mm256_xor_si256(a, b))); }\n"
+            "}\n";
+    }
+    else {
+        os <<
+            "\n"
+            "typedef uint64_t " << word_t << ";\n"
+            "\n"
+            "#define BB_EXPORT_TARGET\n"
+            "\n"
+            "namespace " << ns << " {\n"
+            "typedef " << word_t << " word_t;\n"
+            "static inline word_t bb_zero(void)                        { return 0; }\n"
+            "static inline word_t bb_ones(void)                        { return ~(word_t)0; }\n"
+            "static inline word_t bb_not(word_t a)                     { return ~a; }\n"
+            "static inline word_t bb_and(word_t a, word_t b)           { return a & b; }\n"
+            "static inline word_t bb_andnot(word_t a, word_t b)        { return ~a & b; }\n"
+            "static inline word_t bb_or(word_t a, word_t b)            { return a | b; }\n"
+            "static inline word_t bb_mux(word_t s, word_t a, word_t b) { return a ^ (s & (a ^ b)); }\n"
+            "}\n";
+    }
+
+    // 作業領域(中間層の出力を2面で交互に使う)
+    index_t slot_size = 0;
+    for ( int l = 0; l < layer_size - 1; ++l ) {
+        slot_size = std::max(slot_size, layers[l]->GetOutputNodeSize());
+    }
+    index_t scratch_words = std::max((index_t)1, (layer_size > 2) ? slot_size * 2 : slot_size);
+
+    // 本体
+    os <<
+        "\n"
+        "static const size_t " << func_name << "_input_words   = " << input_node_size  << ";\n"
+        "static const size_t " << func_name << "_output_words  = " << output_node_size << ";\n"
+        "static const size_t " << func_name << "_scratch_words = " << scratch_words    << ";\n"
+        "\n"
+        "\n"
+        "BB_EXPORT_TARGET\n"
+        "void " << func_name << "_scratch(" << word_t << " const *in_data, " << word_t << " *out_data, " << word_t << " *scratch)\n"
+        "{\n"
+        "    using namespace " << ns << ";\n"
+        "\n";
+
+    if ( layer_size == 1 ) {
+        os << "    (void)scratch;\n";
+    }
+    for ( int l = 0; l < layer_size - 1; ++l ) {
+        os << "    word_t *layer" << l << " = &scratch[" << ((l % 2) * slot_size) << "];\n";
+    }
+
+    for ( int l = 0; l < layer_size; ++l ) {
+        auto    layer     = layers[l];
+        index_t node_size = layer->GetOutputNodeSize();
+
+        if ( l > 0 ) {
+            BB_ASSERT(layer->GetInputNodeSize() == layers[l-1]->GetOutputNodeSize());
+        }
+
+        std::string src = (l == 0)              ? "in_data"  : "layer" + std::to_string(l - 1);
+        std::string dst = (l == layer_size - 1) ? "out_data" : "layer" + std::to_string(l);
+
+        os << "\n    // layer" << l << "\n";
+        for ( index_t node = 0; node < node_size; ++node ) {
+            index_t input_size = layer->GetNodeConnectionSize(node);
+            int     table_size = layer->GetLutTableSize(node);
+            BB_ASSERT(table_size == (1 << input_size));
+
+            std::vector<std::string> inputs(input_size);
+            for ( index_t i = 0; i < input_size; ++i ) {
+                inputs[i] = src + "[" + std::to_string(layer->GetNodeConnectionIndex(node, i)) + "]";
+            }
+            std::vector<bool> table(table_size);
+            for ( int i = 0; i < table_size; ++i ) {
+                table[i] = layer->GetLutTable(node, i);
+            }
+
+            os << "    " << dst << "[" << node << "] = "
+               << ExportCpp_LutExpression(table, inputs, (int)input_size - 1, 0) << ";\n";
+        }
+    }
+
+    os <<
+        "}\n"
+        "\n"
+        "\n"
+        "BB_EXPORT_TARGET\n"
+        "void " << func_name << "_frames_scratch(" << word_t << " const *in_data, size_t in_stride, "
+                                                  << word_t << " *out_data, size_t out_stride, size_t word_size,\n"
+        "        " << word_t << " *scratch, " << word_t << " *in_buf, " << word_t << " *out_buf)\n"
+        "{\n"
+        "    for ( size_t word = 0; word < word_size; ++word ) {\n"
+        "        for ( size_t node = 0; node < " << func_name << "_input_words; ++node ) {\n"
+        "            memcpy(&in_buf[node], &in_data[node * in_stride + word], sizeof(" << word_t << "));\n"
+        "        }\n"
+        "        " << func_name << "_scratch(in_buf, out_buf, scratch);\n"
+        "        for ( size_t node = 0; node < " << func_name << "_output_words; ++node ) {\n"
+        "            memcpy(&out_data[node * out_stride + word], &out_buf[node], sizeof(" << word_t << "));\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    // 作業領域をスタックに取る版(上限以下の場合のみ)
+    size_t word_bytes   = (simd == "avx2") ? 32 : 8;
+    size_t stack_single = (size_t)scratch_words * word_bytes;
+    size_t stack_frames = (size_t)(scratch_words + input_node_size + output_node_size) * word_bytes;
+
+    if ( stack_single <= stack_limit ) {
+        os <<
+            "\n"
+            "\n"
+            "BB_EXPORT_TARGET\n"
+            "void " << func_name << "(" << word_t << " const *in_data, " << word_t << " *out_data)\n"
+            "{\n"
+            "    " << word_t << " scratch[" << func_name << "_scratch_words];\n"
+            "    " << func_name << "_scratch(in_data, out_data, scratch);\n"
+            "}\n";
+    }
+    else {
+        os <<
+            "\n"
+            "// " << func_name << "() is not generated (stack usage " << stack_single << " bytes > " << stack_limit << "), use "
+                  << func_name << "_scratch()\n";
+    }
+
+    if ( stack_frames <= stack_limit ) {
+        os <<
+            "\n"
+            "\n"
+            "BB_EXPORT_TARGET\n"
+            "void " << func_name << "_frames(" << word_t << " const *in_data, size_t in_stride, "
+                                              << word_t << " *out_data, size_t out_stride, size_t word_size)\n"
+            "{\n"
+            "    " << word_t << " in_buf[" << func_name << "_input_words];\n"
+            "    " << word_t << " out_buf[" << func_name << "_output_words];\n"
+            "    " << word_t << " scratch[" << func_name << "_scratch_words];\n"
+            "    " << func_name << "_frames_scratch(in_data, in_stride, out_data, out_stride, word_size, scratch, in_buf, out_buf);\n"
+            "}\n";
+    }
+    else {
+        os <<
+            "\n"
+            "// " << func_name << "_frames() is not generated (stack usage " << stack_frames << " bytes > " << stack_limit << "), use "
+                  << func_name << "_frames_scratch()\n";
+    }
+
+    os <<
+        "\n"
+        "#undef BB_EXPORT_TARGET\n"
+        "\n";
+}
+
+
+/**
+ * @brief  LUT-Network の C++ ソース出力
+ * @detail net 内の LutLayer を直列接続として出力する
+ */
+template <typename FT = Bit, typename BT = float>
+void ExportCpp_LutLayers(std::ostream& os, std::string func_name, std::shared_ptr<bb::Sequential> net, std::string simd = "u64", size_t stack_limit = 64 * 1024)
+{
+    std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers;
+
+    // LutLayer だけを取り出し
+    for (int i = 0; i < net->GetSize(); ++i) {
+        auto layer = std::dynamic_pointer_cast< LutLayer<FT, BT> >(net->Get(i));
+        if ( layer != nullptr ) {
+            layers.push_back(layer);
+        }
+    }
+
+    ExportCpp_LutLayers<FT, BT>(os, func_name, layers, simd, stack_limit);
+}
+
+
+}
+
+
+// end of file
@@ -25,16 +25,242 @@
 namespace bb {
 
 
-// LUT-Network 基本レイヤーのVerilog 出力
+// ExportVerilog_LutLayers の出力オプション
+struct ExportVerilogConfig
+{
+    int     register_interval = 1;      // レジスタを置くレイヤー間隔 (最終レイヤーの出力は常にレジスタ)
+    bool    lut_packing       = false;  // 同じレジスタ段内の LUT の連鎖を1つの物理 LUT にまとめる
+    int     lut_size          = 6;      // 物理 LUT の入力数
+};
+
+
+// リソース/レイテンシの見積り
+struct ExportVerilogEstimate
+{
+    struct Module
+    {
+        std::string name;
+        index_t     lut_count    = 0;   // 物理 LUT 数 (lut_size を超える LUT は 2^(N-lut_size) 個とみなす)
+        index_t     ff_count     = 0;   // FF 数 (user 信号分は含まない)
+        int         latency      = 0;   // パイプライン段数
+        index_t     packed_nodes = 0;   // 前段を取り込んでまとめたノード数
+        index_t     removed_luts = 0;   // まとめた結果不要になった LUT 数
+    };
+
+    std::vector<Module> modules;
+
+    std::string GetInfoString(void) const
+    {
+        std::stringstream ss;
+        for ( auto const &m : modules ) {
+            ss << m.name << " : LUT=" << m.lut_count << ", FF=" << m.ff_count << ", latency=" << m.latency;
+            if ( m.packed_nodes > 0 || m.removed_luts > 0 ) {
+                ss << " (packed=" << m.packed_nodes << ", removed=" << m.removed_luts << ")";
+            }
+            ss << std::endl;
+        }
+        return ss.str();
+    }
+};
+
+
+inline index_t ExportVerilog_GetPhysicalLutCount(index_t input_size, int lut_size)
+{
+    return (input_size <= lut_size) ? 1 : ((index_t)1 << (input_size - lut_size));
+}
+
+
+// レジスタ段内のノード (入力は (レベル, インデックス)、レベル0 が in_data、レベル j が段内 j-1 番目のレイヤー)
+struct ExportVerilog_LutNode
+{
+    std::vector< std::pair<int, index_t> >  inputs;
+    std::vector<bool>                       table;
+    bool                                    used   = false;
+    bool                                    packed = false;
+};
+
+
+// 段内ノードの値を評価 (support 上の割り当て assign から)
+inline bool ExportVerilog_EvalLutNode(std::vector< std::vector<ExportVerilog_LutNode> > const &nodes,
+            std::vector< std::pair<int, index_t> > const &support, int assign, std::pair<int, index_t> sig)
+{
+    for ( size_t i = 0; i < support.size(); ++i ) {
+        if ( support[i] == sig ) {
+            return ((assign >> i) & 1) != 0;
+        }
+    }
+    BB_ASSERT(sig.first > 0);
+    auto const &node = nodes[sig.first - 1][sig.second];
+    int index = 0;
+    for ( size_t i = 0; i < node.inputs.size(); ++i ) {
+        if ( ExportVerilog_EvalLutNode(nodes, support, assign, node.inputs[i]) ) {
+            index |= (1 << i);
+        }
+    }
+    return node.table[index];
+}
+
+
+/**
+ * @brief  レジスタ段のネットリスト生成
+ * @detail layers を組み合わせ回路として直列に接続したネットリストを作る
+ *         lut_packing が有効なら、前段の LUT 出力を入力に持つノードは
+ *         合成後の入力数が lut_size 以下である限り前段の LUT を取り込んで1つの LUT にする
+ *         出力に寄与しなくなったノードは used = false となる
+ */
 template <typename FT = Bit, typename BT = float>
-void ExportVerilog_LutLayer(std::ostream& os, std::string module_name, LutLayer<FT, BT> const &lut)
+std::vector< std::vector<ExportVerilog_LutNode> > ExportVerilog_MakeLutStage(std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers,
+            ExportVerilogConfig const &config = ExportVerilogConfig(), index_t *packed_nodes_out = nullptr)
 {
-    index_t node_size      = lut.GetOutputNodeSize();
-    
+    BB_ASSERT(!layers.empty());
+    int layer_size = (int)layers.size();
+
+    // ネットリスト構築
+    std::vector< std::vector<ExportVerilog_LutNode> > nodes(layer_size);
+    for ( int l = 0; l < layer_size; ++l ) {
+        auto const &lut = *layers[l];
+        if ( l > 0 ) {
+            BB_ASSERT(lut.GetInputNodeSize() == layers[l-1]->GetOutputNodeSize());
+        }
+        nodes[l].resize(lut.GetOutputNodeSize());
+        for ( index_t node = 0; node < lut.GetOutputNodeSize(); ++node ) {
+            auto &n = nodes[l][node];
+            for ( index_t i = 0; i < lut.GetNodeConnectionSize(node); ++i ) {
+                n.inputs.push_back(std::make_pair(l, lut.GetNodeConnectionIndex(node, i)));
+            }
+            for ( int i = 0; i < lut.GetLutTableSize(node); ++i ) {
+                n.table.push_back(lut.GetLutTable(node, i));
+            }
+        }
+    }
+
+    // LUT パッキング (前段の LUT を入力数が収まる限り1つずつ取り込む)
+    index_t packed_nodes = 0;
+    if ( config.lut_packing ) {
+        for ( int l = 1; l < layer_size; ++l ) {
+            for ( auto &n : nodes[l] ) {
+                for ( size_t k = 0; k < n.inputs.size(); ) {
+                    auto sig = n.inputs[k];
+                    if ( sig.first == 0 ) {
+                        ++k;
+                        continue;
+                    }
+
+                    // k 番目の入力を前段 LUT の入力に置き換えた場合の入力
+                    std::vector< std::pair<int, index_t> > support;
+                    for ( size_t i = 0; i < n.inputs.size(); ++i ) {
+                        if ( i != k && std::find(support.begin(), support.end(), n.inputs[i]) == support.end() ) {
+                            support.push_back(n.inputs[i]);
+                        }
+                    }
+                    for ( auto const &leaf : nodes[sig.first - 1][sig.second].inputs ) {
+                        if ( std::find(support.begin(), support.end(), leaf) == support.end() ) {
+                            support.push_back(leaf);
+                        }
+                    }
+                    if ( (int)support.size() > config.lut_size ) {
+                        ++k;
+                        continue;
+                    }
+
+                    std::vector<bool> table((size_t)1 << support.size());
+                    for ( int assign = 0; assign < (int)table.size(); ++assign ) {
+                        int index = 0;
+                        for ( size_t i = 0; i < n.inputs.size(); ++i ) {
+                            if ( ExportVerilog_EvalLutNode(nodes, support, assign, n.inputs[i]) ) {
+                                index |= (1 << i);
+                            }
+                        }
+                        table[assign] = n.table[index];
+                    }
+                    n.inputs   = support;
+                    n.table    = table;
+                    n.packed   = true;
+                    k = 0;
+                }
+                if ( n.packed ) {
+                    ++packed_nodes;
+                }
+            }
+        }
+    }
+
+    // 使用ノードのマーク (最終レイヤーは全て出力)
+    for ( auto &n : nodes[layer_size - 1] ) {
+        n.used = true;
+    }
+    for ( int l = layer_size - 1; l > 0; --l ) {
+        for ( auto const &n : nodes[l] ) {
+            if ( !n.used ) { continue; }
+            for ( auto const &sig : n.inputs ) {
+                if ( sig.first > 0 ) {
+                    nodes[sig.first - 1][sig.second].used = true;
+                }
+            }
+        }
+    }
+
+    if ( packed_nodes_out != nullptr ) {
+        *packed_nodes_out = packed_nodes;
+    }
+
+    return nodes;
+}
+
+
+/**
+ * @brief  LUT-Network のレジスタ段を1モジュールとして出力
+ * @detail layers を組み合わせ回路として直列に接続し、最終レイヤーの出力をレジスタで受ける
+ */
+template <typename FT = Bit, typename BT = float>
+void ExportVerilog_LutStage(std::ostream& os, std::string module_name, std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers,
+            ExportVerilogConfig const &config = ExportVerilogConfig(), ExportVerilogEstimate::Module *estimate = nullptr)
+{
+    index_t packed_nodes = 0;
+    auto    nodes        = ExportVerilog_MakeLutStage<FT, BT>(layers, config, &packed_nodes);
+    int     layer_size   = (int)layers.size();
+
+    // 見積り
+    index_t lut_count    = 0;
+    index_t removed_luts = 0;
+    for ( int l = 0; l < layer_size; ++l ) {
+        for ( auto const &n : nodes[l] ) {
+            if ( n.used ) {
+                lut_count += ExportVerilog_GetPhysicalLutCount((index_t)n.inputs.size(), config.lut_size);
+            }
+            else {
+                ++removed_luts;
+            }
+        }
+    }
+    index_t ff_count = (index_t)nodes[layer_size - 1].size();
+
+    if ( estimate != nullptr ) {
+        estimate->name         = module_name;
+        estimate->lut_count    = lut_count;
+        estimate->ff_count     = ff_count;
+        estimate->latency      = 1;
+        estimate->packed_nodes = packed_nodes;
+        estimate->removed_luts = removed_luts;
+    }
+
+    // 信号名
+    auto signal_name = [&](std::pair<int, index_t> sig) -> std::string {
+        std::stringstream ss;
+        if ( sig.first == 0 ) {
+            ss << "in_data[" << sig.second << "]";
+        }
+        else {
+            ss << "lut_l" << (sig.first - 1) << "_" << sig.second << "_out";
+        }
+        return ss.str();
+    };
+
     // モジュール出力
     os <<
         "\n"
         "\n"
+        "// resource estimate : LUT=" << lut_count << ", FF=" << ff_count << ", latency=1\n"
         "module " << module_name << "\n"
         "        #(\n"
         "            parameter DEVICE = \"RTL\"\n"
@@ -44,56 +270,37 @@ void ExportVerilog_LutLayer(std::ostream& os, std::string module_name, LutLayer<
         "            input  wire         clk,\n"
         "            input  wire         cke,\n"
         "            \n"
-        "            input  wire [" << (lut.GetInputNodeSize() - 1) << ":0]  in_data,\n"
-        "            output wire [" << (lut.GetOutputNodeSize() - 1) << ":0]  out_data\n"
+        "            input  wire [" << (layers.front()->GetInputNodeSize() - 1) << ":0]  in_data,\n"
+        "            output wire [" << (layers.back()->GetOutputNodeSize() - 1) << ":0]  out_data\n"
         "        );\n"
         "\n";
 
+    for ( int l = 0; l < layer_size; ++l ) {
+        bool last = (l == layer_size - 1);
+        for (index_t node = 0; node < (index_t)nodes[l].size(); node++) {
+            auto const &n = nodes[l][node];
+            if ( !n.used ) {
+                continue;
+            }
 
-    for (index_t node = 0; node < node_size; node++) {
-        index_t lut_input_size = lut.GetNodeConnectionSize(node);
-        int     lut_table_size = lut.GetLutTableSize(node);
-
-        if ( 0 && lut_input_size == 6 ) {
-            // LUT 出力(Xilinx)
-            os <<
-                "\n"
-                "// LUT : " << node << "\n"
-                "\n"
-                "wire lut_" << node << "_out;\n"
-                "\n"
-                "LUT6\n"
-                "        #(\n"
-                "            .INIT(" << lut_table_size << "'b";
-
-            for (int bit = lut_table_size - 1; bit >= 0; --bit ) {
-                os << (lut.GetLutTable(node, bit) ? "1" : "0");
+            std::stringstream ss_name;
+            if ( last ) {
+                ss_name << "lut_" << node;
             }
-            os <<
-                ")\n";
+            else {
+                ss_name << "lut_l" << l << "_" << node;
+            }
+            std::string name = ss_name.str();
+
+            index_t lut_input_size = (index_t)n.inputs.size();
+            int     lut_table_size = (int)n.table.size();
 
-            os <<
-                "        )\n"
-                "    i_lut6_" << node << "\n"
-                "        (\n"
-                "            .O  (lut_" << node << "_out),\n"
-                "            .I0 (in_data[" << lut.GetNodeConnectionIndex(node, 0) << "]),\n"
-                "            .I1 (in_data[" << lut.GetNodeConnectionIndex(node, 1) << "]),\n"
-                "            .I2 (in_data[" << lut.GetNodeConnectionIndex(node, 2) << "]),\n"
-                "            .I3 (in_data[" << lut.GetNodeConnectionIndex(node, 3) << "]),\n"
-                "            .I4 (in_data[" << lut.GetNodeConnectionIndex(node, 4) << "]),\n"
-                "            .I5 (in_data[" << lut.GetNodeConnectionIndex(node, 5) << "])\n";
-            os <<
-                "        );\n"
-                "\n";
-        }
-        else {
             // LUT 出力
             os <<
                 "\n"
-                "// LUT : " << node << "\n"
+                "// LUT : " << (last ? "" : "layer" + std::to_string(l) + " ") << node << (n.packed ? " (packed)" : "") << "\n"
                 "\n"
-                "wire lut_" << node << "_out;\n"
+                "wire " << name << "_out;\n"
                 "\n"
                 "bb_lut\n"
                 "        #(\n"
@@ -101,7 +308,7 @@ void ExportVerilog_LutLayer(std::ostream& os, std::string module_name, LutLayer<
                 "            .INIT(" << lut_table_size << "'b";
 
             for (int bit = lut_table_size - 1; bit >= 0; --bit ) {
-                os << (lut.GetLutTable(node, bit) ? "1" : "0");
+                os << (n.table[bit] ? "1" : "0");
             }
             os <<
                 "),\n"
@@ -109,39 +316,41 @@ void ExportVerilog_LutLayer(std::ostream& os, std::string module_name, LutLayer<
 
             os <<
                 "        )\n"
-                "    i_lut_" << node << "\n"
+                "    i_" << name << "\n"
                 "        (\n"
                 "            .in_data({\n";
 
             for (index_t bit = lut_input_size - 1; bit >= 1; --bit) {
                 os <<
-                    "                         in_data[" << lut.GetNodeConnectionIndex(node, bit) << "],\n";
+                    "                         " << signal_name(n.inputs[bit]) << ",\n";
             }
             os <<
-                "                         in_data[" << lut.GetNodeConnectionIndex(node, 0) << "]\n"
+                "                         " << signal_name(n.inputs[0]) << "\n"
                 "                    }),\n"
-                "            .out_data(lut_" << node << "_out)\n"
+                "            .out_data(" << name << "_out)\n"
                 "        );\n"
                 "\n";
-        }
 
-        os <<
-            "reg   lut_" << node << "_ff;\n"
-            "always @(posedge clk) begin\n"
-            "    if ( reset ) begin\n"
-            "        lut_" << node << "_ff <= 1'b0;\n"
-            "    end\n"
-            "    else if ( cke ) begin\n"
-            "        lut_" << node << "_ff <= lut_" << node << "_out;\n"
-            "    end\n"
-            "end\n"
-            "\n"
-            "assign out_data[" << node << "] = lut_" << node << "_ff;\n"
-        "\n";
+            if ( last ) {
+                os <<
+                    "reg   lut_" << node << "_ff;\n"
+                    "always @(posedge clk) begin\n"
+                    "    if ( reset ) begin\n"
+                    "        lut_" << node << "_ff <= 1'b0;\n"
+                    "    end\n"
+                    "    else if ( cke ) begin\n"
+                    "        lut_" << node << "_ff <= lut_" << node << "_out;\n"
+                    "    end\n"
+                    "end\n"
+                    "\n"
+                    "assign out_data[" << node << "] = lut_" << node << "_ff;\n"
+                    "\n";
+            }
 
-        os <<
-            "\n"
-            "\n";
+            os <<
+                "\n"
+                "\n";
+        }
     }
 
     os <<
@@ -150,28 +359,86 @@ void ExportVerilog_LutLayer(std::ostream& os, std::string module_name, LutLayer<
 }
 
 
+// register_interval レイヤー毎にレジスタ段として分割
+template <typename FT = Bit, typename BT = float>
+std::vector< std::vector< std::shared_ptr< LutLayer<FT, BT> > > > ExportVerilog_SplitStages(std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers, int register_interval)
+{
+    BB_ASSERT(register_interval >= 1);
+
+    std::vector< std::vector< std::shared_ptr< LutLayer<FT, BT> > > > stages;
+    for (int i = 0; i < (int)layers.size(); ++i) {
+        if ( i % register_interval == 0 ) {
+            stages.push_back(std::vector< std::shared_ptr< LutLayer<FT, BT> > >());
+        }
+        stages.back().push_back(layers[i]);
+    }
+    return stages;
+}
+
+
+// LUT-Network 基本レイヤーのVerilog 出力
+template <typename FT = Bit, typename BT = float>
+void ExportVerilog_LutLayer(std::ostream& os, std::string module_name, LutLayer<FT, BT> const &lut)
+{
+    std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers;
+    layers.push_back(std::shared_ptr< LutLayer<FT, BT> >(const_cast< LutLayer<FT, BT>* >(&lut), [](LutLayer<FT, BT>*) {}));   // 所有しない
+    ExportVerilog_LutStage<FT, BT>(os, module_name, layers);
+}
+
+
 
 // LUT-Network 基本レイヤーの直列接続を出力
 template <typename FT = Bit, typename BT = float>
-void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers)
+void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers,
+            ExportVerilogConfig const &config = ExportVerilogConfig(), ExportVerilogEstimate *estimate = nullptr)
 {
     int layer_size = (int)layers.size();
 
+    // register_interval レイヤー毎にレジスタ段としてまとめる
+    auto stages     = ExportVerilog_SplitStages<FT, BT>(layers, config.register_interval);
+    int  stage_size = (int)stages.size();
+
     std::vector<std::string> sub_modle_name;
     auto first_layer = layers[0];
     auto last_layer  = layers[layer_size - 1];
 
     // サブモジュール名生成
-    for (int i = 0; i < layer_size; ++i) {
+    for (int i = 0; i < stage_size; ++i) {
         std::stringstream ss_sub_name;
         ss_sub_name << module_name << "_sub" << i;
         sub_modle_name.push_back(ss_sub_name.str());
     }
+
+    // サブモジュールを先に生成して見積りを得る
+    std::vector<ExportVerilogEstimate::Module> sub_estimate(stage_size);
+    std::stringstream ss_sub;
+    for (int i = 0; i < stage_size; ++i) {
+        ExportVerilog_LutStage<FT, BT>(ss_sub, sub_modle_name[i], stages[i], config, &sub_estimate[i]);
+    }
+
+    ExportVerilogEstimate::Module top_estimate;
+    top_estimate.name    = module_name;
+    top_estimate.latency = stage_size;
+    top_estimate.ff_count = stage_size;     // valid
+    for ( auto const &e : sub_estimate ) {
+        top_estimate.lut_count    += e.lut_count;
+        top_estimate.ff_count     += e.ff_count;
+        top_estimate.packed_nodes += e.packed_nodes;
+        top_estimate.removed_luts += e.removed_luts;
+    }
+    if ( estimate != nullptr ) {
+        estimate->modules.push_back(top_estimate);
+        for ( auto const &e : sub_estimate ) {
+            estimate->modules.push_back(e);
+        }
+    }
     
     // モジュール出力
     os <<
         "\n"
         "\n"
+        "// resource estimate : LUT=" << top_estimate.lut_count << ", FF=" << top_estimate.ff_count
+                                      << " + USER_BITS*" << stage_size << ", latency=" << stage_size << "\n"
         "module " << module_name << "\n"
         "        #(\n"
         "            parameter USER_WIDTH = 0,\n"
@@ -194,8 +461,8 @@ void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::vec
         "        );\n"
         "\n\n";
 
-    for (int i = 0; i < layer_size; ++i) {
-        auto layer = layers[i];
+    for (int i = 0; i < stage_size; ++i) {
+        auto layer = stages[i].back();
 
         os
             << "reg   [USER_BITS-1:0]  layer" << i << "_user;\n"
@@ -245,25 +512,23 @@ void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::vec
     }
 
     os
-        << "assign out_data  = layer" << (layer_size - 1) << "_data;\n"
-        << "assign out_user  = layer" << (layer_size - 1) << "_user;\n"
-        << "assign out_valid = layer" << (layer_size - 1) << "_valid;\n"
+        << "assign out_data  = layer" << (stage_size - 1) << "_data;\n"
+        << "assign out_user  = layer" << (stage_size - 1) << "_user;\n"
+        << "assign out_valid = layer" << (stage_size - 1) << "_valid;\n"
         << "\n"
         << "endmodule\n"
         << "\n\n";
     
 
     // サブモジュール出力
-    for (int i = 0; i < layer_size; ++i) {
-        auto layer = layers[i];
-        ExportVerilog_LutLayer<FT, BT>(os, sub_modle_name[i], *layer);
-    }
+    os << ss_sub.str();
 }
 
 
 // LUT-Network 基本レイヤーの直列接続を出力
 template <typename FT = Bit, typename BT = float>
-void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::shared_ptr<bb::Sequential> net)
+void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::shared_ptr<bb::Sequential> net,
+            ExportVerilogConfig const &config = ExportVerilogConfig(), ExportVerilogEstimate *estimate = nullptr)
 {
     std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers;
 
@@ -275,15 +540,21 @@ void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::sha
         }
     }
 
-    ExportVerilog_LutLayers<FT, BT>(os, module_name, layers);
+    ExportVerilog_LutLayers<FT, BT>(os, module_name, layers, config, estimate);
 }
 
 
 
 // Convolutionモジュールの出力
-inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string module_name, std::string mlp_name, int in_c, int out_c, int n, int m)
+inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string module_name, std::string mlp_name, int in_c, int out_c, int n, int m,
+            ExportVerilogEstimate::Module const *estimate = nullptr)
 {
     os << "\n\n\n";
+    if ( estimate != nullptr ) {
+        // jelly_img_blk_buffer のラインバッファ(RAM)は見積りに含まない
+        os << "// resource estimate : LUT=" << estimate->lut_count << ", FF=" << estimate->ff_count
+           << " + (USER_BITS+5)*" << estimate->latency << ", latency=" << estimate->latency << " (excluding line buffer)\n";
+    }
     os << "module " << module_name << "\n";
 
     os << R"(
@@ -438,7 +709,8 @@ endmodule
 
 
 template <typename FT = Bit, typename BT = float>
-void ExportVerilog_LutConvolutionLayer(std::ostream& os, std::string module_name, std::shared_ptr< LoweringConvolution<FT, BT> > conv)
+void ExportVerilog_LutConvolutionLayer(std::ostream& os, std::string module_name, std::shared_ptr< LoweringConvolution<FT, BT> > conv,
+            ExportVerilogConfig const &config = ExportVerilogConfig(), ExportVerilogEstimate *estimate = nullptr)
 {
     // group取得
     auto net = std::dynamic_pointer_cast<Sequential>(conv->GetLayer());
@@ -460,15 +732,30 @@ void ExportVerilog_LutConvolutionLayer(std::ostream& os, std::string module_name
     int n = (int)conv->GetFilterHeight();
     int m = (int)conv->GetFilterWidth();
 
-    ExportVerilog_LutConvolutionModule(os, module_name, mlp_name, in_c, out_c, n, m);
-    ExportVerilog_LutLayers<FT, BT>(os, mlp_name, net);
+    // MLP 部を先に生成して見積りを得る
+    std::stringstream       ss_mlp;
+    ExportVerilogEstimate   mlp_estimate;
+    ExportVerilog_LutLayers<FT, BT>(ss_mlp, mlp_name, net, config, &mlp_estimate);
+
+    auto conv_estimate = mlp_estimate.modules[0];
+    conv_estimate.name = module_name;
+    if ( estimate != nullptr ) {
+        estimate->modules.push_back(conv_estimate);
+        for ( auto const &e : mlp_estimate.modules ) {
+            estimate->modules.push_back(e);
+        }
+    }
+
+    ExportVerilog_LutConvolutionModule(os, module_name, mlp_name, in_c, out_c, n, m, &conv_estimate);
+    os << ss_mlp.str();
 }
 
 
 
 
 template <typename FT = Bit, typename BT = float>
-void ExportVerilog_LutCnnLayersAxi4s(std::ostream& os, std::string module_name, std::vector< std::shared_ptr< Filter2d<FT, BT> > > layers)
+void ExportVerilog_LutCnnLayersAxi4s(std::ostream& os, std::string module_name, std::vector< std::shared_ptr< Filter2d<FT, BT> > > layers,
+            ExportVerilogConfig const &config = ExportVerilogConfig(), ExportVerilogEstimate *estimate = nullptr)
 {
     int  layer_size = (int)layers.size();
     auto fisrt_layer = layers[0];
@@ -481,7 +768,37 @@ void ExportVerilog_LutCnnLayersAxi4s(std::ostream& os, std::string module_name,
     int in_c  = (int)in_shape[2];
     int out_c = (int)out_shape[2];
 
+    // 畳み込み層を先に生成して見積りを得る
+    // (jelly_img_dnn_maxpol, jelly_img_blk_buffer, jelly_axi4s_img は見積りに含まない)
+    std::stringstream               ss_sub;
+    ExportVerilogEstimate           sub_estimate;
+    ExportVerilogEstimate::Module   top_estimate;
+    top_estimate.name = module_name;
+    for ( int i = 0; i < layer_size; ++i ) {
+        auto cnv = std::dynamic_pointer_cast< LoweringConvolution<FT, BT> >(layers[i]);
+        if ( cnv ) {
+            std::stringstream ss;
+            ss << module_name << "_l" << i;
+            auto pos = sub_estimate.modules.size();
+            ExportVerilog_LutConvolutionLayer<FT, BT>(ss_sub, ss.str(), cnv, config, &sub_estimate);
+
+            auto const &e = sub_estimate.modules[pos];    // 畳み込み層のトップ
+            top_estimate.lut_count    += e.lut_count;
+            top_estimate.ff_count     += e.ff_count;
+            top_estimate.latency      += e.latency;
+            top_estimate.packed_nodes += e.packed_nodes;
+            top_estimate.removed_luts += e.removed_luts;
+        }
+    }
+    if ( estimate != nullptr ) {
+        estimate->modules.push_back(top_estimate);
+        for ( auto const &e : sub_estimate.modules ) {
+            estimate->modules.push_back(e);
+        }
+    }
 
+    os << "// resource estimate : LUT=" << top_estimate.lut_count << ", FF=" << top_estimate.ff_count
+       << ", latency=" << top_estimate.latency << " (convolution MLP only, excluding line buffers and max pooling)\n";
     os << "module " << module_name << "\n"; 
     os << R"(
         #(
@@ -710,15 +1027,8 @@ void ExportVerilog_LutCnnLayersAxi4s(std::ostream& os, std::string module_name,
     os << "\t\n";
     os << "endmodule\n\n";
 
-    for ( int i = 0; i < layer_size; ++i ) {
-        auto layer = layers[i];
-        auto cnv = std::dynamic_pointer_cast< LoweringConvolution<FT, BT> >(layer);
-        if ( cnv ) {
-            std::stringstream ss;
-            ss << module_name << "_l" << i;
-            ExportVerilog_LutConvolutionLayer(os, ss.str(), cnv);
-        }
-    }
+    // サブモジュール出力
+    os << ss_sub.str();
 }
 
 
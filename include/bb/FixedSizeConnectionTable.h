@@ -86,8 +86,31 @@ public:
         auto ptr = Lock_InputTable();
         ptr(output_node, connection_index) = (IndexType)input_node;
     }
+
+    void SetInputConnectionTable(std::vector<index_t> const &table, std::vector<index_t> const &offset)
+    {
+        index_t output_node_size = (index_t)offset.size() - 1;
+        BB_ASSERT(output_node_size == this->GetOutputNodeSize());
+
+        auto ptr = Lock_InputTable();
+        ParallelFor(0, output_node_size, [&](index_t node) {
+            BB_DEBUG_ASSERT(offset[node + 1] - offset[node] == N);
+            for ( index_t i = 0; i < N; ++i ) {
+                ptr(node, i) = (IndexType)table[(size_t)(offset[node] + i)];
+            }
+        });
+    }
     
 
+    // 出力ノードの並べ替え
+    void PermuteOutputNodes(std::vector<index_t> const &order)
+    {
+        BB_ASSERT((index_t)order.size() == this->GetOutputNodeSize());
+        Tensor_PermuteRows(m_input_table, order);
+        m_reverse_table_dirty = true;
+    }
+
+
     // Lock
     auto Lock_InputTable(void)
     {
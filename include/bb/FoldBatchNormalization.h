@@ -0,0 +1,229 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <sstream>
+
+#include "bb/Sequential.h"
+#include "bb/BatchNormalization.h"
+#include "bb/StochasticBatchNormalization.h"
+#include "bb/Binarize.h"
+#include "bb/BinarizeThreshold.h"
+#include "bb/SparseLutN.h"
+#include "bb/BinaryLutN.h"
+
+
+namespace bb {
+
+
+// [FoldBatchNormalization]
+//  推論用に BatchNormalization を後段の2値化に畳み込む
+//  ・BatchNormalization / StochasticBatchNormalization + 2値化(Binarize, binaryモードの ReLU/HardTanh/Sigmoid)
+//      y = gain * x + offset > th を x との比較に変形し BinarizeThreshold 1段にする
+//      gain が負のノードは比較を反転、gain が 0 のノードは定数出力にする
+//  ・BatchNormalization 込みの binaryモード SparseLutN
+//      正規化と2値化まで含めて真理値表にした BinaryLutN に置き換える
+//  畳み込まない層は元のインスタンスをそのまま共有する(学習には使わないこと)
+
+
+// 畳み込み結果の報告
+struct FoldBatchNormalizationReport
+{
+    index_t folded_bn       = 0;    // 閾値に畳み込んだ BatchNormalization
+    index_t folded_lut      = 0;    // BinaryLutN にした SparseLutN
+    index_t inverted_nodes  = 0;    // 比較を反転したノード
+    index_t constant_nodes  = 0;    // 定数出力になったノード
+
+    std::string GetInfoString(void) const
+    {
+        std::stringstream ss;
+        ss << "folded batch normalization : " << folded_bn
+           << " (inverted nodes=" << inverted_nodes
+           << ", constant nodes=" << constant_nodes << ")" << std::endl;
+        ss << "folded sparse lut : " << folded_lut << std::endl;
+        return ss.str();
+    }
+};
+
+
+/**
+ * @brief  y = gain * x + offset > binary_th を満たす x の条件を閾値に変形
+ * @param  th      x の閾値
+ * @param  invert  true なら x < th、false なら x > th
+ * @return 定数出力(gain が 0)なら true
+ */
+inline bool FoldBatchNormalization_Threshold(double gain, double offset, double binary_th, double &th, bool &invert)
+{
+    invert = false;
+    if ( gain == 0.0 ) {
+        // 常に offset > binary_th の結果
+        th = (offset > binary_th) ? -std::numeric_limits<double>::infinity() : +std::numeric_limits<double>::infinity();
+        return true;
+    }
+
+    th     = (binary_th - offset) / gain;
+    invert = (gain < 0.0);
+    return false;
+}
+
+
+// 正規化層と後段2値化の畳み込み
+template <typename BinType, typename RealType, class BN>
+std::shared_ptr<Model> FoldBatchNormalization_Binarize(std::shared_ptr<BN> bn, std::shared_ptr<Model> next, FoldBatchNormalizationReport &report, bool bypass = false)
+{
+    auto binarize = std::dynamic_pointer_cast< Binarize<BinType, RealType> >(next);
+    if ( binarize == nullptr || !binarize->IsBinaryMode() ) {
+        return nullptr;
+    }
+
+    auto shape     = bn->GetOutputShape();
+    auto node_size = GetShapeSize(shape);
+    auto folded    = BinarizeThreshold<BinType, RealType>::Create(shape);
+
+    double binary_th = (double)binarize->GetBinaryThreshold();
+    {
+        auto th_ptr     = folded->lock_threshold();
+        auto invert_ptr = folded->lock_invert();
+        for ( index_t node = 0; node < node_size; ++node ) {
+            double gain   = bypass ? 1.0 : (double)bn->GetNormalizeGain(node);
+            double offset = bypass ? 0.0 : (double)bn->GetNormalizeOffset(node);
+            double th;
+            bool   invert;
+            if ( FoldBatchNormalization_Threshold(gain, offset, binary_th, th, invert) ) {
+                report.constant_nodes++;
+            }
+            if ( invert ) {
+                report.inverted_nodes++;
+            }
+            th_ptr[node]     = (RealType)th;
+            invert_ptr[node] = invert ? 1 : 0;
+        }
+    }
+
+    report.folded_bn++;
+    return folded;
+}
+
+
+// BatchNormalization 込みの binaryモード SparseLutN の真理値表化
+template <int N, typename BinType, typename RealType>
+std::shared_ptr<Model> FoldBatchNormalization_SparseLut(std::shared_ptr<Model> layer, FoldBatchNormalizationReport &report)
+{
+    auto sparse = std::dynamic_pointer_cast< SparseLutN<N, BinType, RealType> >(layer);
+    if ( sparse == nullptr || !sparse->IsBinaryMode() || !sparse->IsBatchNorm() ) {
+        return nullptr;
+    }
+
+    auto lut = BinaryLutN<N, BinType, RealType>::Create(sparse->GetOutputShape());
+    lut->SetInputShape(sparse->GetInputShape());
+    lut->ImportLayer(sparse);
+
+    report.folded_lut++;
+    return lut;
+}
+
+template <typename BinType, typename RealType>
+std::shared_ptr<Model> FoldBatchNormalization_SparseLut(std::shared_ptr<Model> layer, FoldBatchNormalizationReport &report)
+{
+    std::shared_ptr<Model> folded;
+    if ( !folded ) { folded = FoldBatchNormalization_SparseLut<6, BinType, RealType>(layer, report); }
+    if ( !folded ) { folded = FoldBatchNormalization_SparseLut<5, BinType, RealType>(layer, report); }
+    if ( !folded ) { folded = FoldBatchNormalization_SparseLut<4, BinType, RealType>(layer, report); }
+    if ( !folded ) { folded = FoldBatchNormalization_SparseLut<3, BinType, RealType>(layer, report); }
+    if ( !folded ) { folded = FoldBatchNormalization_SparseLut<2, BinType, RealType>(layer, report); }
+    return folded;
+}
+
+
+template <typename RealType>
+void FoldBatchNormalization_Layers(std::shared_ptr<Sequential> dst, std::shared_ptr<Sequential> src, FoldBatchNormalizationReport &report)
+{
+    int size = src->GetSize();
+    for ( int i = 0; i < size; ++i ) {
+        auto layer = src->Get(i);
+        auto next  = (i + 1 < size) ? src->Get(i + 1) : nullptr;
+
+        // 入れ子の Sequential
+        auto seq = std::dynamic_pointer_cast<Sequential>(layer);
+        if ( seq != nullptr ) {
+            auto sub = Sequential::Create();
+            FoldBatchNormalization_Layers<RealType>(sub, seq, report);
+            dst->Add(sub);
+            continue;
+        }
+
+        // 正規化 + 2値化
+        std::shared_ptr<Model> folded;
+        if ( next != nullptr ) {
+            auto bn = std::dynamic_pointer_cast< BatchNormalization<RealType> >(layer);
+            if ( bn != nullptr ) {
+                if ( !folded ) { folded = FoldBatchNormalization_Binarize<Bit,      RealType>(bn, next, report, bn->IsBypass()); }
+                if ( !folded ) { folded = FoldBatchNormalization_Binarize<RealType, RealType>(bn, next, report, bn->IsBypass()); }
+            }
+
+            auto sbn = std::dynamic_pointer_cast< StochasticBatchNormalization<RealType> >(layer);
+            if ( sbn != nullptr ) {
+                if ( !folded ) { folded = FoldBatchNormalization_Binarize<Bit,      RealType>(sbn, next, report); }
+                if ( !folded ) { folded = FoldBatchNormalization_Binarize<RealType, RealType>(sbn, next, report); }
+            }
+
+            if ( folded ) {
+                dst->Add(folded);
+                ++i;    // 後段の2値化も置き換え済み
+                continue;
+            }
+        }
+
+        // SparseLutN
+        if ( !folded ) { folded = FoldBatchNormalization_SparseLut<Bit,      RealType>(layer, report); }
+        if ( !folded ) { folded = FoldBatchNormalization_SparseLut<RealType, RealType>(layer, report); }
+
+        dst->Add(folded ? folded : layer);
+    }
+}
+
+
+/**
+ * @brief  BatchNormalization の閾値畳み込み
+ * @detail 推論時の出力が net と等しい(閾値上の値を除く)ネットを生成する
+ * @param  net     対象ネット
+ * @param  report  結果の報告(不要なら nullptr)
+ * @return 畳み込み済みネット
+ */
+template <typename RealType = float>
+std::shared_ptr<Sequential> FoldBatchNormalization_Sequential(std::shared_ptr<Sequential> net, FoldBatchNormalizationReport *report = nullptr)
+{
+    BB_ASSERT(net != nullptr);
+
+    FoldBatchNormalizationReport rep;
+    auto folded_net = Sequential::Create();
+    FoldBatchNormalization_Layers<RealType>(folded_net, net, rep);
+
+    auto input_shape = net->GetInputShape();
+    if ( !input_shape.empty() ) {
+        folded_net->SetInputShape(input_shape);
+    }
+
+    if ( report != nullptr ) {
+        *report = rep;
+    }
+
+    return folded_net;
+}
+
+
+}
+
+
+// end of file
@@ -19,6 +19,8 @@
 
 #include "bb/DataType.h"
 #include "bb/Tensor.h"
+#include "bb/Numa.h"
+#include "bb/ConvertSimd.h"
 
 
 namespace bb {
@@ -268,14 +270,25 @@ public:
 class FrameBuffer
 {
 protected:
-    Tensor                  m_tensor;
+    // m_tensor / m_frame_stride / m_view / m_view_offset は、ビューを書き込みロックした際に
+    // const メソッド(LockMemory() const 等)の中から自前のメモリに切り離す(Detach)ため mutable とする
+    // (new_buf 指定で内容を捨てる場合を除き、切り離しの前後で見える内容は変わらない)
+    mutable Tensor          m_tensor;
 
     int                     m_data_type = 0;
     index_t                 m_frame_size = 0;
-    index_t                 m_frame_stride = 0;
+    mutable index_t         m_frame_stride = 0;
     index_t                 m_node_size = 0;
     std::vector<index_t>    m_node_shape;
 
+    // ビュー(FrameRange/Range/Concatenate で作る、他のバッファとメモリを共有した部分領域)
+    //   m_tensor は元のバッファと共有し、先頭を m_view_offset バイトずらして参照する
+    //   frame_stride は元のバッファのものを引き継ぐ
+    //   ビュー側への書き込みは自前のメモリにコピーしてから書く(copy-on-write)
+    //   copy-on-write はビュー側だけで、元のバッファへの書き込みは生きているビューからも見える
+    mutable bool            m_view = false;
+    mutable index_t         m_view_offset = 0;
+
 public:
     /**
       * @brief  デフォルトコンストラクタ
@@ -332,6 +345,8 @@ public:
         m_frame_stride  = buf.m_frame_stride;
         m_node_size     = buf.m_node_size;
         m_node_shape    = buf.m_node_shape;
+        m_view          = buf.m_view;
+        m_view_offset   = buf.m_view_offset;
 
         return *this;
     }
@@ -343,6 +358,13 @@ public:
      */
     FrameBuffer Clone(void) const
     {
+        // ビューは切り離せばそのまま複製になる
+        if ( m_view ) {
+            FrameBuffer clone_buf = *this;
+            clone_buf.Detach();
+            return clone_buf;
+        }
+
         FrameBuffer clone_buf;
 
         clone_buf.m_tensor       = m_tensor.Clone();
@@ -371,6 +393,19 @@ public:
         return m_tensor.IsDeviceAvailable();
     }
 
+    /**
+     * @brief  ビューかどうか問い合わせる
+     * @detail 他のバッファとメモリを共有した部分領域ならtrue
+     *         書き込みのためにロックした時点で自前のメモリに切り離される
+     *         元のバッファへの書き込みは切り離す前のビューからも見えるので、
+     *         ビューを使い終わるまで元のバッファは書き換えないこと
+     * @return ビューならtrue
+     */
+    bool IsView(void) const
+    {
+        return m_view;
+    }
+
 
     /**
      * @brief  サイズ設定
@@ -381,9 +416,16 @@ public:
      */
     void Resize(index_t frame_size, indices_t shape, int data_type)
     {
+        // ビューは共有元のメモリを触らないように新しく確保する
+        if ( m_view ) {
+            m_tensor      = Tensor(m_tensor.IsHostOnly());
+            m_view        = false;
+            m_view_offset = 0;
+        }
+
         m_data_type    = data_type;
         m_frame_size   = frame_size;
-        m_frame_stride = ((frame_size * DataType_GetBitSize(data_type) + 255) / 256) * (256 / 8);        // frame軸は256bit境界にあわせる(SIMD命令用)
+        m_frame_stride = CalcFrameStride(frame_size, data_type);
         m_node_shape   = shape;
 
 
@@ -405,6 +447,12 @@ public:
 
         // メモリ確保
         m_tensor.Resize(tensor_shape, tensor_type);
+
+        // NUMAモード時はノード範囲を処理するスレッドで first-touch しておく
+        if ( Numa::IsEnabled() && !m_tensor.IsDeviceAvailable() ) {
+            auto ptr = m_tensor.LockMemory(true);
+            Numa::FirstTouch(ptr.GetAddr(), m_frame_stride, m_node_size);
+        }
     }
 
 
@@ -441,10 +489,10 @@ public:
         BB_ASSERT(dst.GetType() == GetType());
 
         if ( node_size <= 0) {
-            node_size = std::min(dst.GetNodeSize() - dst_node_offset, GetFrameSize() - src_node_offset);
+            node_size = std::min(dst.GetNodeSize() - dst_node_offset, GetNodeSize() - src_node_offset);
         }
         if ( frame_size <= 0) {
-            frame_size = std::min(dst.GetFrameSize() - dst_frame_offset, GetFrameSize() - dst_frame_offset);
+            frame_size = std::min(dst.GetFrameSize() - dst_frame_offset, GetFrameSize() - src_frame_offset);
         }
 
         BB_ASSERT(frame_size + src_frame_offset <= GetFrameSize());
@@ -498,6 +546,27 @@ public:
         }
 #endif
 
+        // フレーム位置がバイト境界に揃っていればノード毎に memcpy する(Bit の端数ビットのみ個別にコピー)
+        int unit = DataType_GetBitSize(GetType());
+        if ( (src_frame_offset * unit) % 8 == 0 && (dst_frame_offset * unit) % 8 == 0 ) {
+            auto src_ptr  = LockMemoryConst();
+            auto dst_ptr  = dst.LockMemory();
+            auto src_addr = (std::int8_t const *)src_ptr.GetAddr();
+            auto dst_addr = (std::int8_t       *)dst_ptr.GetAddr();
+
+            index_t byte_size  = (frame_size * unit) / 8;
+            index_t tail_frame = byte_size * 8 / unit;
+            ParallelFor(0, node_size, [&](index_t node) {
+                auto src_node_addr = src_addr + m_frame_stride     * (node + src_node_offset);
+                auto dst_node_addr = dst_addr + dst.m_frame_stride * (node + dst_node_offset);
+                memcpy(dst_node_addr + (dst_frame_offset * unit) / 8, src_node_addr + (src_frame_offset * unit) / 8, byte_size);
+                for ( index_t frame = tail_frame; frame < frame_size; ++frame ) {
+                    DataType_Write<Bit>(dst_node_addr, frame + dst_frame_offset, DataType_Read<Bit>(src_node_addr, frame + src_frame_offset));
+                }
+            });
+            return;
+        }
+
         switch ( GetType() ) {
         case BB_TYPE_BIT:    CopyTo_<Bit     >(dst, frame_size, src_frame_offset, dst_frame_offset, node_size, src_node_offset, dst_node_offset); return;
         case BB_TYPE_FP32:   CopyTo_<float   >(dst, frame_size, src_frame_offset, dst_frame_offset, node_size, src_node_offset, dst_node_offset); return;
@@ -523,6 +592,7 @@ public:
     
     void Save(std::ostream &os) const 
     {
+        Detach();
         os.write((char const *)&m_data_type, sizeof(m_data_type));
         SaveIndex(os, m_frame_size);
         SaveIndex(os, m_frame_stride);
@@ -538,6 +608,9 @@ public:
         m_frame_stride = LoadIndex(is);
         m_node_size    = LoadIndex(is);
         m_node_shape   = LoadIndices(is);
+        m_view         = false;
+        m_view_offset  = 0;
+        m_tensor = Tensor();
         m_tensor.Load(is);
     }
 
@@ -557,6 +630,7 @@ public:
     template <class Archive>
     void serialize(Archive& archive, std::uint32_t const version)
     {
+        Detach();
         archive(cereal::make_nvp("data_type",    m_data_type));
         archive(cereal::make_nvp("frame_size",   m_frame_size));
         archive(cereal::make_nvp("frame_stride", m_frame_stride));
@@ -603,6 +677,11 @@ public:
         BB_ASSERT(total == m_node_size);
 
         m_node_shape = shape;
+
+        // ビューの m_tensor は共有元の形状のままにしておく
+        if ( m_view ) {
+            return;
+        }
         
         std::vector<index_t> tensor_shape;
         tensor_shape.push_back(-1);
@@ -624,6 +703,7 @@ public:
      */
     void FillZero(void)
     {
+        Detach(false);
         m_tensor.FillZero();
     }
 
@@ -640,7 +720,7 @@ public:
     // debug
     inline bool IsValidValue(void) const
     {
-        return m_tensor.IsValidValue();
+        return DetachedTensor().IsValidValue();
     }
 
     // debug
@@ -664,10 +744,11 @@ public:
 
     index_t GetFrameStride(void)  const { return m_frame_stride; }
 
-    Memory::Ptr         LockMemory(bool new_buf=false) const    { return m_tensor.LockMemory(new_buf); }
-    Memory::ConstPtr    LockMemoryConst(void) const             { return m_tensor.LockMemoryConst(); }
-    Memory::DevPtr      LockDeviceMemory(bool new_buf=false) const { return m_tensor.LockDeviceMemory(new_buf); }
-    Memory::DevConstPtr LockDeviceMemoryConst(void) const          { return m_tensor.LockDeviceMemoryConst(); }
+    // 書き込みロックではビューを切り離す(new_buf 指定時は内容をコピーしない)
+    Memory::Ptr         LockMemory(bool new_buf=false) const    { Detach(!new_buf); return m_tensor.LockMemory(new_buf); }
+    Memory::ConstPtr    LockMemoryConst(void) const             { return m_tensor.LockMemoryConst().Offset(m_view_offset); }
+    Memory::DevPtr      LockDeviceMemory(bool new_buf=false) const { Detach(!new_buf); return m_tensor.LockDeviceMemory(new_buf); }
+    Memory::DevConstPtr LockDeviceMemoryConst(void) const          { return m_tensor.LockDeviceMemoryConst().Offset(m_view_offset); }
 
     // 型指定アクセス
     template <typename MemTp, typename ValueTp>
@@ -782,12 +863,11 @@ protected:
         auto src_ptr = this->LockConst<ST>();
         auto dst_ptr = dst_buf.Lock<DT>();
 
-        #pragma omp parallel for
-        for (index_t node = 0; node < m_node_size; ++node) {
+        ParallelFor(0, m_node_size, [&](index_t node) {
             for (index_t frame = 0; frame < m_frame_size; ++frame) {
                 dst_ptr.Set(frame, node, (DT)src_ptr.Get(frame, node));
             }
-        }
+        });
 
         return dst_buf;
     }
@@ -796,37 +876,119 @@ protected:
     FrameBuffer ConvertTo_(int type)
     {
         switch (type) {
-        case BB_TYPE_BIT:    return ConvertTo__<Bit,          ST>();
-        case BB_TYPE_FP32:   return ConvertTo__<float,        ST>();
-        case BB_TYPE_FP64:   return ConvertTo__<double,       ST>();
-        case BB_TYPE_INT8:   return ConvertTo__<std::int8_t,  ST>();
-        case BB_TYPE_INT16:  return ConvertTo__<std::int16_t, ST>();
-        case BB_TYPE_INT32:  return ConvertTo__<std::int32_t, ST>();
-        case BB_TYPE_INT64:  return ConvertTo__<std::int64_t, ST>();
-        case BB_TYPE_UINT8:  return ConvertTo__<std::int8_t,  ST>();
-        case BB_TYPE_UINT16: return ConvertTo__<std::int16_t, ST>();
-        case BB_TYPE_UINT32: return ConvertTo__<std::int32_t, ST>();
-        case BB_TYPE_UINT64: return ConvertTo__<std::int64_t, ST>();
+        case BB_TYPE_BIT:    return ConvertTo__<Bit,           ST>();
+        case BB_TYPE_FP32:   return ConvertTo__<float,         ST>();
+        case BB_TYPE_FP64:   return ConvertTo__<double,        ST>();
+        case BB_TYPE_INT8:   return ConvertTo__<std::int8_t,   ST>();
+        case BB_TYPE_INT16:  return ConvertTo__<std::int16_t,  ST>();
+        case BB_TYPE_INT32:  return ConvertTo__<std::int32_t,  ST>();
+        case BB_TYPE_INT64:  return ConvertTo__<std::int64_t,  ST>();
+        case BB_TYPE_UINT8:  return ConvertTo__<std::uint8_t,  ST>();
+        case BB_TYPE_UINT16: return ConvertTo__<std::uint16_t, ST>();
+        case BB_TYPE_UINT32: return ConvertTo__<std::uint32_t, ST>();
+        case BB_TYPE_UINT64: return ConvertTo__<std::uint64_t, ST>();
         default:   BB_ASSERT(0);
         }
         return FrameBuffer();
     }
 
+    // 行(1ノード分)単位の変換関数を全ノードに適用
+    template <typename ST, typename DT, typename Func>
+    FrameBuffer ConvertRows_(int type, Func func) const
+    {
+        FrameBuffer dst_buf(GetFrameSize(), GetShape(), type);
+
+        auto src_ptr = LockMemoryConst();
+        auto dst_ptr = dst_buf.LockMemory(true);
+        auto src_addr   = (std::uint8_t const *)src_ptr.GetAddr();
+        auto dst_addr   = (std::uint8_t       *)dst_ptr.GetAddr();
+        auto src_stride = m_frame_stride;
+        auto dst_stride = dst_buf.m_frame_stride;
+        auto frame_size = m_frame_size;
+
+        ParallelFor(0, m_node_size, [&](index_t node) {
+            func((ST const *)(src_addr + node * src_stride), (DT *)(dst_addr + node * dst_stride), frame_size);
+        });
+
+        return dst_buf;
+    }
+
+    // 変換カーネルのある組み合わせ (無ければ false)
+    bool ConvertToKernel_(int type, FrameBuffer &dst_buf) const
+    {
+        // FP16 は格納用の型として fp32 との変換のみ対応
+        if ( m_data_type == BB_TYPE_FP16 || type == BB_TYPE_FP16 ) {
+            static SimdKernel fp16_kernel("FrameBuffer::ConvertTo<fp16>", {SimdLevel::AVX2});
+            bool f16c = (fp16_kernel.Select() >= SimdLevel::AVX2 && GetSimdFeatures().f16c);
+            if ( m_data_type == BB_TYPE_FP32 && type == BB_TYPE_FP16 ) {
+                dst_buf = ConvertRows_<float, std::uint16_t>(type, f16c ? simd_fp32_ConvertToFp16_f16c : simd_fp32_ConvertToFp16);
+                return true;
+            }
+            if ( m_data_type == BB_TYPE_FP16 && type == BB_TYPE_FP32 ) {
+                dst_buf = ConvertRows_<std::uint16_t, float>(type, f16c ? simd_fp16_ConvertToFp32_f16c : simd_fp16_ConvertToFp32);
+                return true;
+            }
+            BB_ASSERT(0);
+            return false;
+        }
+
+#ifdef BB_WITH_CUDA
+        // デバイス側にある場合は従来の経路に任せる
+        if ( IsDeviceAvailable() ) {
+            return false;
+        }
+#endif
+
+        static SimdKernel convert_kernel("FrameBuffer::ConvertTo", {SimdLevel::AVX2});
+        if ( convert_kernel.Select() < SimdLevel::AVX2 ) {
+            return false;
+        }
+
+        if ( m_data_type == BB_TYPE_FP32 && type == BB_TYPE_BIT ) {
+            dst_buf = ConvertRows_<float, std::uint8_t>(type, simd_fp32_ConvertToBit_avx2);
+            return true;
+        }
+        if ( m_data_type == BB_TYPE_BIT && type == BB_TYPE_FP32 ) {
+            dst_buf = ConvertRows_<std::uint8_t, float>(type, simd_bit_ConvertToFp32_avx2);
+            return true;
+        }
+        if ( m_data_type == BB_TYPE_UINT8 && type == BB_TYPE_FP32 ) {
+            dst_buf = ConvertRows_<std::uint8_t, float>(type, [](std::uint8_t const *src, float *dst, index_t size) {
+                    simd_uint8_ConvertToFp32_avx2(src, dst, size, 1.0f);
+                });
+            return true;
+        }
+
+        return false;
+    }
+
 public:
+    /**
+     * @brief  型変換
+     * @detail fp32/bit/uint8 間の主要な変換は SIMD カーネルで行う
+     *         FP16 は fp32 との相互変換のみ対応
+     * @param  type 変換後の型
+     * @return 変換後のバッファ
+     */
     FrameBuffer ConvertTo(int type)
     {
+        FrameBuffer dst_buf;
+        if ( ConvertToKernel_(type, dst_buf) ) {
+            return dst_buf;
+        }
+
         switch (m_data_type) {
         case BB_TYPE_BIT:    return ConvertTo_<Bit>(type);
         case BB_TYPE_FP32:   return ConvertTo_<float>(type);
         case BB_TYPE_FP64:   return ConvertTo_<double>(type);
-        case BB_TYPE_INT8:   return ConvertTo_<std::int8_t >(type);
+        case BB_TYPE_INT8:   return ConvertTo_<std::int8_t>(type);
         case BB_TYPE_INT16:  return ConvertTo_<std::int16_t>(type);
         case BB_TYPE_INT32:  return ConvertTo_<std::int32_t>(type);
         case BB_TYPE_INT64:  return ConvertTo_<std::int64_t>(type);
-        case BB_TYPE_UINT8:  return ConvertTo_<std::int8_t>(type);
-        case BB_TYPE_UINT16: return ConvertTo_<std::int16_t>(type);
-        case BB_TYPE_UINT32: return ConvertTo_<std::int32_t>(type);
-        case BB_TYPE_UINT64: return ConvertTo_<std::int64_t>(type);
+        case BB_TYPE_UINT8:  return ConvertTo_<std::uint8_t>(type);
+        case BB_TYPE_UINT16: return ConvertTo_<std::uint16_t>(type);
+        case BB_TYPE_UINT32: return ConvertTo_<std::uint32_t>(type);
+        case BB_TYPE_UINT64: return ConvertTo_<std::uint64_t>(type);
         default:   BB_ASSERT(0);
         }
         return FrameBuffer();
@@ -866,7 +1028,7 @@ protected:
     }
 
     template<typename Tp>
-    Tp ReadValue(void *base, index_t frame) const
+    Tp ReadValue(void const *base, index_t frame) const
     {
         switch (m_data_type) {
         case BB_TYPE_BIT:    return static_cast<Tp>(DataType_Read<Bit>         (base, frame));  break;
@@ -1029,7 +1191,7 @@ public:
     template <typename Tp>
     inline Tp GetValue(index_t frame, index_t node) const
     {
-        auto ptr = LockMemory();
+        auto ptr = LockMemoryConst();
         return ReadValue<Tp>(GetNodeBaseAddr(ptr.GetAddr(), node), frame);
     }
 
@@ -1121,8 +1283,9 @@ public:
         BB_ASSERT(data.size() == (size_t)m_node_size);
         BB_ASSERT(frame >= 0 && frame < m_frame_size);
 
+        auto ptr = LockMemory();
         for (index_t node = 0; node < m_node_size; ++node) {
-            SetValue<Tp>(frame, node, data[node]);
+            SetValue<Tp>(ptr.GetAddr(), frame, node, data[node]);
         }
     }
 
@@ -1130,12 +1293,7 @@ public:
     void SetVector(std::vector< std::vector<Tp> > const &data)
     {
         BB_ASSERT(data.size() == (size_t)m_frame_size);
-        for (index_t frame = 0; frame < m_frame_size; ++frame) {
-            BB_ASSERT(data[frame].size() == (size_t)m_node_size);
-            for (index_t node = 0; node < m_node_size; ++node) {
-                SetValue<Tp>(frame, node, data[frame][node]);
-            }
-        }
+        SetData<Tp>(data);
     }
 
     template<typename Tp>
@@ -1144,13 +1302,12 @@ public:
         BB_ASSERT(GetType() == DataType<Tp>::type);
         BB_ASSERT(offset + m_frame_size <= (index_t)data.size() );
 
-        auto ptr = Lock<Tp>();
+        std::vector<Tp const *> rows(m_frame_size);
         for (index_t frame = 0; frame < m_frame_size; ++frame) {
-            BB_ASSERT(data[frame].size() == (size_t)m_node_size);
-            for (index_t node = 0; node < m_node_size; ++node) {
-                ptr.Set(frame, node, data[frame + offset][node]);
-            }
+            BB_ASSERT(data[frame + offset].size() == (size_t)m_node_size);
+            rows[frame] = data[frame + offset].data();
         }
+        SetFrameRows_<Tp, Tp>(rows.data(), m_frame_size, 0);
     }
 
     template<typename Tp>
@@ -1159,14 +1316,195 @@ public:
         BB_ASSERT(frame >= 0 && frame < m_frame_size);
 
         std::vector<Tp> data(m_node_size);
+        auto ptr = LockMemoryConst();
         for (index_t node = 0; node < m_node_size; ++node) {
-            data[node] = GetValue<Tp>(frame, node);
+            data[node] = ReadValue<Tp>(GetNodeBaseAddr(ptr.GetAddr(), node), frame);
         }
 
         return data;
     }
 
 
+protected:
+    // サンプル優先の行 rows[frame][node] との間の転送
+    // 転置はノード方向とフレーム方向のブロック単位で行い、ブロック毎に並列化する
+    // fp32/bit と fp32(uint8) の組み合わせは SIMD 版で転置する
+    template<typename BufType, typename VecType>
+    void SetFrameRows_(VecType const * const *rows, index_t size, index_t offset, float scale=1.0f)
+    {
+        BB_ASSERT(GetType() == DataType<BufType>::type);
+        BB_ASSERT(offset >= 0 && offset + size <= m_frame_size);
+
+        if ( SetFrameRowsSimd_((BufType const *)nullptr, rows, size, offset, scale) ) {
+            return;
+        }
+
+        index_t const block      = 32;
+        index_t const node_size  = m_node_size;
+        bool    const scaling    = (scale != 1.0f);
+
+        auto ptr = Lock<BufType>();
+        ParallelFor(0, (node_size + block - 1) / block, [&](index_t node_block) {
+            index_t node_begin = node_block * block;
+            index_t node_end   = std::min(node_begin + block, node_size);
+            for ( index_t frame_begin = 0; frame_begin < size; frame_begin += block ) {
+                index_t frame_end = std::min(frame_begin + block, size);
+                for ( index_t node = node_begin; node < node_end; ++node ) {
+                    for ( index_t i = frame_begin; i < frame_end; ++i ) {
+                        if ( scaling ) {
+                            ptr.Set(i + offset, node, (BufType)(rows[i][node] * scale));
+                        }
+                        else {
+                            ptr.Set(i + offset, node, (BufType)rows[i][node]);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    template<typename BufType, typename VecType>
+    void GetFrameRows_(VecType * const *rows, index_t size, index_t offset) const
+    {
+        BB_ASSERT(GetType() == DataType<BufType>::type);
+        BB_ASSERT(offset >= 0 && offset + size <= m_frame_size);
+
+        if ( GetFrameRowsSimd_((BufType const *)nullptr, rows, size, offset) ) {
+            return;
+        }
+
+        index_t const block      = 32;
+        index_t const node_size  = m_node_size;
+
+        auto ptr = LockConst<BufType>();
+        ParallelFor(0, (size + block - 1) / block, [&](index_t frame_block) {
+            index_t frame_begin = frame_block * block;
+            index_t frame_end   = std::min(frame_begin + block, size);
+            for ( index_t node_begin = 0; node_begin < node_size; node_begin += block ) {
+                index_t node_end = std::min(node_begin + block, node_size);
+                for ( index_t i = frame_begin; i < frame_end; ++i ) {
+                    for ( index_t node = node_begin; node < node_end; ++node ) {
+                        rows[i][node] = (VecType)ptr.Get(i + offset, node);
+                    }
+                }
+            }
+        });
+    }
+
+    // SIMD 版 (対応しない型の組み合わせは false を返して汎用版に任せる)
+    template<typename BufType, typename VecType>
+    bool SetFrameRowsSimd_(BufType const *, VecType const * const *, index_t, index_t, float) { return false; }
+
+    template<typename VecType>
+    bool SetFrameRowsSimdFp32_(VecType const * const *rows, index_t size, index_t offset, float scale)
+    {
+        static SimdKernel set_kernel("FrameBuffer::SetData<fp32>", {SimdLevel::AVX2});
+        if ( set_kernel.Select() < SimdLevel::AVX2 ) {
+            return false;
+        }
+
+        // タイルの大きさ (サンプル側の行を 64byte 単位で読み、ノード側の行に 1Kbyte ずつ書く)
+        index_t const node_block  = 16;
+        index_t const frame_block = 256;
+        index_t const node_size   = m_node_size;
+        index_t const stride      = m_frame_stride / (index_t)sizeof(float);
+
+        auto ptr  = LockMemory();
+        auto base = (float *)ptr.GetAddr() + offset;
+        ParallelFor(0, (node_size + node_block - 1) / node_block, [&](index_t node_index) {
+            index_t node_begin = node_index * node_block;
+            index_t node_end   = std::min(node_begin + node_block, node_size);
+            for ( index_t frame_begin = 0; frame_begin < size; frame_begin += frame_block ) {
+                index_t frame_end = std::min(frame_begin + frame_block, size);
+                simd_fp32_TransposeFromRows_avx2<VecType>(rows, frame_begin, frame_end, node_begin, node_end, base, stride, scale);
+            }
+        });
+        return true;
+    }
+
+    bool SetFrameRowsSimd_(float const *, float const * const *rows, index_t size, index_t offset, float scale)
+    {
+        return SetFrameRowsSimdFp32_<float>(rows, size, offset, scale);
+    }
+
+    bool SetFrameRowsSimd_(float const *, std::uint8_t const * const *rows, index_t size, index_t offset, float scale)
+    {
+        return SetFrameRowsSimdFp32_<std::uint8_t>(rows, size, offset, scale);
+    }
+
+    bool SetFrameRowsSimd_(Bit const *, float const * const *rows, index_t size, index_t offset, float scale)
+    {
+        static SimdKernel set_kernel("FrameBuffer::SetData<bit>", {SimdLevel::AVX2});
+        if ( offset % 8 != 0 || set_kernel.Select() < SimdLevel::AVX2 ) {
+            return false;
+        }
+
+        index_t const block      = 32;
+        index_t const node_size  = m_node_size;
+        index_t const stride     = m_frame_stride;
+
+        auto ptr  = LockMemory();
+        auto base = (std::uint8_t *)ptr.GetAddr() + offset / 8;
+        ParallelFor(0, (node_size + block - 1) / block, [&](index_t node_block) {
+            index_t node_begin = node_block * block;
+            index_t node_end   = std::min(node_begin + block, node_size);
+            simd_bit_TransposeFromRows_avx2(rows, 0, size, node_begin, node_end, base, stride, scale);
+        });
+        return true;
+    }
+
+    template<typename BufType, typename VecType>
+    bool GetFrameRowsSimd_(BufType const *, VecType * const *, index_t, index_t) const { return false; }
+
+    bool GetFrameRowsSimd_(float const *, float * const *rows, index_t size, index_t offset) const
+    {
+        static SimdKernel get_kernel("FrameBuffer::GetData<fp32>", {SimdLevel::AVX2});
+        if ( get_kernel.Select() < SimdLevel::AVX2 ) {
+            return false;
+        }
+
+        // タイルの大きさ (ノード側の行を 1Kbyte ずつ読み、サンプル側の行に 64byte 単位で書く)
+        index_t const node_block  = 16;
+        index_t const frame_block = 256;
+        index_t const node_size   = m_node_size;
+        index_t const stride      = m_frame_stride / (index_t)sizeof(float);
+
+        auto ptr  = LockMemoryConst();
+        auto base = (float const *)ptr.GetAddr() + offset;
+        ParallelFor(0, (size + frame_block - 1) / frame_block, [&](index_t frame_index) {
+            index_t frame_begin = frame_index * frame_block;
+            index_t frame_end   = std::min(frame_begin + frame_block, size);
+            for ( index_t node_begin = 0; node_begin < node_size; node_begin += node_block ) {
+                index_t node_end = std::min(node_begin + node_block, node_size);
+                simd_fp32_TransposeToRows_avx2(base, stride, frame_begin, frame_end, node_begin, node_end, rows);
+            }
+        });
+        return true;
+    }
+
+    bool GetFrameRowsSimd_(Bit const *, float * const *rows, index_t size, index_t offset) const
+    {
+        static SimdKernel get_kernel("FrameBuffer::GetData<bit>", {SimdLevel::AVX2});
+        if ( offset % 8 != 0 || get_kernel.Select() < SimdLevel::AVX2 ) {
+            return false;
+        }
+
+        index_t const block      = 32;
+        index_t const node_size  = m_node_size;
+        index_t const stride     = m_frame_stride;
+
+        auto ptr  = LockMemoryConst();
+        auto base = (std::uint8_t const *)ptr.GetAddr() + offset / 8;
+        ParallelFor(0, (size + block - 1) / block, [&](index_t frame_block) {
+            index_t frame_begin = frame_block * block;
+            index_t frame_end   = std::min(frame_begin + block, size);
+            simd_bit_TransposeToRows_avx2(base, stride, frame_begin, frame_end, 0, node_size, rows);
+        });
+        return true;
+    }
+
+
+public:
     template<typename BufType, typename VecType=float>
     void SetData_(std::vector< std::vector<VecType> > const &data, index_t offset=0)
     {
@@ -1176,14 +1514,12 @@ public:
         index_t size = (index_t)data.size(); 
         if ( size + offset > m_frame_size ) { size = m_frame_size - offset; }
 
-        auto ptr = Lock<BufType>();
+        std::vector<VecType const *> rows(size);
         for (index_t i = 0; i < size; ++i) {
-            index_t frame = i + offset;
             BB_ASSERT(data[i].size() == (size_t)m_node_size);
-            for (index_t node = 0; node < m_node_size; ++node) {
-                ptr.Set(frame, node, (BufType)data[i][node]);
-            }
+            rows[i] = data[i].data();
         }
+        SetFrameRows_<BufType, VecType>(rows.data(), size, offset);
     }
 
     template<typename BufType, typename VecType=float>
@@ -1195,15 +1531,12 @@ public:
         BB_ASSERT(offset + size <= m_frame_size);
 
         std::vector< std::vector<VecType> > data(size);
-
-        auto ptr = LockConst<BufType>();
+        std::vector<VecType *>              rows(size);
         for (index_t i = 0; i < size; ++i) {
             data[i].resize(m_node_size);
-            index_t frame = i + offset;
-            for (index_t node = 0; node < m_node_size; ++node) {
-                data[i][node] = (VecType)ptr.Get(frame, node);
-            }
+            rows[i] = data[i].data();
         }
+        GetFrameRows_<BufType, VecType>(rows.data(), size, offset);
 
         return data;
     }
@@ -1248,6 +1581,81 @@ public:
     }
 
 
+    // 連続配列 [frame][node] (サンプル優先) との間の一括転送
+    template<typename BufType, typename VecType=float>
+    void SetDataArray_(VecType const *data, index_t size, index_t offset=0, float scale=1.0f)
+    {
+        std::vector<VecType const *> rows(size);
+        for ( index_t i = 0; i < size; ++i ) {
+            rows[i] = data + i * m_node_size;
+        }
+        SetFrameRows_<BufType, VecType>(rows.data(), size, offset, scale);
+    }
+
+    template<typename BufType, typename VecType=float>
+    void GetDataArray_(VecType *data, index_t size, index_t offset=0) const
+    {
+        std::vector<VecType *> rows(size);
+        for ( index_t i = 0; i < size; ++i ) {
+            rows[i] = data + i * m_node_size;
+        }
+        GetFrameRows_<BufType, VecType>(rows.data(), size, offset);
+    }
+
+    /**
+     * @brief  連続配列からの一括設定
+     * @detail data[frame][node] (C連続) の size フレーム分を offset フレーム目から設定する
+     * @param  data   入力配列
+     * @param  size   フレーム数
+     * @param  offset 設定先の先頭フレーム
+     * @param  scale  設定時に掛ける係数 (uint8 画像の正規化などに使う)
+     */
+    template<typename VecType=float>
+    void SetDataArray(VecType const *data, index_t size, index_t offset=0, float scale=1.0f)
+    {
+        switch (GetType()) {
+        case BB_TYPE_BIT:    SetDataArray_<bb::Bit,       VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_FP32:   SetDataArray_<float,         VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_FP64:   SetDataArray_<double,        VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_INT8:   SetDataArray_<std::int8_t,   VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_INT16:  SetDataArray_<std::int16_t,  VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_INT32:  SetDataArray_<std::int32_t,  VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_INT64:  SetDataArray_<std::int64_t,  VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_UINT8:  SetDataArray_<std::uint8_t,  VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_UINT16: SetDataArray_<std::uint16_t, VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_UINT32: SetDataArray_<std::uint32_t, VecType>(data, size, offset, scale);    break;
+        case BB_TYPE_UINT64: SetDataArray_<std::uint64_t, VecType>(data, size, offset, scale);    break;
+        default:   BB_ASSERT(0);
+        }
+    }
+
+    /**
+     * @brief  連続配列への一括取得
+     * @detail offset フレーム目から size フレーム分を data[frame][node] (C連続) に取り出す
+     * @param  data   出力配列
+     * @param  size   フレーム数
+     * @param  offset 取得元の先頭フレーム
+     */
+    template<typename VecType=float>
+    void GetDataArray(VecType *data, index_t size, index_t offset=0) const
+    {
+        switch (GetType()) {
+        case BB_TYPE_BIT:    GetDataArray_<bb::Bit,       VecType>(data, size, offset);    break;
+        case BB_TYPE_FP32:   GetDataArray_<float,         VecType>(data, size, offset);    break;
+        case BB_TYPE_FP64:   GetDataArray_<double,        VecType>(data, size, offset);    break;
+        case BB_TYPE_INT8:   GetDataArray_<std::int8_t,   VecType>(data, size, offset);    break;
+        case BB_TYPE_INT16:  GetDataArray_<std::int16_t,  VecType>(data, size, offset);    break;
+        case BB_TYPE_INT32:  GetDataArray_<std::int32_t,  VecType>(data, size, offset);    break;
+        case BB_TYPE_INT64:  GetDataArray_<std::int64_t,  VecType>(data, size, offset);    break;
+        case BB_TYPE_UINT8:  GetDataArray_<std::uint8_t,  VecType>(data, size, offset);    break;
+        case BB_TYPE_UINT16: GetDataArray_<std::uint16_t, VecType>(data, size, offset);    break;
+        case BB_TYPE_UINT32: GetDataArray_<std::uint32_t, VecType>(data, size, offset);    break;
+        case BB_TYPE_UINT64: GetDataArray_<std::uint64_t, VecType>(data, size, offset);    break;
+        default:   BB_ASSERT(0);
+        }
+    }
+
+
     // テンソルの設定
 public:
     template<typename Tp>
@@ -1279,86 +1687,110 @@ public:
 
 
     // フレームの部分切り出し
-    FrameBuffer FrameRange(index_t size, index_t offset=0)
+    //  多くのカーネルは x と y が同じ frame_stride で、パディング部分はフレーム外のデータを
+    //  含まないことを前提としているため、ビューを返すのは全範囲の場合だけとし
+    //  部分範囲は標準の frame_stride にコピーする(パディング部分はゼロクリア)
+    //  したがって Sequential のマイクロバッチ分割や DynamicBatcher の結果切り出しのような
+    //  部分範囲の切り出しは毎回コピーになる(フレーム方向オフセットのビューは未対応)
+    FrameBuffer FrameRange(index_t size, index_t offset=0) const
     {
         BB_ASSERT(offset >= 0 && offset < m_frame_size);
-        BB_ASSERT(size >= 0 &&  size < m_frame_size - offset);
+        BB_ASSERT(size >= 0 &&  size <= m_frame_size - offset);
+
+        int unit = DataType_GetBitSize(m_data_type);
+        if ( offset == 0 && size == m_frame_size ) {
+            FrameBuffer view_buf = *this;
+            view_buf.m_view = true;
+            return view_buf;
+        }
 
         FrameBuffer buf(size, m_node_shape, m_data_type);
 
-        auto src_ptr = m_tensor.LockMemoryConst();
+        auto src_ptr = LockMemoryConst();
         auto dst_ptr = buf.m_tensor.LockMemory(true);
         auto src_addr = (std::int8_t const *)src_ptr.GetAddr();
         auto dst_addr = (std::int8_t       *)dst_ptr.GetAddr();
 
         if (m_data_type == BB_TYPE_BIT && (offset % 8) != 0 ) {
-            #pragma omp parallel for
-            for (index_t node = 0; node < m_node_size; ++node)
-            {
+            ParallelFor(0, m_node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < size; ++frame) {
                     auto val = DataType_Read<Bit>(src_addr + m_frame_stride * node, frame + offset);
-                    DataType_Write<Bit>(dst_addr + m_frame_stride * node, frame, val);
+                    DataType_Write<Bit>(dst_addr + buf.m_frame_stride * node, frame, val);
                 }
-            }           
+            });
         }
         else {
-            int     unit   = DataType_GetBitSize(m_data_type);
             index_t byte_offset = (offset * unit + 7) / 8;
             index_t byte_size   = (size * unit + 7) / 8;
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < m_node_size; ++node)
-            {
+            ParallelFor(0, m_node_size, [&](index_t node) {
                 memcpy(dst_addr + buf.m_frame_stride * node, src_addr + m_frame_stride * node + byte_offset, byte_size);
-            }
+            });
         }
 
+        buf.ClearPadding(dst_addr);
+
         return buf;
     }
 
     
-    FrameBuffer Range(index_t size, index_t offset=0)
+    // ノードの部分切り出し(同じメモリを参照するビューを返す)
+    FrameBuffer Range(index_t size, index_t offset=0) const
     {
         BB_ASSERT(offset >= 0 && offset < m_node_size);
-        BB_ASSERT(size >= 0 &&  size < m_node_size - offset);
+        BB_ASSERT(size >= 0 &&  size <= m_node_size - offset);
 
-        FrameBuffer buf(m_frame_size, {size}, m_data_type);
+        BB_DEBUG_ASSERT(m_frame_stride == CalcFrameStride(m_frame_size, m_data_type));
 
-        auto src_ptr = m_tensor.LockMemoryConst();
-        auto dst_ptr = buf.m_tensor.LockMemory(true);
-        auto src_addr = (std::int8_t const *)src_ptr.GetAddr();
-        auto dst_addr = (std::int8_t       *)dst_ptr.GetAddr();
-
-        index_t stride_size = GetFrameStride();
-        memcpy(dst_addr, src_addr + (m_frame_stride * offset), stride_size * size);
-
-        return buf;
+        FrameBuffer view_buf = *this;
+        view_buf.m_node_size   = size;
+        view_buf.m_node_shape  = indices_t({size});
+        view_buf.m_view        = true;
+        view_buf.m_view_offset = m_view_offset + m_frame_stride * offset;
+        return view_buf;
     }
 
 
-    FrameBuffer Concatenate(FrameBuffer const& buf)
+    // ノード方向の連結
+    //  同じメモリ上で隣接している(Range で切り出した隣り合う範囲など)ならビューを返す
+    //  それ以外はノード毎にコピーする
+    FrameBuffer Concatenate(FrameBuffer const& buf) const
     {
         BB_ASSERT(buf.GetType() == GetType());
         BB_ASSERT(buf.m_frame_size == m_frame_size);
-        BB_ASSERT(buf.m_frame_stride == m_frame_stride);
+
+        if ( buf.m_frame_stride == m_frame_stride && buf.m_view_offset == m_view_offset + m_frame_stride * m_node_size ) {
+            auto src0_ptr = m_tensor.LockMemoryConst();
+            auto src1_ptr = buf.m_tensor.LockMemoryConst();
+            if ( src0_ptr.GetAddr() == src1_ptr.GetAddr() ) {
+                BB_DEBUG_ASSERT(m_frame_stride == CalcFrameStride(m_frame_size, m_data_type));
+                FrameBuffer view_buf = *this;
+                view_buf.m_node_size  = m_node_size + buf.m_node_size;
+                view_buf.m_node_shape = indices_t({view_buf.m_node_size});
+                view_buf.m_view       = true;
+                return view_buf;
+            }
+        }
 
         FrameBuffer dst_buf(m_frame_size, {m_node_size + buf.m_node_size}, m_data_type);
 
         auto dst_ptr  = dst_buf.m_tensor.LockMemory(true);
         auto dst_addr = (std::int8_t *)dst_ptr.GetAddr();
-
-        {
-            auto src0_ptr  = m_tensor.LockMemoryConst();
-            auto src0_addr = (std::int8_t const *)src0_ptr.GetAddr();
-            memcpy(dst_addr, src0_addr, m_frame_stride * m_node_size);
-            dst_addr += m_frame_stride * m_node_size;
-        }
-
-        {
-            auto src1_ptr  = buf.m_tensor.LockMemoryConst();
-            auto src1_addr = (std::int8_t const *)src1_ptr.GetAddr();
-            memcpy(dst_addr, src1_addr, buf.m_frame_stride * buf.m_node_size);
-        }
+        index_t dst_stride = dst_buf.m_frame_stride;
+
+        // ノード毎にコピーする
+        auto src0_ptr  = LockMemoryConst();
+        auto src1_ptr  = buf.LockMemoryConst();
+        auto src0_addr = (std::int8_t const *)src0_ptr.GetAddr();
+        auto src1_addr = (std::int8_t const *)src1_ptr.GetAddr();
+        ParallelFor(0, m_node_size + buf.m_node_size, [&](index_t node) {
+            if ( node < m_node_size ) {
+                memcpy(dst_addr + dst_stride * node, src0_addr + m_frame_stride * node, dst_stride);
+            }
+            else {
+                memcpy(dst_addr + dst_stride * node, src1_addr + buf.m_frame_stride * (node - m_node_size), dst_stride);
+            }
+        });
 
         return dst_buf;
     }
@@ -1369,34 +1801,35 @@ public:
     //  演算
     // -------------------------------------
 
-    inline FrameBuffer& operator+=(FrameBuffer src) { m_tensor += src.m_tensor; return *this; }
-    inline FrameBuffer& operator+=(double src)      { m_tensor += src; return *this; }
-    inline FrameBuffer& operator-=(FrameBuffer src) { m_tensor -= src.m_tensor; return *this; }
-    inline FrameBuffer& operator-=(double src)      { m_tensor -= src; return *this; }
-    inline FrameBuffer& operator*=(FrameBuffer src) { m_tensor *= src.m_tensor; return *this; }
-    inline FrameBuffer& operator*=(double src)      { m_tensor *= src; return *this; }
-    inline FrameBuffer& operator/=(FrameBuffer src) { m_tensor /= src.m_tensor; return *this; }
-    inline FrameBuffer& operator/=(double src)      { m_tensor /= src; return *this; }
+    // テンソル全体の演算はビューを切り離してから行う
+    inline FrameBuffer& operator+=(FrameBuffer src) { Detach(); m_tensor += src.DetachedTensor(); return *this; }
+    inline FrameBuffer& operator+=(double src)      { Detach(); m_tensor += src; return *this; }
+    inline FrameBuffer& operator-=(FrameBuffer src) { Detach(); m_tensor -= src.DetachedTensor(); return *this; }
+    inline FrameBuffer& operator-=(double src)      { Detach(); m_tensor -= src; return *this; }
+    inline FrameBuffer& operator*=(FrameBuffer src) { Detach(); m_tensor *= src.DetachedTensor(); return *this; }
+    inline FrameBuffer& operator*=(double src)      { Detach(); m_tensor *= src; return *this; }
+    inline FrameBuffer& operator/=(FrameBuffer src) { Detach(); m_tensor /= src.DetachedTensor(); return *this; }
+    inline FrameBuffer& operator/=(double src)      { Detach(); m_tensor /= src; return *this; }
 
     
     FrameBuffer Sqrt(void)
     {
         FrameBuffer dst(GetFrameSize(), GetShape(), GetType(), IsHostOnly());
-        dst.m_tensor = m_tensor.Sqrt();
+        dst.m_tensor = DetachedTensor().Sqrt();
         return dst;
     }
 
     FrameBuffer Exp(void)
     {
         FrameBuffer dst(GetFrameSize(), GetShape(), GetType(), IsHostOnly());
-        dst.m_tensor = m_tensor.Exp();
+        dst.m_tensor = DetachedTensor().Exp();
         return dst;
     }
     
 
     double Sum(void)
     {
-        return m_tensor.Sum();
+        return DetachedTensor().Sum();
     }
 
     double Norm(void)
@@ -1420,27 +1853,93 @@ public:
     friend  FrameBuffer operator/(double src0, FrameBuffer const &src1);
     friend  FrameBuffer Sqrt(FrameBuffer const &src);
     friend  FrameBuffer Exp(FrameBuffer const &src);
+
+
+protected:
+    // -------------------------------------
+    //  ビュー管理
+    // -------------------------------------
+
+    /**
+     * @brief  ビューの切り離し
+     * @detail ビューなら自前のメモリを確保して参照先を切り替える(通常のバッファなら何もしない)
+     *         内容は変わらないので const からも呼べるようにしている
+     * @param  copy 内容をコピーする場合 true
+     */
+    // 標準の frame_stride (frame軸は256bit境界にあわせる(SIMD命令用))
+    static index_t CalcFrameStride(index_t frame_size, int data_type)
+    {
+        return ((frame_size * DataType_GetBitSize(data_type) + 255) / 256) * (256 / 8);
+    }
+
+    // 末尾フレーム以降のパディング部分をゼロクリア
+    void ClearPadding(std::int8_t *addr) const
+    {
+        int     unit       = DataType_GetBitSize(m_data_type);
+        index_t valid_bits = m_frame_size * unit;
+        index_t full_bytes = valid_bits / 8;
+        ParallelFor(0, m_node_size, [&](index_t node) {
+            auto row = addr + m_frame_stride * node;
+            if ( valid_bits % 8 != 0 ) {
+                row[full_bytes] &= (std::int8_t)((1 << (valid_bits % 8)) - 1);
+                memset(row + full_bytes + 1, 0, m_frame_stride - full_bytes - 1);
+            }
+            else {
+                memset(row + full_bytes, 0, m_frame_stride - full_bytes);
+            }
+        });
+    }
+
+    void Detach(bool copy = true) const
+    {
+        if ( !m_view ) {
+            return;
+        }
+
+        FrameBuffer buf(m_frame_size, m_node_shape, m_data_type, IsHostOnly());
+        if ( copy ) {
+            auto src_ptr  = LockMemoryConst();
+            auto dst_ptr  = buf.m_tensor.LockMemory(true);
+            auto src_addr = (std::int8_t const *)src_ptr.GetAddr();
+            auto dst_addr = (std::int8_t       *)dst_ptr.GetAddr();
+            ParallelFor(0, m_node_size, [&](index_t node) {
+                memcpy(dst_addr + buf.m_frame_stride * node, src_addr + m_frame_stride * node, buf.m_frame_stride);
+            });
+        }
+
+        m_tensor       = buf.m_tensor;
+        m_frame_stride = buf.m_frame_stride;
+        m_view         = false;
+        m_view_offset  = 0;
+    }
+
+    // テンソル全体を扱う演算用
+    Tensor DetachedTensor(void) const
+    {
+        Detach();
+        return m_tensor;
+    }
 };
 
 
 inline FrameBuffer operator+(FrameBuffer const &src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor + src1.m_tensor;
+    dst.m_tensor = src0.DetachedTensor() + src1.DetachedTensor();
     return dst;
 }
 
 inline FrameBuffer operator+(FrameBuffer const &src0, double src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor + src1;
+    dst.m_tensor = src0.DetachedTensor() + src1;
     return dst;
 }
 
 inline FrameBuffer operator+(double src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src1.GetFrameSize(), src1.GetShape(), src1.GetType(), src1.IsHostOnly());
-    dst.m_tensor = src0 + src1.m_tensor;
+    dst.m_tensor = src0 + src1.DetachedTensor();
     return dst;
 }
 
@@ -1448,21 +1947,21 @@ inline FrameBuffer operator+(double src0, FrameBuffer const &src1)
 inline FrameBuffer operator-(FrameBuffer const &src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor - src1.m_tensor;
+    dst.m_tensor = src0.DetachedTensor() - src1.DetachedTensor();
     return dst;
 }
 
 inline FrameBuffer operator-(FrameBuffer const &src0, double src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor - src1;
+    dst.m_tensor = src0.DetachedTensor() - src1;
     return dst;
 }
 
 inline FrameBuffer operator-(double src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src1.GetFrameSize(), src1.GetShape(), src1.GetType(), src1.IsHostOnly());
-    dst.m_tensor = src0 - src1.m_tensor;
+    dst.m_tensor = src0 - src1.DetachedTensor();
     return dst;
 }
 
@@ -1470,21 +1969,21 @@ inline FrameBuffer operator-(double src0, FrameBuffer const &src1)
 inline FrameBuffer operator*(FrameBuffer const &src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor * src1.m_tensor;
+    dst.m_tensor = src0.DetachedTensor() * src1.DetachedTensor();
     return dst;
 }
 
 inline FrameBuffer operator*(FrameBuffer const &src0, double src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor * src1;
+    dst.m_tensor = src0.DetachedTensor() * src1;
     return dst;
 }
 
 inline FrameBuffer operator*(double src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src1.GetFrameSize(), src1.GetShape(), src1.GetType(), src1.IsHostOnly());
-    dst.m_tensor = src0 * src1.m_tensor;
+    dst.m_tensor = src0 * src1.DetachedTensor();
     return dst;
 }
 
@@ -1492,35 +1991,35 @@ inline FrameBuffer operator*(double src0, FrameBuffer const &src1)
 inline FrameBuffer operator/(FrameBuffer const &src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor / src1.m_tensor;
+    dst.m_tensor = src0.DetachedTensor() / src1.DetachedTensor();
     return dst;
 }
 
 inline FrameBuffer operator/(FrameBuffer const &src0, double src1)
 {
     FrameBuffer dst(src0.GetFrameSize(), src0.GetShape(), src0.GetType(), src0.IsHostOnly());
-    dst.m_tensor = src0.m_tensor / src1;
+    dst.m_tensor = src0.DetachedTensor() / src1;
     return dst;
 }
 
 inline FrameBuffer operator/(double src0, FrameBuffer const &src1)
 {
     FrameBuffer dst(src1.GetFrameSize(), src1.GetShape(), src1.GetType(), src1.IsHostOnly());
-    dst.m_tensor = src0 / src1.m_tensor;
+    dst.m_tensor = src0 / src1.DetachedTensor();
     return dst;
 }
 
 inline FrameBuffer Sqrt(FrameBuffer const &src)
 {
     FrameBuffer dst(src.GetFrameSize(), src.GetShape(), src.GetType(), src.IsHostOnly());
-    dst.m_tensor = Sqrt(src.m_tensor);
+    dst.m_tensor = Sqrt(src.DetachedTensor());
     return dst;
 }
 
 inline FrameBuffer Exp(FrameBuffer const &src)
 {
     FrameBuffer dst(src.GetFrameSize(), src.GetShape(), src.GetType(), src.IsHostOnly());
-    dst.m_tensor = Exp(src.m_tensor);
+    dst.m_tensor = Exp(src.DetachedTensor());
     return dst;
 }
 
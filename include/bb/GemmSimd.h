@@ -0,0 +1,320 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#ifdef BB_WITH_OPENBLAS
+#include <cblas.h>
+#endif
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+#include "bb/ThreadPool.h"
+
+
+namespace bb {
+
+
+// [fp32 GEMM]
+//  C(m, n) = Σk A(m, k) * B(k, n) + beta * C(m, n)
+//  A, B は行/列ストライドを個別に指定でき、転置はストライドの入替えで表す
+//  (FrameBuffer はノード毎にフレームが連続するので、フレームを n か k に当てれば
+//   DenseAffine の forward/backward が転置コピー無しでそのまま GEMM になる)
+//   ・A を MR 行、B を NR 列のパネルに詰め直し(キャッシュブロッキング)
+//   ・MR x NR のマイクロカーネルで C をレジスタに保持したまま k 方向に積和する
+//       AVX2    : 6 x 16 (ymm 12本を累積に使用)
+//       AVX-512 : 6 x 32 (zmm 12本を累積に使用)
+//   ・C を MC x NC のタイルに分けて並列化する
+//  BB_WITH_OPENBLAS 定義時は cblas_sgemm に委譲する(ストライドが BLAS で表せる場合)
+
+
+static index_t const simd_fp32_Gemm_MR = 6;
+static index_t const simd_fp32_Gemm_MC = 96;
+static index_t const simd_fp32_Gemm_KC = 256;
+static index_t const simd_fp32_Gemm_NC = 1024;
+
+
+// A のパネル詰め : dst[k][r] (MR 行単位、端は 0 詰め)
+inline void simd_fp32_Gemm_PackA(float *dst, float const *a, index_t a_rs, index_t a_cs, index_t m_size, index_t k_size)
+{
+    index_t const MR = simd_fp32_Gemm_MR;
+    for ( index_t m0 = 0; m0 < m_size; m0 += MR ) {
+        index_t m_valid = std::min(MR, m_size - m0);
+        for ( index_t k = 0; k < k_size; ++k ) {
+            index_t r = 0;
+            for ( ; r < m_valid; ++r ) {
+                dst[r] = a[(m0 + r) * a_rs + k * a_cs];
+            }
+            for ( ; r < MR; ++r ) {
+                dst[r] = 0.0f;
+            }
+            dst += MR;
+        }
+    }
+}
+
+// B のパネル詰め : dst[k][n] (NR 列単位、端は 0 詰め)
+inline void simd_fp32_Gemm_PackB(float *dst, float const *b, index_t b_rs, index_t b_cs, index_t k_size, index_t n_size, index_t NR)
+{
+    for ( index_t n0 = 0; n0 < n_size; n0 += NR ) {
+        index_t n_valid = std::min(NR, n_size - n0);
+        for ( index_t k = 0; k < k_size; ++k ) {
+            float const *src = &b[k * b_rs + n0 * b_cs];
+            if ( b_cs == 1 ) {
+                std::memcpy(dst, src, n_valid * sizeof(float));
+            }
+            else {
+                for ( index_t n = 0; n < n_valid; ++n ) {
+                    dst[n] = src[n * b_cs];
+                }
+            }
+            for ( index_t n = n_valid; n < NR; ++n ) {
+                dst[n] = 0.0f;
+            }
+            dst += NR;
+        }
+    }
+}
+
+
+// 汎用版マイクロカーネル (MR x 16)
+inline void simd_fp32_Gemm_Kernel_fp32(index_t k_size, float const *ap, float const *bp, float *c, index_t c_rs, bool accumulate)
+{
+    index_t const MR = simd_fp32_Gemm_MR;
+    index_t const NR = 16;
+
+    float acc[MR][NR] = {};
+    for ( index_t k = 0; k < k_size; ++k ) {
+        for ( index_t r = 0; r < MR; ++r ) {
+            for ( index_t n = 0; n < NR; ++n ) {
+                acc[r][n] += ap[r] * bp[n];
+            }
+        }
+        ap += MR;
+        bp += NR;
+    }
+
+    for ( index_t r = 0; r < MR; ++r ) {
+        for ( index_t n = 0; n < NR; ++n ) {
+            c[r * c_rs + n] = accumulate ? c[r * c_rs + n] + acc[r][n] : acc[r][n];
+        }
+    }
+}
+
+// AVX2版マイクロカーネル (6 x 16)
+BB_TARGET_AVX2
+inline void simd_fp32_Gemm_Kernel_avx2(index_t k_size, float const *ap, float const *bp, float *c, index_t c_rs, bool accumulate)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for ( index_t k = 0; k < k_size; ++k ) {
+        __m256 b0 = _mm256_loadu_ps(&bp[0]);
+        __m256 b1 = _mm256_loadu_ps(&bp[8]);
+        __m256 a;
+        a = _mm256_broadcast_ss(&ap[0]); c00 = _mm256_fmadd_ps(a, b0, c00); c01 = _mm256_fmadd_ps(a, b1, c01);
+        a = _mm256_broadcast_ss(&ap[1]); c10 = _mm256_fmadd_ps(a, b0, c10); c11 = _mm256_fmadd_ps(a, b1, c11);
+        a = _mm256_broadcast_ss(&ap[2]); c20 = _mm256_fmadd_ps(a, b0, c20); c21 = _mm256_fmadd_ps(a, b1, c21);
+        a = _mm256_broadcast_ss(&ap[3]); c30 = _mm256_fmadd_ps(a, b0, c30); c31 = _mm256_fmadd_ps(a, b1, c31);
+        a = _mm256_broadcast_ss(&ap[4]); c40 = _mm256_fmadd_ps(a, b0, c40); c41 = _mm256_fmadd_ps(a, b1, c41);
+        a = _mm256_broadcast_ss(&ap[5]); c50 = _mm256_fmadd_ps(a, b0, c50); c51 = _mm256_fmadd_ps(a, b1, c51);
+        ap += 6;
+        bp += 16;
+    }
+
+    __m256 acc[6][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51}};
+    for ( int r = 0; r < 6; ++r ) {
+        float *c_row = &c[r * c_rs];
+        for ( int j = 0; j < 2; ++j ) {
+            __m256 y = acc[r][j];
+            if ( accumulate ) {
+                y = _mm256_add_ps(y, _mm256_loadu_ps(&c_row[j * 8]));
+            }
+            _mm256_storeu_ps(&c_row[j * 8], y);
+        }
+    }
+}
+
+// AVX-512版マイクロカーネル (6 x 32)
+BB_TARGET_AVX512
+inline void simd_fp32_Gemm_Kernel_avx512(index_t k_size, float const *ap, float const *bp, float *c, index_t c_rs, bool accumulate)
+{
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+
+    for ( index_t k = 0; k < k_size; ++k ) {
+        __m512 b0 = _mm512_loadu_ps(&bp[0]);
+        __m512 b1 = _mm512_loadu_ps(&bp[16]);
+        __m512 a;
+        a = _mm512_set1_ps(ap[0]); c00 = _mm512_fmadd_ps(a, b0, c00); c01 = _mm512_fmadd_ps(a, b1, c01);
+        a = _mm512_set1_ps(ap[1]); c10 = _mm512_fmadd_ps(a, b0, c10); c11 = _mm512_fmadd_ps(a, b1, c11);
+        a = _mm512_set1_ps(ap[2]); c20 = _mm512_fmadd_ps(a, b0, c20); c21 = _mm512_fmadd_ps(a, b1, c21);
+        a = _mm512_set1_ps(ap[3]); c30 = _mm512_fmadd_ps(a, b0, c30); c31 = _mm512_fmadd_ps(a, b1, c31);
+        a = _mm512_set1_ps(ap[4]); c40 = _mm512_fmadd_ps(a, b0, c40); c41 = _mm512_fmadd_ps(a, b1, c41);
+        a = _mm512_set1_ps(ap[5]); c50 = _mm512_fmadd_ps(a, b0, c50); c51 = _mm512_fmadd_ps(a, b1, c51);
+        ap += 6;
+        bp += 32;
+    }
+
+    __m512 acc[6][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51}};
+    for ( int r = 0; r < 6; ++r ) {
+        float *c_row = &c[r * c_rs];
+        for ( int j = 0; j < 2; ++j ) {
+            __m512 y = acc[r][j];
+            if ( accumulate ) {
+                y = _mm512_add_ps(y, _mm512_loadu_ps(&c_row[j * 16]));
+            }
+            _mm512_storeu_ps(&c_row[j * 16], y);
+        }
+    }
+}
+
+
+/**
+ * @brief  fp32 GEMM  C = A * B + beta * C
+ * @detail 実行時に CPU を判定して AVX-512/AVX2/汎用版を選択する
+ *         A(m, k) = a[m * a_rs + k * a_cs]
+ *         B(k, n) = b[k * b_rs + n * b_cs]
+ *         C(m, n) = c[m * c_rs + n]
+ * @param  beta  0 なら C を上書き、1 なら C に加算
+ */
+inline void simd_fp32_Gemm
+    (
+        index_t         m_size,
+        index_t         n_size,
+        index_t         k_size,
+        float const     *a,
+        index_t         a_rs,
+        index_t         a_cs,
+        float const     *b,
+        index_t         b_rs,
+        index_t         b_cs,
+        float           beta,
+        float           *c,
+        index_t         c_rs
+    )
+{
+    BB_ASSERT(beta == 0.0f || beta == 1.0f);
+
+    if ( m_size <= 0 || n_size <= 0 ) {
+        return;
+    }
+
+    if ( k_size <= 0 ) {
+        if ( beta == 0.0f ) {
+            for ( index_t m = 0; m < m_size; ++m ) {
+                std::fill(&c[m * c_rs], &c[m * c_rs] + n_size, 0.0f);
+            }
+        }
+        return;
+    }
+
+#ifdef BB_WITH_OPENBLAS
+    if ( (a_cs == 1 || a_rs == 1) && (b_cs == 1 || b_rs == 1) ) {
+        bool a_trans = (a_cs != 1);
+        bool b_trans = (b_cs != 1);
+        cblas_sgemm(CblasRowMajor,
+                a_trans ? CblasTrans : CblasNoTrans,
+                b_trans ? CblasTrans : CblasNoTrans,
+                (int)m_size, (int)n_size, (int)k_size,
+                1.0f,
+                a, (int)(a_trans ? std::max(a_cs, m_size) : std::max(a_rs, k_size)),
+                b, (int)(b_trans ? std::max(b_cs, k_size) : std::max(b_rs, n_size)),
+                beta,
+                c, (int)c_rs);
+        return;
+    }
+#endif
+
+    static SimdKernel kernel("Gemm<fp32>", {SimdLevel::AVX2, SimdLevel::AVX512});
+    auto level = kernel.Select();
+
+    index_t const MR = simd_fp32_Gemm_MR;
+    index_t const MC = simd_fp32_Gemm_MC;
+    index_t const KC = simd_fp32_Gemm_KC;
+    index_t const NC = simd_fp32_Gemm_NC;
+    index_t const NR = (level >= SimdLevel::AVX512) ? 32 : 16;
+
+    index_t m_blocks = (m_size + MC - 1) / MC;
+    index_t n_blocks = (n_size + NC - 1) / NC;
+
+    // C のタイル単位で並列化(タイル毎に A/B を詰め直す)
+    ParallelFor(0, m_blocks * n_blocks, [&](index_t tile) {
+        index_t m0 = (tile % m_blocks) * MC;
+        index_t n0 = (tile / m_blocks) * NC;
+        index_t mc = std::min(MC, m_size - m0);
+        index_t nc = std::min(NC, n_size - n0);
+
+        std::vector<float> a_pack(((mc + MR - 1) / MR) * MR * KC);
+        std::vector<float> b_pack(((nc + NR - 1) / NR) * NR * KC);
+        float              c_tmp[6 * 32];
+
+        for ( index_t k0 = 0; k0 < k_size; k0 += KC ) {
+            index_t kc         = std::min(KC, k_size - k0);
+            bool    accumulate = (k0 > 0 || beta != 0.0f);
+
+            simd_fp32_Gemm_PackB(b_pack.data(), &b[k0 * b_rs + n0 * b_cs], b_rs, b_cs, kc, nc, NR);
+            simd_fp32_Gemm_PackA(a_pack.data(), &a[m0 * a_rs + k0 * a_cs], a_rs, a_cs, mc, kc);
+
+            for ( index_t jr = 0; jr < nc; jr += NR ) {
+                for ( index_t ir = 0; ir < mc; ir += MR ) {
+                    float const *ap      = &a_pack[(ir / MR) * MR * kc];
+                    float const *bp      = &b_pack[(jr / NR) * NR * kc];
+                    float       *c_addr  = &c[(m0 + ir) * c_rs + (n0 + jr)];
+                    index_t     m_valid  = std::min(MR, mc - ir);
+                    index_t     n_valid  = std::min(NR, nc - jr);
+                    bool        full     = (m_valid == MR && n_valid == NR);
+
+                    // 端のタイルは一時領域で計算してから有効部分だけ書き戻す
+                    float       *dst     = full ? c_addr : c_tmp;
+                    index_t     dst_rs   = full ? c_rs   : NR;
+                    bool        dst_acc  = full ? accumulate : false;
+
+                    if ( level >= SimdLevel::AVX512 ) {
+                        simd_fp32_Gemm_Kernel_avx512(kc, ap, bp, dst, dst_rs, dst_acc);
+                    }
+                    else if ( level >= SimdLevel::AVX2 ) {
+                        simd_fp32_Gemm_Kernel_avx2(kc, ap, bp, dst, dst_rs, dst_acc);
+                    }
+                    else {
+                        simd_fp32_Gemm_Kernel_fp32(kc, ap, bp, dst, dst_rs, dst_acc);
+                    }
+
+                    if ( !full ) {
+                        for ( index_t r = 0; r < m_valid; ++r ) {
+                            for ( index_t n = 0; n < n_valid; ++n ) {
+                                float v = c_tmp[r * NR + n];
+                                c_addr[r * c_rs + n] = accumulate ? c_addr[r * c_rs + n] + v : v;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+
+}
+
+
+// end of file
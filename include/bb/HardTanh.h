@@ -98,6 +98,8 @@ public:
 
     std::string GetClassName(void) const { return "HardTanh"; }
 
+    bool IsBinaryMode(void) const { return DataType<BinType>::type == BB_TYPE_BIT || m_binary_mode; }
+
     void        SetFrameBufferX(FrameBuffer x) { m_x_buf = x; }
     FrameBuffer GetFrameBufferX(void)          { return m_x_buf; }
 
@@ -129,13 +131,31 @@ public:
             return _super::Forward(x_buf, train);
         }
 
-        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
-
         // backward用に保存
         if ( train ) {
             m_x_buf = x_buf;
         }
 
+        InferenceContext ctx;
+        return Forward(x_buf, ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    inline FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        // binaryモード
+        if ( DataType<BinType>::type == BB_TYPE_BIT || m_binary_mode ) {
+            return _super::Forward(x_buf, ctx);
+        }
+
+        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
+
         // 戻り値の設定
         FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), x_buf.GetType());
 
@@ -167,15 +187,14 @@ public:
             auto y_ptr = y_buf.template Lock<BinType>();
 
             // Hard-Tanh
-    #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto x = x_ptr.Get(frame, node);
                     if ( x <= m_hardtanh_min ) { x = m_hardtanh_min; }
                     if ( x >= m_hardtanh_max ) { x = m_hardtanh_max; }
                     y_ptr.Set(frame, node, x);
                 }
-            }
+            });
             return y_buf;
         }
     }
@@ -232,8 +251,7 @@ public:
             auto dx_ptr = dx_buf.template Lock<RealType>();
 
             // Hard-Tanh
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto x  = x_ptr.Get(frame, node);
                     auto dy = dy_ptr.Get(frame, node);
@@ -241,7 +259,7 @@ public:
                     if ( x >= m_hardtanh_max ) { dy = (RealType)0; }
                     dx_ptr.Set(frame, node, dy);
                 }
-            }
+            });
 
             return dx_buf;
         }
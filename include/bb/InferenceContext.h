@@ -0,0 +1,67 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <map>
+#include <memory>
+
+
+namespace bb {
+
+
+/**
+ * @brief   推論用コンテキスト
+ * @details const な Forward(x_buf, ctx) で使う呼び出し単位の作業領域を保持する
+ *          重みなどのモデル本体は読み出し専用で共有し、レイヤーが呼び出し毎に
+ *          必要とする状態(出力バッファの使い回しなど)はすべてここに置く
+ *          コンテキスト自体はスレッドセーフではないので、スレッド毎に1つ用意すること
+ */
+class InferenceContext
+{
+protected:
+    std::map< void const *, std::shared_ptr<void> >  m_states;
+
+public:
+    InferenceContext() {}
+    InferenceContext(InferenceContext const &) = delete;
+    InferenceContext& operator=(InferenceContext const &) = delete;
+
+    /**
+     * @brief  レイヤー毎の状態取得
+     * @detail owner をキーに状態を取得する(無ければデフォルト構築する)
+     * @param  owner 状態を所有するレイヤー
+     * @return 状態への参照
+     */
+    template <typename T>
+    T& GetState(void const *owner)
+    {
+        auto &state = m_states[owner];
+        if ( !state ) {
+            state = std::make_shared<T>();
+        }
+        return *std::static_pointer_cast<T>(state);
+    }
+
+    /**
+     * @brief  状態の破棄
+     * @detail 保持している作業領域をすべて解放する
+     */
+    void Clear(void)
+    {
+        m_states.clear();
+    }
+};
+
+
+}
+
+
+// end of file
@@ -0,0 +1,511 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <list>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bb/DynamicBatcher.h"
+
+
+namespace bb {
+
+
+// --------------------------------------------------------------------------
+//  通信プロトコル (Unix domain socket 上の固定長ヘッダ + データ)
+//    要求 : header(code=コマンド) + float32[frame_size][node_size]
+//    応答 : header(code=状態)     + float32[frame_size][node_size]
+//    統計 : header(code=状態)     + 文字列(data_size バイト)
+//  ローカル通信専用なのでバイトオーダーはホストのまま
+// --------------------------------------------------------------------------
+
+struct InferenceMessageHeader
+{
+    std::uint32_t   magic;
+    std::uint32_t   code;
+    std::uint32_t   frame_size;
+    std::uint32_t   node_size;
+    std::uint64_t   data_size;      //< 後続データのバイト数
+};
+
+enum : std::uint32_t
+{
+    BB_INFERENCE_MAGIC           = 0x53494242,     // "BBIS"
+
+    BB_INFERENCE_CMD_FORWARD     = 1,
+    BB_INFERENCE_CMD_STATISTICS  = 2,
+
+    BB_INFERENCE_STATUS_OK       = 0,
+    BB_INFERENCE_STATUS_ERROR    = 1,
+};
+
+
+inline bool InferenceSocket_Read(int fd, void *buf, size_t size)
+{
+    auto ptr = (char *)buf;
+    while ( size > 0 ) {
+        auto ret = recv(fd, ptr, size, 0);
+        if ( ret < 0 && errno == EINTR ) { continue; }
+        if ( ret <= 0 ) { return false; }
+        ptr  += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+inline bool InferenceSocket_Write(int fd, void const *buf, size_t size)
+{
+    auto ptr = (char const *)buf;
+    while ( size > 0 ) {
+        auto ret = send(fd, ptr, size, MSG_NOSIGNAL);
+        if ( ret < 0 && errno == EINTR ) { continue; }
+        if ( ret <= 0 ) { return false; }
+        ptr  += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+inline bool InferenceSocket_WriteMessage(int fd, std::uint32_t code, std::uint32_t frame_size, std::uint32_t node_size, void const *data, std::uint64_t data_size)
+{
+    InferenceMessageHeader header;
+    header.magic      = BB_INFERENCE_MAGIC;
+    header.code       = code;
+    header.frame_size = frame_size;
+    header.node_size  = node_size;
+    header.data_size  = data_size;
+    if ( !InferenceSocket_Write(fd, &header, sizeof(header)) ) {
+        return false;
+    }
+    return data_size == 0 || InferenceSocket_Write(fd, data, (size_t)data_size);
+}
+
+
+/**
+ * @brief   ローカル推論サーバー
+ * @details Unix domain socket で推論要求を受け付け、DynamicBatcher で
+ *          複数接続の要求をまとめて推論する
+ *          モデルは Runner::LoadJson / LoadBinary などで読み込み済みのものを渡す
+ */
+class InferenceServer
+{
+public:
+    struct create_t
+    {
+        std::shared_ptr<Model>  net;                        //< 推論するモデル
+        std::string             socket_path;                //< 待ち受ける Unix domain socket のパス
+        index_t                 max_batch_size = 256;       //< 1回にまとめる最大フレーム数
+        double                  max_delay      = 0.001;     //< 最初の要求からの最大待ち時間[s]
+        index_t                 max_frame_size = 65536;     //< 1要求の最大フレーム数
+    };
+
+protected:
+    struct Connection
+    {
+        int                 fd = -1;
+        std::thread         thread;
+        std::atomic<bool>   done{false};
+    };
+
+    std::shared_ptr<DynamicBatcher>             m_batcher;
+    std::string                                 m_socket_path;
+    index_t                                     m_max_frame_size = 65536;
+
+    int                                         m_listen_fd = -1;
+    std::atomic<bool>                           m_stop{false};
+    std::thread                                 m_accept_thread;
+    std::mutex                                  m_mutex;
+    std::list< std::unique_ptr<Connection> >    m_connections;
+
+protected:
+    InferenceServer(create_t const &create)
+    {
+        DynamicBatcher::create_t batcher_create;
+        batcher_create.net            = create.net;
+        batcher_create.max_batch_size = create.max_batch_size;
+        batcher_create.max_delay      = create.max_delay;
+        m_batcher        = DynamicBatcher::Create(batcher_create);
+        m_socket_path    = create.socket_path;
+        m_max_frame_size = create.max_frame_size;
+    }
+
+public:
+    ~InferenceServer()
+    {
+        Stop();
+    }
+
+    static std::shared_ptr<InferenceServer> Create(create_t const &create)
+    {
+        return std::shared_ptr<InferenceServer>(new InferenceServer(create));
+    }
+
+    static std::shared_ptr<InferenceServer> Create(std::shared_ptr<Model> net, std::string socket_path, index_t max_batch_size = 256, double max_delay = 0.001)
+    {
+        create_t create;
+        create.net            = net;
+        create.socket_path    = socket_path;
+        create.max_batch_size = max_batch_size;
+        create.max_delay      = max_delay;
+        return Create(create);
+    }
+
+    std::string GetClassName(void) const { return "InferenceServer"; }
+
+    std::shared_ptr<DynamicBatcher> GetBatcher(void) const { return m_batcher; }
+
+    /**
+     * @brief  待ち受け開始
+     * @return 成功すれば true
+     */
+    bool Start(void)
+    {
+        BB_ASSERT(m_listen_fd < 0);
+
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if ( m_socket_path.empty() || m_socket_path.size() >= sizeof(addr.sun_path) ) {
+            return false;
+        }
+        strncpy(addr.sun_path, m_socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ( fd < 0 ) {
+            return false;
+        }
+
+        // 前回のソケットが残っていれば消す(ソケット以外のファイルは消さずに bind を失敗させる)
+        RemoveSocketFile();
+        if ( bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0 ) {
+            close(fd);
+            return false;
+        }
+
+        m_listen_fd = fd;
+        m_stop      = false;
+        m_accept_thread = std::thread(&InferenceServer::AcceptMain, this);
+        return true;
+    }
+
+    /**
+     * @brief  待ち受け停止
+     * @detail 接続中のクライアントも切断する
+     */
+    void Stop(void)
+    {
+        if ( m_listen_fd < 0 ) {
+            return;
+        }
+
+        m_stop = true;
+        shutdown(m_listen_fd, SHUT_RDWR);
+        m_accept_thread.join();
+        close(m_listen_fd);
+        m_listen_fd = -1;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for ( auto &conn : m_connections ) {
+            shutdown(conn->fd, SHUT_RDWR);
+        }
+        for ( auto &conn : m_connections ) {
+            conn->thread.join();
+            close(conn->fd);
+        }
+        m_connections.clear();
+
+        RemoveSocketFile();
+    }
+
+    std::string GetStatisticsString(void)
+    {
+        return m_batcher->GetStatisticsString();
+    }
+
+protected:
+    void RemoveSocketFile(void)
+    {
+        struct stat st;
+        if ( lstat(m_socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) ) {
+            unlink(m_socket_path.c_str());
+        }
+    }
+
+    void AcceptMain(void)
+    {
+        for ( ; ; ) {
+            int fd = accept(m_listen_fd, nullptr, nullptr);
+            if ( fd < 0 ) {
+                // 停止要求以外のエラーでは待ち受けを続ける
+                if ( m_stop ) {
+                    break;
+                }
+                if ( errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM ) {
+                    // 資源不足は解消を待ってから再試行
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // 終了済みの接続を回収
+            for ( auto it = m_connections.begin(); it != m_connections.end(); ) {
+                if ( (*it)->done ) {
+                    (*it)->thread.join();
+                    close((*it)->fd);
+                    it = m_connections.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+
+            std::unique_ptr<Connection> conn(new Connection);
+            conn->fd     = fd;
+            auto ptr     = conn.get();
+            conn->thread = std::thread([this, ptr]() {
+                ConnectionMain(ptr->fd);
+                shutdown(ptr->fd, SHUT_RDWR);   // close は回収時に行う
+                ptr->done = true;
+            });
+            m_connections.push_back(std::move(conn));
+        }
+    }
+
+    void ConnectionMain(int fd)
+    {
+        auto input_shape = m_batcher->GetModel()->GetInputShape();
+        auto input_node_size = GetShapeSize(input_shape);
+
+        std::vector<float>  buf;
+        for ( ; ; ) {
+            InferenceMessageHeader header;
+            if ( !InferenceSocket_Read(fd, &header, sizeof(header)) || header.magic != BB_INFERENCE_MAGIC ) {
+                return;
+            }
+
+            if ( header.code == BB_INFERENCE_CMD_FORWARD ) {
+                index_t frame_size = (index_t)header.frame_size;
+                index_t node_size  = (index_t)header.node_size;
+                bool    valid = (node_size == input_node_size && frame_size > 0 && frame_size <= m_max_frame_size
+                                    && header.data_size == (std::uint64_t)(frame_size * node_size * sizeof(float)));
+                if ( !valid ) {
+                    // 形式が不正な場合はデータを読み捨てずに切断する
+                    InferenceSocket_WriteMessage(fd, BB_INFERENCE_STATUS_ERROR, 0, 0, nullptr, 0);
+                    return;
+                }
+
+                buf.resize((size_t)(frame_size * node_size));
+                if ( !InferenceSocket_Read(fd, buf.data(), (size_t)header.data_size) ) {
+                    return;
+                }
+
+                FrameBuffer x_buf(frame_size, input_shape, BB_TYPE_FP32);
+                x_buf.SetDataArray(buf.data(), frame_size);
+
+                FrameBuffer y_buf;
+                try {
+                    y_buf = m_batcher->Forward(x_buf);
+                }
+                catch (...) {
+                    if ( !InferenceSocket_WriteMessage(fd, BB_INFERENCE_STATUS_ERROR, 0, 0, nullptr, 0) ) {
+                        return;
+                    }
+                    continue;
+                }
+
+                index_t output_node_size = y_buf.GetNodeSize();
+                buf.resize((size_t)(frame_size * output_node_size));
+                y_buf.GetDataArray(buf.data(), frame_size);
+                if ( !InferenceSocket_WriteMessage(fd, BB_INFERENCE_STATUS_OK, (std::uint32_t)frame_size, (std::uint32_t)output_node_size,
+                                                    buf.data(), (std::uint64_t)(buf.size() * sizeof(float))) ) {
+                    return;
+                }
+            }
+            else if ( header.code == BB_INFERENCE_CMD_STATISTICS && header.data_size == 0 ) {
+                auto str = m_batcher->GetStatisticsString();
+                if ( !InferenceSocket_WriteMessage(fd, BB_INFERENCE_STATUS_OK, 0, 0, str.data(), str.size()) ) {
+                    return;
+                }
+            }
+            else {
+                InferenceSocket_WriteMessage(fd, BB_INFERENCE_STATUS_ERROR, 0, 0, nullptr, 0);
+                return;
+            }
+        }
+    }
+};
+
+
+/**
+ * @brief   ローカル推論サーバーのクライアント
+ * @details InferenceServer に接続して推論要求を送る
+ *          1つのクライアントは同時に1要求のみ(並列に投げる場合はスレッド毎に接続する)
+ */
+class InferenceClient
+{
+protected:
+    int     m_fd = -1;
+
+public:
+    InferenceClient() {}
+    InferenceClient(InferenceClient const &) = delete;
+    InferenceClient& operator=(InferenceClient const &) = delete;
+
+    ~InferenceClient()
+    {
+        Close();
+    }
+
+    /**
+     * @brief  接続
+     * @param  socket_path  サーバーの Unix domain socket のパス
+     * @return 成功すれば true
+     */
+    bool Connect(std::string socket_path)
+    {
+        Close();
+
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if ( socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path) ) {
+            return false;
+        }
+        strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ( fd < 0 ) {
+            return false;
+        }
+        if ( connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0 ) {
+            close(fd);
+            return false;
+        }
+        m_fd = fd;
+        return true;
+    }
+
+    void Close(void)
+    {
+        if ( m_fd >= 0 ) {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    bool IsConnected(void) const { return m_fd >= 0; }
+
+    /**
+     * @brief  推論要求
+     * @param  x            入力 x[frame][node] (C連続)
+     * @param  frame_size   フレーム数
+     * @param  node_size    入力ノード数
+     * @param  y            出力 y[frame][node] (C連続)
+     * @param  output_node_size 出力ノード数
+     * @return 成功すれば true
+     */
+    bool Forward(float const *x, index_t frame_size, index_t node_size, std::vector<float> &y, index_t &output_node_size)
+    {
+        if ( m_fd < 0 ) {
+            return false;
+        }
+
+        if ( !InferenceSocket_WriteMessage(m_fd, BB_INFERENCE_CMD_FORWARD, (std::uint32_t)frame_size, (std::uint32_t)node_size,
+                                                x, (std::uint64_t)(frame_size * node_size * sizeof(float))) ) {
+            return false;
+        }
+
+        InferenceMessageHeader header;
+        if ( !InferenceSocket_Read(m_fd, &header, sizeof(header)) || header.magic != BB_INFERENCE_MAGIC ) {
+            return false;
+        }
+        if ( header.code != BB_INFERENCE_STATUS_OK || (index_t)header.frame_size != frame_size
+                || header.data_size != (std::uint64_t)header.frame_size * header.node_size * sizeof(float) ) {
+            return false;
+        }
+
+        output_node_size = (index_t)header.node_size;
+        y.resize((size_t)(frame_size * output_node_size));
+        return InferenceSocket_Read(m_fd, y.data(), (size_t)header.data_size);
+    }
+
+    /**
+     * @brief  推論要求
+     * @param  x_buf  入力データ
+     * @return 推論結果(FP32)、失敗時は空の FrameBuffer
+     */
+    FrameBuffer Forward(FrameBuffer x_buf)
+    {
+        index_t frame_size = x_buf.GetFrameSize();
+        index_t node_size  = x_buf.GetNodeSize();
+
+        std::vector<float> x((size_t)(frame_size * node_size));
+        x_buf.GetDataArray(x.data(), frame_size);
+
+        std::vector<float> y;
+        index_t            output_node_size = 0;
+        if ( !Forward(x.data(), frame_size, node_size, y, output_node_size) ) {
+            return FrameBuffer();
+        }
+
+        FrameBuffer y_buf(frame_size, {output_node_size}, BB_TYPE_FP32);
+        y_buf.SetDataArray(y.data(), frame_size);
+        return y_buf;
+    }
+
+    /**
+     * @brief  サーバーの統計情報取得
+     * @return 統計情報を示す文字列(失敗時は空文字列)
+     */
+    std::string GetStatisticsString(void)
+    {
+        if ( m_fd < 0 || !InferenceSocket_WriteMessage(m_fd, BB_INFERENCE_CMD_STATISTICS, 0, 0, nullptr, 0) ) {
+            return "";
+        }
+
+        InferenceMessageHeader header;
+        if ( !InferenceSocket_Read(m_fd, &header, sizeof(header)) || header.magic != BB_INFERENCE_MAGIC
+                || header.code != BB_INFERENCE_STATUS_OK ) {
+            return "";
+        }
+
+        std::string str((size_t)header.data_size, '\0');
+        if ( header.data_size > 0 && !InferenceSocket_Read(m_fd, &str[0], str.size()) ) {
+            return "";
+        }
+        return str;
+    }
+};
+
+
+}
+
+#endif  // _WIN32
+
+
+// end of file
@@ -116,8 +116,7 @@ public:
             auto loss_buf_ptr = m_loss_buf.Lock(true);
             auto loss_ptr     = m_loss.Lock();
 
-            #pragma omp parallel for
-            for (index_t frame = 0; frame < frame_size; ++frame) {
+            ParallelFor(0, frame_size, [&](index_t frame) {
                 for (index_t pix = 0; pix < pix_size; ++pix) {
                     // max
                     auto c = y_ptr.Get(frame, 0);
@@ -152,7 +151,7 @@ public:
                         dy_ptr.Set(frame, node, dy * t_sum);
                     }
                 }
-            }
+            });
 
             double loss_sum = 0;
             for ( index_t frame = 0; frame < frame_size; ++frame ) {
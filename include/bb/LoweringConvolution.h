@@ -124,6 +124,11 @@ public:
 
     std::string GetClassName(void) const { return "LoweringConvolution"; }
 
+    bool IsForwardReplayable(void) const
+    {
+        return m_im2col->IsForwardReplayable() && m_layer->IsForwardReplayable() && m_col2im->IsForwardReplayable();
+    }
+
     
     std::shared_ptr< Model > GetLayer(void)
     {
@@ -133,6 +138,9 @@ public:
 
     index_t GetFilterHeight(void) { return m_filter_h_size; }
     index_t GetFilterWidth(void)  { return m_filter_w_size; }
+    index_t GetXStride(void)      { return m_x_stride; }
+    index_t GetYStride(void)      { return m_y_stride; }
+    std::string GetPadding(void)  { return m_padding; }
 
 
     /**
@@ -256,6 +264,21 @@ public:
         return x_buf;
     }
 
+   /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        x_buf = m_im2col->Forward(x_buf, ctx);
+        x_buf = m_layer->Forward(x_buf, ctx);
+        x_buf = m_col2im->Forward(x_buf, ctx);
+        return x_buf;
+    }
+
    /**
      * @brief  backward演算
      * @detail backward演算を行う
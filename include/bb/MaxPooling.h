@@ -98,6 +98,7 @@ public:
     }
 
     std::string GetClassName(void) const { return "MaxPooling"; }
+    bool IsForwardReplayable(void) const { return true; }
 
     index_t GetFilterHeight(void) { return m_filter_h_size; }
     index_t GetFilterWidth(void)  { return m_filter_w_size; }
@@ -167,12 +168,12 @@ protected:
     }
     */
 
-    inline index_t GetInputNode(index_t c, index_t y, index_t x)
+    inline index_t GetInputNode(index_t c, index_t y, index_t x) const
     {
         return (c * m_input_h_size + y) * m_input_w_size + x;
     }
 
-    inline index_t GetOutputNode(index_t c, index_t y, index_t x)
+    inline index_t GetOutputNode(index_t c, index_t y, index_t x) const
     {
         return (c * m_output_h_size + y) * m_output_w_size + x;
     }
@@ -180,22 +181,38 @@ protected:
 public:
     FrameBuffer Forward(FrameBuffer x_buf, bool train = true)
     {
-        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
-
         // SetInputShpaeされていなければ初回に設定
         if (x_buf.GetShape() != m_input_shape) {
             SetInputShape(x_buf.GetShape());
         }
 
-        // 出力を設定
-        FrameBuffer y_buf(x_buf.GetFrameSize(), m_output_shape, DataType<FT>::type);
-        
+        InferenceContext ctx;
+        auto y_buf = Forward(x_buf, ctx);
+
         // backwardの為に保存
         if ( train ) {
             m_x_buf = x_buf;
             m_y_buf = y_buf;
         }
 
+        return y_buf;
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
+        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
+        BB_ASSERT(x_buf.GetShape() == m_input_shape);
+
+        // 出力を設定
+        FrameBuffer y_buf(x_buf.GetFrameSize(), m_output_shape, DataType<FT>::type);
+
 #ifdef BB_WITH_CUDA
         // FP32 CUDA版
         if ( DataType<FT>::type == BB_TYPE_FP32 && !m_host_only && x_buf.IsDeviceAvailable() && y_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
@@ -242,15 +259,15 @@ public:
         }
 #endif
      
-        if ( DataType<FT>::type == BB_TYPE_BIT ) {
+        static SimdKernel forward_kernel("MaxPooling::Forward", {SimdLevel::AVX2});
+        if ( DataType<FT>::type == BB_TYPE_BIT && forward_kernel.Select() >= SimdLevel::AVX2 ) {
             // バイナリ用実装
             auto x_ptr = x_buf.LockConst<FT>();
             auto y_ptr = y_buf.Lock<FT>(true);
 
             index_t  m256_frame_size = (int)y_buf.GetFrameStride() / 32;
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) BB_TARGET_AVX2 {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         __m256i *y_addr = (__m256i *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -274,20 +291,19 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
 
         // float用実装
-        if ( DataType<FT>::type == BB_TYPE_FP32 ) {
+        if ( DataType<FT>::type == BB_TYPE_FP32 && forward_kernel.Select() >= SimdLevel::AVX2 ) {
             auto x_ptr = x_buf.LockConst<FT>();
             auto y_ptr = y_buf.Lock<FT>(true);
 
             index_t  m256_frame_size = (int)y_buf.GetFrameStride() / sizeof(float);
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) BB_TARGET_AVX2 {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float *y_addr = (float *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -311,7 +327,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -323,12 +339,11 @@ public:
 
             auto frame_size = x_buf.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
-                            FT max_val = 0;
+                            FT max_val = x_ptr.Get(frame, {x*m_filter_w_size, y*m_filter_h_size, c});
                             for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
                                 index_t iy = y*m_filter_h_size + fy;
                                 if ( iy < m_input_h_size ) {
@@ -345,7 +360,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -424,7 +439,8 @@ public:
         }
 #endif
 
-        if ( DataType<BT>::type == BB_TYPE_FP32 && DataType<FT>::type == BB_TYPE_FP32 ) {
+        static SimdKernel backward_kernel("MaxPooling::Backward", {SimdLevel::AVX2});
+        if ( DataType<BT>::type == BB_TYPE_FP32 && DataType<FT>::type == BB_TYPE_FP32 && backward_kernel.Select() >= SimdLevel::AVX2 ) {
             // float用実装
             index_t  m256_frame_size = dx_buf.GetFrameStride() / sizeof(float);
 
@@ -433,8 +449,7 @@ public:
             auto dy_ptr = dy_buf.LockConst<BT>();
             auto dx_ptr = dx_buf.Lock<BT>(true);
 
-    #pragma omp parallel for
-            for (index_t n = 0; n < m_input_c_size; ++n) {
+            ParallelFor(0, m_input_c_size, [&](index_t n) BB_TARGET_AVX2 {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float const * y_addr  = (float const *)y_ptr.GetAddr(GetOutputNode(n, y, x));
@@ -462,7 +477,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -476,8 +491,7 @@ public:
 
             auto frame_size = x_buf.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
@@ -498,7 +512,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
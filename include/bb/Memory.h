@@ -13,6 +13,7 @@
 #include <string.h>
 #include <memory>
 #include <atomic>
+#include <mutex>
 #include <type_traits>
 
 #ifdef BB_WITH_CUDA
@@ -109,6 +110,15 @@ public:
             return m_addr;
         }
 
+        // 先頭を byte_offset ずらしたポインタ(同じメモリのロックを保持する)
+        ConstPtr_ Offset(index_t byte_offset) const
+        {
+            if ( m_mem == nullptr ) {
+                return *this;
+            }
+            return ConstPtr_((std::uint8_t const *)m_addr + byte_offset, m_mem);
+        }
+
         template<typename Tp>
         Tp const& At(index_t index) const {
 //          BB_DEBUG_ASSERT(m_ptr != nullptr);
@@ -217,6 +227,7 @@ protected:
     void*               m_devAddr = nullptr;
     bool                m_devModified = false;
     std::atomic<int>    m_devRefCnt;
+    mutable std::mutex  m_syncMutex;    // const アクセス時のホスト/デバイス間同期の排他用
 #endif
 
 #ifdef BB_WITH_CUDA
@@ -566,6 +577,9 @@ public:
 
 #ifdef BB_WITH_CUDA
         if ( m_devAvailable ) {
+            // 複数スレッドからの同時読み出しに備えて同期処理を排他する
+            std::lock_guard<std::mutex> lock(m_syncMutex);
+
             if (m_addr == nullptr) {
                 // ホスト側メモリ未確保ならここで確保
                 CudaDevicePush dev_push(m_device);
@@ -640,6 +654,9 @@ public:
         auto self = const_cast<Memory *>(this);
 
         if ( m_devAvailable ) {
+            // 複数スレッドからの同時読み出しに備えて同期処理を排他する
+            std::lock_guard<std::mutex> lock(m_syncMutex);
+
             if (m_devAddr == nullptr) {
                 // デバイス側メモリ未確保ならここで確保
                 CudaDevicePush dev_push(m_device);
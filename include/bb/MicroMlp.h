@@ -219,6 +219,13 @@ public:
         return m_affine->GetNodeConnectionIndex(node, input_index);
     }
 
+    bool PermuteNodes(std::vector<index_t> const &order)
+    {
+        m_affine->PermuteNodes(order);
+        m_batch_norm->PermuteNodes(order);
+        return true;
+    }
+
     std::vector<double> ForwardNode(index_t node, std::vector<double> x_vec) const
     {
         x_vec = m_affine    ->ForwardNode(node, x_vec);
@@ -281,12 +281,40 @@ public:
         ptr(node, input_index) = (std::int32_t)input_node;
     }
 
+    void SetNodeConnectionTable(std::vector<index_t> const &table, std::vector<index_t> const &offset)
+    {
+        index_t output_node_size = (index_t)offset.size() - 1;
+        BB_ASSERT(output_node_size * N == m_input_index.GetSize());
+
+        auto ptr = lock_InputIndex();
+        ParallelFor(0, output_node_size, [&](index_t node) {
+            BB_DEBUG_ASSERT(offset[node + 1] - offset[node] == N);
+            for ( index_t i = 0; i < N; ++i ) {
+                ptr(node, i) = (std::int32_t)table[(size_t)(offset[node] + i)];
+            }
+        });
+    }
+
     index_t GetNodeConnectionIndex(index_t node, index_t input_index) const
     {
         auto ptr = lock_InputIndex_const();
         return (index_t)ptr(node, input_index);
     }
 
+    bool PermuteNodes(std::vector<index_t> const &order)
+    {
+        Tensor_PermuteRows(m_input_index, order);
+        Tensor_PermuteRows(*m_W0,  order);
+        Tensor_PermuteRows(*m_b0,  order);
+        Tensor_PermuteRows(*m_W1,  order);
+        Tensor_PermuteRows(*m_b1,  order);
+        Tensor_PermuteRows(*m_dW0, order);
+        Tensor_PermuteRows(*m_db0, order);
+        Tensor_PermuteRows(*m_dW1, order);
+        Tensor_PermuteRows(*m_db1, order);
+        return true;
+    }
+
 
    /**
      * @brief  入力のshape設定
@@ -517,9 +545,9 @@ public:
 #endif
 
         // AVX版
-        if ( DataType<FXT>::type == BB_TYPE_FP32 && DataType<T>::type == BB_TYPE_FP32 && m_host_simd ) {
+        static SimdKernel forward_kernel("MicroMlpAffine::Forward", {SimdLevel::AVX2});
+        if ( DataType<FXT>::type == BB_TYPE_FP32 && DataType<T>::type == BB_TYPE_FP32 && m_host_simd && forward_kernel.Select() >= SimdLevel::AVX2 ) {
             const index_t   frame_size = x_buf.GetFrameStride() / sizeof(float);
-            const __m256    zero = _mm256_set1_ps(0);
 
             auto x_ptr = x_buf.LockMemoryConst();
             auto y_ptr = y_buf.LockMemory();
@@ -532,8 +560,8 @@ public:
             auto in_sig_buf  = (float const *)x_ptr.GetAddr();
             auto out_sig_buf = (float       *)y_ptr.GetAddr();
 
-    #pragma omp parallel for
-            for (index_t node = 0; node < m_output_node_size; ++node) {
+            ParallelFor(0, m_output_node_size, [&](index_t node) BB_TARGET_AVX2 {
+                const __m256    zero = _mm256_set1_ps(0);
                 __m256  W0[M][N];
                 __m256  b0[M];
                 __m256  W1[M];
@@ -577,7 +605,7 @@ public:
 
                     _mm256_store_ps(&out_sig_ptr[frame], sum1);
                 }
-            }
+            });
             return y_buf;
         }
         
@@ -592,8 +620,7 @@ public:
             auto W1_ptr = lock_W1_const();
             auto b1_ptr = lock_b1_const();
 
-#pragma omp parallel for
-            for ( index_t node = 0; node < m_output_node_size; ++node ) {
+            ParallelFor(0, m_output_node_size, [&](index_t node) {
                 index_t in_idx[N];
                 for ( int i = 0; i < N; ++i) {
                     in_idx[i] = input_index_ptr(node, i);
@@ -621,7 +648,7 @@ public:
 
                     y_ptr.Set(frame, node, sum1);
                 }
-            }
+            });
             return y_buf;
         }
     }
@@ -738,7 +765,8 @@ public:
 //      m_db1->FillZero();
 
         // AVX版
-        if ( DataType<FXT>::type == BB_TYPE_FP32 && DataType<T>::type == BB_TYPE_FP32 ) {
+        static SimdKernel backward_kernel("MicroMlpAffine::Backward", {SimdLevel::AVX2});
+        if ( DataType<FXT>::type == BB_TYPE_FP32 && DataType<T>::type == BB_TYPE_FP32 && backward_kernel.Select() >= SimdLevel::AVX2 ) {
             index_t frame_size = dy_buf.GetFrameStride() / sizeof(float);
             index_t node_size  = m_output_node_size;
 
@@ -762,13 +790,11 @@ public:
             auto dx_addr = (float       *)dx_ptr.GetAddr();
             auto x_addr  = (float const *)x_ptr.GetAddr();
 
-            const __m256    zero = _mm256_set1_ps(0);
-
             FrameBuffer dx_tmp(dy_buf.GetFrameSize(), {m_output_node_size * N}, BB_TYPE_FP32);
             auto dx_tmp_ptr = dx_tmp.Lock<float>();
             
-            #pragma omp parallel for
-            for (int node = 0; node < (int)node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
+                const __m256    zero = _mm256_set1_ps(0);
                 __m256  W0[M][N];
                 __m256  b0[M];
                 __m256  dW0[M][N];
@@ -853,28 +879,29 @@ public:
                     dW1_ptr(node, i) += bb_mm256_cvtss_f32(bb_mm256_hsum_ps(dW1[i]));
                 }
                 db1_ptr(node) += bb_mm256_cvtss_f32(bb_mm256_hsum_ps(db1));
-            }
-
-            // 足しこみ
-            for (int node = 0; node < (int)node_size; ++node) {
-                float*  in_err_ptr[N];
-                for (int i = 0; i < N; ++i) {
-                    in_err_ptr[i] = &dx_addr[frame_size * input_index_ptr(node, i)];
-                }
+            });
 
-                #pragma omp parallel for
-                for (int frame = 0; frame < frame_size; frame += 8) {
+            // 足しこみ(フレーム方向で分割し、各スレッド内でノード順に加算する)
+            ParallelForRange(0, frame_size / 8, [&](index_t block_begin, index_t block_end) BB_TARGET_AVX2 {
+                for (int node = 0; node < (int)node_size; ++node) {
+                    float*  in_err_ptr[N];
                     for (int i = 0; i < N; ++i) {
-                        __m256 in_err = _mm256_load_ps(&in_err_ptr[i][frame]);
+                        in_err_ptr[i] = &dx_addr[frame_size * input_index_ptr(node, i)];
+                    }
+
+                    for (index_t frame = block_begin * 8; frame < block_end * 8; frame += 8) {
+                        for (int i = 0; i < N; ++i) {
+                            __m256 in_err = _mm256_load_ps(&in_err_ptr[i][frame]);
 
-                         float* tmp_dx_addr = dx_tmp_ptr.GetAddr(node * N + i);
-                        __m256 tmp_err = _mm256_load_ps(&tmp_dx_addr[frame]);
+                             float* tmp_dx_addr = dx_tmp_ptr.GetAddr(node * N + i);
+                            __m256 tmp_err = _mm256_load_ps(&tmp_dx_addr[frame]);
 
-                        in_err = _mm256_add_ps(in_err, tmp_err);
-                        _mm256_store_ps(&in_err_ptr[i][frame], in_err);
+                            in_err = _mm256_add_ps(in_err, tmp_err);
+                            _mm256_store_ps(&in_err_ptr[i][frame], in_err);
+                        }
                     }
                 }
-            }
+            });
             
             return dx_buf;
         }
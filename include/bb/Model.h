@@ -14,6 +14,7 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 
 #if BB_WITH_CEREAL
 #include "cereal/types/array.hpp"
@@ -24,6 +25,7 @@
 
 #include "bb/FrameBuffer.h"
 #include "bb/Variables.h"
+#include "bb/InferenceContext.h"
 
 
 namespace bb {
@@ -35,6 +37,7 @@ class Model
 protected:
     std::string     m_name;
     bool            m_parameter_lock = false;
+    mutable std::mutex  m_inference_mutex;
 
     /**
      * @brief  コマンドを処理
@@ -243,6 +246,24 @@ public:
      */
     virtual FrameBuffer Forward(FrameBuffer x_buf, bool train=true) = 0;
 
+   /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更しない推論専用のforward演算を行う
+     *         呼び出し毎の状態は ctx に置くため、コンテキストをスレッド毎に
+     *         分ければ同じモデルを複数スレッドから同時に呼び出せる
+     *         対応していないレイヤーは従来の Forward(x_buf, false) を排他して呼ぶ
+     *         入力形状は事前に SetInputShape で確定させておくこと
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    virtual FrameBuffer Forward(FrameBuffer x_buf, InferenceContext & /*ctx*/) const
+    {
+        // 出力を内部で使い回すレイヤーもあるので複製して返す
+        std::lock_guard<std::mutex> lock(m_inference_mutex);
+        return const_cast<Model *>(this)->Forward(x_buf, false).Clone();
+    }
+
    /**
      * @brief  forward演算(複数入力対応)
      * @detail forward演算を行う
@@ -263,6 +284,16 @@ public:
 
     virtual void        SetFrameBufferX(FrameBuffer x_buf) {}
     virtual FrameBuffer GetFrameBufferX(void) { return FrameBuffer(); }
+
+   /**
+     * @brief  学習時forwardの再実行可否
+     * @detail 同じ入力で Forward(x, true) をやり直すと同じ出力と Backward 用の
+     *         内部状態が得られ、それ以外の状態(移動平均や乱数列など)を変えない
+     *         レイヤーは true を返す
+     *         Sequential のパイプライン学習はこれを使ってチャンク毎の状態を戻す
+     * @return 再実行できるなら true
+     */
+    virtual bool IsForwardReplayable(void) const { return false; }
     
 
 
@@ -0,0 +1,416 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+
+#include "bb/Model.h"
+#include "bb/LossFunction.h"
+#include "bb/MetricsFunction.h"
+#include "bb/Optimizer.h"
+#include "bb/ThreadPool.h"
+#include "bb/Utility.h"
+
+
+namespace bb {
+
+
+// 複数モデル同時学習クラス
+//  ・ハイパーパラメータや構成の比較用に K 個のモデルを同じミニバッチで並行して学習する
+//  ・データのシャッフルと FrameBuffer への変換はバッチ毎に1回だけ行い全モデルで共有する
+//  ・各モデルは専用スレッドで動き、スレッドプールのスレッドをモデル数で分け合う
+//    (モデルスレッドの分だけワーカーを休ませ、動くスレッドの総数をプールのスレッド数に収める)
+//  ・入力側はキューで先読みするので、データ準備と学習が重なる
+template <typename T>
+class MultiRunner
+{
+public:
+    struct model_t
+    {
+        std::string                         name;           //< モデル名(ログ表示用)
+        std::shared_ptr<Model>              net;            //< ネット
+        std::shared_ptr<LossFunction>       lossFunc;       //< 損失関数オブジェクト
+        std::shared_ptr<MetricsFunction>    metricsFunc;    //< 評価関数オブジェクト
+        std::shared_ptr<Optimizer>          optimizer;      //< オプティマイザ
+    };
+
+    struct create_t
+    {
+        std::string                         name;                       //< 名前(ログファイル名に使う)
+        std::vector<model_t>                models;                     //< 学習するモデル
+        bool                                parallel       = true;      //< モデルを並列に実行するか(falseならバッチ毎に順に実行)
+        int                                 queue_size     = 2;         //< 先読みするミニバッチ数
+        bool                                print_progress = true;      //< 途中経過を表示するか
+        bool                                log_write      = true;      //< ログを書き込むか
+        bool                                log_append     = true;      //< ログを追記モードにするか
+        std::int64_t                        seed           = 1;         //< 乱数初期値
+    };
+
+protected:
+    std::string                         m_name;
+    std::vector<model_t>                m_models;
+    std::mt19937_64                     m_mt;
+    index_t                             m_epoch = 0;
+    bool                                m_parallel       = true;
+    int                                 m_queue_size     = 2;
+    bool                                m_print_progress = true;
+    bool                                m_log_write      = true;
+    bool                                m_log_append     = true;
+
+    // 全モデルに配るミニバッチ(読み出し専用で共有する)
+    struct Batch
+    {
+        FrameBuffer x_buf;
+        FrameBuffer t_buf;
+    };
+
+protected:
+    MultiRunner(create_t const &create)
+    {
+        m_name           = create.name;
+        m_parallel       = create.parallel;
+        m_queue_size     = create.queue_size;
+        m_print_progress = create.print_progress;
+        m_log_write      = create.log_write;
+        m_log_append     = create.log_append;
+        m_mt.seed(create.seed);
+
+        for ( auto const &model : create.models ) {
+            AddModel(model);
+        }
+    }
+
+public:
+    ~MultiRunner() {}
+
+    static std::shared_ptr<MultiRunner> Create(create_t const &create)
+    {
+        return std::shared_ptr<MultiRunner>(new MultiRunner(create));
+    }
+
+    static std::shared_ptr<MultiRunner> Create(std::string name, bool print_progress = true, std::int64_t seed = 1)
+    {
+        create_t create;
+        create.name           = name;
+        create.print_progress = print_progress;
+        create.seed           = seed;
+        return Create(create);
+    }
+
+    /**
+     * @brief  モデル追加
+     * @detail 同時に学習するモデルを追加する
+     *         ネットや評価関数などのオブジェクトはモデル間で共有しないこと
+     * @param  model 追加するモデル
+     */
+    void AddModel(model_t const &model)
+    {
+        BB_ASSERT(model.net != nullptr);
+        BB_ASSERT(model.lossFunc != nullptr);
+        BB_ASSERT(model.metricsFunc != nullptr);
+        BB_ASSERT(model.optimizer != nullptr);
+
+        m_models.push_back(model);
+        if ( m_models.back().name.empty() ) {
+            m_models.back().name = model.net->GetName();
+        }
+    }
+
+    void AddModel(
+                std::string                         name,
+                std::shared_ptr<Model>              net,
+                std::shared_ptr<LossFunction>       lossFunc,
+                std::shared_ptr<MetricsFunction>    metricsFunc,
+                std::shared_ptr<Optimizer>          optimizer
+            )
+    {
+        model_t model;
+        model.name        = name;
+        model.net         = net;
+        model.lossFunc    = lossFunc;
+        model.metricsFunc = metricsFunc;
+        model.optimizer   = optimizer;
+        AddModel(model);
+    }
+
+    // アクセサ
+    void        SetName(std::string name) { m_name = name; }
+    std::string GetName(void) const { return m_name; }
+
+    void SetSeed(std::int64_t seed) { m_mt.seed(seed); }
+    void SetParallel(bool parallel) { m_parallel = parallel; }
+    void SetPrintProgress(bool print_progress) { m_print_progress = print_progress; }
+
+    index_t GetModelSize(void) const { return (index_t)m_models.size(); }
+    model_t const &GetModel(index_t index) const { return m_models[index]; }
+
+
+    /**
+     * @brief  学習
+     * @detail 全モデルを同じミニバッチで1エポックずつ揃えて学習する
+     *         エポック毎にテストデータで評価し、学習データの評価値は学習時の集計値を表示する
+     * @param  td          学習データ
+     * @param  epoch_size  エポック数
+     * @param  batch_size  ミニバッチサイズ
+     * @return 最終エポックでの各モデルのテストデータ評価値
+     */
+    std::vector<double> Fitting(
+            TrainData<T> &td,
+            index_t      epoch_size,
+            index_t      batch_size
+        )
+    {
+        BB_ASSERT(!m_models.empty());
+        BB_ASSERT(batch_size > 0);
+
+        // ログファイルオープン
+        std::ofstream ofs_log;
+        if ( m_log_write ) {
+            ofs_log.open(m_name + "_log.txt", m_log_append ? std::ios::app : std::ios::out);
+        }
+
+        ostream_tee log_stream;
+        log_stream.add(std::cout);
+        if (ofs_log.is_open()) { log_stream.add(ofs_log); }
+
+        log_stream << "fitting start : " << m_name << " (" << m_models.size() << " models)" << std::endl;
+
+        // オプティマイザ設定
+        for ( auto &model : m_models ) {
+            model.optimizer->SetVariables(model.net->GetParameters(), model.net->GetGradients());
+        }
+
+        auto start_time = std::chrono::system_clock::now();
+        std::vector<double> test_metrics(m_models.size(), 0.0);
+        for ( index_t epoch = 0; epoch < epoch_size; ++epoch ) {
+            // 学習実施
+            m_epoch++;
+            auto train_metrics = Calculation(td.x_train, td.x_shape, td.t_train, td.t_shape, batch_size, batch_size, true, m_print_progress);
+
+            // 学習状況評価
+            test_metrics = Calculation(td.x_test, td.x_shape, td.t_test, td.t_shape, batch_size, 0, false, m_print_progress);
+            double now_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start_time).count() / 1000.0;
+            for ( size_t k = 0; k < m_models.size(); ++k ) {
+                auto const &model = m_models[k];
+                log_stream  << std::setw(10) << std::fixed << std::setprecision(2) << now_time << "s "
+                            << "epoch[" << std::setw(3) << m_epoch << "] "
+                            << model.name << " "
+                            << "test "  << model.metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << test_metrics[k]  << " "
+                            << "train " << model.metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << train_metrics[k] << std::endl;
+            }
+
+            // Shuffle
+            ShuffleDataSet(m_mt(), td.x_train, td.t_train);
+        }
+
+        log_stream << "fitting end\n" << std::endl;
+
+        return test_metrics;
+    }
+
+
+    /**
+     * @brief  評価
+     * @detail 全モデルをテストデータで評価する
+     * @param  td          評価データ
+     * @param  batch_size  ミニバッチサイズ
+     * @return 各モデルの評価値
+     */
+    std::vector<double> Evaluation(
+            TrainData<T> &td,
+            index_t      batch_size
+        )
+    {
+        return Calculation(td.x_test, td.x_shape, td.t_test, td.t_shape, batch_size, 0, false, m_print_progress);
+    }
+
+
+protected:
+    // 1モデル分のミニバッチ処理
+    static void CalculateBatch(model_t &model, Batch const &batch, bool train)
+    {
+        auto y_buf = model.net->Forward(batch.x_buf, train);
+
+        FrameBuffer dy_buf;
+        if ( train ) {
+            dy_buf = model.lossFunc->CalculateLoss(y_buf, batch.t_buf, batch.x_buf.GetFrameSize());
+        }
+
+        model.metricsFunc->CalculateMetrics(y_buf, batch.t_buf);
+
+        if ( train ) {
+            model.net->Backward(dy_buf);
+            model.optimizer->Update();
+        }
+    }
+
+    // 全モデルに同じミニバッチを供給しながら処理する
+    std::vector<double> Calculation(
+                std::vector< std::vector<T> > const &x,
+                indices_t                           x_shape,
+                std::vector< std::vector<T> > const &t,
+                indices_t                           t_shape,
+                index_t                             max_batch_size,
+                index_t                             min_batch_size,
+                bool                                train,
+                bool                                print_progress
+            )
+    {
+        BB_ASSERT(x.size() == t.size());
+
+        int model_size = (int)m_models.size();
+        for ( auto &model : m_models ) {
+            model.metricsFunc->Clear();
+            if ( train ) {
+                model.lossFunc->Clear();
+            }
+        }
+
+        // 出力先キュー(モデル毎)
+        bool parallel = m_parallel && model_size > 1;
+        std::vector< std::unique_ptr< BoundedQueue<Batch> > > queues;
+        if ( parallel ) {
+            for ( int k = 0; k < model_size; ++k ) {
+                queues.push_back(std::unique_ptr< BoundedQueue<Batch> >(new BoundedQueue<Batch>(m_queue_size)));
+            }
+        }
+
+        std::mutex          exception_mutex;
+        std::exception_ptr  exception;
+
+        // モデル毎のスレッド(スレッドプールのスレッドを分け合う)
+        //  モデルスレッドを増やす分だけプールのワーカーを休ませる
+        ThreadPool::ReserveScope reserve(parallel ? model_size - 1 : 0);
+        int thread_size = ThreadPool::GetInstance().GetActiveThreadSize();
+        auto model_main = [&](int k) {
+            int group_first = (int)(((std::int64_t)thread_size * k) / model_size);
+            int group_end   = (int)(((std::int64_t)thread_size * (k + 1)) / model_size);
+            ThreadPool::ThreadGroupScope scope(group_first, std::max(1, group_end - group_first));
+
+            try {
+                Batch batch;
+                while ( queues[k]->Pop(batch) ) {
+                    CalculateBatch(m_models[k], batch, train);
+                }
+            }
+            catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(exception_mutex);
+                    if ( !exception ) {
+                        exception = std::current_exception();
+                    }
+                }
+                for ( auto &queue : queues ) {
+                    queue->Close();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        if ( parallel ) {
+            for ( int k = 0; k < model_size; ++k ) {
+                threads.push_back(std::thread(model_main, k));
+            }
+        }
+
+        // 呼び出し元スレッドでミニバッチを作って配る
+        try {
+            index_t frame_size = (index_t)x.size();
+            index_t index = 0;
+            while ( index < frame_size ) {
+                // ミニバッチサイズ計算
+                index_t  mini_batch_size = std::min(max_batch_size, frame_size - index);
+
+                // 残数が規定以下なら抜ける
+                if ( mini_batch_size < min_batch_size ) {
+                    break;
+                }
+
+                // 各モデルが参照中のバッファを書き換えないよう毎回新しく確保する
+                Batch batch;
+                batch.x_buf = FrameBuffer(mini_batch_size, x_shape, DataType<T>::type);
+                batch.x_buf.SetVector(x, index);
+                batch.t_buf = FrameBuffer(mini_batch_size, t_shape, DataType<T>::type);
+                batch.t_buf.SetVector(t, index);
+
+                if ( parallel ) {
+                    bool closed = false;
+                    for ( auto &queue : queues ) {
+                        if ( !queue->Push(batch) ) {
+                            closed = true;
+                        }
+                    }
+                    if ( closed ) {
+                        break;
+                    }
+                }
+                else {
+                    for ( auto &model : m_models ) {
+                        CalculateBatch(model, batch, train);
+                    }
+                }
+
+                // print progress
+                if ( print_progress ) {
+                    index_t progress = index + mini_batch_size;
+                    index_t rate = progress * 100 / frame_size;
+                    std::cerr << "\r[" << rate << "% (" << progress << "/" << frame_size << ")]        " << std::flush;
+                }
+
+                // インデックスを進める
+                index += mini_batch_size;
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if ( !exception ) {
+                exception = std::current_exception();
+            }
+        }
+
+        for ( auto &queue : queues ) {
+            queue->Close();
+        }
+        for ( auto &th : threads ) {
+            th.join();
+        }
+
+        // clear progress
+        if ( print_progress ) {
+            std::cerr << "\r                                                                               \r" << std::flush;
+        }
+
+        if ( exception ) {
+            std::rethrow_exception(exception);
+        }
+
+        std::vector<double> metrics;
+        for ( auto const &model : m_models ) {
+            metrics.push_back(model.metricsFunc->GetMetrics());
+        }
+        return metrics;
+    }
+};
+
+
+}
+
+
+// end of file
@@ -0,0 +1,337 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <cctype>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "bb/DataType.h"
+#include "bb/Utility.h"
+#include "bb/ThreadPool.h"
+
+
+namespace bb {
+
+
+// [Numa クラス]
+//  ・2ソケット以上の環境で FrameBuffer のメモリ配置とスレッド配置を揃える
+//  ・有効時は FrameBuffer をノード範囲で分割し、処理するスレッドで first-touch する
+//  ・各レイヤーのノード方向の並列化は ThreadPool の static 分割なので、
+//    スレッド番号とノード範囲の対応はレイヤー間で一致する
+//  ・ThreadPool のスレッドは NUMA ノード順に CPU へ固定(bind)する
+//
+//  環境変数 BB_NUMA=1 もしくは SetEnable() で有効化する
+//  トポロジは Linux の /sys/devices/system/node から取得する(他OSでは単一ノード扱い)
+
+class Numa
+{
+protected:
+    struct Status
+    {
+        bool                            enable       = false;
+        bool                            bind_threads = true;
+        bool                            bound        = false;
+        std::vector< std::vector<int> > node_cpus;      // NUMAノード毎のCPU番号
+        std::vector<int>                thread_cpu;     // bind したスレッド毎のCPU番号
+    };
+
+    static Status& GetStatus(void)
+    {
+        static Status   status;
+        static bool     initialized = Setup(status);
+        (void)initialized;
+        return status;
+    }
+
+    // 10進のCPU番号(0～max_cpu-1)の解釈
+    static bool ParseCpuNumber(std::string const &str, int &value)
+    {
+        if ( str.empty() || str.size() > 5 ) {
+            return false;
+        }
+        int v = 0;
+        for ( auto c : str ) {
+            if ( !std::isdigit((unsigned char)c) ) {
+                return false;
+            }
+            v = v * 10 + (c - '0');
+        }
+        if ( v >= max_cpu ) {
+            return false;
+        }
+        value = v;
+        return true;
+    }
+
+    static bool Setup(Status &status)
+    {
+        // トポロジ取得
+#ifdef __linux__
+        for ( int node = 0; ; ++node ) {
+            std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if ( !ifs.is_open() ) {
+                break;
+            }
+            std::string text;
+            std::getline(ifs, text);
+            auto cpus = ParseCpuList(text);
+            if ( !cpus.empty() ) {
+                status.node_cpus.push_back(cpus);
+            }
+        }
+#endif
+
+        // 取得できなければ単一ノード扱い
+        if ( status.node_cpus.empty() ) {
+            status.node_cpus.push_back(std::vector<int>());
+        }
+
+        // 環境変数による設定
+        char const *env = getenv("BB_NUMA");
+        if ( env != nullptr && env[0] != '\0' ) {
+            status.enable = EvalBool(env);
+        }
+        if ( status.enable && status.bind_threads ) {
+            BindThreads(status);
+        }
+
+        return true;
+    }
+
+    static int GetThreadCount(void)
+    {
+        return ThreadPool::GetInstance().GetThreadSize();
+    }
+
+    static void BindCpu(int cpu)
+    {
+#ifdef __linux__
+        if ( cpu >= 0 ) {
+            cpu_set_t   mask;
+            CPU_ZERO(&mask);
+            CPU_SET(cpu, &mask);
+            sched_setaffinity(0, sizeof(mask), &mask);
+        }
+#else
+        (void)cpu;
+#endif
+    }
+
+    static void BindThreads(Status &status)
+    {
+        auto &pool = ThreadPool::GetInstance();
+        int thread_size = pool.GetThreadSize();
+        status.thread_cpu.assign(thread_size, -1);
+        for ( int thread = 0; thread < thread_size; ++thread ) {
+            status.thread_cpu[thread] = GetThreadCpu(status.node_cpus, thread, thread_size);
+        }
+
+#ifdef __linux__
+        // 呼び出し元スレッドがスレッド0、ワーカーは起動時に固定する
+        auto thread_cpu = status.thread_cpu;
+        pool.SetThreadInitializer([thread_cpu](int thread) {
+                if ( thread < (int)thread_cpu.size() ) {
+                    BindCpu(thread_cpu[thread]);
+                }
+            });
+        pool.SetThreadSize(thread_size);
+        BindCpu(status.thread_cpu[0]);
+        status.bound = true;
+#endif
+    }
+
+public:
+    // CPU番号の上限(sysfs の値が壊れていても巨大な範囲を展開しない)
+    static int const max_cpu = 65536;
+
+    /**
+     * @brief  CPUリストの展開
+     * @detail sysfs の "0-3,8,10-11" 形式のCPUリストを展開する
+     *         前後の空白は無視し、数値として解釈できない項目や
+     *         逆順・上限超えの範囲は読み飛ばす(例外は投げない)
+     * @param  text CPUリスト文字列
+     * @return CPU番号の並び
+     */
+    static std::vector<int> ParseCpuList(std::string text)
+    {
+        std::vector<int>    cpus;
+        std::stringstream   ss(text);
+        std::string         item;
+        while ( std::getline(ss, item, ',') ) {
+            // 前後の空白除去
+            auto first = item.find_first_not_of(" \t\r\n");
+            auto last  = item.find_last_not_of(" \t\r\n");
+            if ( first == std::string::npos ) {
+                continue;
+            }
+            item = item.substr(first, last - first + 1);
+
+            int  lo = 0, hi = 0;
+            auto pos = item.find('-');
+            if ( pos == std::string::npos ) {
+                if ( !ParseCpuNumber(item, lo) ) {
+                    continue;
+                }
+                hi = lo;
+            }
+            else {
+                if ( !ParseCpuNumber(item.substr(0, pos), lo) || !ParseCpuNumber(item.substr(pos + 1), hi) || lo > hi ) {
+                    continue;
+                }
+            }
+
+            for ( int cpu = lo; cpu <= hi; ++cpu ) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    /**
+     * @brief  スレッドの割り当てCPU取得
+     * @detail スレッド番号を NUMAノード順に連続して割り当てる
+     * @param  node_cpus   NUMAノード毎のCPU番号
+     * @param  thread      スレッド番号
+     * @param  thread_size スレッド数
+     * @return CPU番号(割り当てられなければ -1)
+     */
+    static int GetThreadCpu(std::vector< std::vector<int> > const &node_cpus, int thread, int thread_size)
+    {
+        int node_size = (int)node_cpus.size();
+        if ( node_size <= 0 || thread_size <= 0 || thread < 0 || thread >= thread_size ) {
+            return -1;
+        }
+        int node  = (int)(((std::int64_t)thread * node_size) / thread_size);
+        int first = (int)(((std::int64_t)node * thread_size + node_size - 1) / node_size);
+        auto const &cpus = node_cpus[node];
+        if ( cpus.empty() ) {
+            return -1;
+        }
+        return cpus[(thread - first) % (int)cpus.size()];
+    }
+
+    /**
+     * @brief  NUMAモードの設定
+     * @detail NUMAモードの設定
+     * @param  enable       有効にするならtrue
+     * @param  bind_threads スレッドをCPUに固定するならtrue
+     */
+    static void SetEnable(bool enable, bool bind_threads = true)
+    {
+        auto &status = GetStatus();
+        status.enable       = enable;
+        status.bind_threads = bind_threads;
+        if ( enable && bind_threads ) {
+            BindThreads(status);
+        }
+    }
+
+    /**
+     * @brief  NUMAモードの問い合わせ
+     * @detail NUMAモードの問い合わせ
+     * @return 有効ならtrue
+     */
+    static bool IsEnabled(void)
+    {
+        return GetStatus().enable;
+    }
+
+    /**
+     * @brief  NUMAノード数取得
+     * @detail NUMAノード数取得
+     * @return NUMAノード数
+     */
+    static int GetNodeSize(void)
+    {
+        return (int)GetStatus().node_cpus.size();
+    }
+
+    /**
+     * @brief  スレッドのバインド(スレッド数変更後の再設定用)
+     * @detail スレッドのバインド
+     */
+    static void BindThreads(void)
+    {
+        auto &status = GetStatus();
+        if ( status.enable && status.bind_threads ) {
+            BindThreads(status);
+        }
+    }
+
+    /**
+     * @brief  first-touch によるページ配置
+     * @detail unit_size バイト単位の unit_count 個の領域を、
+     *         ノード方向の static 分割と同じ割り当てでスレッド毎にゼロ書き込みする
+     * @param  addr       先頭アドレス
+     * @param  unit_size  1単位(FrameBufferなら1ノード分)のバイト数
+     * @param  unit_count 単位数(FrameBufferならノード数)
+     */
+    static void FirstTouch(void *addr, index_t unit_size, index_t unit_count)
+    {
+        if ( addr == nullptr || unit_size <= 0 || unit_count <= 0 ) {
+            return;
+        }
+
+        auto base = (std::uint8_t *)addr;
+
+        ParallelFor(0, unit_count, [&](index_t unit) {
+                memset(base + unit * unit_size, 0, (size_t)unit_size);
+            });
+    }
+
+    /**
+     * @brief  状態表示用文字列取得
+     * @detail 状態表示用文字列取得
+     * @return 状態を示す文字列
+     */
+    static std::string GetInfoString(void)
+    {
+        auto &status = GetStatus();
+
+        std::stringstream ss;
+        ss << "numa            : " << (status.enable ? "enable" : "disable")
+           << " (nodes=" << status.node_cpus.size()
+           << ", threads=" << GetThreadCount()
+           << ", bind=" << (status.enable && status.bound ? "on" : "off") << ")" << std::endl;
+
+        if ( status.enable ) {
+            for ( size_t node = 0; node < status.node_cpus.size(); ++node ) {
+                ss << "  node" << node << " cpus :";
+                for ( auto cpu : status.node_cpus[node] ) {
+                    ss << " " << cpu;
+                }
+                ss << std::endl;
+            }
+            if ( status.bound ) {
+                ss << "  thread cpus :";
+                for ( auto cpu : status.thread_cpu ) {
+                    ss << " " << cpu;
+                }
+                ss << std::endl;
+            }
+        }
+        return ss.str();
+    }
+};
+
+
+}
+
+
+// end of file
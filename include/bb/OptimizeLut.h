@@ -0,0 +1,391 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "bb/Sequential.h"
+#include "bb/LutLayer.h"
+#include "bb/BinaryLutN.h"
+
+
+namespace bb {
+
+
+// [OptimizeLut]
+//  学習済み LUT-Network の論理最適化
+//  ・定数入力の畳み込み : 前段の定数ノードを真理値表に埋め込む
+//  ・無関係入力の削除   : 真理値表が依存しない入力を外す
+//  ・重複ノードの併合   : 入力と真理値表が同じノードを1つにまとめる
+//  ・未使用ノードの削除 : 最終段から辿れないノードを削除する
+//  結果は BinaryLutN を並べた等価な Sequential として生成する
+//  (各段の LUT 入力数は残った入力数の最大値まで縮める、最終段の出力並びは変えない)
+
+
+// 最適化結果の報告
+struct OptimizeLutReport
+{
+    struct Layer
+    {
+        index_t input_node_size   = 0;
+        index_t node_size_before  = 0;
+        index_t node_size_after   = 0;
+        index_t constant_nodes    = 0;  // 定数に畳み込んだノード
+        index_t duplicate_nodes   = 0;  // 他ノードと併合したノード
+        index_t dead_nodes        = 0;  // 未使用で削除したノード
+        index_t removed_inputs    = 0;  // 外した LUT 入力(定数/重複/無関係)
+        int     lut_input_before  = 0;
+        int     lut_input_after   = 0;
+    };
+
+    std::vector<Layer>  layers;
+
+    index_t GetNodeSizeBefore(void) const
+    {
+        index_t size = 0;
+        for ( auto const &l : layers ) { size += l.node_size_before; }
+        return size;
+    }
+
+    index_t GetNodeSizeAfter(void) const
+    {
+        index_t size = 0;
+        for ( auto const &l : layers ) { size += l.node_size_after; }
+        return size;
+    }
+
+    std::string GetInfoString(void) const
+    {
+        std::stringstream ss;
+        for ( size_t i = 0; i < layers.size(); ++i ) {
+            auto const &l = layers[i];
+            ss << "layer" << i
+               << " : nodes " << l.node_size_before << " -> " << l.node_size_after
+               << " (const=" << l.constant_nodes
+               << ", dup=" << l.duplicate_nodes
+               << ", dead=" << l.dead_nodes << ")"
+               << ", lut inputs " << l.lut_input_before << " -> " << l.lut_input_after
+               << ", removed inputs=" << l.removed_inputs << std::endl;
+        }
+        ss << "total : nodes " << GetNodeSizeBefore() << " -> " << GetNodeSizeAfter() << std::endl;
+        return ss.str();
+    }
+};
+
+
+// 最適化中のノード
+struct OptimizeLut_Node
+{
+    std::vector<index_t>    inputs;         // 有効な入力(前段ノード番号の昇順)
+    std::vector<bool>       table;          // inputs に対する真理値表
+    int                     constant = -1;  // 定数なら 0/1
+    index_t                 alias    = -1;  // 併合先ノード
+    bool                    live     = false;
+};
+
+
+// 入力の定数/別名を解決し、無関係入力を外す
+inline void OptimizeLut_Simplify
+    (
+        OptimizeLut_Node                        &node,
+        std::vector<index_t> const              &raw_inputs,
+        std::vector<bool> const                 &raw_table,
+        std::vector<OptimizeLut_Node> const     *prev
+    )
+{
+    int raw_size = (int)raw_inputs.size();
+
+    // 入力の解決(定数なら値、別名なら併合先)
+    std::vector<int>        raw_const(raw_size, -1);
+    std::vector<index_t>    raw_node(raw_size);
+    for ( int i = 0; i < raw_size; ++i ) {
+        index_t input_node = raw_inputs[i];
+        if ( prev != nullptr ) {
+            auto const &p = (*prev)[input_node];
+            if ( p.constant >= 0 ) {
+                raw_const[i] = p.constant;
+            }
+            else if ( p.alias >= 0 ) {
+                input_node = p.alias;
+            }
+        }
+        raw_node[i] = input_node;
+    }
+
+    std::vector<index_t> vars;
+    for ( int i = 0; i < raw_size; ++i ) {
+        if ( raw_const[i] < 0 ) {
+            vars.push_back(raw_node[i]);
+        }
+    }
+    std::sort(vars.begin(), vars.end());
+    vars.erase(std::unique(vars.begin(), vars.end()), vars.end());
+
+    // 有効入力に対する真理値表
+    int k = (int)vars.size();
+    std::vector<int> raw_var(raw_size, -1);
+    for ( int i = 0; i < raw_size; ++i ) {
+        if ( raw_const[i] < 0 ) {
+            raw_var[i] = (int)(std::lower_bound(vars.begin(), vars.end(), raw_node[i]) - vars.begin());
+        }
+    }
+
+    std::vector<bool> table((size_t)1 << k);
+    for ( int a = 0; a < (1 << k); ++a ) {
+        int index = 0;
+        for ( int i = 0; i < raw_size; ++i ) {
+            int bit = (raw_const[i] >= 0) ? raw_const[i] : ((a >> raw_var[i]) & 1);
+            index |= (bit << i);
+        }
+        table[a] = raw_table[index];
+    }
+
+    // 無関係入力の削除
+    for ( int v = k - 1; v >= 0; --v ) {
+        int  size = (int)vars.size();
+        bool dont_care = true;
+        for ( int a = 0; a < (1 << size) && dont_care; ++a ) {
+            if ( ((a >> v) & 1) == 0 && table[a] != table[a | (1 << v)] ) {
+                dont_care = false;
+            }
+        }
+        if ( !dont_care ) {
+            continue;
+        }
+
+        std::vector<bool> reduced((size_t)1 << (size - 1));
+        for ( int a = 0; a < (1 << (size - 1)); ++a ) {
+            int lo = a & ((1 << v) - 1);
+            int hi = (a >> v) << (v + 1);
+            reduced[a] = table[hi | lo];
+        }
+        table.swap(reduced);
+        vars.erase(vars.begin() + v);
+    }
+
+    node.inputs   = vars;
+    node.table    = table;
+    node.constant = vars.empty() ? (table[0] ? 1 : 0) : -1;
+    node.alias    = -1;
+}
+
+
+/**
+ * @brief  BinaryLutN の生成(LUT入力数は実行時に指定)
+ */
+template <typename FT = Bit, typename BT = float>
+inline std::shared_ptr< LutLayer<FT, BT> > OptimizeLut_CreateLayer(int n, indices_t output_shape)
+{
+    switch ( n ) {
+    case 1: return BinaryLutN<1, FT, BT>::Create(output_shape);
+    case 2: return BinaryLutN<2, FT, BT>::Create(output_shape);
+    case 3: return BinaryLutN<3, FT, BT>::Create(output_shape);
+    case 4: return BinaryLutN<4, FT, BT>::Create(output_shape);
+    case 5: return BinaryLutN<5, FT, BT>::Create(output_shape);
+    case 6: return BinaryLutN<6, FT, BT>::Create(output_shape);
+    case 7: return BinaryLutN<7, FT, BT>::Create(output_shape);
+    case 8: return BinaryLutN<8, FT, BT>::Create(output_shape);
+    default: BB_ASSERT(0); return nullptr;
+    }
+}
+
+
+/**
+ * @brief  LUT-Network の論理最適化
+ * @detail layers[i] の出力が layers[i+1] の入力に直結していること
+ * @param  layers  LutLayer 列
+ * @param  report  結果の報告(不要なら nullptr)
+ * @return 等価な最適化済みネット
+ */
+template <typename FT = Bit, typename BT = float>
+std::shared_ptr<Sequential> OptimizeLut_LutLayers(std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers, OptimizeLutReport *report = nullptr)
+{
+    BB_ASSERT(!layers.empty());
+
+    int layer_size = (int)layers.size();
+    std::vector< std::vector<OptimizeLut_Node> >    nodes(layer_size);
+    OptimizeLutReport                               rep;
+    rep.layers.resize(layer_size);
+
+    // 前段から順に定数畳み込み、無関係入力削除、重複併合
+    for ( int l = 0; l < layer_size; ++l ) {
+        auto    lut       = layers[l];
+        index_t node_size = lut->GetOutputNodeSize();
+        auto   &r         = rep.layers[l];
+        auto   *prev      = (l > 0) ? &nodes[l-1] : nullptr;
+
+        if ( l > 0 ) {
+            BB_ASSERT(lut->GetInputNodeSize() == layers[l-1]->GetOutputNodeSize());
+        }
+
+        r.input_node_size  = lut->GetInputNodeSize();
+        r.node_size_before = node_size;
+
+        nodes[l].resize(node_size);
+        std::map< std::pair< std::vector<index_t>, std::vector<bool> >, index_t >   unique_nodes;
+        for ( index_t node = 0; node < node_size; ++node ) {
+            index_t input_size = lut->GetNodeConnectionSize(node);
+            int     table_size = lut->GetLutTableSize(node);
+            BB_ASSERT(table_size == (1 << input_size));
+
+            std::vector<index_t> raw_inputs(input_size);
+            for ( index_t i = 0; i < input_size; ++i ) {
+                raw_inputs[i] = lut->GetNodeConnectionIndex(node, i);
+            }
+            std::vector<bool> raw_table(table_size);
+            for ( int i = 0; i < table_size; ++i ) {
+                raw_table[i] = lut->GetLutTable(node, i);
+            }
+
+            auto &n = nodes[l][node];
+            OptimizeLut_Simplify(n, raw_inputs, raw_table, prev);
+
+            r.lut_input_before = std::max(r.lut_input_before, (int)input_size);
+            r.removed_inputs  += input_size - (index_t)n.inputs.size();
+
+            // 最終段は出力並びを保つため併合しない
+            if ( n.constant < 0 && l < layer_size - 1 ) {
+                auto key = std::make_pair(n.inputs, n.table);
+                auto it  = unique_nodes.find(key);
+                if ( it != unique_nodes.end() ) {
+                    n.alias = it->second;
+                }
+                else {
+                    unique_nodes[key] = node;
+                }
+            }
+        }
+    }
+
+    // 後段から参照されるノードを辿る
+    for ( auto &n : nodes[layer_size-1] ) {
+        n.live = true;
+    }
+    for ( int l = layer_size - 1; l > 0; --l ) {
+        for ( auto const &n : nodes[l] ) {
+            if ( n.live ) {
+                for ( auto input_node : n.inputs ) {
+                    nodes[l-1][input_node].live = true;
+                }
+            }
+        }
+    }
+
+    // 残すノードの番号付け
+    std::vector< std::vector<index_t> > new_index(layer_size);
+    std::vector< std::vector<index_t> > kept(layer_size);
+    for ( int l = 0; l < layer_size; ++l ) {
+        auto &r = rep.layers[l];
+        new_index[l].assign(nodes[l].size(), -1);
+        for ( index_t node = 0; node < (index_t)nodes[l].size(); ++node ) {
+            auto const &n = nodes[l][node];
+            if ( l < layer_size - 1 ) {
+                if      ( n.constant >= 0 ) { r.constant_nodes++;  continue; }
+                else if ( n.alias >= 0 )    { r.duplicate_nodes++; continue; }
+                else if ( !n.live )         { r.dead_nodes++;      continue; }
+            }
+            else if ( n.constant >= 0 ) {
+                r.constant_nodes++;
+            }
+            new_index[l][node] = (index_t)kept[l].size();
+            kept[l].push_back(node);
+        }
+
+        // 段を空にはできないので最低1ノード(定数)残す
+        if ( kept[l].empty() ) {
+            auto &n = nodes[l][0];
+            n.inputs.clear();
+            n.table.assign(1, false);
+            n.constant = 0;
+            new_index[l][0] = 0;
+            kept[l].push_back(0);
+        }
+    }
+
+    // 新しいネットの生成
+    auto net = Sequential::Create();
+    for ( int l = 0; l < layer_size; ++l ) {
+        auto &r = rep.layers[l];
+
+        int n_size = 1;
+        for ( auto node : kept[l] ) {
+            n_size = std::max(n_size, (int)nodes[l][node].inputs.size());
+        }
+
+        indices_t output_shape = (l == layer_size - 1) ? layers[l]->GetOutputShape() : indices_t({(index_t)kept[l].size()});
+        indices_t input_shape  = (l == 0) ? layers[0]->GetInputShape() : indices_t({(index_t)kept[l-1].size()});
+
+        auto lut = OptimizeLut_CreateLayer<FT, BT>(n_size, output_shape);
+        lut->SetInputShape(input_shape);
+
+        for ( index_t new_node = 0; new_node < (index_t)kept[l].size(); ++new_node ) {
+            auto const &n = nodes[l][kept[l][new_node]];
+            int k = (int)n.inputs.size();
+
+            // 余った入力は先頭入力を重複接続(真理値表では無関係)
+            for ( int i = 0; i < n_size; ++i ) {
+                index_t input_node = 0;
+                if ( k > 0 ) {
+                    input_node = n.inputs[(i < k) ? i : 0];
+                    if ( l > 0 ) {
+                        input_node = new_index[l-1][input_node];
+                    }
+                }
+                lut->SetNodeConnectionIndex(new_node, i, input_node);
+            }
+            for ( int i = 0; i < (1 << n_size); ++i ) {
+                bool value = (n.constant >= 0) ? (n.constant != 0) : n.table[i & ((1 << k) - 1)];
+                lut->SetLutTable(new_node, i, value);
+            }
+        }
+
+        r.node_size_after = (index_t)kept[l].size();
+        r.lut_input_after = n_size;
+        net->Add(lut);
+    }
+
+    if ( report != nullptr ) {
+        *report = rep;
+    }
+
+    return net;
+}
+
+
+/**
+ * @brief  LUT-Network の論理最適化
+ * @detail net は LutLayer のみで構成されていること
+ * @param  net     対象ネット
+ * @param  report  結果の報告(不要なら nullptr)
+ * @return 等価な最適化済みネット
+ */
+template <typename FT = Bit, typename BT = float>
+std::shared_ptr<Sequential> OptimizeLut_LutLayers(std::shared_ptr<Sequential> net, OptimizeLutReport *report = nullptr)
+{
+    std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers;
+    for ( int i = 0; i < net->GetSize(); ++i ) {
+        auto layer = std::dynamic_pointer_cast< LutLayer<FT, BT> >(net->Get(i));
+        BB_ASSERT(layer != nullptr);
+        layers.push_back(layer);
+    }
+    return OptimizeLut_LutLayers<FT, BT>(layers, report);
+}
+
+
+}
+
+
+// end of file
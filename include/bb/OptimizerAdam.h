@@ -12,6 +12,8 @@
 
 #include "bb/Optimizer.h"
 #include "bb/Variables.h"
+#include "bb/SparseGradient.h"
+#include "bb/ThreadPool.h"
 
 
 namespace bb {
@@ -34,6 +36,17 @@ protected:
     Variables       m_params;
     Variables       m_grads;
 
+    std::vector< std::vector<int> >  m_sparse_step;    // 疎勾配Tensorの要素毎の最終更新ステップ
+
+#ifdef BB_WITH_CUDA
+    // 疎勾配と混在時に密なTensorだけを CUDA 版で更新するための部分集合(メモリは共有)
+    std::vector<bool>               m_dense_mask;
+    std::shared_ptr<Variables>      m_dense_params;
+    std::shared_ptr<Variables>      m_dense_grads;
+    std::shared_ptr<Variables>      m_dense_m;
+    std::shared_ptr<Variables>      m_dense_v;
+#endif
+
 public:
     struct create_t
     {
@@ -111,6 +124,13 @@ public:
         m_v = Variables(params.GetTypes(), params.GetShapes());
         m_m = 0;
         m_v = 0;
+
+        m_sparse_step.clear();
+        m_sparse_step.resize(params.GetSize());
+
+#ifdef BB_WITH_CUDA
+        m_dense_mask.clear();
+#endif
     }
     
 
@@ -120,6 +140,18 @@ public:
             return;
         }
 
+        ++m_iter;
+
+        // 疎勾配が有効な勾配があれば遅延更新
+        if ( UpdateSparse() ) {
+            return;
+        }
+
+        // 密に更新したので遅延更新の記録は破棄
+        for ( auto &step : m_sparse_step ) {
+            step.clear();
+        }
+
 #ifdef BB_WITH_CUDA
         if ( m_params.IsDeviceAvailable() && m_grads.IsDeviceAvailable() && m_m.IsDeviceAvailable() && m_v.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
             // CUDA版
@@ -157,6 +189,168 @@ public:
             m_b2 *= m_beta2;
         }
     }
+
+protected:
+    /**
+     * @brief  疎勾配の遅延更新
+     * @detail SparseGradient が有効な勾配Tensorは記録されたエントリだけを更新する。
+     *         前回更新から飛ばしたステップ数 k に対して m, v を β1^k, β2^k で減衰させてから
+     *         通常の更新を行うことで、勾配0のステップを省略した分を補正する(LazyAdam相当)。
+     *         省略中に慣性で進むはずだったパラメータの移動は行わない。
+     * @return 疎勾配が1つも無ければ何もせず false を返す
+     */
+    bool UpdateSparse(void)
+    {
+        auto size = m_grads.GetSize();
+
+        std::vector< std::shared_ptr<SparseGradient> > sparse((size_t)size);
+        bool found = false;
+        for ( index_t i = 0; i < size; ++i ) {
+            sparse[(size_t)i] = m_grads.GetSparseGradient(i);
+            found = found || (bool)sparse[(size_t)i];
+        }
+        if ( !found ) {
+            return false;
+        }
+
+        if ( (index_t)m_sparse_step.size() != size ) {
+            m_sparse_step.clear();
+            m_sparse_step.resize((size_t)size);
+        }
+
+        auto lr_t = m_learning_rate * std::sqrt((T)1.0 - m_b2) / ((T)1.0 - m_b1 );
+
+        // 通常のTensorは可能なら CUDA 版でまとめて更新
+        bool dense_done = UpdateDenseDevice(sparse, lr_t);
+
+        for ( index_t i = 0; i < size; ++i ) {
+            if ( !sparse[(size_t)i] ) {
+                m_sparse_step[(size_t)i].clear();   // 再度疎になったらここから数える
+                if ( dense_done ) {
+                    continue;
+                }
+
+                // 通常のTensorは密に更新
+                m_m[i] += ((T)1.0 - m_beta1) * (m_grads[i] - m_m[i]);
+                m_v[i] += ((T)1.0 - m_beta2) * (m_grads[i] * m_grads[i] - m_v[i]);
+
+                m_params[i] -= lr_t * m_m[i] / (Sqrt(m_v[i]) + (T)1e-7);
+                m_grads[i]   = 0;
+                continue;
+            }
+
+            auto &tracker = *sparse[(size_t)i];
+            auto &step    = m_sparse_step[(size_t)i];
+            if ( step.empty() ) {
+                // ここまでは密に更新済み
+                step.assign((size_t)m_params[i].GetSize(), m_iter - 1);
+            }
+
+            auto block_size = tracker.GetBlockSize();
+            auto row_size   = tracker.GetRowSize();
+            BB_ASSERT(tracker.GetTouchedSize() == 0 || block_size * row_size == m_params[i].GetSize());
+
+            auto param_ptr = m_params[i].Lock<T>();
+            auto grad_ptr  = m_grads[i].Lock<T>();
+            auto m_ptr     = m_m[i].Lock<T>();
+            auto v_ptr     = m_v[i].Lock<T>();
+
+            ParallelFor(0, block_size, [&](index_t block) {
+                for ( auto row : tracker.GetTouched(block) ) {
+                    auto index = block * row_size + row;
+
+                    T m = m_ptr[index];
+                    T v = v_ptr[index];
+
+                    int skip = m_iter - 1 - step[(size_t)index];
+                    if ( skip > 0 ) {
+                        m *= std::pow(m_beta1, (T)skip);
+                        v *= std::pow(m_beta2, (T)skip);
+                    }
+
+                    T g = grad_ptr[index];
+                    m += ((T)1.0 - m_beta1) * (g - m);
+                    v += ((T)1.0 - m_beta2) * (g * g - v);
+
+                    param_ptr[index] -= lr_t * m / (std::sqrt(v) + (T)1e-7);
+                    m_ptr[index]      = m;
+                    v_ptr[index]      = v;
+                    grad_ptr[index]   = 0;
+                    step[(size_t)index] = m_iter;
+                }
+            });
+
+            tracker.Clear();
+        }
+
+        m_b1 *= m_beta1;
+        m_b2 *= m_beta2;
+
+        return true;
+    }
+
+    /**
+     * @brief  疎勾配と混在時の密なTensorの CUDA 版更新
+     * @detail 疎勾配の無いTensorだけを集めた Variables を作り(疎勾配の有無が変わった時だけ作り直す)
+     *         通常時と同じ bbcu_fp32_Adam で更新する
+     * @return CUDA 版で更新したら true(CUDAが使えなければ何もせず false)
+     */
+    bool UpdateDenseDevice(std::vector< std::shared_ptr<SparseGradient> > const &sparse, T lr_t)
+    {
+#ifdef BB_WITH_CUDA
+        if ( !Manager::IsDeviceAvailable() ) {
+            return false;
+        }
+
+        std::vector<bool> mask(sparse.size());
+        for ( size_t i = 0; i < sparse.size(); ++i ) {
+            mask[i] = !sparse[i];
+        }
+
+        if ( mask != m_dense_mask || !m_dense_params ) {
+            m_dense_mask   = mask;
+            m_dense_params = std::make_shared<Variables>();
+            m_dense_grads  = std::make_shared<Variables>();
+            m_dense_m      = std::make_shared<Variables>();
+            m_dense_v      = std::make_shared<Variables>();
+            for ( size_t i = 0; i < mask.size(); ++i ) {
+                if ( mask[i] ) {
+                    m_dense_params->PushBack(std::make_shared<Tensor>(m_params[(index_t)i]));
+                    m_dense_grads ->PushBack(std::make_shared<Tensor>(m_grads [(index_t)i]));
+                    m_dense_m     ->PushBack(std::make_shared<Tensor>(m_m     [(index_t)i]));
+                    m_dense_v     ->PushBack(std::make_shared<Tensor>(m_v     [(index_t)i]));
+                }
+            }
+        }
+
+        if ( m_dense_params->IsEmpty() ) {
+            return true;
+        }
+
+        if ( !(m_dense_params->IsDeviceAvailable() && m_dense_grads->IsDeviceAvailable()
+                    && m_dense_m->IsDeviceAvailable() && m_dense_v->IsDeviceAvailable()) ) {
+            return false;
+        }
+
+        bbcu_fp32_Adam
+                (
+                    (int            )m_dense_params->GetSize(),
+                    (int     const *)m_dense_params->GetDeviceSizeTable(),
+                    (float * const *)m_dense_params->GetDeviceAddrTable(),
+                    (float * const *)m_dense_grads->GetDeviceAddrTable(),
+                    (float * const *)m_dense_m->GetDeviceAddrTable(),
+                    (float * const *)m_dense_v->GetDeviceAddrTable(),
+                    (float          )lr_t,
+                    (float          )m_beta1,
+                    (float          )m_beta2
+                );
+        return true;
+#else
+        (void)sparse;
+        (void)lr_t;
+        return false;
+#endif
+    }
 };
 
 
@@ -11,6 +11,8 @@
 
 
 #include "bb/Optimizer.h"
+#include "bb/SparseGradient.h"
+#include "bb/ThreadPool.h"
 
 
 namespace bb {
@@ -66,9 +68,57 @@ public:
             return;
         }
 
+        // 疎勾配が有効な勾配は記録されたエントリだけ更新
+        if ( UpdateSparse() ) {
+            return;
+        }
+
         m_params -= m_learning_rate * m_grads;
         m_grads   = 0;
     }
+
+protected:
+    bool UpdateSparse(void)
+    {
+        auto size = m_grads.GetSize();
+
+        std::vector< std::shared_ptr<SparseGradient> > sparse((size_t)size);
+        bool found = false;
+        for ( index_t i = 0; i < size; ++i ) {
+            sparse[(size_t)i] = m_grads.GetSparseGradient(i);
+            found = found || (bool)sparse[(size_t)i];
+        }
+        if ( !found ) {
+            return false;
+        }
+
+        for ( index_t i = 0; i < size; ++i ) {
+            if ( !sparse[(size_t)i] ) {
+                m_params[i] -= m_learning_rate * m_grads[i];
+                m_grads[i]   = 0;
+                continue;
+            }
+
+            auto &tracker   = *sparse[(size_t)i];
+            auto block_size = tracker.GetBlockSize();
+            auto row_size   = tracker.GetRowSize();
+            BB_ASSERT(tracker.GetTouchedSize() == 0 || block_size * row_size == m_params[i].GetSize());
+
+            auto param_ptr = m_params[i].Lock<T>();
+            auto grad_ptr  = m_grads[i].Lock<T>();
+            ParallelFor(0, block_size, [&](index_t block) {
+                for ( auto row : tracker.GetTouched(block) ) {
+                    auto index = block * row_size + row;
+                    param_ptr[index] -= m_learning_rate * grad_ptr[index];
+                    grad_ptr[index]   = 0;
+                }
+            });
+
+            tracker.Clear();
+        }
+
+        return true;
+    }
 };
 
 
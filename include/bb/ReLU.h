@@ -77,6 +77,8 @@ public:
 
     std::string GetClassName(void) const { return "ReLU"; }
 
+    bool IsBinaryMode(void) const { return DataType<BinType>::type == BB_TYPE_BIT || m_binary_mode; }
+
 
     // 1ノードのみForward計算
     std::vector<double> ForwardNode(index_t node, std::vector<double> x_vec) const
@@ -107,10 +109,8 @@ public:
             return _super::Forward(x_buf, train);
         }
 
-        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
-
-        // 戻り値のサイズ設定
-        FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), DataType<BinType>::type);
+        InferenceContext ctx;
+        auto y_buf = Forward(x_buf, ctx);
 
         // backward用に保存
         if ( train ) {
@@ -118,6 +118,27 @@ public:
             m_y_buf = y_buf;
         }
 
+        return y_buf;
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    inline FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        // binaryモード
+        if ( DataType<BinType>::type == BB_TYPE_BIT || m_binary_mode) {
+            return _super::Forward(x_buf, ctx);
+        }
+
+        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
+
+        // 戻り値のサイズ設定
+        FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), DataType<BinType>::type);
 
 #ifdef BB_WITH_CUDA
         if ( !m_host_only && DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32
@@ -136,7 +157,8 @@ public:
         }
 #endif
 
-        if (  DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 ) {
+        static SimdKernel forward_kernel("ReLU::Forward", {SimdLevel::AVX2});
+        if (  DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && forward_kernel.Select() >= SimdLevel::AVX2 ) {
             // AVX版
             index_t frame_size = x_buf.GetFrameSize();
             index_t node_size  = x_buf.GetNodeSize();
@@ -145,8 +167,8 @@ public:
             auto y_ptr = y_buf.template Lock<float>(true);
 
             index_t  m256_frame_size = (int)(((frame_size + 7) / 8) * 8);
-            __m256 zero = _mm256_set1_ps(0);
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
+                __m256 zero = _mm256_set1_ps(0);
                 auto x_addr = (float const *)x_ptr.GetAddr(node);
                 auto y_addr = (float *)y_ptr.GetAddr(node);
                 for (index_t frame = 0; frame < m256_frame_size; frame += 8) {
@@ -154,7 +176,7 @@ public:
                     in_sig = _mm256_max_ps(in_sig, zero);
                     _mm256_store_ps(&y_addr[frame], in_sig);
                 }
-            }
+            });
             return y_buf;
         }
 
@@ -167,13 +189,12 @@ public:
             auto y_ptr = y_buf.template Lock<BinType>();
 
             // ReLU
-    #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto x = x_ptr.Get(frame, node);
                     y_ptr.Set(frame, node, x > (RealType)0.0 ? (BinType)x : (BinType)0.0);
                 }
-            }
+            });
             return y_buf;
         }
     }
@@ -221,7 +242,8 @@ public:
         }
 #endif
 
-        if ( DataType<RealType>::type == BB_TYPE_FP32 ) {
+        static SimdKernel backward_kernel("ReLU::Backward", {SimdLevel::AVX2});
+        if ( DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && backward_kernel.Select() >= SimdLevel::AVX2 ) {
             // AVX版
             index_t frame_size = dx_buf.GetFrameSize();
             index_t node_size = dx_buf.GetNodeSize();
@@ -233,8 +255,8 @@ public:
 
             index_t  m256_frame_size = (int)(((frame_size + 7) / 8) * 8);
 
-            __m256 zero = _mm256_set1_ps(0);
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
+                __m256 zero = _mm256_set1_ps(0);
                 auto y_addr  = (float *)y_ptr.GetAddr(node);
                 auto dy_addr = (float *)dy_ptr.GetAddr(node);
                 auto dx_addr = (float *)dx_ptr.GetAddr(node);
@@ -245,7 +267,7 @@ public:
                     __m256 dx   = _mm256_and_ps(dy, mask);
                     _mm256_store_ps(&dx_addr[frame], dx);
                 }
-            }
+            });
             return dx_buf;
         }
 
@@ -259,14 +281,13 @@ public:
             auto dx_ptr = dx_buf.template Lock<RealType>();
 
             // ReLU
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto y  = y_ptr.Get(frame, node);
                     auto dy = dy_ptr.Get(frame, node);
                     dx_ptr.Set(frame, node, (y > (BinType)0) ? dy : (RealType)0);
                 }
-            }
+            });
 
             return dx_buf;
         }
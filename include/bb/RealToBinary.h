@@ -183,6 +183,12 @@ public:
             SetInputShape(x_buf.GetShape());
         }
 
+        // 固定閾値ならモデルの状態を使わない
+        if ( m_value_generator == nullptr ) {
+            InferenceContext ctx;
+            return Forward(x_buf, ctx);
+        }
+
         // 戻り値の型を設定
         FrameBuffer y_buf(x_buf.GetFrameSize() * m_modulation_size, m_node_shape, DataType<BinType>::type);
 
@@ -193,12 +199,11 @@ public:
         auto y_ptr = y_buf.Lock<BinType>();
 
         RealType th_step = (m_input_range_hi - m_input_range_lo) / (RealType)(m_modulation_size + 1);
-        for ( index_t input_frame = 0; input_frame < input_frame_size; ++input_frame) {
-            for ( index_t i = 0; i < m_modulation_size; ++i ) {
-                index_t output_frame = input_frame * m_modulation_size + i;
-
-                if ( m_framewise || m_value_generator == nullptr ) {
-                    // frame毎に閾値変調
+        if ( m_framewise || m_value_generator == nullptr ) {
+            // frame毎に閾値変調(閾値を先に求めてからノード方向に1回だけ並列化する)
+            std::vector<RealType> th_table(input_frame_size * m_modulation_size);
+            for ( index_t input_frame = 0; input_frame < input_frame_size; ++input_frame) {
+                for ( index_t i = 0; i < m_modulation_size; ++i ) {
                     RealType th;
                     if ( m_value_generator != nullptr ) {
                         th = m_value_generator->GetValue();
@@ -208,16 +213,26 @@ public:
                     else {
                         th = m_input_range_lo + (th_step * (RealType)(i + 1));
                     }
+                    th_table[input_frame * m_modulation_size + i] = th;
+                }
+            }
 
-                    #pragma omp parallel for
-                    for (index_t node = 0; node < node_size; ++node) {
-                        RealType x = x_ptr.Get(input_frame, node);
-                        BinType  y = (x > th) ? (BinType)1 : (BinType)0;
+            ParallelFor(0, node_size, [&](index_t node) {
+                for ( index_t input_frame = 0; input_frame < input_frame_size; ++input_frame) {
+                    RealType x = x_ptr.Get(input_frame, node);
+                    for ( index_t i = 0; i < m_modulation_size; ++i ) {
+                        index_t output_frame = input_frame * m_modulation_size + i;
+                        BinType y = (x > th_table[output_frame]) ? (BinType)1 : (BinType)0;
                         y_ptr.Set(output_frame, node, y);
                     }
                 }
-                else {
-                    // データ毎に閾値変調
+            });
+        }
+        else {
+            // データ毎に閾値変調
+            for ( index_t input_frame = 0; input_frame < input_frame_size; ++input_frame) {
+                for ( index_t i = 0; i < m_modulation_size; ++i ) {
+                    index_t output_frame = input_frame * m_modulation_size + i;
                     for (index_t node = 0; node < node_size; ++node) {
                         RealType th = m_value_generator->GetValue();
                         RealType x = x_ptr.Get(input_frame, node);
@@ -231,6 +246,57 @@ public:
         return y_buf;
     }
 
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        if (!m_binary_mode) {
+            return x_buf;
+        }
+
+        // 乱数による閾値変調は生成器の状態を進めるので排他して通常の処理を呼ぶ
+        if ( m_value_generator != nullptr ) {
+            return Model::Forward(x_buf, ctx);
+        }
+
+        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
+        BB_ASSERT(x_buf.GetShape() == m_node_shape);
+
+        // 戻り値の型を設定
+        FrameBuffer y_buf(x_buf.GetFrameSize() * m_modulation_size, m_node_shape, DataType<BinType>::type);
+
+        index_t node_size        = x_buf.GetNodeSize();
+        index_t input_frame_size = x_buf.GetFrameSize();
+
+        auto x_ptr = x_buf.LockConst<RealType>();
+        auto y_ptr = y_buf.Lock<BinType>();
+
+        // 等間隔の固定閾値で変調
+        RealType th_step = (m_input_range_hi - m_input_range_lo) / (RealType)(m_modulation_size + 1);
+        std::vector<RealType> th_table(m_modulation_size);
+        for ( index_t i = 0; i < m_modulation_size; ++i ) {
+            th_table[i] = m_input_range_lo + (th_step * (RealType)(i + 1));
+        }
+
+        ParallelFor(0, node_size, [&](index_t node) {
+            for ( index_t input_frame = 0; input_frame < input_frame_size; ++input_frame) {
+                RealType x = x_ptr.Get(input_frame, node);
+                for ( index_t i = 0; i < m_modulation_size; ++i ) {
+                    index_t output_frame = input_frame * m_modulation_size + i;
+                    BinType y = (x > th_table[i]) ? (BinType)1 : (BinType)0;
+                    y_ptr.Set(output_frame, node, y);
+                }
+            }
+        });
+
+        return y_buf;
+    }
+
 
     FrameBuffer Backward(FrameBuffer dy_buf)
     {
@@ -252,15 +318,14 @@ public:
         auto dy_ptr = dy_buf.LockConst<RealType>();
         auto dx_ptr = dx_buf.Lock<RealType>();
 
-        #pragma omp parallel for
-        for (index_t node = 0; node < node_size; node++) {
+        ParallelFor(0, node_size, [&](index_t node) {
             for (index_t output_frame = 0; output_frame < output_frame_size; ++output_frame) {
                 index_t input_frame = output_frame / m_modulation_size;
 
                 RealType dy = dy_ptr.Get(output_frame, node);
                 dx_ptr.Add(input_frame, node, dy);
             }
-        }
+        });
 #endif
 
         return dx_buf;
@@ -91,6 +91,7 @@ public:
 
 
     std::string GetClassName(void) const { return "Reduce"; }
+    bool IsForwardReplayable(void) const { return true; }
 
     /**
      * @brief  入力のshape設定
@@ -183,8 +184,7 @@ public:
 
 //          index_t node_size = std::max(input_node_size, output_node_size);
 
-            #pragma omp parallel for
-            for (index_t output_node = 0; output_node < output_node_size; ++output_node) {
+            ParallelFor(0, output_node_size, [&](index_t output_node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     FT sum = 0;
                     for (index_t i = 0; i < mux_size; ++i) {
@@ -192,7 +192,7 @@ public:
                     }
                     y_ptr.Set(frame, output_node, sum / (FT)mux_size);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -239,8 +239,7 @@ public:
             auto dy_ptr = dy_buf.LockConst<BT>();
             auto dx_ptr = dx_buf.Lock<BT>();
 
-            #pragma omp parallel for
-            for (index_t output_node = 0; output_node < output_node_size; ++output_node) {
+            ParallelFor(0, output_node_size, [&](index_t output_node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     BT dy = dy_ptr.Get(frame, output_node);
                     BT dx = dy / (BT)mux_size;
@@ -248,7 +247,7 @@ public:
                         dx_ptr.Set(frame, output_node_size * i + output_node, dx);
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
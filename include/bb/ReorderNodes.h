@@ -0,0 +1,179 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "bb/SparseLayer.h"
+#include "bb/Sequential.h"
+
+
+namespace bb {
+
+
+// [ReorderNodes]
+//  疎結合レイヤーのノード並べ替えによる入力参照の局所化
+//  ・後段レイヤーのノードを先頭から走査し、初めて参照された前段ノードから順に番号を振り直す
+//    (後段の各ノードが参照する入力と、連続する後段ノードが参照する入力が近い行に集まる)
+//  ・後段から前段に向かって順に決定する(最終段の出力順は変えない)
+//  ・並べ替えたレイヤーの後段の入力接続を付け替えるので、ネットとしての演算結果は変わらない
+//
+//  学習前(初期化直後)か学習後に使うこと(Optimizer の内部状態は並べ替えない)
+
+
+/**
+ * @brief  後段の参照順による前段ノードの並び順
+ * @param  next       後段レイヤー
+ * @param  node_size  前段の出力ノード数
+ * @return 並び順(新しいノード i に元のノード order[i] を置く)
+ */
+inline std::vector<index_t> ReorderNodes_MakeOrder(std::shared_ptr<SparseLayer> next, index_t node_size)
+{
+    std::vector<index_t>    order;
+    std::vector<bool>       placed(node_size, false);
+    order.reserve(node_size);
+
+    index_t next_node_size = next->GetOutputNodeSize();
+    for ( index_t node = 0; node < next_node_size; ++node ) {
+        index_t connection_size = next->GetNodeConnectionSize(node);
+        for ( index_t i = 0; i < connection_size; ++i ) {
+            index_t input_node = next->GetNodeConnectionIndex(node, i);
+            if ( !placed[input_node] ) {
+                placed[input_node] = true;
+                order.push_back(input_node);
+            }
+        }
+    }
+
+    // どこからも参照されないノードは末尾
+    for ( index_t node = 0; node < node_size; ++node ) {
+        if ( !placed[node] ) {
+            order.push_back(node);
+        }
+    }
+
+    return order;
+}
+
+
+/**
+ * @brief  入力参照の広がりの平均
+ * @detail 各ノードの入力インデックスの最大と最小の差の平均(並べ替えの効果確認用)
+ * @param  layer  対象レイヤー
+ * @return 平均
+ */
+inline double ReorderNodes_GetAverageSpan(std::shared_ptr<SparseLayer> layer)
+{
+    index_t node_size = layer->GetOutputNodeSize();
+    if ( node_size <= 0 ) {
+        return 0;
+    }
+
+    double sum = 0;
+    for ( index_t node = 0; node < node_size; ++node ) {
+        index_t connection_size = layer->GetNodeConnectionSize(node);
+        if ( connection_size <= 0 ) {
+            continue;
+        }
+        index_t min_index = layer->GetNodeConnectionIndex(node, 0);
+        index_t max_index = min_index;
+        for ( index_t i = 1; i < connection_size; ++i ) {
+            index_t input_node = layer->GetNodeConnectionIndex(node, i);
+            min_index = std::min(min_index, input_node);
+            max_index = std::max(max_index, input_node);
+        }
+        sum += (double)(max_index - min_index);
+    }
+    return sum / (double)node_size;
+}
+
+
+/**
+ * @brief  直列に接続された SparseLayer 列のノード並べ替え
+ * @detail layers[i] の出力が layers[i+1] の入力に直結していること
+ *         並べ替えに対応しないレイヤーはそのままにする
+ * @param  layers  レイヤー列
+ * @return 並べ替えたレイヤー数
+ */
+inline int ReorderNodes(std::vector< std::shared_ptr<SparseLayer> > const &layers)
+{
+    int count = 0;
+    for ( int layer = (int)layers.size() - 2; layer >= 0; --layer ) {
+        auto cur  = layers[layer];
+        auto next = layers[layer + 1];
+
+        index_t node_size = cur->GetOutputNodeSize();
+        BB_ASSERT(next->GetInputNodeSize() == node_size);
+
+        auto order = ReorderNodes_MakeOrder(next, node_size);
+        if ( !cur->PermuteNodes(order) ) {
+            continue;
+        }
+
+        // 後段の入力接続を付け替え
+        std::vector<index_t> new_index(node_size);
+        for ( index_t node = 0; node < node_size; ++node ) {
+            new_index[order[node]] = node;
+        }
+
+        index_t next_node_size = next->GetOutputNodeSize();
+        for ( index_t node = 0; node < next_node_size; ++node ) {
+            index_t connection_size = next->GetNodeConnectionSize(node);
+            for ( index_t i = 0; i < connection_size; ++i ) {
+                next->SetNodeConnectionIndex(node, i, new_index[next->GetNodeConnectionIndex(node, i)]);
+            }
+        }
+
+        ++count;
+    }
+    return count;
+}
+
+
+/**
+ * @brief  Sequential 内のノード並べ替え
+ * @detail SparseLayer が連続する区間毎に並べ替える(入れ子の Sequential も対象)
+ *         区間の最後のレイヤーの出力順は変えない
+ * @param  net  対象ネット
+ * @return 並べ替えたレイヤー数
+ */
+inline int ReorderNodes(std::shared_ptr<Sequential> net)
+{
+    int count = 0;
+    std::vector< std::shared_ptr<SparseLayer> > layers;
+    for ( int i = 0; i < net->GetSize(); ++i ) {
+        auto layer = net->Get(i);
+
+        auto sparse_layer = std::dynamic_pointer_cast<SparseLayer>(layer);
+        if ( sparse_layer ) {
+            layers.push_back(sparse_layer);
+            continue;
+        }
+
+        count += ReorderNodes(layers);
+        layers.clear();
+
+        auto sequential = std::dynamic_pointer_cast<Sequential>(layer);
+        if ( sequential ) {
+            count += ReorderNodes(sequential);
+        }
+    }
+    count += ReorderNodes(layers);
+
+    return count;
+}
+
+
+}
+
+
+// end of file
@@ -16,6 +16,8 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <future>
+#include <algorithm>
 #include <assert.h>
 #include <string>
 
@@ -142,7 +144,13 @@ protected:
     bool                                m_file_write              = false;
     bool                                m_write_serial            = false;
     bool                                m_initial_evaluation      = false;
-    
+
+    index_t                             m_eval_test_size          = 0;        //< エポック毎評価のテストデータ数(0なら全数)
+    index_t                             m_eval_train_size         = 0;        //< エポック毎評価の学習データ数(0なら全数)
+    bool                                m_eval_train_reuse        = false;    //< 学習データの評価値を学習時の集計で代用するか
+    std::shared_ptr<Model>              m_eval_net;                           //< 非同期評価用ネット(nullptrなら同期評価)
+    std::shared_ptr<MetricsFunction>    m_eval_metricsFunc;                   //< 非同期評価用の評価関数
+
     callback_proc_t                     m_callback_proc = nullptr;
     void                                *m_callback_user = 0;
 
@@ -167,6 +175,11 @@ public:
         bool                                file_write = false;                 //< 計算結果を保存するか
         bool                                write_serial = false;               //< EPOC単位で計算結果を連番で保存するか
         bool                                initial_evaluation = false;         //< 初期評価を行うか
+        index_t                             eval_test_size  = 0;                //< エポック毎評価に使うテストデータ数(0なら全数)
+        index_t                             eval_train_size = 0;                //< エポック毎評価に使う学習データ数(0なら全数)
+        bool                                eval_train_reuse = false;           //< 学習データの評価値を学習時の集計で代用するか
+        std::shared_ptr<Model>              eval_net;                           //< 非同期評価用ネット(学習ネットと同構成、nullptrなら同期評価)
+        std::shared_ptr<MetricsFunction>    eval_metricsFunc;                   //< 非同期評価用の評価関数(eval_net指定時に必要)
         std::int64_t                        seed = 1;                           //< 乱数初期値
         callback_proc_t                     callback_proc = nullptr;            //< コールバック関数
         void*                               callback_user = 0;                  //< コールバック関数のユーザーパラメータ
@@ -195,6 +208,11 @@ protected:
         m_file_write              = create.file_write;
         m_write_serial            = create.write_serial;
         m_initial_evaluation      = create.initial_evaluation;
+        m_eval_test_size          = create.eval_test_size;
+        m_eval_train_size         = create.eval_train_size;
+        m_eval_train_reuse        = create.eval_train_reuse;
+        m_eval_net                = create.eval_net;
+        m_eval_metricsFunc        = create.eval_metricsFunc;
         m_callback_proc           = create.callback_proc;
         m_callback_user           = create.callback_user;
         m_data_augmentation_proc  = create.data_augmentation_proc;
@@ -317,6 +335,36 @@ public:
         m_callback_proc = callback_proc;
         m_callback_user = user;
     }
+
+    /**
+     * @brief  エポック毎評価のデータ数設定
+     * @detail 0 以外を指定すると開始時に固定で選んだランダムなサブセットで評価する
+     * @param  test_size  テストデータ数(0なら全数)
+     * @param  train_size 学習データ数(0なら全数)
+     * @param  train_reuse 学習データの評価値を学習時の集計で代用するか
+     */
+    void SetEvaluationSize(index_t test_size, index_t train_size, bool train_reuse = false)
+    {
+        m_eval_test_size   = test_size;
+        m_eval_train_size  = train_size;
+        m_eval_train_reuse = train_reuse;
+    }
+
+    /**
+     * @brief  非同期評価用ネット設定
+     * @detail エポック終了時に学習ネットのパラメータを eval_net に写し、
+     *         次のエポックの学習と並行してバックグラウンドで評価する
+     *         eval_net は学習ネットと同じ構成で別に生成したもの
+     *         評価は学習と同じグローバルな ThreadPool で動くため、
+     *         並行中は両者でワーカーを取り合い学習側のエポック時間も伸びる
+     * @param  eval_net         評価用ネット(nullptrなら同期評価)
+     * @param  eval_metricsFunc 評価用の評価関数(学習側とは別インスタンス)
+     */
+    void SetEvaluationNet(std::shared_ptr<Model> eval_net, std::shared_ptr<MetricsFunction> eval_metricsFunc)
+    {
+        m_eval_net         = eval_net;
+        m_eval_metricsFunc = eval_metricsFunc;
+    }
     
 
     // Serialize
@@ -392,12 +440,14 @@ public:
 #endif
 
 
-    void Fitting(
+    double Fitting(
             TrainData<T> &td,
             index_t      epoch_size,
             index_t      batch_size
         )
     {
+        double test_metrics = 0;
+
         std::string csv_file_name = m_name + "_metrics.txt";
         std::string log_file_name = m_name + "_log.txt";
 #ifdef BB_WITH_CEREAL
@@ -423,6 +473,8 @@ public:
                 ofs_log << "-----------------------------------"    << std::endl;
                 ofs_log << "epoch_size      : " << epoch_size       << std::endl;
                 ofs_log << "mini_batch_size : " << batch_size       << std::endl;
+                ofs_log << Numa::GetInfoString();
+                ofs_log << GetSimdInfoString();
                 ofs_log << "-----------------------------------"    << std::endl;
             }
             
@@ -451,6 +503,31 @@ public:
             // オプティマイザ設定
             m_optimizer->SetVariables(m_net->GetParameters(), m_net->GetGradients());
 
+            // エポック毎評価用データ準備
+            //  間引き評価や非同期評価では、開始時のデータから固定で抜き出したものを使う
+            //  (非同期評価中も学習側はシャッフルやData Augmentationでデータを書き換えるため)
+            bool async_eval  = (m_eval_net != nullptr);
+            bool fixed_test  = async_eval || (m_eval_test_size > 0 && m_eval_test_size < (index_t)td.x_test.size());
+            bool fixed_train = !m_eval_train_reuse
+                                && (async_eval || (m_eval_train_size > 0 && m_eval_train_size < (index_t)td.x_train.size()));
+            if ( async_eval ) {
+                BB_ASSERT(m_eval_metricsFunc != nullptr);
+                BB_ASSERT(m_eval_metricsFunc != m_metricsFunc);
+            }
+
+            std::vector< std::vector<T> >   x_eval_test;
+            std::vector< std::vector<T> >   t_eval_test;
+            std::vector< std::vector<T> >   x_eval_train;
+            std::vector< std::vector<T> >   t_eval_train;
+            if ( fixed_test ) {
+                SelectEvaluationSet(td.x_test, td.t_test, m_eval_test_size, x_eval_test, t_eval_test);
+            }
+            if ( fixed_train ) {
+                SelectEvaluationSet(td.x_train, td.t_train, m_eval_train_size, x_eval_train, t_eval_train);
+            }
+
+            std::future<double> eval_future;
+
             // 初期評価
             if (m_initial_evaluation) {
                 auto test_metrics  = Calculation(td.x_test,  td.x_shape, td.t_test,  td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
@@ -471,7 +548,7 @@ public:
 
                 // 学習実施
                 m_epoch++;
-                Calculation(td_work.x_train, td_work.x_shape, td_work.t_train, td_work.t_shape, batch_size, batch_size,
+                auto fit_metrics = Calculation(td_work.x_train, td_work.x_shape, td_work.t_train, td_work.t_shape, batch_size, batch_size,
                                         m_metricsFunc, m_lossFunc, m_optimizer, true, m_print_progress, m_print_progress_loss, m_print_progress_accuracy);
 
                 // ネット保存
@@ -515,12 +592,27 @@ public:
                 // 学習状況評価
                 {
                     double now_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start_time).count() / 1000.0;
-                    auto test_metrics  = Calculation(td_work.x_test,  td_work.x_shape, td_work.t_test,  td_work.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
-                    auto train_metrics = Calculation(td_work.x_train, td_work.x_shape, td_work.t_train, td_work.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
-                    log_stream  << std::setw(10) << std::fixed << std::setprecision(2) << now_time << "s "
-                                << "epoch[" << std::setw(3) << m_epoch << "] "
-                                << "test "  << m_metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << test_metrics  << " "
-                                << "train " << m_metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << train_metrics << std::endl;
+                    if ( async_eval ) {
+                        // 前回の評価完了を待ってからパラメータを写し、次のエポックの学習と並行して評価する
+                        if ( eval_future.valid() ) {
+                            test_metrics = eval_future.get();
+                        }
+                        CopyEvaluationNet();
+                        index_t epoch_no = m_epoch;
+                        eval_future = std::async(std::launch::async, [&, now_time, epoch_no, fit_metrics]() {
+                                return EpochEvaluation(log_stream, m_eval_net, m_eval_metricsFunc, now_time, epoch_no,
+                                            x_eval_test, t_eval_test, x_eval_train, t_eval_train,
+                                            td.x_shape, td.t_shape, batch_size, fit_metrics, false);
+                            });
+                    }
+                    else {
+                        test_metrics = EpochEvaluation(log_stream, m_net, m_metricsFunc, now_time, m_epoch,
+                                            fixed_test  ? x_eval_test  : td_work.x_test,
+                                            fixed_test  ? t_eval_test  : td_work.t_test,
+                                            fixed_train ? x_eval_train : td_work.x_train,
+                                            fixed_train ? t_eval_train : td_work.t_train,
+                                            td_work.x_shape, td_work.t_shape, batch_size, fit_metrics, m_print_progress);
+                    }
                 }
 
                 // callback
@@ -532,9 +624,16 @@ public:
                 ShuffleDataSet(m_mt(), td.x_train, td.t_train);
             }
 
+            // 非同期評価の完了待ち
+            if ( eval_future.valid() ) {
+                test_metrics = eval_future.get();
+            }
+
             // 終了メッセージ
             log_stream << "fitting end\n" << std::endl;
         }
+
+        return test_metrics;
     }
 
 
@@ -546,8 +645,193 @@ public:
         return Calculation(td.x_test,  td.x_shape, td.t_test,  td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
     }
 
-    
+
+    /**
+     * @brief  連続配列による学習
+     * @detail x[frame][node], t[frame][node] (C連続) の配列を直接用いてエポックループを実行する
+     *         TrainData への変換を行わず、ミニバッチ毎に必要なフレームだけを集めて転送する
+     *         シャッフルはインデックスの並べ替えで行うので入力配列は変更しない
+     * @param  x_train     学習用入力
+     * @param  t_train     学習用期待値
+     * @param  train_size  学習用フレーム数
+     * @param  x_test      評価用入力(nullptrなら評価は学習データで行う)
+     * @param  t_test      評価用期待値
+     * @param  test_size   評価用フレーム数
+     * @param  x_shape     入力のノード形状
+     * @param  t_shape     期待値のノード形状
+     * @param  epoch_size  エポック数
+     * @param  batch_size  ミニバッチサイズ
+     * @return 最終エポックの評価値
+     */
+    double FittingArray(
+            T const     *x_train,
+            T const     *t_train,
+            index_t     train_size,
+            T const     *x_test,
+            T const     *t_test,
+            index_t     test_size,
+            indices_t   x_shape,
+            indices_t   t_shape,
+            index_t     epoch_size,
+            index_t     batch_size
+        )
+    {
+        BB_ASSERT(x_train != nullptr && t_train != nullptr);
+        BB_ASSERT(train_size > 0 && batch_size > 0);
+
+        if ( x_test == nullptr || t_test == nullptr || test_size <= 0 ) {
+            x_test    = x_train;
+            t_test    = t_train;
+            test_size = train_size;
+        }
+
+        // ログファイルオープン
+        std::ofstream ofs_log;
+        if ( m_log_write ) {
+            ofs_log.open(m_name + "_log.txt", m_log_append ? std::ios::app : std::ios::out);
+        }
+
+        ostream_tee log_stream;
+        log_stream.add(std::cout);
+        if (ofs_log.is_open()) { log_stream.add(ofs_log); }
+
+        log_stream << "fitting start : " << m_name << std::endl;
+
+        // オプティマイザ設定
+        m_optimizer->SetVariables(m_net->GetParameters(), m_net->GetGradients());
+
+        std::vector<index_t> order(train_size);
+        for ( index_t i = 0; i < train_size; ++i ) {
+            order[i] = i;
+        }
+
+        auto   start_time   = std::chrono::system_clock::now();
+        double test_metrics = 0;
+        for ( index_t epoch = 0; epoch < epoch_size; ++epoch ) {
+            // 学習実施
+            m_epoch++;
+            CalculationArray(x_train, x_shape, t_train, t_shape, train_size, &order[0], batch_size, batch_size,
+                                    m_metricsFunc, m_lossFunc, m_optimizer, true, m_print_progress, m_print_progress_loss, m_print_progress_accuracy);
+
+            // 学習状況評価
+            double now_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start_time).count() / 1000.0;
+            test_metrics = CalculationArray(x_test, x_shape, t_test, t_shape, test_size, nullptr, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
+            log_stream  << std::setw(10) << std::fixed << std::setprecision(2) << now_time << "s "
+                        << "epoch[" << std::setw(3) << m_epoch << "] "
+                        << "test "  << m_metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << test_metrics << std::endl;
+
+            // callback
+            if (m_callback_proc != nullptr) {
+                m_callback_proc(m_net, m_callback_user);
+            }
+
+            // Shuffle
+            ShuffleDataSet(m_mt(), order);
+        }
+
+        log_stream << "fitting end\n" << std::endl;
+
+        return test_metrics;
+    }
+
+    /**
+     * @brief  連続配列による評価
+     * @detail x[frame][node], t[frame][node] (C連続) の配列で評価する
+     * @return 評価値
+     */
+    double EvaluationArray(
+            T const     *x,
+            T const     *t,
+            index_t     frame_size,
+            indices_t   x_shape,
+            indices_t   t_shape,
+            index_t     batch_size
+        )
+    {
+        return CalculationArray(x, x_shape, t, t_shape, frame_size, nullptr, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
+    }
+
+
 protected:
+    // 評価用データを固定で抜き出す(size が 0 か全数以上なら全数をコピー)
+    void SelectEvaluationSet(
+                std::vector< std::vector<T> > const &x_src,
+                std::vector< std::vector<T> > const &t_src,
+                index_t                             size,
+                std::vector< std::vector<T> >       &x_dst,
+                std::vector< std::vector<T> >       &t_dst
+            )
+    {
+        BB_ASSERT(x_src.size() == t_src.size());
+
+        index_t frame_size = (index_t)x_src.size();
+        std::vector<index_t> index(frame_size);
+        for ( index_t i = 0; i < frame_size; ++i ) {
+            index[i] = i;
+        }
+        if ( size > 0 && size < frame_size ) {
+            ShuffleDataSet(m_mt(), index);
+            index.resize(size);
+            std::sort(index.begin(), index.end());
+        }
+
+        x_dst.clear();
+        t_dst.clear();
+        x_dst.reserve(index.size());
+        t_dst.reserve(index.size());
+        for ( auto i : index ) {
+            x_dst.push_back(x_src[i]);
+            t_dst.push_back(t_src[i]);
+        }
+    }
+
+    // 非同期評価用ネットへ学習ネットの状態を写す
+    void CopyEvaluationNet(void)
+    {
+        if ( m_eval_net->GetInputShape() != m_net->GetInputShape() ) {
+            m_eval_net->SetInputShape(m_net->GetInputShape());
+        }
+
+        std::stringstream ss;
+        m_net->Save(ss);
+        m_eval_net->Load(ss);
+    }
+
+    // エポック毎の評価とログ出力(train_reuse 時は fit_metrics をそのまま学習データの評価値とする)
+    double EpochEvaluation(
+                std::ostream                        &os,
+                std::shared_ptr<Model>              net,
+                std::shared_ptr<MetricsFunction>    metricsFunc,
+                double                              now_time,
+                index_t                             epoch,
+                std::vector< std::vector<T> > const &x_test,
+                std::vector< std::vector<T> > const &t_test,
+                std::vector< std::vector<T> > const &x_train,
+                std::vector< std::vector<T> > const &t_train,
+                indices_t                           x_shape,
+                indices_t                           t_shape,
+                index_t                             batch_size,
+                double                              fit_metrics,
+                bool                                print_progress
+            )
+    {
+        auto test_metrics  = Calculation(x_test, x_shape, t_test, t_shape, batch_size, 0, metricsFunc, nullptr, nullptr, false, print_progress, true, true, net);
+        auto train_metrics = fit_metrics;
+        if ( !m_eval_train_reuse ) {
+            train_metrics = Calculation(x_train, x_shape, t_train, t_shape, batch_size, 0, metricsFunc, nullptr, nullptr, false, print_progress, true, true, net);
+        }
+
+        // 非同期評価時に他の出力と混ざらないよう1行まとめて出力する
+        std::stringstream ss;
+        ss  << std::setw(10) << std::fixed << std::setprecision(2) << now_time << "s "
+            << "epoch[" << std::setw(3) << epoch << "] "
+            << "test "  << metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << test_metrics  << " "
+            << "train " << metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << train_metrics << std::endl;
+        os << ss.str() << std::flush;
+
+        return test_metrics;
+    }
+
     double Calculation(
                 std::vector< std::vector<T> > const &x,
                 indices_t x_shape,
@@ -561,12 +845,98 @@ protected:
                 bool train = false,
                 bool print_progress = false,
                 bool print_progress_loss = true,
-                bool print_progress_metrics = true
+                bool print_progress_metrics = true,
+                std::shared_ptr< Model >           net = nullptr
             )
 
     {
         BB_ASSERT(x.size() == t.size());
 
+        return CalculationLoop((index_t)x.size(), max_batch_size, min_batch_size, metricsFunc, lossFunc, optimizer,
+                    train, print_progress, print_progress_loss, print_progress_metrics, net,
+                    [&](FrameBuffer &x_buf, FrameBuffer &t_buf, index_t start, index_t run_size) {
+                        x_buf.Resize(run_size, x_shape, DataType<T>::type);
+                        x_buf.SetVector(x, start);
+                        t_buf.Resize(run_size, t_shape, DataType<T>::type);
+                        t_buf.SetVector(t, start);
+                    });
+    }
+
+    // 連続配列版の Calculation (order が指定されればその順にフレームを集める)
+    double CalculationArray(
+                T const *x,
+                indices_t x_shape,
+                T const *t,
+                indices_t t_shape,
+                index_t frame_size,
+                index_t const *order,
+                index_t max_batch_size,
+                index_t min_batch_size,
+                std::shared_ptr< MetricsFunction > metricsFunc = nullptr,
+                std::shared_ptr< LossFunction >    lossFunc = nullptr,
+                std::shared_ptr< Optimizer >       optimizer = nullptr,
+                bool train = false,
+                bool print_progress = false,
+                bool print_progress_loss = true,
+                bool print_progress_metrics = true
+            )
+    {
+        index_t x_node_size = GetShapeSize(x_shape);
+        index_t t_node_size = GetShapeSize(t_shape);
+
+        std::vector<T>  x_work;
+        std::vector<T>  t_work;
+
+        return CalculationLoop(frame_size, max_batch_size, min_batch_size, metricsFunc, lossFunc, optimizer,
+                    train, print_progress, print_progress_loss, print_progress_metrics, nullptr,
+                    [&](FrameBuffer &x_buf, FrameBuffer &t_buf, index_t start, index_t run_size) {
+                        // 対象フレームを集める(順序指定が無ければそのまま参照)
+                        T const *x_addr = x + start * x_node_size;
+                        T const *t_addr = t + start * t_node_size;
+                        if ( order != nullptr ) {
+                            x_work.resize(run_size * x_node_size);
+                            t_work.resize(run_size * t_node_size);
+                            ParallelFor(0, run_size, [&](index_t frame) {
+                                index_t src = order[start + frame];
+                                std::copy(x + src * x_node_size, x + (src + 1) * x_node_size, &x_work[frame * x_node_size]);
+                                std::copy(t + src * t_node_size, t + (src + 1) * t_node_size, &t_work[frame * t_node_size]);
+                            });
+                            x_addr = &x_work[0];
+                            t_addr = &t_work[0];
+                        }
+
+                        x_buf.Resize(run_size, x_shape, DataType<T>::type);
+                        x_buf.SetDataArray<T>(x_addr, run_size);
+                        t_buf.Resize(run_size, t_shape, DataType<T>::type);
+                        t_buf.SetDataArray<T>(t_addr, run_size);
+                    });
+    }
+
+    /**
+     * @brief  Calculation / CalculationArray 共通のミニバッチループ
+     * @detail set_data(x_buf, t_buf, start, run_size) で start フレーム目から
+     *         run_size フレーム分の入力と期待値を x_buf, t_buf に設定させる
+     */
+    template <typename SetDataFunc>
+    double CalculationLoop(
+                index_t frame_size,
+                index_t max_batch_size,
+                index_t min_batch_size,
+                std::shared_ptr< MetricsFunction > metricsFunc,
+                std::shared_ptr< LossFunction >    lossFunc,
+                std::shared_ptr< Optimizer >       optimizer,
+                bool train,
+                bool print_progress,
+                bool print_progress_loss,
+                bool print_progress_metrics,
+                std::shared_ptr< Model >           net,
+                SetDataFunc                        set_data
+            )
+    {
+        if ( net == nullptr ) {
+            net = m_net;
+        }
+
         if ( metricsFunc != nullptr ) {
             metricsFunc->Clear();
         }
@@ -574,8 +944,6 @@ protected:
             lossFunc->Clear();
         }
         
-        index_t frame_size = (index_t)x.size();
-        
         FrameBuffer x_buf;
         FrameBuffer t_buf;
 
@@ -597,17 +965,12 @@ protected:
                     run_size = m_max_run_size;
                 }
 
-                // 学習データセット
-                x_buf.Resize(run_size, x_shape, DataType<T>::type);
-                x_buf.SetVector(x, index + i);
+                // 学習データと期待値データをセット
+                set_data(x_buf, t_buf, index + i, run_size);
 
                 // Forward
-                auto y_buf = m_net->Forward(x_buf, train);
+                auto y_buf = net->Forward(x_buf, train);
 
-                // 期待値データセット
-                t_buf.Resize(run_size, t_shape, DataType<T>::type);
-                t_buf.SetVector(t, index + i);
-                
                 FrameBuffer dy_buf;
                 if ( lossFunc != nullptr ) {
                     dy_buf = lossFunc->CalculateLoss(y_buf, t_buf, mini_batch_size);
@@ -618,7 +981,7 @@ protected:
                 }
 
                 if ( train && lossFunc != nullptr ) {
-                    auto dx = m_net->Backward(dy_buf);
+                    auto dx = net->Backward(dy_buf);
                 }
 
                 i += run_size;
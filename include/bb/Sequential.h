@@ -10,23 +10,93 @@
 #pragma once
 
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <algorithm>
 
 
 #include "bb/Model.h"
+#include "bb/ThreadPool.h"
 
 
 namespace bb {
 
 
 //! layer class
+//  パイプライン実行
+//  ・pipeline_chunk_size を設定すると、ミニバッチをそのフレーム数毎の
+//    チャンクに分け、レイヤーを区切ったステージ間でウェーブフロント的に
+//    並行実行する(チャンク i がステージ k にいる間にチャンク i+1 が
+//    ステージ k-1 を実行)
+//  ・各ステージは専用スレッドで動作し、ThreadPool のスレッドを等分した
+//    スレッドグループで各レイヤー内の並列処理を行う(ステージスレッドの分は
+//    ワーカーを休ませて、総スレッド数はプールの設定に収める)
+//  ・ステージ間は pipeline_queue_size 個までのキューで受け渡す
+//  ・RealToBinary や ConvolutionIm2Col のようにフレーム数を変えるレイヤーも扱える
+//    (チャンクの出力は全体の出力の連続した範囲になるものとし、チャンク毎の
+//    出力フレーム数の累積和で書き込み位置を決める)
+//  ・学習時は各ステージがチャンク毎の入力を保持し、Backward では逆順の
+//    ステージを末尾のチャンクから流す。レイヤーは直前の Forward の状態しか
+//    持たないので、各ステージは Backward 前にそのチャンクの Forward を
+//    再実行して状態を復元する(最後に流したチャンクは再実行しない)
+//  ・再実行で結果や状態が変わるレイヤー(Dropout 等の確率的なレイヤーや
+//    移動平均を持つ BatchNormalization など、IsForwardReplayable() が false)
+//    を含む場合、学習時は従来通り逐次実行する
 class Sequential : public Model
 {
 protected:
     std::vector< std::shared_ptr<Model> > m_layers;
 
+    index_t     m_pipeline_chunk_size = 0;      // 0 ならパイプライン実行しない
+    int         m_pipeline_stage_size = 0;      // 0 ならスレッド数とレイヤー数から自動
+    int         m_pipeline_queue_size = 2;
+
+    // 学習時のパイプライン Forward の状態(Backward で使う)
+    bool                                    m_pipeline_train = false;
+    index_t                                 m_pipeline_frame_size = 0;
+    index_t                                 m_pipeline_run_chunk_size = 0;
+    std::vector<index_t>                    m_pipeline_y_offsets;   // [chunk] 出力フレーム位置(累積和)
+    std::vector< std::vector<FrameBuffer> > m_pipeline_x_bufs;      // [stage][chunk] ステージ入力
+
 protected:
     Sequential() {}
 
+    /**
+     * @brief  コマンド処理
+     * @detail コマンド処理
+     * @param  args   コマンド
+     */
+    void CommandProc(std::vector<std::string> args)
+    {
+        // パイプライン実行のチャンクサイズ
+        if ( args.size() == 2 && args[0] == "pipeline_chunk_size" )
+        {
+            m_pipeline_chunk_size = (index_t)EvalInt(args[1]);
+        }
+
+        // パイプラインのステージ数
+        if ( args.size() == 2 && args[0] == "pipeline_stage_size" )
+        {
+            m_pipeline_stage_size = (int)EvalInt(args[1]);
+        }
+
+        // ステージ間キューの深さ
+        if ( args.size() == 2 && args[0] == "pipeline_queue_size" )
+        {
+            m_pipeline_queue_size = (int)EvalInt(args[1]);
+        }
+
+        Model::CommandProc(args);
+    }
+
+    // パイプラインのステージ実行中か(ネストした Sequential は逐次実行する)
+    static bool& InPipelineStage(void)
+    {
+        static thread_local bool in_stage = false;
+        return in_stage;
+    }
+
 public:
     /**
      * @brief  デストラクタ(仮想関数)
@@ -51,6 +121,16 @@ public:
         return "Sequential";
     }
 
+    bool IsForwardReplayable(void) const
+    {
+        for (auto const &layer : m_layers) {
+            if ( !layer->IsForwardReplayable() ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     void Add(std::shared_ptr<Model> layer)
     {
         m_layers.push_back(layer);
@@ -72,6 +152,7 @@ public:
      */   
     void SendCommand(std::string command, std::string send_to = "all")
     {
+        Model::SendCommand(command, send_to);
         for (auto layer : m_layers) {
             layer->SendCommand(command, send_to);
         }
@@ -155,20 +236,325 @@ public:
      */
     FrameBuffer Forward(FrameBuffer x, bool train = true)
     {
+        if ( train ) {
+            m_pipeline_train = false;
+            m_pipeline_x_bufs.clear();
+            m_pipeline_y_offsets.clear();
+        }
+
+        if ( m_pipeline_chunk_size > 0 && m_layers.size() > 1
+                && x.GetFrameSize() > m_pipeline_chunk_size && !InPipelineStage()
+                && (!train || IsForwardReplayable()) ) {
+            return ForwardPipeline(x, train);
+        }
+
         for (auto layer : m_layers) {
             x = layer->Forward(x, train);
         }
         return x;
     }
 
+   /**
+     * @brief  推論用forward演算
+     * @detail 各レイヤーの推論用forward演算を順に呼び出す
+     *         コンテキストをスレッド毎に分ければ複数スレッドから同時に呼び出せる
+     * @param  x     入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x, InferenceContext &ctx) const
+    {
+        for (auto const &layer : m_layers) {
+            x = layer->Forward(x, ctx);
+        }
+        return x;
+    }
+
+    /**
+     * @brief  パイプライン設定
+     * @detail パイプライン実行を設定する
+     * @param  chunk_size  チャンクのフレーム数(0で無効)
+     * @param  stage_size  ステージ数(0で自動)
+     * @param  queue_size  ステージ間キューの深さ
+     */
+    void SetPipeline(index_t chunk_size, int stage_size = 0, int queue_size = 2)
+    {
+        m_pipeline_chunk_size = chunk_size;
+        m_pipeline_stage_size = stage_size;
+        m_pipeline_queue_size = queue_size;
+    }
+
+protected:
+    using PipelineItem = std::pair<index_t, FrameBuffer>;     // (チャンク番号, データ)
+
+    // チャンク数に応じたステージ数
+    int GetPipelineStageSize(index_t chunk_count) const
+    {
+        int layer_size = (int)m_layers.size();
+        int stage_size = m_pipeline_stage_size > 0 ? m_pipeline_stage_size : GetThreadSize();
+        stage_size = std::max(1, std::min(stage_size, layer_size));
+        return (int)std::min((index_t)stage_size, chunk_count);
+    }
+
+    // 出力バッファを need_size フレーム以上に拡張(先頭 used_size フレームは引き継ぐ)
+    static void GrowPipelineBuffer(FrameBuffer &buf, index_t used_size, index_t need_size)
+    {
+        if ( need_size <= buf.GetFrameSize() ) {
+            return;
+        }
+
+        FrameBuffer new_buf(std::max(need_size, buf.GetFrameSize() * 2), buf.GetShape(), buf.GetType());
+        if ( used_size > 0 ) {
+            buf.CopyTo(new_buf, used_size, 0, 0);
+        }
+        buf = new_buf;
+    }
+
+    // ステージの担当レイヤー範囲(レイヤー数で均等割り)
+    void GetPipelineStageLayers(int stage, int stage_size, int &layer_begin, int &layer_end) const
+    {
+        int layer_size = (int)m_layers.size();
+        layer_begin = (int)(((std::int64_t)layer_size * stage) / stage_size);
+        layer_end   = (int)(((std::int64_t)layer_size * (stage + 1)) / stage_size);
+    }
+
+    /**
+     * @brief  パイプライン実行
+     * @detail ステージ毎のスレッドでチャンクを順に流す
+     * @param  stage_size   ステージ数
+     * @param  chunk_order  投入するチャンク番号の順序
+     * @param  source       チャンクの入力を返す(先頭ステージで呼ばれる)
+     * @param  proc         ステージの処理(流れる順のステージ位置とアイテム)
+     * @param  sink         最終ステージの出力を受け取る(chunk_order の順に呼ばれる)
+     */
+    template<class SourceFunc, class ProcFunc, class SinkFunc>
+    void RunPipeline(int stage_size, std::vector<index_t> const &chunk_order, SourceFunc source, ProcFunc proc, SinkFunc sink)
+    {
+        // ステージスレッドを増やす分だけプールのワーカーを休ませる
+        ThreadPool::ReserveScope reserve(stage_size - 1);
+        int thread_size = ThreadPool::GetInstance().GetActiveThreadSize();
+
+        std::vector< std::unique_ptr< BoundedQueue<PipelineItem> > > queues;
+        for ( int stage = 0; stage < stage_size; ++stage ) {
+            queues.push_back(std::unique_ptr< BoundedQueue<PipelineItem> >(new BoundedQueue<PipelineItem>(m_pipeline_queue_size)));
+        }
+
+        std::mutex          exception_mutex;
+        std::exception_ptr  exception;
+
+        auto stage_main = [&](int stage) {
+            int group_first = (int)(((std::int64_t)thread_size * stage) / stage_size);
+            int group_end   = (int)(((std::int64_t)thread_size * (stage + 1)) / stage_size);
+
+            ThreadPool::ThreadGroupScope scope(group_first, std::max(1, group_end - group_first));
+            InPipelineStage() = true;
+
+            try {
+                for ( size_t i = 0; ; ++i ) {
+                    // 入力取得
+                    PipelineItem item;
+                    if ( stage == 0 ) {
+                        if ( i >= chunk_order.size() ) {
+                            break;
+                        }
+                        item = PipelineItem(chunk_order[i], source(chunk_order[i]));
+                    }
+                    else {
+                        if ( !queues[stage]->Pop(item) ) {
+                            break;
+                        }
+                    }
+
+                    proc(stage, item);
+
+                    if ( stage + 1 < stage_size ) {
+                        // 出力を内部で使い回すレイヤーもあるので複製して渡す
+                        item.second = item.second.Clone();
+                        if ( !queues[stage + 1]->Push(item) ) {
+                            break;
+                        }
+                    }
+                    else {
+                        sink(item);
+                    }
+                }
+            }
+            catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(exception_mutex);
+                    if ( !exception ) {
+                        exception = std::current_exception();
+                    }
+                }
+                for ( auto &queue : queues ) {
+                    queue->Close();
+                }
+            }
+
+            if ( stage + 1 < stage_size ) {
+                queues[stage + 1]->Close();
+            }
+            InPipelineStage() = false;
+        };
+
+        // ステージ0 は呼び出し元スレッドで実行
+        std::vector<std::thread> threads;
+        for ( int stage = 1; stage < stage_size; ++stage ) {
+            threads.push_back(std::thread(stage_main, stage));
+        }
+        stage_main(0);
+        for ( auto &th : threads ) {
+            th.join();
+        }
+
+        if ( exception ) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    FrameBuffer ForwardPipeline(FrameBuffer x_buf, bool train)
+    {
+        index_t frame_size  = x_buf.GetFrameSize();
+        index_t chunk_size  = m_pipeline_chunk_size;
+        index_t chunk_count = (frame_size + chunk_size - 1) / chunk_size;
+        int     stage_size  = GetPipelineStageSize(chunk_count);
+
+        std::vector<index_t> chunk_order((size_t)chunk_count);
+        for ( index_t chunk = 0; chunk < chunk_count; ++chunk ) {
+            chunk_order[(size_t)chunk] = chunk;
+        }
+
+        // 学習時は Backward での再実行用にステージ入力を保持する
+        if ( train ) {
+            m_pipeline_x_bufs.assign(stage_size, std::vector<FrameBuffer>((size_t)chunk_count));
+        }
+
+        FrameBuffer          y_buf;
+        std::vector<index_t> y_offsets((size_t)chunk_count + 1, 0);
+        RunPipeline(stage_size, chunk_order,
+            [&](index_t chunk) {
+                index_t offset = chunk * chunk_size;
+                return x_buf.FrameRange(std::min(chunk_size, frame_size - offset), offset);
+            },
+            [&](int stage, PipelineItem &item) {
+                if ( train ) {
+                    m_pipeline_x_bufs[stage][(size_t)item.first] = item.second;
+                }
+
+                int layer_begin, layer_end;
+                GetPipelineStageLayers(stage, stage_size, layer_begin, layer_end);
+                for ( int layer = layer_begin; layer < layer_end; ++layer ) {
+                    item.second = m_layers[layer]->Forward(item.second, train);
+                }
+            },
+            [&](PipelineItem const &item) {
+                // 最終ステージは結果を書き込む(チャンクは順に到着する)
+                //  出力フレーム数はレイヤーによって入力と異なるので、チャンク毎の実際の
+                //  出力フレーム数を積算して位置を決める(バッファは先頭チャンクの比率で確保し、
+                //  足りなければ拡張する)
+                auto const &buf    = item.second;
+                auto        chunk  = (size_t)item.first;
+                index_t     offset = y_offsets[chunk];
+                index_t     size   = buf.GetFrameSize();
+                if ( chunk == 0 ) {
+                    index_t in_size = std::min(chunk_size, frame_size);
+                    y_buf = FrameBuffer(std::max((index_t)1, (size * frame_size + in_size - 1) / in_size), buf.GetShape(), buf.GetType());
+                }
+                BB_ASSERT(buf.GetShape() == y_buf.GetShape() && buf.GetType() == y_buf.GetType());
+                GrowPipelineBuffer(y_buf, offset, offset + size);
+                buf.CopyTo(y_buf, size, 0, offset, buf.GetNodeSize());
+                y_offsets[chunk + 1] = offset + size;
+            });
+
+        index_t y_frame_size = y_offsets.back();
+        if ( y_frame_size != y_buf.GetFrameSize() ) {
+            y_buf = y_buf.FrameRange(y_frame_size, 0);
+        }
+
+        if ( train ) {
+            m_pipeline_train          = true;
+            m_pipeline_frame_size     = frame_size;
+            m_pipeline_run_chunk_size = chunk_size;
+            m_pipeline_y_offsets      = y_offsets;
+        }
+
+        return y_buf;
+    }
+
+    FrameBuffer BackwardPipeline(FrameBuffer dy_buf)
+    {
+        BB_ASSERT(dy_buf.GetFrameSize() == m_pipeline_y_offsets.back());
+
+        index_t frame_size  = m_pipeline_frame_size;
+        index_t chunk_size  = m_pipeline_run_chunk_size;
+        int     stage_size  = (int)m_pipeline_x_bufs.size();
+        index_t chunk_count = (index_t)m_pipeline_x_bufs[0].size();
+
+        // レイヤーに状態が残っている末尾のチャンクから流す
+        std::vector<index_t> chunk_order((size_t)chunk_count);
+        for ( index_t i = 0; i < chunk_count; ++i ) {
+            chunk_order[(size_t)i] = chunk_count - 1 - i;
+        }
+
+        FrameBuffer dx_buf;
+        RunPipeline(stage_size, chunk_order,
+            [&](index_t chunk) {
+                // Forward で書き込んだ位置で切り出す
+                index_t offset = m_pipeline_y_offsets[(size_t)chunk];
+                return dy_buf.FrameRange(m_pipeline_y_offsets[(size_t)chunk + 1] - offset, offset);
+            },
+            [&](int pos, PipelineItem &item) {
+                // 後段のステージから逆順に流す
+                int stage = stage_size - 1 - pos;
+                int layer_begin, layer_end;
+                GetPipelineStageLayers(stage, stage_size, layer_begin, layer_end);
+
+                // Forward を再実行してレイヤーの状態をこのチャンクに戻す
+                auto &x_chunk = m_pipeline_x_bufs[stage][(size_t)item.first];
+                if ( item.first != chunk_count - 1 ) {
+                    auto x = x_chunk;
+                    for ( int layer = layer_begin; layer < layer_end; ++layer ) {
+                        x = m_layers[layer]->Forward(x, true);
+                    }
+                }
+                x_chunk = FrameBuffer();
+
+                for ( int layer = layer_end - 1; layer >= layer_begin; --layer ) {
+                    item.second = m_layers[layer]->Backward(item.second);
+                }
+            },
+            [&](PipelineItem const &item) {
+                // 最終ステージは結果を書き込む(チャンクは末尾から到着する)
+                auto const &buf    = item.second;
+                index_t     offset = item.first * chunk_size;
+                if ( item.first == chunk_count - 1 ) {
+                    dx_buf = FrameBuffer(frame_size, buf.GetShape(), buf.GetType());
+                }
+                BB_ASSERT(buf.GetFrameSize() == std::min(chunk_size, frame_size - offset));
+                buf.CopyTo(dx_buf, buf.GetFrameSize(), 0, offset, buf.GetNodeSize());
+            });
+
+        m_pipeline_train = false;
+        m_pipeline_x_bufs.clear();
+        m_pipeline_y_offsets.clear();
+
+        return dx_buf;
+    }
+
+public:
+
    /**
      * @brief  backward演算
      * @detail backward演算を行う
-     *         
+     *         直前の学習時 Forward がパイプライン実行ならパイプラインで逆伝播する
      * @return backward演算結果
      */
     FrameBuffer Backward(FrameBuffer dy)
     {
+        if ( m_pipeline_train ) {
+            return BackwardPipeline(dy);
+        }
+
         for (auto it = m_layers.rbegin(); it != m_layers.rend(); ++it) {
             dy = (*it)->Backward(dy);
         }
@@ -34,7 +34,7 @@ class ShuffleModulation : public Model
 protected:
     bool                    m_host_only = false;
 
-    FrameBuffer             m_y_buf;
+    InferenceContext        m_ctx;      //< 学習時用(出力バッファを使い回す)
 
     Tensor_<std::int32_t>   m_table;
 
@@ -143,23 +143,38 @@ public:
 
     FrameBuffer Forward(FrameBuffer x_buf, bool train = true)
     {
-        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
-        BB_ASSERT(x_buf.GetFrameSize() % (m_shuffle_size * m_lowering_size) == 0);
-
         // SetInputShpaeされていなければ初回に設定
         if (x_buf.GetShape() != m_node_shape) {
             SetInputShape(x_buf.GetShape());
         }
 
+        return Forward(x_buf, m_ctx);
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     *         出力バッファはコンテキスト内で使い回すので次の呼び出しまで有効
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        BB_ASSERT(x_buf.GetType() == DataType<FT>::type);
+        BB_ASSERT(x_buf.GetFrameSize() % (m_shuffle_size * m_lowering_size) == 0);
+        BB_ASSERT(x_buf.GetShape() == m_node_shape);
+
         // 戻り値の型を設定
-        m_y_buf.Resize(x_buf.GetFrameSize(), m_node_shape, DataType<FT>::type);
+        FrameBuffer &y_buf = ctx.GetState<FrameBuffer>(this);
+        y_buf.Resize(x_buf.GetFrameSize(), m_node_shape, DataType<FT>::type);
 
 #ifdef BB_WITH_CUDA
         if ( false && DataType<FT>::type == BB_TYPE_BIT && !m_host_only
-                && x_buf.IsDeviceAvailable() && m_y_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
+                && x_buf.IsDeviceAvailable() && y_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
             // GPU版
             auto x_ptr     = x_buf.LockDeviceMemoryConst();
-            auto y_ptr     = m_y_buf.LockDeviceMemory(true);
+            auto y_ptr     = y_buf.LockDeviceMemory(true);
             auto table_ptr = m_table.LockDeviceMemoryConst();
 
             bbcu_bit_ShuffleModulation_Forward
@@ -174,7 +189,7 @@ public:
                     (int        )(x_buf.GetFrameStride() / sizeof(int))
                 );
 
-            return m_y_buf;
+            return y_buf;
         }
 #endif
 
@@ -187,7 +202,7 @@ public:
             int lowering_size = (int)m_lowering_size;
 
             auto x_ptr     = x_buf.LockMemoryConst();
-            auto y_ptr     = m_y_buf.LockMemory();
+            auto y_ptr     = y_buf.LockMemory();
             auto table_ptr = m_table.LockMemoryConst();
 
             auto x_addr     = (int const *)x_ptr.GetAddr();
@@ -195,7 +210,7 @@ public:
             auto table_addr = (int const *)table_ptr.GetAddr();
 
             for ( int node = 0; node < node_size; ++node) {
-                for ( int f = 0; f < frame_size/32; ++f ) {
+                for ( int f = 0; f < (frame_size + 31) / 32; ++f ) {
                     int y = 0;
                     for ( int bit = 0; bit < 32; ++bit ) {
                         int frame = f*32 + bit;
@@ -213,7 +228,7 @@ public:
                     y_addr[node*frame_stride + f] = y;
                 }
             }
-            return m_y_buf;
+            return y_buf;
         }
 
 
@@ -223,14 +238,14 @@ public:
             index_t frame_size = x_buf.GetFrameSize();
 
             auto x_ptr = x_buf.LockConst<FT>();
-            auto y_ptr = m_y_buf.Lock<FT>();
+            auto y_ptr = y_buf.Lock<FT>();
 
 //          std::vector<int> table(m_shuffle_size);
 //          for ( int i = 0; i < (int)m_shuffle_size; ++i ) {
 //              table[i] = i;
 //          }
 
-            auto table_ptr = m_table.Lock(true);
+            auto table_ptr = m_table.LockConst();
             for ( index_t node = 0; node < node_size; ++node) {
                 for ( index_t frame = 0; frame < frame_size; frame += (m_shuffle_size * m_lowering_size)) {
                     for ( index_t i = 0; i < m_shuffle_size; ++i ) {
@@ -244,7 +259,7 @@ public:
                 }
             }
 
-            return m_y_buf;
+            return y_buf;
         }
     }
 
@@ -10,10 +10,11 @@
 #pragma once
 
 #include <vector>
-#include <list>
 #include <random>
 #include <algorithm>
 
+#include "bb/Assert.h"
+
 
 namespace bb {
 
@@ -21,6 +22,10 @@ namespace bb {
 // なるべく重複しないようにランダムにインデックスをシャッフルする
 // トランプのカードを配るイメージで、手持ちが無くなれば再充填することで、
 // 特定の値がずっと出なかったり、同じものが出続けることを防止する
+//
+// 配列1本で管理し、[0, m_head) が配布済み、[m_head, size) が手持ち
+// 取り出しは手持ちからランダムに1枚選んで先頭と交換する(逐次的な Fisher-Yates)ので O(1)
+// 手持ちが無くなれば、取り出し中のセットを先頭に寄せ、残りの配布済みを手持ちに戻す
 
 // シャッフルクラス
 template <typename INDEX>
@@ -28,8 +33,8 @@ class ShuffleSet
 {
 protected:
     std::mt19937_64     m_mt;
-    std::list<INDEX>    m_heap;
-    std::list<INDEX>    m_reserve;
+    std::vector<INDEX>  m_deck;
+    INDEX               m_head = 0;
 
 public:
     ShuffleSet()
@@ -45,59 +50,57 @@ public:
     {
         // 初期化
         m_mt.seed(seed);
-        m_heap.clear();
-        m_reserve.clear();
-
-        // シャッフル
-        std::vector<INDEX> heap(size);
+        m_deck.resize((size_t)size);
         for (INDEX i = 0; i < size; i++) {
-            heap[i] = i;
+            m_deck[(size_t)i] = i;
         }
-        std::shuffle(heap.begin(), heap.end(), m_mt);
-
-        // 設定
-        m_heap.assign(heap.begin(), heap.end());
+        m_head = 0;
     }
-    
-    std::vector<INDEX> GetRandomSet(INDEX n)
+
+    INDEX GetSize(void) const { return (INDEX)m_deck.size(); }
+
+    /**
+     * @brief  ランダムなセットの取り出し
+     * @detail n 個を重複なく取り出す(n がサイズを超える場合のみ重複する)
+     * @param  n    個数
+     * @param  set  出力先(n 個)
+     */
+    void GetRandomSet(INDEX n, INDEX *set)
     {
-        std::vector<INDEX>  set;
-        std::vector<INDEX>  stash;
+        INDEX size = (INDEX)m_deck.size();
+        BB_ASSERT(size > 0 || n == 0);
 
-        // 指定個数取り出す
+        INDEX set_begin = m_head;     // 今回取り出した分は [set_begin, m_head)
         for (INDEX i = 0; i < n; i++) {
-            if (m_heap.empty()) {
-                // 一通り割り当てたら利用済みを再利用
-                std::vector<INDEX> heap(m_reserve.size());
-                heap.assign(m_reserve.begin(), m_reserve.end());
-                std::shuffle(heap.begin(), heap.end(), m_mt);
-                m_heap.assign(heap.begin(), heap.end());
-                m_reserve.clear();
+            if (m_head >= size) {
+                INDEX k = m_head - set_begin;
+                if (k < size) {
+                    // 今回取り出し中のものを先頭に寄せて、それ以外を手持ちに戻す
+                    std::rotate(m_deck.begin(), m_deck.begin() + (size_t)set_begin, m_deck.end());
+                    m_head = k;
+                }
+                else {
+                    // 手持ちで不足する場合は今回分から回す
+                    m_head = 0;
+                }
+                set_begin = 0;
             }
-            
-            // reserveで不足する場合は stash から回す
-            if (m_heap.empty()) {
-                std::vector<INDEX> heap(stash.size());
-                heap.assign(stash.begin(), stash.end());
-                std::shuffle(heap.begin(), heap.end(), m_mt);
-                m_heap.assign(heap.begin(), heap.end());
-                stash.clear();
-            }
-
-            // 先頭から取り出す
-            auto item = m_heap.front();
-            set.push_back(item);
 
-            // 使ったものはstashに移す
-            m_heap.pop_front();
-            stash.push_back(item);
+            // 手持ちからランダムに選ぶ
+            std::uniform_int_distribution<INDEX> dist(m_head, size - 1);
+            INDEX j = dist(m_mt);
+            std::swap(m_deck[(size_t)m_head], m_deck[(size_t)j]);
+            set[i] = m_deck[(size_t)m_head];
+            ++m_head;
         }
+    }
 
-        // stashに残っているものはリザーブに回す
-        for (auto item : stash) {
-            m_reserve.push_back(item);
+    std::vector<INDEX> GetRandomSet(INDEX n)
+    {
+        std::vector<INDEX> set((size_t)n);
+        if ( n > 0 ) {
+            GetRandomSet(n, &set[0]);
         }
-
         return set;
     }
 };
@@ -71,6 +71,8 @@ public:
 
     std::string GetClassName(void) const { return "Sigmoid"; }
 
+    bool IsBinaryMode(void) const { return DataType<BinType>::type == BB_TYPE_BIT || m_binary_mode; }
+
 
     /**
      * @brief  入力形状設定
@@ -114,16 +116,35 @@ public:
             return _super::Forward(x_buf, train);
         }
 
-        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
-
-        // 戻り値のサイズ設定
-        FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), x_buf.GetType());
+        InferenceContext ctx;
+        auto y_buf = Forward(x_buf, ctx);
 
         // ローカルに保存
         if ( train ) {
             m_y_buf = y_buf;
         }
 
+        return y_buf;
+    }
+
+    /**
+     * @brief  推論用forward演算
+     * @detail モデルを変更せずにforward演算を行う
+     * @param  x_buf 入力データ
+     * @param  ctx   推論コンテキスト
+     * @return forward演算結果
+     */
+    inline FrameBuffer Forward(FrameBuffer x_buf, InferenceContext &ctx) const
+    {
+        // binaryモード
+        if ( DataType<BinType>::type == BB_TYPE_BIT || m_binary_mode) {
+            return _super::Forward(x_buf, ctx);
+        }
+
+        BB_ASSERT(x_buf.GetType() == DataType<RealType>::type);
+
+        // 戻り値のサイズ設定
+        FrameBuffer y_buf(x_buf.GetFrameSize(), x_buf.GetShape(), x_buf.GetType());
 
 #ifdef BB_WITH_CUDA
         if ( DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && !this->m_host_only
@@ -150,13 +171,12 @@ public:
             auto y_ptr = y_buf.template Lock<BinType>();
 
             // Sigmoid
-    #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     RealType sig = x_ptr.Get(frame, node);
                     y_ptr.Set(frame, node, (BinType)((RealType)1 / ((RealType)1 + std::exp(-sig))));
                 }
-            }
+            });
             return y_buf;
         }
     }
@@ -210,14 +230,13 @@ public:
             auto dx_ptr = dx_buf.template Lock<RealType>();
 
             // Sigmoid
-    #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 for (index_t frame = 0; frame < frame_size; ++frame) {
                     auto sig  = y_ptr.Get(frame, node);
                     auto grad = dy_ptr.Get(frame, node);
                     dx_ptr.Set(frame, node, grad * (-sig + (RealType)1) * sig);
                 }
-            }
+            });
             return dx_buf;
         }
     }
@@ -10,6 +10,15 @@
 #pragma once
 
 #include <assert.h>
+#include <stdlib.h>
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <initializer_list>
 
 
 #ifdef _MSC_VER
@@ -19,9 +28,277 @@
 #endif
 
 
+// 関数単位での命令セット指定(実行時に CPU を判定して呼び分ける関数用)
+// MSVC は指定なしで全ての intrinsic が使えるので空にする
+#if defined(__GNUC__) || defined(__clang__)
+#define BB_TARGET_AVX2      __attribute__((target("avx2,fma")))
+#define BB_TARGET_AVX512    __attribute__((target("avx2,fma,avx512f,avx512bw")))
+#define BB_TARGET_AVX2_POPCNT   __attribute__((target("avx2,fma,popcnt")))
+#define BB_TARGET_AVX2_F16C     __attribute__((target("avx2,fma,f16c")))
+#else
+#define BB_TARGET_AVX2
+#define BB_TARGET_AVX512
+#define BB_TARGET_AVX2_POPCNT
+#define BB_TARGET_AVX2_F16C
+#endif
+
 
 namespace bb {
 
+
+// CPU の対応命令
+struct SimdFeatures
+{
+    bool    sse41    = false;
+    bool    avx      = false;
+    bool    avx2     = false;
+    bool    fma      = false;
+    bool    f16c     = false;
+    bool    avx512f  = false;
+    bool    avx512bw = false;
+};
+
+inline SimdFeatures DetectSimdFeatures(void)
+{
+    SimdFeatures f;
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    f.sse41    = __builtin_cpu_supports("sse4.1") != 0;
+    f.avx      = __builtin_cpu_supports("avx") != 0;
+    f.avx2     = __builtin_cpu_supports("avx2") != 0;
+    f.fma      = __builtin_cpu_supports("fma") != 0;
+    f.f16c     = __builtin_cpu_supports("f16c") != 0;
+    f.avx512f  = __builtin_cpu_supports("avx512f") != 0;
+    f.avx512bw = __builtin_cpu_supports("avx512bw") != 0;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_id = info[0];
+    __cpuid(info, 1);
+    f.sse41 = (info[2] & (1 << 19)) != 0;
+    f.fma   = (info[2] & (1 << 12)) != 0;
+    f.f16c  = (info[2] & (1 << 29)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool os_avx    = (xcr0 & 0x06) == 0x06;   // XMM/YMM
+    bool os_avx512 = (xcr0 & 0xe6) == 0xe6;   // XMM/YMM/opmask/ZMM
+    f.avx = os_avx && (info[2] & (1 << 28)) != 0;
+    f.fma = f.fma && os_avx;
+    f.f16c = f.f16c && os_avx;
+    if ( max_id >= 7 ) {
+        __cpuidex(info, 7, 0);
+        f.avx2     = os_avx    && (info[1] & (1 << 5))  != 0;
+        f.avx512f  = os_avx512 && (info[1] & (1 << 16)) != 0;
+        f.avx512bw = os_avx512 && (info[1] & (1 << 30)) != 0;
+    }
+#endif
+    return f;
+}
+
+inline SimdFeatures const &GetSimdFeatures(void)
+{
+    static SimdFeatures features = DetectSimdFeatures();
+    return features;
+}
+
+
+// 命令セットの段階
+enum class SimdLevel : int
+{
+    None   = 0,     // 汎用(C++)版
+    SSE41  = 1,
+    AVX2   = 2,     // AVX2 + FMA
+    AVX512 = 3,     // AVX-512F + BW
+};
+
+inline char const *SimdLevelToString(SimdLevel level)
+{
+    switch ( level ) {
+    case SimdLevel::SSE41:  return "sse4.1";
+    case SimdLevel::AVX2:   return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    default:                return "none";
+    }
+}
+
+inline SimdLevel SimdLevelFromString(std::string str)
+{
+    if ( str == "avx512" )                  { return SimdLevel::AVX512; }
+    if ( str == "avx2" )                    { return SimdLevel::AVX2; }
+    if ( str == "sse4" || str == "sse4.1" ) { return SimdLevel::SSE41; }
+    return SimdLevel::None;
+}
+
+
+// [SimdKernel クラス]
+//  ・SIMD 実装を持つカーネル毎のディスパッチ情報
+//  ・実装済みの命令セットのうち、CPU と上限設定が許す最も広いものを選ぶ
+//  ・生成したカーネルは一覧に登録され、選択結果を GetSimdInfoString() で表示できる
+//
+//  呼び出し側では関数内 static として置き、Select() の結果で実装を呼び分ける
+//  (AVX2 以上の実装は BB_TARGET_AVX2 などを付けた関数/ラムダに置く)
+
+class SimdKernel
+{
+protected:
+    std::string         m_name;
+    unsigned            m_levels;       // 実装済み命令セットのビット集合
+    std::atomic<int>    m_selected;
+
+    // 上限設定(-1 は未設定)
+    static std::atomic<int>& LimitLevel(void)
+    {
+        static std::atomic<int> limit(-1);
+        return limit;
+    }
+
+    struct Registry
+    {
+        std::mutex                  mutex;
+        std::vector<SimdKernel *>   kernels;
+    };
+
+    static Registry& GetRegistry(void)
+    {
+        static Registry registry;
+        return registry;
+    }
+
+public:
+    SimdKernel(std::string name, std::initializer_list<SimdLevel> levels) : m_name(name), m_levels(1), m_selected(-1)
+    {
+        for ( auto level : levels ) {
+            m_levels |= (1u << (int)level);
+        }
+        auto &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.kernels.push_back(this);
+    }
+
+    ~SimdKernel()
+    {
+        auto &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for ( auto it = registry.kernels.begin(); it != registry.kernels.end(); ++it ) {
+            if ( *it == this ) {
+                registry.kernels.erase(it);
+                break;
+            }
+        }
+    }
+
+    SimdKernel(SimdKernel const &) = delete;
+    SimdKernel& operator=(SimdKernel const &) = delete;
+
+    /**
+     * @brief  CPU が対応する最大の命令セット
+     * @return 命令セット
+     */
+    static SimdLevel GetCpuLevel(void)
+    {
+        auto const &f = GetSimdFeatures();
+        if ( f.avx512f && f.avx512bw && f.avx2 && f.fma ) { return SimdLevel::AVX512; }
+        if ( f.avx2 && f.fma )                           { return SimdLevel::AVX2; }
+        if ( f.sse41 )                                   { return SimdLevel::SSE41; }
+        return SimdLevel::None;
+    }
+
+    /**
+     * @brief  使用する命令セットの上限設定
+     * @detail 環境変数 BB_SIMD (none/sse4/avx2/avx512) でも設定できる
+     * @param  level 上限
+     */
+    static void SetLimit(SimdLevel level)
+    {
+        LimitLevel() = (int)level;
+    }
+
+    /**
+     * @brief  使用可能な命令セット
+     * @detail CPU の対応と上限設定の小さい方
+     * @return 命令セット
+     */
+    static SimdLevel GetLevel(void)
+    {
+        int limit = LimitLevel();
+        if ( limit < 0 ) {
+            char const *env = getenv("BB_SIMD");
+            limit = (env != nullptr && env[0] != '\0') ? (int)SimdLevelFromString(env) : (int)SimdLevel::AVX512;
+            LimitLevel() = limit;
+        }
+        return (SimdLevel)std::min((int)GetCpuLevel(), limit);
+    }
+
+    /**
+     * @brief  実装の選択
+     * @detail 実装済みの中から使用可能な最も広い命令セットを選ぶ
+     * @return 選択した命令セット
+     */
+    SimdLevel Select(void)
+    {
+        int level = (int)GetLevel();
+        while ( level > 0 && (m_levels & (1u << level)) == 0 ) {
+            --level;
+        }
+        m_selected.store(level, std::memory_order_relaxed);
+        return (SimdLevel)level;
+    }
+
+    std::string GetName(void) const { return m_name; }
+
+    /**
+     * @brief  状態表示用文字列取得
+     * @detail CPU の対応命令と、実行済みカーネルの選択結果
+     * @return 状態を示す文字列
+     */
+    static std::string GetInfoString(void)
+    {
+        auto const &f = GetSimdFeatures();
+        std::stringstream ss;
+        ss << "simd            : " << SimdLevelToString(GetLevel())
+           << " (cpu:" << (f.sse41 ? " sse4.1" : "") << (f.avx ? " avx" : "") << (f.avx2 ? " avx2" : "")
+           << (f.fma ? " fma" : "") << (f.f16c ? " f16c" : "") << (f.avx512f ? " avx512f" : "") << (f.avx512bw ? " avx512bw" : "") << ")" << std::endl;
+
+        auto &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::vector<std::string> lines;
+        for ( auto kernel : registry.kernels ) {
+            int selected = kernel->m_selected.load();
+            if ( selected < 0 ) {
+                continue;
+            }
+            std::string line = "  " + kernel->m_name + " : " + SimdLevelToString((SimdLevel)selected);
+            if ( std::find(lines.begin(), lines.end(), line) == lines.end() ) {
+                lines.push_back(line);
+            }
+        }
+        for ( auto const &line : lines ) {
+            ss << line << std::endl;
+        }
+        return ss.str();
+    }
+};
+
+inline std::string GetSimdInfoString(void)
+{
+    return SimdKernel::GetInfoString();
+}
+
+
+// 64bit 中の1の数 (BB_TARGET_AVX2_POPCNT の関数内に展開されれば popcnt 命令になる)
+inline int bb_popcount64(std::uint64_t x)
+{
+#ifdef _MSC_VER
+    return (int)__popcnt64(x);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+
+// 以下の AVX2 用ヘルパーは BB_TARGET_AVX2 の関数(ラムダ)からのみ呼ぶこと
+
+BB_TARGET_AVX2
 inline float bb_mm256_cvtss_f32(__m256 a)
 {
 #ifdef _MSC_VER
@@ -32,65 +309,45 @@ inline float bb_mm256_cvtss_f32(__m256 a)
 #endif
 }
 
+BB_TARGET_AVX2
 inline __m256 bb_mm256_fmadd_ps(__m256 a, __m256 b, __m256 c)
 {
-#ifdef __AVX2__
     return _mm256_fmadd_ps(a, b, c);
-#else
-    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256 bb_mm256_fmsub_ps(__m256 a, __m256 b, __m256 c)
 {
-#ifdef __AVX2__
     return _mm256_fmsub_ps(a, b, c);
-#else
-    return _mm256_sub_ps(_mm256_mul_ps(a, b), c);
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256 bb_mm256_fnmadd_ps(__m256 a, __m256 b, __m256 c)
 {
-#ifdef __AVX2__
     return _mm256_fnmadd_ps(a, b, c);
-#else
-    return _mm256_sub_ps(c, _mm256_mul_ps(a, b));
-#endif
 }
 
 
+BB_TARGET_AVX2
 inline __m256i bb_mm256_andnot_si256(__m256i a, __m256i b)
 {
-#ifdef __AVX2__
     return _mm256_andnot_si256(a, b);
-#else
-    __m256 res = _mm256_andnot_ps(*(__m256 *)&a, *(__m256 *)&b);
-    return *(__m256i *)&res;
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256i bb_mm256_and_si256(__m256i a, __m256i b)
 {
-#ifdef __AVX2__
     return _mm256_and_si256(a, b);
-#else
-    __m256 res = _mm256_and_ps(*(__m256 *)&a, *(__m256 *)&b);
-    return *(__m256i *)&res;
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256i bb_mm256_or_si256(__m256i a, __m256i b)
 {
-#ifdef __AVX2__
     return _mm256_or_si256(a, b);
-#else
-    __m256 res = _mm256_or_ps(*(__m256 *)&a, *(__m256 *)&b);
-    return *(__m256i *)&res;
-#endif
 }
 
 // horizontal sum
+BB_TARGET_AVX2
 inline __m256 bb_mm256_hsum_ps(__m256 r)
 {
     r = _mm256_hadd_ps(r, r);
@@ -103,21 +360,4 @@ inline __m256 bb_mm256_hsum_ps(__m256 r)
 }
 
 
-#ifndef __AVX2__
-#define _mm256_andnot_si256     bb_mm256_andnot_si256
-#define _mm256_and_si256        bb_mm256_and_si256
-#define _mm256_or_si256         bb_mm256_or_si256
-#define _mm256_fmadd_ps         bb_mm256_fmadd_ps
-#define _mm256_fmsub_ps         bb_mm256_fmsub_ps
-#define _mm256_fnmadd_ps        bb_mm256_fnmadd_ps
-#endif
-
-
-#if !defined(__AVX__) && !defined(__AVX2__)
-// #error AVX is not supported 
-#endif
-
-#if defined(__AVX__) && !defined(__AVX2__)
-// #warning AVX2 is not supported (use AVX instruction only)
-#endif
-
+// end of file
@@ -471,8 +471,7 @@ public:
             auto input_index_ptr = m_input_index.LockConst();
             auto W_ptr           = lock_W_const();
 
-            #pragma omp parallel for
-            for ( index_t node = 0; node < node_size; ++node ) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 RealType W[NN];
                 for ( int i = 0; i < NN; ++i) {
                     W[i] = W_ptr(node, i);
@@ -506,7 +505,7 @@ public:
 
                     y_ptr.Set(frame, node, y);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -0,0 +1,158 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "bb/DataType.h"
+#include "bb/Tensor.h"
+
+
+namespace bb {
+
+
+/**
+ * @brief  疎な勾配の追跡
+ * @detail 勾配Tensorを (ブロック, 行) の2次元とみなし、バッチ中に
+ *         無視できない勾配を受け取った行だけを記録する。
+ *         LUTであればブロックがノード、行がテーブルのエントリに相当する。
+ *         レイヤーは GetGradients で勾配Tensorと組にして Variables に載せ、
+ *         Optimizer は有効なものについて記録された行だけを遅延更新する。
+ *         AccumulateBlock はブロック内最大絶対値の threshold 倍以下の勾配を
+ *         加算せずに捨てる近似であり、触れた行をすべて追跡するわけではない
+ *         (threshold = 0 なら非ゼロの勾配はすべて記録される)。
+ */
+class SparseGradient
+{
+protected:
+    bool                                m_enable     = false;   //< 疎勾配モード
+    index_t                             m_block_size = 0;       //< ブロック数
+    index_t                             m_row_size   = 0;       //< ブロックあたりの行数
+    std::vector<std::uint8_t>           m_flags;                //< 記録済みフラグ
+    std::vector< std::vector<index_t> > m_touched;              //< ブロック毎の記録済み行
+
+public:
+    /**
+     * @brief  有効/無効設定
+     * @detail 無効の間は Optimizer は対応する勾配を密に更新する
+     */
+    void SetEnable(bool enable)
+    {
+        if ( !enable ) {
+            Clear();
+        }
+        m_enable = enable;
+    }
+
+    bool IsEnabled(void) const { return m_enable; }
+
+    /**
+     * @brief  サイズ設定
+     * @detail サイズが変わった場合のみ記録を破棄して作り直す
+     * @param  block_size ブロック数
+     * @param  row_size   ブロックあたりの行数
+     */
+    void Resize(index_t block_size, index_t row_size)
+    {
+        if ( block_size == m_block_size && row_size == m_row_size ) {
+            return;
+        }
+
+        m_block_size = block_size;
+        m_row_size   = row_size;
+        m_flags.assign((size_t)(block_size * row_size), 0);
+        m_touched.assign((size_t)block_size, std::vector<index_t>());
+    }
+
+    index_t GetBlockSize(void) const { return m_block_size; }
+    index_t GetRowSize(void)   const { return m_row_size; }
+
+    /**
+     * @brief  行の記録
+     * @detail 同一ブロックを複数スレッドから同時に触らない限りスレッドセーフ
+     */
+    void Touch(index_t block, index_t row)
+    {
+        BB_DEBUG_ASSERT(block >= 0 && block < m_block_size);
+        BB_DEBUG_ASSERT(row >= 0 && row < m_row_size);
+
+        auto &flag = m_flags[(size_t)(block * m_row_size + row)];
+        if ( !flag ) {
+            flag = 1;
+            m_touched[(size_t)block].push_back(row);
+        }
+    }
+
+    /**
+     * @brief  ブロック単位の勾配加算
+     * @detail ブロック内の最大絶対値に対して threshold 倍を超える勾配だけを
+     *         dst に加算して記録する。それ以外は無視できるものとして捨てる。
+     * @param  block     ブロック番号
+     * @param  grad      ブロック内の勾配(row_size個)
+     * @param  dst       加算先(row_size個の連続領域)
+     * @param  threshold 最大値に対する相対閾値
+     */
+    template<typename T>
+    void AccumulateBlock(index_t block, T const *grad, T *dst, T threshold)
+    {
+        T max_abs = 0;
+        for ( index_t row = 0; row < m_row_size; ++row ) {
+            max_abs = std::max(max_abs, (T)std::abs(grad[row]));
+        }
+
+        T th = max_abs * threshold;
+        for ( index_t row = 0; row < m_row_size; ++row ) {
+            if ( std::abs(grad[row]) > th ) {
+                dst[row] += grad[row];
+                Touch(block, row);
+            }
+        }
+    }
+
+    std::vector<index_t> const &GetTouched(index_t block) const
+    {
+        BB_DEBUG_ASSERT(block >= 0 && block < m_block_size);
+        return m_touched[(size_t)block];
+    }
+
+    index_t GetTouchedSize(void) const
+    {
+        index_t size = 0;
+        for ( auto const &t : m_touched ) {
+            size += (index_t)t.size();
+        }
+        return size;
+    }
+
+    /**
+     * @brief  記録のクリア
+     * @detail 記録済みの行だけを戻すのでコストは記録数に比例する
+     */
+    void Clear(void)
+    {
+        for ( index_t block = 0; block < m_block_size; ++block ) {
+            auto &touched = m_touched[(size_t)block];
+            for ( auto row : touched ) {
+                m_flags[(size_t)(block * m_row_size + row)] = 0;
+            }
+            touched.clear();
+        }
+    }
+};
+
+
+}
+
+
+// end of file
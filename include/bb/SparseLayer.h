@@ -13,7 +13,7 @@
 #include <algorithm>
 
 #include "bb/Model.h"
-#include "bb/ShuffleSet.h"
+#include "bb/ConnectionTable.h"
 #include "bb/Utility.h"
 
 
@@ -54,144 +54,51 @@ public:
         index_t input_node = GetNodeConnectionIndex(GetShapeIndex(output_indices, this->GetOutputShape()), connection);
         return GetShapeIndices(input_node, this->GetInputShape());
     }
+
+    /**
+     * @brief  出力ノードの並べ替え
+     * @detail 新しいノード i に元のノード order[i] の接続とパラメータを移す
+     *         後段の入力接続の付け替えは呼び出し側で行う(ReorderNodes 参照)
+     *         学習中の Optimizer の内部状態は並べ替えないので学習前か学習後に使うこと
+     * @param  order  並び順
+     * @return 対応していれば true
+     */
+    virtual bool PermuteNodes(std::vector<index_t> const &/*order*/)
+    {
+        return false;
+    }
     
 
 protected:
 
-    void InitializeNodeInput(std::uint64_t seed, std::string connection = "")
+    /**
+     * @brief  接続の一括設定
+     * @detail 出力ノード node の i 番目の接続を table[offset[node] + i] に設定する
+     *         派生クラスでまとめて書き込めるならオーバーライドする
+     */
+    virtual void SetNodeConnectionTable(std::vector<index_t> const &table, std::vector<index_t> const &offset)
     {
-        auto input_shape  = this->GetInputShape();
-        auto output_shape = this->GetOutputShape();
-
-        auto input_node_size  = GetShapeSize(input_shape);
-        auto output_node_size = GetShapeSize(output_shape);
-
-        auto argv = SplitString(connection);
-
-        if (argv.size() > 0 && argv[0] == "pointwise") {
-            BB_ASSERT(input_shape.size() == 3);
-            BB_ASSERT(output_shape.size() == 3);
-            BB_ASSERT(input_shape[0] == output_shape[0]);
-            BB_ASSERT(input_shape[1] == output_shape[1]);
-            std::mt19937_64 mt(seed);
-            for (index_t y = 0; y < output_shape[1]; ++y) {
-                for (index_t x = 0; x < output_shape[0]; ++x) {
-                    // 接続先をシャッフル
-                    ShuffleSet<index_t> ss(input_shape[2], mt());
-                    for (index_t c = 0; c < output_shape[2]; ++c) {
-                        // 入力をランダム接続
-                        index_t  connection_size = GetConnectionSize({x, y, c});
-                        auto random_set = ss.GetRandomSet(connection_size);
-                        for (index_t i = 0; i < connection_size; ++i) {
-                            SetConnectionIndices({x, y, c}, i, {x, y, random_set[i]});
-                        }
-                    }
-                }
+        index_t output_node_size = (index_t)offset.size() - 1;
+        for ( index_t node = 0; node < output_node_size; ++node ) {
+            for ( index_t i = offset[node]; i < offset[node + 1]; ++i ) {
+                SetNodeConnectionIndex(node, i - offset[node], table[(size_t)i]);
             }
-            return;
-        }
-
-        if (argv.size() > 0 && argv[0] == "depthwise") {
-            BB_ASSERT(input_shape.size() == 3);
-            BB_ASSERT(output_shape.size() == 3);
-            BB_ASSERT(input_shape[2] == output_shape[2]);
-            std::mt19937_64 mt(seed);
-            for (index_t c = 0; c < output_shape[2]; ++c) {
-                // 接続先をシャッフル
-                ShuffleSet<index_t> ss(input_shape[0] * input_shape[1], mt());
-                for (index_t y = 0; y < output_shape[1]; ++y) {
-                    for (index_t x = 0; x < output_shape[0]; ++x) {
-                        // 入力をランダム接続
-                        index_t  connection_size = GetConnectionSize({x, y, c});
-                        auto random_set = ss.GetRandomSet(connection_size);
-                        for (index_t i = 0; i < connection_size; ++i) {
-                            index_t iy = random_set[i] / input_shape[0];
-                            index_t ix = random_set[i] % input_shape[0];
-
-                            index_t output_node = GetShapeIndex({x, y, c}, output_shape);
-                            index_t input_node  = GetShapeIndex({ix, iy, c}, input_shape);
-
-                            BB_ASSERT(output_node >= 0 && output_node < output_node_size);
-                            BB_ASSERT(input_node  >= 0 && input_node  < input_node_size);
-                            SetNodeConnectionIndex(output_node, i, input_node);
-                        }
-                    }
-                }
-            }
-            return;
-        }
-
-        if ( argv.size() > 0 && argv[0] == "gauss" ) {
-            // ガウス分布で結線
-            int n = (int)input_shape.size();
-            std::vector<double> step(n);
-            std::vector<double> sigma(n);
-            for (int i = 0; i < n; ++i) {
-                step[i]  = (double)(input_shape[i] - 1) / (double)(output_shape[i] - 1);
-                sigma[i] = (double)input_shape[i] / (double)output_shape[i];
-            }
-
-            std::mt19937_64                     mt(seed);
-            std::normal_distribution<double>    norm_dist(0.0, 1.0);
-            indices_t           output_index(n, 0);
-            do {
-                // 入力の参照基準位置算出
-                std::vector<double> input_offset(n);
-                for (int i = 0; i < n; ++i) {
-                    input_offset[i] = output_index[i] * step[i];
-                }
-
-                auto output_node = GetShapeIndex(output_index, output_shape);
-                auto m = GetNodeConnectionSize(output_node);
-                std::set<index_t>   s;
-                std::vector<double> input_position(n);
-                for ( int i = 0; i < m; ++i ) {
-                    for ( ; ; ) {
-                        for ( int j = 0; j < n; ++j ) {
-                            input_position[j] = input_offset[j] + norm_dist(mt) * sigma[j];
-                        }
-                        auto input_index = RegurerlizeIndices(input_position, input_shape);
-                        auto input_node  = GetShapeIndex(input_index, input_shape);
-                        if ( s.count(input_node) == 0 ){
-                            SetNodeConnectionIndex(output_node, i, input_node);
-                            s.insert(input_node);
-                            break;
-                        }
-                    }
-                }
-            } while ( GetNextIndices(output_index, output_shape) );
-            return;
         }
+    }
 
-        if ( argv.size() > 0 && argv[0] == "serial" ) {
-            // 連番結線
-            index_t input_node = 0;
-            for ( index_t output_node = 0; output_node < output_node_size; ++output_node ) {
-                index_t m = GetNodeConnectionSize(output_node);
-                for ( index_t i = 0; i < m; ++i ) {
-                    SetNodeConnectionIndex(output_node, i, input_node % input_node_size);
-                    ++input_node;
-                }
-            }
-            return;
-        }
+    void InitializeNodeInput(std::uint64_t seed, std::string connection = "")
+    {
+        auto output_node_size = GetShapeSize(this->GetOutputShape());
 
-        if ( argv.size() == 0 || argv[0] == "random" ) {
-            // ランダム結線
-            ShuffleSet<index_t> ss(input_node_size, seed);    // 接続先をシャッフル
-            for (index_t node = 0; node < output_node_size; ++node) {
-                // 入力をランダム接続
-                index_t  connection_size = GetNodeConnectionSize(node);
-                auto random_set = ss.GetRandomSet(connection_size);
-                for (index_t i = 0; i < connection_size; ++i) {
-                    SetNodeConnectionIndex(node, i, random_set[i]);
-                }
-            }
-            return;
+        std::vector<index_t> offset(output_node_size + 1);
+        offset[0] = 0;
+        for ( index_t node = 0; node < output_node_size; ++node ) {
+            offset[node + 1] = offset[node] + GetNodeConnectionSize(node);
         }
 
-        std::cout << "unknown connection rule : \"" << argv[0] <<  "\"" << std::endl;
-        BB_ASSERT(0);
+        std::vector<index_t> table;
+        ConnectionTable_MakeTable(table, offset, this->GetInputShape(), this->GetOutputShape(), seed, connection);
+        SetNodeConnectionTable(table, offset);
     }
 };
 
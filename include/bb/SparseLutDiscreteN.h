@@ -214,6 +214,13 @@ public:
         return m_lut->GetNodeConnectionIndex(node, input_index);
     }
 
+    bool PermuteNodes(std::vector<index_t> const &order)
+    {
+        m_lut->PermuteNodes(order);
+        m_batch_norm->PermuteNodes(order);
+        return true;
+    }
+
     std::vector<double> ForwardNode(index_t node, std::vector<double> x_vec) const
     {
         index_t input_size = this->GetNodeConnectionSize(node);
@@ -17,6 +17,7 @@
 #include "bb/Tensor.h"
 #include "bb/FixedSizeConnectionTable.h"
 #include "bb/StochasticOperation.h"
+#include "bb/SparseGradient.h"
 
 
 namespace bb {
@@ -53,6 +54,9 @@ protected:
     std::shared_ptr<Tensor>     m_W;
     std::shared_ptr<Tensor>     m_dW;
 
+    std::shared_ptr<SparseGradient> m_sparse_dW;                        //< 疎勾配の追跡(dW と組で Optimizer に渡す)
+    RealType                    m_sparse_threshold = (RealType)0.01;    //< 疎勾配の相対閾値
+
     RealType                    m_momentum;
 
     RealType                    m_gamma;
@@ -94,6 +98,7 @@ protected:
 
         m_W  = std::make_shared<Tensor>();
         m_dW = std::make_shared<Tensor>();
+        m_sparse_dW = std::make_shared<SparseGradient>();
 
         if ( DataType<BinType>::type == BB_TYPE_BIT ) {
             m_binary_mode = true;
@@ -129,6 +134,12 @@ protected:
         {
             m_momentum = (RealType)EvalReal(args[1]);
         }
+
+        // 疎勾配モード設定
+        if (args.size() == 2 && args[0] == "sparse_gradient")
+        {
+            SetSparseGradient(EvalBool(args[1]), m_sparse_threshold);
+        }
     }
     
     virtual void PrintInfoText(std::ostream& os, std::string indent, int columns, int nest, int depth)
@@ -194,6 +205,9 @@ public:
         return std::string("SparseLut") + std::to_string(N);
     }
 
+    bool IsBinaryMode(void) const { return m_binary_mode; }
+    bool IsBatchNorm(void)  const { return m_batch_norm; }
+
 
 public:
     // Serialize
@@ -326,6 +340,18 @@ public:
         return m_connection_table.GetInputConnection(output_node, input_index);
     }
 
+    bool PermuteNodes(std::vector<index_t> const &order)
+    {
+        m_connection_table.PermuteOutputNodes(order);
+        Tensor_PermuteRows(*m_W,  order);
+        Tensor_PermuteRows(*m_dW, order);
+        Tensor_PermuteRows(m_mean,         order);
+        Tensor_PermuteRows(m_rstd,         order);
+        Tensor_PermuteRows(m_running_mean, order);
+        Tensor_PermuteRows(m_running_var,  order);
+        return true;
+    }
+
 
    /**
      * @brief  入力のshape設定
@@ -373,10 +399,27 @@ public:
     {
         Variables gradients;
         if ( !this->m_parameter_lock ) {
-            gradients.PushBack(m_dW);
+            gradients.PushBack(m_dW, m_sparse_dW);
         }
         return gradients;
     }
+
+    /**
+     * @brief  疎勾配モード設定
+     * @detail 有効にするとCPU版のBackwardで各ノードのテーブルのうち
+     *         最大値の threshold 倍を超える勾配を受けたエントリだけを dW に加算して記録し、
+     *         Optimizer はそのエントリだけを遅延更新する。
+     *         疎勾配モード中は CUDA 版の Backward は使わない。
+     * @param  enable    有効/無効
+     * @param  threshold ノード内の最大勾配に対する相対閾値
+     */
+    void SetSparseGradient(bool enable, RealType threshold = (RealType)0.01)
+    {
+        m_sparse_threshold = threshold;
+        m_sparse_dW->SetEnable(enable);
+    }
+
+    bool IsSparseGradient(void) const { return m_sparse_dW->IsEnabled(); }
     
     void        SetFrameBufferX(FrameBuffer x) { m_x_buf = x; }
     FrameBuffer GetFrameBufferX(void)          { return m_x_buf; }
@@ -615,8 +658,7 @@ public:
                     auto running_mean_ptr = m_running_mean.Lock();
                     auto running_var_ptr  = m_running_var.Lock();
 
-                    #pragma omp parallel for
-                    for ( index_t node = 0; node < node_size; ++node ) {
+                    ParallelFor(0, node_size, [&](index_t node) {
                         RealType W[(1 << N)];
                         for ( int i = 0; i < (1 << N); ++i) {
                             W[i] = W_ptr(node, i);
@@ -697,7 +739,7 @@ public:
 
                             y_ptr.Set(frame, node, y);
                         }
-                    }
+                    });
                 }
                 else {
                     auto x_ptr            = x_buf.LockConst<BinType>();
@@ -707,8 +749,7 @@ public:
                     auto running_mean_ptr = m_running_mean.LockConst();
                     auto running_var_ptr  = m_running_var.LockConst();
 
-                    #pragma omp parallel for
-                    for ( index_t node = 0; node < node_size; ++node ) {
+                    ParallelFor(0, node_size, [&](index_t node) {
                         RealType W[(1 << N)];
                         for ( int i = 0; i < (1 << N); ++i) {
                             W[i] = W_ptr(node, i);
@@ -752,7 +793,7 @@ public:
 
                             y_ptr.Set(frame, node, y);
                         }
-                    }
+                    });
                 }
 
                 return y_buf;
@@ -819,8 +860,7 @@ public:
                 auto input_table_ptr  = m_connection_table.LockConst_InputTable();
                 auto W_ptr            = lock_W_const();
 
-                #pragma omp parallel for
-                for ( index_t node = 0; node < node_size; ++node ) {
+                ParallelFor(0, node_size, [&](index_t node) {
                     RealType W[(1 << N)];
                     for ( int i = 0; i < (1 << N); ++i) {
                         W[i] = W_ptr(node, i);
@@ -857,7 +897,7 @@ public:
 
                         y_ptr.Set(frame, node, y);
                     }
-                }
+                });
                 return y_buf;
             }
         }
@@ -890,7 +930,7 @@ public:
             // with BatchNormalization
     #ifdef BB_WITH_CUDA
             // CUDA float
-            if ( N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only
+            if ( N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only && !IsSparseGradient()
                     && x_buf.IsDeviceAvailable() && dy_buf.IsDeviceAvailable() && tmp_buf.IsDeviceAvailable() && dx_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
 
                 Tensor_<RealType>   dmean(output_shape);
@@ -941,7 +981,7 @@ public:
             }
 
             // CUDA bit
-            if ( N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_BIT && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only
+            if ( N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_BIT && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only && !IsSparseGradient()
                     && x_buf.IsDeviceAvailable() && dy_buf.IsDeviceAvailable() && tmp_buf.IsDeviceAvailable() && dx_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
 
                 Tensor_<RealType>   dmean(output_shape);
@@ -1008,6 +1048,10 @@ public:
                 auto mean_ptr        = m_mean.LockConst();
                 auto rstd_ptr        = m_rstd.LockConst();
 
+                if ( IsSparseGradient() ) {
+                    m_sparse_dW->Resize(node_size, NN);
+                }
+
                 for ( index_t node = 0; node < node_size; ++node ) {
                     RealType W[(1 << N)];
                     for ( int i = 0; i < (1 << N); ++i) {
@@ -1094,8 +1138,13 @@ public:
                         }
                     }
 
-                    for ( int i = 0; i < (1 << N); ++i ) {
-                        dW_ptr(node, i) += dW[i];
+                    if ( IsSparseGradient() ) {
+                        m_sparse_dW->AccumulateBlock<RealType>(node, dW, &dW_ptr(node, 0), m_sparse_threshold);
+                    }
+                    else {
+                        for ( int i = 0; i < (1 << N); ++i ) {
+                            dW_ptr(node, i) += dW[i];
+                        }
                     }
                 }
 
@@ -1104,7 +1153,7 @@ public:
         }
         else {
 #ifdef BB_WITH_CUDA
-            if ( N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only
+            if ( N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only && !IsSparseGradient()
                     && dy_buf.IsDeviceAvailable() && x_buf.IsDeviceAvailable() && dx_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
                 auto x_ptr             = x_buf.LockDeviceMemoryConst();
                 auto dy_ptr            = dy_buf.LockDeviceMemoryConst();
@@ -1140,7 +1189,7 @@ public:
             }
 
             // LUT6 Bit CUDA
-            if ( N == 6 && N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_BIT && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only
+            if ( N == 6 && N >= 2 && N <= 6 && DataType<BinType>::type == BB_TYPE_BIT && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only && !IsSparseGradient()
                     && dy_buf.IsDeviceAvailable() && x_buf.IsDeviceAvailable() && dx_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
                 auto x_ptr             = x_buf.LockDeviceMemoryConst();
                 auto dy_ptr            = dy_buf.LockDeviceMemoryConst();
@@ -1191,6 +1240,10 @@ public:
                 auto W_ptr           = lock_W_const();
                 auto dW_ptr          = lock_dW();
 
+                if ( IsSparseGradient() ) {
+                    m_sparse_dW->Resize(node_size, NN);
+                }
+
                 for ( index_t node = 0; node < node_size; ++node ) {
                     RealType W[(1 << N)];
                     for ( int i = 0; i < (1 << N); ++i) {
@@ -1223,8 +1276,13 @@ public:
                         }
                     }
 
-                    for ( int i = 0; i < (1 << N); ++i ) {
-                        dW_ptr(node, i) += dW[i];
+                    if ( IsSparseGradient() ) {
+                        m_sparse_dW->AccumulateBlock<RealType>(node, dW, &dW_ptr(node, 0), m_sparse_threshold);
+                    }
+                    else {
+                        for ( int i = 0; i < (1 << N); ++i ) {
+                            dW_ptr(node, i) += dW[i];
+                        }
                     }
                 }
 
@@ -290,6 +290,15 @@ public:
         return y_vec;
     }
 
+    // ノードの並べ替え(前段の SparseLayer と揃える場合に使用)
+    void PermuteNodes(std::vector<index_t> const &order)
+    {
+        Tensor_PermuteRows(m_mean,         order);
+        Tensor_PermuteRows(m_rstd,         order);
+        Tensor_PermuteRows(m_running_mean, order);
+        Tensor_PermuteRows(m_running_var,  order);
+    }
+
 
     /**
      * @brief  forward演算
@@ -382,8 +391,7 @@ public:
                 const __m256    reciprocal_frame_size = _mm256_set1_ps(1.0f / (float)frame_size);
                 const __m256    epsilon = _mm256_set1_ps(1.0e-7f);
 
-                #pragma omp parallel for
-                for (int node = 0; node < (int)node_size; ++node) {
+                ParallelFor(0, node_size, [&](index_t node) {
                     float const *x_addr = x_ptr.GetAddr(node);
                     float       *y_addr = y_ptr.GetAddr(node);
 
@@ -433,11 +441,10 @@ public:
                         __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
                         _mm256_store_ps(&y_addr[frame], y);
                     }
-                }
+                });
             }
             else {
-                #pragma omp parallel for
-                for (int node = 0; node < (int)node_size; ++node) {
+                ParallelFor(0, node_size, [&](index_t node) {
                     auto x_addr = x_ptr.GetAddr(node);
                     auto y_addr = y_ptr.GetAddr(node);
 
@@ -454,7 +461,7 @@ public:
                         __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
                         _mm256_store_ps(&y_addr[frame], y);
                     }
-                }
+                });
             }
 
             return y_buf;
@@ -475,8 +482,7 @@ public:
             auto running_var_ptr  = m_running_var.Lock();
 
             if ( train ) {
-                #pragma omp parallel for
-                for (index_t node = 0; node < node_size; ++node) {
+                ParallelFor(0, node_size, [&](index_t node) {
                     T mean;
                     T var;
 #if 0
@@ -534,7 +540,7 @@ public:
                         x = x * m_gamma + m_beta;
                         y_ptr.Set(frame, node, x);
                     }
-                }
+                });
             }
             else {
 //              #pragma omp parallel for
@@ -545,7 +551,7 @@ public:
                     T   rstd  = (T)1.0 / (std::sqrt(var) + (T)1.0e-7);
 
                     T   gain   = m_gamma / (std::sqrt(var) + (T)1.0e-7);
-                    T   offset = m_beta - (m_gamma * mean_ptr[node] / (sqrt(var) + (T)1.0e-7));
+                    T   offset = m_beta - (m_gamma * mean / (sqrt(var) + (T)1.0e-7));
 
                     for ( index_t frame = 0; frame < frame_size; ++frame) {
                         T x = x_ptr.Get(frame, node);
@@ -606,8 +612,7 @@ public:
             auto mean_ptr         = m_mean.Lock();
             auto rstd_ptr         = m_rstd.Lock();        
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 // 集計
                 T mean = mean_ptr[node];
                 T rstd = rstd_ptr[node];
@@ -619,7 +624,7 @@ public:
                     x = x * m_gamma + m_beta;
                     y_ptr.Set(frame, node, x);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -691,8 +696,7 @@ public:
             auto dx_ptr = dx_buf.Lock<T>();
             auto dy_ptr = dy_buf.LockConst<T>();
 
-            #pragma omp parallel for
-            for (int node = 0; node < (int)node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 auto dy_addr = dy_ptr.GetAddr(node);
                 auto dx_addr = dx_ptr.GetAddr(node);
                 auto x_addr  = x_ptr.GetAddr(node);
@@ -739,7 +743,7 @@ public:
                     __m256 dx = _mm256_fmadd_ps(_mm256_mul_ps(x, dvar), reciprocal_frame_size, dxc);
                     _mm256_store_ps(&dx_addr[frame], dx);
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -757,8 +761,7 @@ public:
             auto dx_ptr = dx_buf.Lock<T>();
             auto dy_ptr = dy_buf.LockConst<T>();
 
-            #pragma omp parallel for
-            for (index_t node = 0; node < node_size; ++node) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 T   mean   = mean_ptr[node];
                 T   rstd   = rstd_ptr[node];
                 T   dmeanx = 0;
@@ -786,7 +789,7 @@ public:
                     T dx  = dxc + dmean + (x * dvar / (T)frame_size);
                     dx_ptr.Set(frame, node, dx);
                 }
-            }
+            });
 
             return dx_buf;
         } 
@@ -218,6 +218,15 @@ public:
         return m_lut->GetNodeConnectionIndex(output_node, connection);
     }
 
+    bool PermuteNodes(std::vector<index_t> const &order)
+    {
+        if ( !m_lut->PermuteNodes(order) ) {
+            return false;
+        }
+        m_norm->PermuteNodes(order);
+        return true;
+    }
+
     /*
     index_t GetNodeInputSize(index_t node) const
     {
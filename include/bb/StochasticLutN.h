@@ -17,6 +17,7 @@
 #include "bb/FixedSizeConnectionTable.h"
 #include "bb/StochasticOperation.h"
 #include "bb/StochasticLutSimd.h"
+#include "bb/SparseGradient.h"
 
 
 namespace bb {
@@ -53,6 +54,9 @@ protected:
     std::shared_ptr<Tensor>     m_W;
     std::shared_ptr<Tensor>     m_dW;
 
+    std::shared_ptr<SparseGradient> m_sparse_dW;                        //< 疎勾配の追跡(dW と組で Optimizer に渡す)
+    RealType                    m_sparse_threshold = (RealType)0.01;    //< 疎勾配の相対閾値
+
     std::mt19937_64             m_mt;
 
 public:
@@ -74,6 +78,7 @@ protected:
 
         m_W  = std::make_shared<Tensor>();
         m_dW = std::make_shared<Tensor>();
+        m_sparse_dW = std::make_shared<SparseGradient>();
     }
 
     void CommandProc(std::vector<std::string> args)
@@ -109,6 +114,12 @@ protected:
         {
             m_host_simd = EvalBool(args[1]);
         }
+
+        // 疎勾配モード設定
+        if (args.size() == 2 && args[0] == "sparse_gradient")
+        {
+            SetSparseGradient(EvalBool(args[1]), m_sparse_threshold);
+        }
     }
 
 public:
@@ -231,6 +242,14 @@ public:
         return m_connection_table.GetInputConnection(node, input_index);
     }
 
+    bool PermuteNodes(std::vector<index_t> const &order)
+    {
+        m_connection_table.PermuteOutputNodes(order);
+        Tensor_PermuteRows(*m_W,  order);
+        Tensor_PermuteRows(*m_dW, order);
+        return true;
+    }
+
 
    /**
      * @brief  入力のshape設定
@@ -300,9 +319,26 @@ public:
     Variables GetGradients(void)
     {
         Variables gradients;
-        gradients.PushBack(m_dW);
+        gradients.PushBack(m_dW, m_sparse_dW);
         return gradients;
     }
+
+    /**
+     * @brief  疎勾配モード設定
+     * @detail 有効にするとCPU版のBackwardで各ノードのテーブルのうち
+     *         最大値の threshold 倍を超える勾配を受けたエントリだけを dW に加算して記録し、
+     *         Optimizer はそのエントリだけを遅延更新する。
+     *         疎勾配モード中は SIMD/CUDA 版の Backward は使わない。
+     * @param  enable    有効/無効
+     * @param  threshold ノード内の最大勾配に対する相対閾値
+     */
+    void SetSparseGradient(bool enable, RealType threshold = (RealType)0.01)
+    {
+        m_sparse_threshold = threshold;
+        m_sparse_dW->SetEnable(enable);
+    }
+
+    bool IsSparseGradient(void) const { return m_sparse_dW->IsEnabled(); }
     
 
     void        SetFrameBufferX(FrameBuffer x) { m_x_buf = x; }
@@ -430,8 +466,9 @@ public:
 #endif
 
         // LUT6 SIMD
+        static SimdKernel forward_kernel("StochasticLut6::Forward", {SimdLevel::AVX2});
         if ( DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && m_host_simd
-                && y_buf.GetFrameSize() % 8 == 0 ) {
+                && y_buf.GetFrameSize() % 8 == 0 && forward_kernel.Select() >= SimdLevel::AVX2 ) {
             auto input_table_ptr = m_connection_table.LockConst_InputTable();
             simd_fp32_StochasticLut6_Forward(x_buf, y_buf, input_table_ptr.GetAddr(), m_W, m_binary_mode, m_lut_binarize, m_unbinarize_bias);
             return y_buf;
@@ -447,8 +484,7 @@ public:
             auto input_table_ptr = m_connection_table.LockConst_InputTable();
             auto W_ptr           = lock_W_const();
 
-            #pragma omp parallel for
-            for ( index_t node = 0; node < node_size; ++node ) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 // read W
                 RealType W[(1 << N)];
                 for ( int i = 0; i < (1 << N); ++i) {
@@ -481,7 +517,7 @@ public:
 
                     y_ptr.Set(frame, node, y);
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -500,7 +536,7 @@ public:
 
 #ifdef BB_WITH_CUDA
         // LUT6 FP32 CUDA
-        if ( DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only
+        if ( DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only && !IsSparseGradient()
                 && dy_buf.IsDeviceAvailable() && x_buf.IsDeviceAvailable() && dx_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
 
             // tmp buffer
@@ -544,7 +580,7 @@ public:
         }
 
         // LUT6 Bit CUDA
-        if ( DataType<BinType>::type == BB_TYPE_BIT && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only
+        if ( DataType<BinType>::type == BB_TYPE_BIT && DataType<RealType>::type == BB_TYPE_FP32 && !m_host_only && !IsSparseGradient()
                 && dy_buf.IsDeviceAvailable() && x_buf.IsDeviceAvailable() && dx_buf.IsDeviceAvailable() && Manager::IsDeviceAvailable()) {
 
             // tmp buffer
@@ -589,8 +625,9 @@ public:
 #endif
 
         // LUT6 SIMD
-        if ( N == 6 && DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && m_host_simd
-                && dy_buf.GetFrameSize() % 8 == 0 ) {
+        static SimdKernel backward_kernel("StochasticLut6::Backward", {SimdLevel::AVX2});
+        if ( N == 6 && DataType<BinType>::type == BB_TYPE_FP32 && DataType<RealType>::type == BB_TYPE_FP32 && m_host_simd && !IsSparseGradient()
+                && dy_buf.GetFrameSize() % 8 == 0 && backward_kernel.Select() >= SimdLevel::AVX2 ) {
             auto input_table_ptr = m_connection_table.LockConst_InputTable();
             simd_fp32_StochasticLut6_Backward(x_buf, dy_buf, dx_buf, input_table_ptr.GetAddr(), m_W, m_dW, m_unbinarize_bias, m_binary_mode, m_lut_binarize);
             return dx_buf;
@@ -611,9 +648,12 @@ public:
             auto input_table_ptr = m_connection_table.LockConst_InputTable();
             auto W_ptr           = lock_W_const();
             auto dW_ptr          = lock_dW();
+
+            if ( IsSparseGradient() ) {
+                m_sparse_dW->Resize(node_size, NN);
+            }
             
-            #pragma omp parallel for
-            for ( index_t node = 0; node < node_size; ++node ) {
+            ParallelFor(0, node_size, [&](index_t node) {
                 // read W
                 RealType W[1 << N];
                 for ( int i = 0; i < NN; ++i) {
@@ -653,15 +693,19 @@ public:
                 }
 
                 // write dW
-                for ( int i = 0; i < NN; ++i) {
-                    dW_ptr(node, i) += dW[i];
+                if ( IsSparseGradient() ) {
+                    m_sparse_dW->AccumulateBlock<RealType>(node, dW, &dW_ptr(node, 0), m_sparse_threshold);
                 }
-            }
+                else {
+                    for ( int i = 0; i < NN; ++i) {
+                        dW_ptr(node, i) += dW[i];
+                    }
+                }
+            });
 
             // integrate dx
             auto dx_ptr = dx_buf.Lock<RealType>();
-            #pragma omp parallel for
-            for ( index_t frame = 0; frame < frame_size; ++frame ) {
+            ParallelFor(0, frame_size, [&](index_t frame) {
                 for ( index_t node = 0; node < node_size; ++node ) {
                     for (int i = 0; i < N; ++i) {
                         RealType dx = tmp_ptr.Get(frame, node * N + i);
@@ -669,7 +713,7 @@ public:
                         dx_ptr.Add(frame, input_node, dx);
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -22,6 +22,7 @@
 namespace bb {
 
 
+BB_TARGET_AVX2
 inline void simd_fp32_StochasticLut6_Forward
     (
         FrameBuffer                         x_buf,
@@ -40,8 +41,7 @@ inline void simd_fp32_StochasticLut6_Forward
     auto node_size  = y_buf.GetNodeSize();
     auto frame_size = y_buf.GetFrameStride() / (index_t)sizeof(float);
 
-    #pragma omp parallel for
-    for ( index_t node = 0; node < node_size; ++node ) {
+    ParallelFor(0, node_size, [&](index_t node) BB_TARGET_AVX2 {
         // read W
         __m256   W[64];
         for ( int i = 0; i < 64; ++i ) {
@@ -159,10 +159,11 @@ inline void simd_fp32_StochasticLut6_Forward
 
             _mm256_storeu_ps(&y_addr[frame], y);
         }
-    }
+    });
 }
 
 
+BB_TARGET_AVX2
 inline void simd_fp32_StochasticLut6_Backward
     (
         FrameBuffer                 x_buf,
@@ -192,8 +193,7 @@ inline void simd_fp32_StochasticLut6_Backward
     auto W_ptr           = W->LockConst<float>();
     auto dW_ptr          = dW->Lock<float>();
 
-    #pragma omp parallel for
-    for ( index_t node = 0; node < output_node_size; ++node ) {           // initialize dW
+    ParallelFor(0, output_node_size, [&](index_t node) BB_TARGET_AVX2 { // initialize dW
         __m256  dW[64];
         for ( int i = 0; i < 64; ++i) {
             dW[i] = _mm256_set1_ps(0.0f);
@@ -437,21 +437,22 @@ inline void simd_fp32_StochasticLut6_Backward
         for ( int i = 0; i < 64; ++i) {
             dW_ptr(node, i) += bb_mm256_cvtss_f32(bb_mm256_hsum_ps(dW[i]));
         }
-    }
+    });
 
-    #pragma omp parallel for
-    for ( index_t frame = 0; frame < frame_size; frame += 8 ) {
+    ParallelForRange(0, frame_size / 8, [&](index_t block_begin, index_t block_end) BB_TARGET_AVX2 {
         for ( index_t node = 0; node < output_node_size; ++node ) {
             for ( int i = 0; i < 6; ++i) {
                 float       *dx_addr     = dx_ptr.GetAddr(input_table[node*6+i]);
-                __m256 dx  = _mm256_load_ps(&dx_addr[frame]);
                 float const *dx_tmp_addr = dx_tmp_ptr.GetAddr(node*6 + i);
-                __m256 tmp = _mm256_load_ps(&dx_tmp_addr[frame]);
-                dx = _mm256_add_ps(dx, tmp);
-                _mm256_store_ps(&dx_addr[frame], dx);
+                for ( index_t frame = block_begin * 8; frame < block_end * 8; frame += 8 ) {
+                    __m256 dx  = _mm256_load_ps(&dx_addr[frame]);
+                    __m256 tmp = _mm256_load_ps(&dx_tmp_addr[frame]);
+                    dx = _mm256_add_ps(dx, tmp);
+                    _mm256_store_ps(&dx_addr[frame], dx);
+                }
             }
         }
-    }
+    });
 }
 
 
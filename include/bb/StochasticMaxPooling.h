@@ -203,8 +203,7 @@ public:
 
             index_t  m256_frame_size = (int)m_y.GetFrameStride() / 32;
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         __m256i *y_addr = (__m256i *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -228,7 +227,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_y_buf;
         }
@@ -242,8 +241,7 @@ public:
 
             index_t  m256_frame_size = (int)m_y.GetFrameStride() / sizeof(float);
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float *y_addr = (float *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -267,7 +265,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_y;
         }
@@ -280,8 +278,7 @@ public:
 
             auto frame_size = m_x.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
@@ -303,7 +300,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_y;
         }
@@ -354,8 +351,7 @@ public:
             auto dy_ptr = dy.LockConst<BT>();
             auto dx_ptr = m_dx.Lock<BT>(true);
 
-    #pragma omp parallel for
-            for (index_t n = 0; n < m_input_c_size; ++n) {
+            ParallelFor(0, m_input_c_size, [&](index_t n) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float const * y_addr  = (float const *)y_ptr.GetAddr(GetOutputNode(n, y, x));
@@ -383,7 +379,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_dx;
         }
@@ -398,8 +394,7 @@ public:
 
             auto frame_size = m_x_buf.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
@@ -420,7 +415,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return m_dx;
         }
@@ -194,8 +194,7 @@ public:
 
             index_t  m256_frame_size = (int)y.GetFrameStride() / 32;
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         __m256i *y_addr = (__m256i *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -219,7 +218,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -233,8 +232,7 @@ public:
 
             index_t  m256_frame_size = (int)y_buf.GetFrameStride() / sizeof(float);
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float *y_addr = (float *)y_ptr.GetAddr(GetOutputNode(c, y, x));
@@ -258,7 +256,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -271,8 +269,7 @@ public:
 
             auto frame_size = x_buf.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
@@ -294,7 +291,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -346,8 +343,7 @@ public:
             auto dy_ptr = dy_buf.LockConst<BT>();
             auto dx_ptr = dx_buf.Lock<BT>(true);
 
-    #pragma omp parallel for
-            for (index_t n = 0; n < m_input_c_size; ++n) {
+            ParallelFor(0, m_input_c_size, [&](index_t n) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         float const * y_addr  = (float const *)y_ptr.GetAddr(GetOutputNode(n, y, x));
@@ -375,7 +371,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -389,8 +385,7 @@ public:
 
             auto frame_size = x_buf.GetFrameSize();
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < m_input_c_size; ++c) {
+            ParallelFor(0, m_input_c_size, [&](index_t c) {
                 for (index_t y = 0; y < m_output_h_size; ++y) {
                     for (index_t x = 0; x < m_output_w_size; ++x) {
                         for (index_t frame = 0; frame < frame_size; ++frame) {
@@ -426,7 +421,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -1852,6 +1852,78 @@ public:
         return std::vector<VecType>();
     }
 
+    // 連続配列との間の一括転送 (並びは SetData/GetData と同じ)
+    template<typename BufType, typename VecType=float>
+    void SetDataArray_(VecType const *data, index_t size)
+    {
+        BB_ASSERT(GetType() == DataType<BufType>::type);
+        BB_ASSERT(size == m_size);
+
+        auto ptr = Lock<BufType>();
+        auto dst = &ptr[0];
+        ParallelForRange(0, m_size, [&](index_t begin, index_t end) {
+            for (index_t i = begin; i < end; ++i) {
+                dst[i] = (BufType)data[i];
+            }
+        }, 4096);
+    }
+
+    template<typename BufType, typename VecType=float>
+    void GetDataArray_(VecType *data, index_t size) const
+    {
+        BB_ASSERT(GetType() == DataType<BufType>::type);
+        BB_ASSERT(size == m_size);
+
+        auto ptr = LockConst<BufType>();
+        auto src = &ptr[0];
+        ParallelForRange(0, m_size, [&](index_t begin, index_t end) {
+            for (index_t i = begin; i < end; ++i) {
+                data[i] = (VecType)src[i];
+            }
+        }, 4096);
+    }
+
+    template<typename VecType=float>
+    void SetDataArray(VecType const *data, index_t size)
+    {
+        switch (GetType()) {
+        case BB_TYPE_FP32:   SetDataArray_<float,         VecType>(data, size);    break;
+        case BB_TYPE_FP64:   SetDataArray_<double,        VecType>(data, size);    break;
+        case BB_TYPE_INT8:   SetDataArray_<std::int8_t,   VecType>(data, size);    break;
+        case BB_TYPE_INT16:  SetDataArray_<std::int16_t,  VecType>(data, size);    break;
+        case BB_TYPE_INT32:  SetDataArray_<std::int32_t,  VecType>(data, size);    break;
+        case BB_TYPE_INT64:  SetDataArray_<std::int64_t,  VecType>(data, size);    break;
+        case BB_TYPE_UINT8:  SetDataArray_<std::uint8_t,  VecType>(data, size);    break;
+        case BB_TYPE_UINT16: SetDataArray_<std::uint16_t, VecType>(data, size);    break;
+        case BB_TYPE_UINT32: SetDataArray_<std::uint32_t, VecType>(data, size);    break;
+        case BB_TYPE_UINT64: SetDataArray_<std::uint64_t, VecType>(data, size);    break;
+        default:   BB_ASSERT(0);
+        }
+    }
+
+    template<typename VecType=float>
+    void GetDataArray(VecType *data, index_t size) const
+    {
+        switch (GetType()) {
+        case BB_TYPE_FP32:   GetDataArray_<float,         VecType>(data, size);    break;
+        case BB_TYPE_FP64:   GetDataArray_<double,        VecType>(data, size);    break;
+        case BB_TYPE_INT8:   GetDataArray_<std::int8_t,   VecType>(data, size);    break;
+        case BB_TYPE_INT16:  GetDataArray_<std::int16_t,  VecType>(data, size);    break;
+        case BB_TYPE_INT32:  GetDataArray_<std::int32_t,  VecType>(data, size);    break;
+        case BB_TYPE_INT64:  GetDataArray_<std::int64_t,  VecType>(data, size);    break;
+        case BB_TYPE_UINT8:  GetDataArray_<std::uint8_t,  VecType>(data, size);    break;
+        case BB_TYPE_UINT16: GetDataArray_<std::uint16_t, VecType>(data, size);    break;
+        case BB_TYPE_UINT32: GetDataArray_<std::uint32_t, VecType>(data, size);    break;
+        case BB_TYPE_UINT64: GetDataArray_<std::uint64_t, VecType>(data, size);    break;
+        default:   BB_ASSERT(0);
+        }
+    }
+
+    std::vector<index_t> GetStride(void) const
+    {
+        return m_stride;
+    }
+
 
     // -------------------------------------
     //  メモリ直接アクセス用ポインタ取得
@@ -2426,5 +2498,33 @@ inline std::ostream& operator<<(std::ostream& os, Tensor const &t)
 }
 
 
+/**
+ * @brief  先頭次元(ノード)方向の並べ替え
+ * @detail 新しい行 i に元の行 order[i] を置く
+ *         (パラメータを (node, ...) の形で持つレイヤーのノード並べ替え用)
+ * @param  tensor 対象(Tensor もしくは Tensor_)
+ * @param  order  並び順
+ */
+template<class TensorType>
+inline void Tensor_PermuteRows(TensorType &tensor, std::vector<index_t> const &order)
+{
+    index_t row_size = (index_t)order.size();
+    index_t size     = tensor.GetSize();
+    if ( size == 0 || row_size == 0 ) {
+        return;
+    }
+    BB_ASSERT(size % row_size == 0);
+
+    index_t unit = (size / row_size) * DataType_GetByteSize(tensor.GetType());
+    auto ptr  = tensor.LockMemory();
+    auto addr = (std::uint8_t *)ptr.GetAddr();
+
+    std::vector<std::uint8_t> tmp(addr, addr + unit * row_size);
+    for ( index_t row = 0; row < row_size; ++row ) {
+        BB_DEBUG_ASSERT(order[row] >= 0 && order[row] < row_size);
+        memcpy(addr + row * unit, &tmp[order[row] * unit], (size_t)unit);
+    }
+}
+
 
 }
\ No newline at end of file
@@ -14,10 +14,19 @@
 #include <vector>
 #include <memory>
 
+#include "bb/DataType.h"
+#include "bb/ThreadPool.h"
+
 
 namespace bb {
 
 
+// 要素毎演算の並列化単位(小さいテンソルでスレッドを起こさないため)
+#ifndef BB_TENSOR_OPERATOR_GRAIN
+#define BB_TENSOR_OPERATOR_GRAIN    4096
+#endif
+
+
 // -------------------------------------
 //  基本演算定義
 // -------------------------------------
@@ -30,10 +39,9 @@ inline void Tensor_Vector_set
     index_t size
 )
 {
-#pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = a;
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -49,10 +57,9 @@ inline void Tensor_Vector_add_ex
     index_t size
 )
 {
-#pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = a * src0[i] + b * src1[i] + c;
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -68,10 +75,9 @@ inline void Tensor_Vector_sub_ex
     index_t size
 )
 {
-#pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = a * src0[i] - b * src1[i] - c;
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -86,10 +92,9 @@ inline void Tensor_Vector_mul_ex
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = a * src0[i] * src1[i] + b;
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 template<typename T>
@@ -105,10 +110,9 @@ inline void Tensor_Vector_div_ex
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = (a * src0[i] + b) / (c * src1[i] + d);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -119,10 +123,9 @@ inline void Tensor_Vector_sqrt(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = (T)std::sqrt((double)src[i]);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 template<>
@@ -132,10 +135,9 @@ inline void Tensor_Vector_sqrt<float>(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = std::sqrt(src[i]);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -146,10 +148,9 @@ inline void Tensor_Vector_exp(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = (T)std::exp((double)src[i]);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 template<>
@@ -159,10 +160,9 @@ inline void Tensor_Vector_exp<float>(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = std::exp(src[i]);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -174,10 +174,9 @@ inline void Tensor_Vector_min(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = std::min(src0[i], src1[i]);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 template<typename T>
@@ -188,10 +187,9 @@ inline void Tensor_Vector_min_v(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = std::min(src0[i], src1);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -203,10 +201,9 @@ inline void Tensor_Vector_max(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = std::max(src0[i], src1[i]);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 template<typename T>
@@ -217,10 +214,9 @@ inline void Tensor_Vector_max_v(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = std::max(src0[i], src1);
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
@@ -233,10 +229,9 @@ inline void Tensor_Vector_clamp(
     index_t size
 )
 {
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
+    ParallelFor(0, size, [&](index_t i) {
         dst[i] = std::max(a, std::min(b, src[i]));
-    }
+    }, BB_TENSOR_OPERATOR_GRAIN);
 }
 
 
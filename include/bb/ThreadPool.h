@@ -0,0 +1,668 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <stdlib.h>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "bb/DataType.h"
+
+
+namespace bb {
+
+
+// [ThreadPool クラス]
+//  ・CPU版カーネル共通の常駐スレッドプール(ワークスティーリング)
+//  ・ループ毎に OpenMP の並列リージョンを開閉するコストを避ける
+//  ・スレッド0 は呼び出し元スレッド自身で、ワーカーは 1～(thread_size-1)
+//  ・ParallelFor はチャンク i をワーカー i のキューに投入するので
+//    (盗まれない限り)範囲とスレッドの対応は毎回同じになる(NUMA配置と整合)
+//  ・ネストした ParallelFor は NestedPolicy で直列実行か並列実行かを選ぶ
+//  ・プール外のスレッドを並行に動かす間は ReserveScope で同数のワーカーを休ませる
+//
+//  スレッド数は SetThreadSize() もしくは環境変数 BB_NUM_THREADS で設定する
+//  (未設定時は OpenMP の omp_get_max_threads()、無ければ CPU 数)
+
+class ThreadPool
+{
+public:
+    enum class NestedPolicy
+    {
+        Serial,         // タスク内からの ParallelFor はその場で直列実行
+        Parallel,       // タスク内からの ParallelFor もタスク化する
+    };
+
+    class TaskGroup;
+    class ThreadGroupScope;
+    class ReserveScope;
+
+protected:
+    struct Task
+    {
+        std::function<void()>   func;
+        TaskGroup               *group = nullptr;
+    };
+
+    struct Worker
+    {
+        std::mutex          mutex;
+        std::deque<Task>    queue;
+        std::thread         thread;
+    };
+
+    std::vector< std::unique_ptr<Worker> >  m_workers;          // [0] は呼び出し元スレッド用(投入先のみ)
+    int                                     m_thread_size = 0;
+    NestedPolicy                            m_nested_policy = NestedPolicy::Serial;
+    std::function<void(int)>                m_thread_init;
+    std::atomic<std::int64_t>               m_queued{0};
+    bool                                    m_stop = false;
+    std::mutex                              m_mutex;
+    std::condition_variable                 m_cv;
+    int                                     m_spin_count = 2000;
+    std::atomic<int>                        m_reserved{0};             // 休ませるワーカー数(番号の大きい側から)
+
+    static int& ThisThreadIndex(void)
+    {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    static int& ThisTaskDepth(void)
+    {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    // スレッドグループ(size が 0 ならプール全体)
+    struct ThreadGroup
+    {
+        int first = 0;
+        int size  = 0;
+    };
+
+    static ThreadGroup& ThisThreadGroup(void)
+    {
+        static thread_local ThreadGroup group;
+        return group;
+    }
+
+    static int GetDefaultThreadSize(void)
+    {
+        char const *env = getenv("BB_NUM_THREADS");
+        if ( env != nullptr && atoi(env) > 0 ) {
+            return atoi(env);
+        }
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return std::max(1, (int)std::thread::hardware_concurrency());
+#endif
+    }
+
+    ThreadPool()
+    {
+        Start(GetDefaultThreadSize());
+    }
+
+    void Start(int thread_size)
+    {
+        m_thread_size = std::max(1, thread_size);
+        m_stop        = false;
+        for ( int i = 0; i < m_thread_size; ++i ) {
+            m_workers.push_back(std::unique_ptr<Worker>(new Worker));
+        }
+        for ( int i = 1; i < m_thread_size; ++i ) {
+            m_workers[i]->thread = std::thread(&ThreadPool::WorkerMain, this, i);
+        }
+    }
+
+    void Stop(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        for ( auto &worker : m_workers ) {
+            if ( worker->thread.joinable() ) {
+                worker->thread.join();
+            }
+        }
+        m_workers.clear();
+        m_queued = 0;
+    }
+
+    void Push(int target, Task task)
+    {
+        auto &worker = *m_workers[target % m_thread_size];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.queue.push_front(std::move(task));
+        }
+        ++m_queued;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_cv.notify_all();
+    }
+
+    // 自分のキューは先頭から、他のキューは末尾から取り出す
+    bool Pop(int self, Task &task)
+    {
+        if ( m_queued.load(std::memory_order_relaxed) <= 0 ) {
+            return false;
+        }
+
+        for ( int i = 0; i < m_thread_size; ++i ) {
+            auto &worker = *m_workers[(self + i) % m_thread_size];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if ( !worker.queue.empty() ) {
+                if ( i == 0 ) {
+                    task = std::move(worker.queue.front());
+                    worker.queue.pop_front();
+                }
+                else {
+                    task = std::move(worker.queue.back());
+                    worker.queue.pop_back();
+                }
+                --m_queued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Execute(Task &task);
+
+    // ReserveScope で休ませているワーカーか
+    bool IsReserved(int index) const
+    {
+        return index >= GetActiveThreadSize();
+    }
+
+    void Reserve(int size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_reserved += size;
+        }
+        m_cv.notify_all();
+    }
+
+    void WorkerMain(int index)
+    {
+        ThisThreadIndex() = index;
+        if ( m_thread_init ) {
+            m_thread_init(index);
+        }
+
+        int spin = 0;
+        for ( ; ; ) {
+            Task task;
+            if ( !IsReserved(index) && Pop(index, task) ) {
+                Execute(task);
+                spin = 0;
+                continue;
+            }
+
+            // しばらくはスピンして次のループに備える
+            if ( spin < m_spin_count ) {
+                ++spin;
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [&]{ return m_stop || (m_queued.load() > 0 && !IsReserved(index)); });
+            if ( m_stop ) {
+                return;
+            }
+            spin = 0;
+        }
+    }
+
+public:
+    ~ThreadPool()
+    {
+        Stop();
+    }
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool& operator=(ThreadPool const &) = delete;
+
+    /**
+     * @brief  インスタンス取得
+     * @detail プロセス共通のスレッドプールを取得する
+     * @return スレッドプール
+     */
+    static ThreadPool& GetInstance(void)
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief  スレッド数設定
+     * @detail スレッド数設定(ワーカーを作り直すので並列処理中に呼ばないこと)
+     * @param  thread_size スレッド数(呼び出し元スレッドを含む)
+     */
+    void SetThreadSize(int thread_size)
+    {
+        Stop();
+        Start(thread_size);
+    }
+
+    /**
+     * @brief  スレッド数取得
+     * @detail スレッド数取得
+     * @return スレッド数(呼び出し元スレッドを含む)
+     */
+    int GetThreadSize(void) const
+    {
+        return m_thread_size;
+    }
+
+    /**
+     * @brief  ネスト時の方針設定
+     * @detail タスク内から呼ばれた ParallelFor の扱いを設定する
+     * @param  policy 方針
+     */
+    void SetNestedPolicy(NestedPolicy policy)
+    {
+        m_nested_policy = policy;
+    }
+
+    NestedPolicy GetNestedPolicy(void) const
+    {
+        return m_nested_policy;
+    }
+
+    /**
+     * @brief  ワーカー開始時フック設定
+     * @detail ワーカー起動時にスレッド番号を引数に呼ばれる(CPU固定などに使う)
+     *         既存ワーカーには適用されないので、必要なら SetThreadSize() で作り直す
+     * @param  func フック関数
+     */
+    void SetThreadInitializer(std::function<void(int)> func)
+    {
+        m_thread_init = func;
+    }
+
+    /**
+     * @brief  スレッド番号取得
+     * @detail 現在のスレッドのプール内番号(プール外のスレッドは0)
+     * @return スレッド番号
+     */
+    static int GetThreadIndex(void)
+    {
+        return ThisThreadIndex();
+    }
+
+    /**
+     * @brief  タスク実行中かの問い合わせ
+     * @return タスク内(ParallelFor の本体内を含む)なら true
+     */
+    static bool InTask(void)
+    {
+        return ThisTaskDepth() > 0;
+    }
+
+    /**
+     * @brief  稼働スレッド数取得
+     * @detail ReserveScope で休ませているワーカーを除いたスレッド数
+     * @return スレッド数(呼び出し元スレッドを含む)
+     */
+    int GetActiveThreadSize(void) const
+    {
+        return m_thread_size - std::min(m_reserved.load(), m_thread_size - 1);
+    }
+
+    void Run(TaskGroup &group, std::function<void()> func, int target = -1);
+    void Wait(TaskGroup &group);
+
+    /**
+     * @brief  範囲分割による並列実行
+     * @detail [begin, end) を最大スレッド数のチャンクに static 分割し、
+     *         func(chunk_begin, chunk_end) を並列に呼び出す
+     * @param  begin 開始インデックス
+     * @param  end   終了インデックス
+     * @param  func  チャンク処理関数
+     * @param  grain 1チャンクの最小要素数
+     */
+    template <typename Func>
+    void ParallelForRange(index_t begin, index_t end, Func const &func, index_t grain = 1);
+
+    /**
+     * @brief  インデックス毎の並列実行
+     * @detail func(i) を [begin, end) の各 i について並列に呼び出す
+     * @param  begin 開始インデックス
+     * @param  end   終了インデックス
+     * @param  func  処理関数
+     * @param  grain 1チャンクの最小要素数
+     */
+    template <typename Func>
+    void ParallelFor(index_t begin, index_t end, Func const &func, index_t grain = 1)
+    {
+        ParallelForRange(begin, end, [&func](index_t lo, index_t hi) {
+                for ( index_t i = lo; i < hi; ++i ) {
+                    func(i);
+                }
+            }, grain);
+    }
+};
+
+
+// タスクグループ(Run で投入したタスクの完了を Wait で待つ)
+class ThreadPool::TaskGroup
+{
+    friend class ThreadPool;
+
+protected:
+    ThreadPool                  &m_pool;
+    std::atomic<std::int64_t>   m_pending{0};
+    std::mutex                  m_mutex;
+    std::exception_ptr          m_exception;
+
+public:
+    explicit TaskGroup(ThreadPool &pool = ThreadPool::GetInstance()) : m_pool(pool) {}
+
+    ~TaskGroup()
+    {
+        if ( m_pending.load() > 0 ) {
+            try { m_pool.Wait(*this); } catch (...) {}
+        }
+    }
+
+    /**
+     * @brief  タスク投入
+     * @param  func   タスク
+     * @param  target 投入先スレッド番号(負なら現在のスレッド)
+     */
+    void Run(std::function<void()> func, int target = -1)
+    {
+        m_pool.Run(*this, func, target);
+    }
+
+    /**
+     * @brief  完了待ち
+     * @detail 待つ間は呼び出し元スレッドもタスクを実行する
+     *         タスクで例外が発生していれば再送出する
+     */
+    void Wait(void)
+    {
+        m_pool.Wait(*this);
+    }
+};
+
+
+// ワーカーの予約(スコープを抜けると元に戻る)
+//  ・プール外のスレッドを size 本並行に動かす間、番号の大きい側から同数のワーカーを休ませ、
+//    動くスレッドの総数をプールのスレッド数に収める
+//  ・休ませたワーカーのキューに残ったタスクは他のスレッドが盗んで実行する
+class ThreadPool::ReserveScope
+{
+protected:
+    ThreadPool  &m_pool;
+    int         m_size;
+
+public:
+    explicit ReserveScope(int size, ThreadPool &pool = ThreadPool::GetInstance())
+        : m_pool(pool), m_size(std::max(0, size))
+    {
+        m_pool.Reserve(m_size);
+    }
+
+    ~ReserveScope()
+    {
+        m_pool.Reserve(-m_size);
+    }
+
+    ReserveScope(ReserveScope const &) = delete;
+    ReserveScope& operator=(ReserveScope const &) = delete;
+};
+
+
+// スレッドグループの設定(スコープを抜けると元に戻る)
+//  ・設定したスレッドから呼ぶ ParallelFor は first～first+size-1 番のスレッドに分配する
+//  ・パイプライン実行などで、ステージ毎にプールのスレッドを割り当てる用途
+class ThreadPool::ThreadGroupScope
+{
+protected:
+    ThreadGroup m_prev;
+
+public:
+    ThreadGroupScope(int first, int size)
+    {
+        m_prev = ThisThreadGroup();
+        ThisThreadGroup().first = first;
+        ThisThreadGroup().size  = size;
+    }
+
+    ~ThreadGroupScope()
+    {
+        ThisThreadGroup() = m_prev;
+    }
+
+    ThreadGroupScope(ThreadGroupScope const &) = delete;
+    ThreadGroupScope& operator=(ThreadGroupScope const &) = delete;
+};
+
+
+inline void ThreadPool::Execute(Task &task)
+{
+    ++ThisTaskDepth();
+    try {
+        task.func();
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(task.group->m_mutex);
+        if ( !task.group->m_exception ) {
+            task.group->m_exception = std::current_exception();
+        }
+    }
+    --ThisTaskDepth();
+    --task.group->m_pending;
+}
+
+inline void ThreadPool::Run(TaskGroup &group, std::function<void()> func, int target)
+{
+    Task task;
+    task.func  = std::move(func);
+    task.group = &group;
+    ++group.m_pending;
+    Push(target < 0 ? ThisThreadIndex() : target, std::move(task));
+}
+
+inline void ThreadPool::Wait(TaskGroup &group)
+{
+    int self = ThisThreadIndex();
+    while ( group.m_pending.load() > 0 ) {
+        Task task;
+        if ( Pop(self, task) ) {
+            Execute(task);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(group.m_mutex);
+        std::swap(exception, group.m_exception);
+    }
+    if ( exception ) {
+        std::rethrow_exception(exception);
+    }
+}
+
+template <typename Func>
+void ThreadPool::ParallelForRange(index_t begin, index_t end, Func const &func, index_t grain)
+{
+    index_t size = end - begin;
+    if ( size <= 0 ) {
+        return;
+    }
+
+    // スレッドグループ指定時はグループ内のスレッド数で分割する
+    auto const &tg = ThisThreadGroup();
+    index_t thread_size = (tg.size > 0) ? std::min(tg.size, m_thread_size) : m_thread_size;
+
+    grain = std::max((index_t)1, grain);
+    index_t chunk_size = std::min(thread_size, (size + grain - 1) / grain);
+
+    // 分割不要もしくはネスト禁止時はその場で実行
+    if ( chunk_size <= 1 || (InTask() && m_nested_policy == NestedPolicy::Serial) ) {
+        func(begin, end);
+        return;
+    }
+
+    TaskGroup group(*this);
+    int first = (tg.size > 0) ? tg.first : ThisThreadIndex();
+    for ( index_t chunk = 1; chunk < chunk_size; ++chunk ) {
+        index_t lo = begin + (size * chunk) / chunk_size;
+        index_t hi = begin + (size * (chunk + 1)) / chunk_size;
+        group.Run([&func, lo, hi]() { func(lo, hi); }, (int)((first + chunk) % m_thread_size));
+    }
+
+    // チャンク0 は自スレッドで実行
+    ++ThisTaskDepth();
+    try {
+        func(begin, begin + size / chunk_size);
+    }
+    catch (...) {
+        --ThisTaskDepth();
+        try { group.Wait(); } catch (...) {}
+        throw;
+    }
+    --ThisTaskDepth();
+
+    group.Wait();
+}
+
+
+// [BoundedQueue クラス]
+//  ・スレッド間受け渡し用の容量制限付きキュー
+//  ・Push は満杯なら、Pop は空なら待つ
+//  ・Close 後の Push は失敗し、Pop は残りを取り出し終えると失敗する
+template <typename T>
+class BoundedQueue
+{
+protected:
+    std::deque<T>           m_queue;
+    size_t                  m_capacity;
+    bool                    m_closed = false;
+    std::mutex              m_mutex;
+    std::condition_variable m_cv_push;
+    std::condition_variable m_cv_pop;
+
+public:
+    explicit BoundedQueue(size_t capacity = 1) : m_capacity(std::max((size_t)1, capacity)) {}
+
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv_push.wait(lock, [&]{ return m_closed || m_queue.size() < m_capacity; });
+        if ( m_closed ) {
+            return false;
+        }
+        m_queue.push_back(std::move(item));
+        m_cv_pop.notify_one();
+        return true;
+    }
+
+    bool Pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv_pop.wait(lock, [&]{ return m_closed || !m_queue.empty(); });
+        if ( m_queue.empty() ) {
+            return false;
+        }
+        item = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_cv_push.notify_one();
+        return true;
+    }
+
+    void Close(void)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_cv_push.notify_all();
+        m_cv_pop.notify_all();
+    }
+};
+
+
+/**
+ * @brief  共通スレッドプールでの並列for
+ * @detail for (i = begin; i < end; ++i) func(i); を並列実行する
+ * @param  begin 開始インデックス
+ * @param  end   終了インデックス
+ * @param  func  処理関数
+ * @param  grain 1チャンクの最小要素数
+ */
+template <typename Func>
+inline void ParallelFor(index_t begin, index_t end, Func const &func, index_t grain = 1)
+{
+    ThreadPool::GetInstance().ParallelFor(begin, end, func, grain);
+}
+
+/**
+ * @brief  共通スレッドプールでの範囲分割並列実行
+ * @detail func(chunk_begin, chunk_end) をチャンク毎に並列実行する
+ * @param  begin 開始インデックス
+ * @param  end   終了インデックス
+ * @param  func  チャンク処理関数
+ * @param  grain 1チャンクの最小要素数
+ */
+template <typename Func>
+inline void ParallelForRange(index_t begin, index_t end, Func const &func, index_t grain = 1)
+{
+    ThreadPool::GetInstance().ParallelForRange(begin, end, func, grain);
+}
+
+/**
+ * @brief  共通スレッドプールのスレッド数設定
+ * @param  thread_size スレッド数
+ */
+inline void SetThreadSize(int thread_size)
+{
+    ThreadPool::GetInstance().SetThreadSize(thread_size);
+}
+
+/**
+ * @brief  共通スレッドプールのスレッド数取得
+ * @return スレッド数
+ */
+inline int GetThreadSize(void)
+{
+    return ThreadPool::GetInstance().GetThreadSize();
+}
+
+
+}
+
+
+// end of file
@@ -199,8 +199,7 @@ public:
             index_t output_h_size = input_h_size * m_filter_h_size;
             index_t output_w_size = input_w_size * m_filter_w_size;
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < c_size; ++c) {
+            ParallelFor(0, c_size, [&](index_t c) {
                 for (index_t iy = 0; iy < input_h_size; ++iy) {
                     for (index_t ix = 0; ix < input_w_size; ++ix) {
                         index_t input_node = (c * input_h_size + iy) * input_w_size + ix;
@@ -227,7 +226,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return y_buf;
         }
@@ -275,8 +274,7 @@ public:
             index_t output_h_size = input_h_size * m_filter_h_size;
             index_t output_w_size = input_w_size * m_filter_w_size;
 
-            #pragma omp parallel for
-            for (index_t c = 0; c < c_size; ++c) {
+            ParallelFor(0, c_size, [&](index_t c) {
                 for (index_t iy = 0; iy < input_h_size; ++iy) {
                     for (index_t ix = 0; ix < input_w_size; ++ix) {
                         index_t input_node = (c * input_h_size + iy) * input_w_size + ix;
@@ -301,7 +299,7 @@ public:
                         }
                     }
                 }
-            }
+            });
 
             return dx_buf;
         }
@@ -11,6 +11,7 @@
 
 #include "bb/DataType.h"
 #include "bb/Tensor.h"
+#include "bb/SparseGradient.h"
 
 namespace bb
 {
@@ -20,6 +21,7 @@ class Variables
 {
 protected:
     std::vector< std::shared_ptr<Tensor> >    m_tensors;
+    std::vector< std::shared_ptr<SparseGradient> > m_sparse;   // 勾配の場合の疎勾配情報(無ければnullptr)
 
 #ifdef BB_WITH_CUDA
     bool        m_size_table_dirty = true;  // サイズテーブルはクリーンな状態か
@@ -38,11 +40,13 @@ public:
         for ( size_t i = 0; i < shapes.size(); ++i ) {
             m_tensors.push_back(std::make_shared<Tensor>(shapes[i], types[i]));
         }
+        m_sparse.resize(m_tensors.size());
     }
 
     Variables(Variables const &v)
     {
         m_tensors = v.m_tensors;
+        m_sparse  = v.m_sparse;
     }
 
 
@@ -177,9 +181,10 @@ public:
         return shapes;
     }
     
-    void PushBack(std::shared_ptr<Tensor> t)
+    void PushBack(std::shared_ptr<Tensor> t, std::shared_ptr<SparseGradient> sparse = nullptr)
     {
         m_tensors.push_back(t);
+        m_sparse.push_back(sparse);
 
 #ifdef BB_WITH_CUDA
         m_size_table_dirty = true;
@@ -192,6 +197,9 @@ public:
         for ( auto& t : v.m_tensors ) {
             m_tensors.push_back(t);
         }
+        for ( auto& s : v.m_sparse ) {
+            m_sparse.push_back(s);
+        }
 
 #ifdef BB_WITH_CUDA
         m_size_table_dirty = true;
@@ -212,11 +220,24 @@ public:
         return *m_tensors[index];
     }
 
+    /**
+     * @brief  疎勾配情報の取得
+     * @param  index Tensor番号
+     * @return 有効な疎勾配情報があればそれを、無ければ nullptr を返す
+     */
+    std::shared_ptr<SparseGradient> GetSparseGradient(index_t index) const
+    {
+        BB_DEBUG_ASSERT(index >= 0 && index < GetSize());
+        auto const &sparse = m_sparse[index];
+        return (sparse && sparse->IsEnabled()) ? sparse : nullptr;
+    }
+
 
     // arithmetic operator
     Variables &operator=(Variables const &src)
     {
         m_tensors = src.m_tensors;
+        m_sparse  = src.m_sparse;
         return *this;
     }
     
@@ -0,0 +1,625 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <memory>
+
+#include "bb/Sequential.h"
+#include "bb/LutLayer.h"
+#include "bb/LoweringConvolution.h"
+#include "bb/MaxPooling.h"
+#include "bb/ExportVerilog.h"
+#include "bb/ThreadPool.h"
+
+
+namespace bb {
+
+
+// [VerilogSimulator]
+//  ExportVerilog が出力する回路のレジスタ段と valid/user パイプラインをクロック単位で模擬する機能モデル
+//  ・64bit ワードの各ビットを独立した 64 本のテストベンチ(レーン)として扱い、
+//    全ノードの LUT をビット演算で一括評価する
+//  ・cke / valid / user もレーン毎に持つので、ストールやバブルを含む入力系列を並列に流せる
+//  ・回路は ExportVerilog_LutLayers と同じネットリスト生成(ExportVerilog_SplitStages と
+//    ExportVerilog_MakeLutStage)から作る。register_interval によるレジスタ段の分割や
+//    lut_packing でまとめた LUT、削除されたノードも出力 HDL と同じ形で評価するので、
+//    モデルの Forward と照合すればネットリスト生成の誤りを検出できる (VerilogSimulator_VerifyNetlist)
+//    ネットリストを Verilog の文字列にする部分(INIT の並びやポート接続の書式)は対象外
+//  ・VerilogSimulatorLutCnn の AXI4-Stream 部分(ラインバッファ、画素ストリームのハンドシェーク)は
+//    サイクル単位では模擬しない。窓の切り出しと MaxPooling は画像単位で計算し、
+//    MLP 部分だけを上記のパイプラインとして流す
+
+
+/**
+ * @brief  ExportVerilog_LutLayers 出力回路の機能シミュレータ
+ * @detail レジスタ段毎のネットリストを組み合わせ回路として評価し、
+ *         段の出力は lut_ff に取り込み、user/valid も同じ段数だけ遅延する
+ */
+class VerilogSimulatorLutLayers
+{
+public:
+    using word_t  = std::uint64_t;
+    using Netlist = std::vector< std::vector<ExportVerilog_LutNode> >;  // レジスタ段のネットリスト [level-1][node]
+    static int const lane_size = 64;
+
+protected:
+    // 段内のレベル (ExportVerilog_LutNode::inputs のレベル番号に対応、レベル0 は段の入力)
+    struct Level
+    {
+        index_t                     node_size      = 0;
+        int                         max_input_size = 0;
+        int                         table_unit     = 0;     // 1ノード当たりのテーブルワード数
+        std::vector<char>           used;                   // [node] HDL に出力されるノード
+        std::vector<int>            input_size;             // [node]
+        std::vector<index_t>        input_index;            // [node][max_input_size] 段内の値配列の位置
+        std::vector<word_t>         table;                  // [node][table_unit]
+    };
+
+    struct Stage
+    {
+        index_t                     input_node_size  = 0;
+        index_t                     output_node_size = 0;
+        std::vector<Level>          levels;                 // レベル1以降
+        std::vector<index_t>        level_offset;           // 値配列での各レベルの先頭 (レベル0 から)
+        std::vector<word_t>         value;                  // 組み合わせ回路の値 [level][node]
+        std::vector<word_t>         ff;                     // lut_ff [output_node]
+        word_t                      valid = 0;              // layer valid
+        std::vector<word_t>         user;                   // layer user [bit]
+    };
+
+    std::vector<Stage>  m_stages;
+    int                 m_user_width = 0;
+
+    VerilogSimulatorLutLayers() {}
+
+    // LUT の評価 (シャノン展開のマルチプレクサ木)
+    static word_t EvalLut(Level const &level, index_t node, word_t const *value)
+    {
+        int             n     = level.input_size[node];
+        index_t const  *index = &level.input_index[node * level.max_input_size];
+        word_t const   *table = &level.table[node * level.table_unit];
+
+        word_t g[256];
+        for ( int j = 0; j < (1 << n); ++j ) {
+            g[j] = ((table[j / 64] >> (j % 64)) & 1) ? ~(word_t)0 : (word_t)0;
+        }
+        for ( int k = 0; k < n; ++k ) {
+            word_t x = value[index[k]];
+            for ( int j = 0; j < (1 << (n - 1 - k)); ++j ) {
+                g[j] = g[2*j] ^ (x & (g[2*j] ^ g[2*j+1]));
+            }
+        }
+        return g[0];
+    }
+
+public:
+    /**
+     * @brief  ネットリストからの生成
+     * @detail ExportVerilog_MakeLutStage が作るレジスタ段毎のネットリストをそのまま回路として使う
+     *         使われないノードを参照するなど HDL として成り立たないネットリストは BB_ASSERT で止める
+     * @param  netlists         レジスタ段毎のネットリスト
+     * @param  input_node_size  入力ノード数
+     * @param  user_width       USER_WIDTH
+     */
+    static std::shared_ptr<VerilogSimulatorLutLayers> CreateFromNetlist(std::vector<Netlist> const &netlists,
+                index_t input_node_size, int user_width = 32)
+    {
+        BB_ASSERT(!netlists.empty());
+        BB_ASSERT(user_width >= 0 && user_width <= 64);
+
+        auto self = std::shared_ptr<VerilogSimulatorLutLayers>(new VerilogSimulatorLutLayers);
+        self->m_user_width = user_width;
+
+        for ( auto const &nodes : netlists ) {
+            BB_ASSERT(!nodes.empty());
+
+            Stage stage;
+            stage.input_node_size  = input_node_size;
+            stage.output_node_size = (index_t)nodes.back().size();
+            stage.level_offset.push_back(0);
+            stage.level_offset.push_back(input_node_size);
+
+            int level_size = (int)nodes.size();
+            for ( int l = 0; l < level_size; ++l ) {
+                auto const &level_nodes = nodes[l];
+
+                Level level;
+                level.node_size = (index_t)level_nodes.size();
+                for ( auto const &n : level_nodes ) {
+                    level.max_input_size = std::max(level.max_input_size, (int)n.inputs.size());
+                }
+                BB_ASSERT(level.max_input_size <= 8);
+                level.table_unit = ((1 << level.max_input_size) + 63) / 64;
+
+                level.used.assign(level.node_size, 0);
+                level.input_size.assign(level.node_size, 0);
+                level.input_index.assign(level.node_size * level.max_input_size, 0);
+                level.table.assign(level.node_size * level.table_unit, 0);
+                for ( index_t node = 0; node < level.node_size; ++node ) {
+                    auto const &n = level_nodes[node];
+                    BB_ASSERT(n.used || l < level_size - 1);    // 最終レベルは全て出力
+                    if ( !n.used ) {
+                        continue;
+                    }
+
+                    int input_size = (int)n.inputs.size();
+                    BB_ASSERT(n.table.size() == ((size_t)1 << input_size));
+                    level.used[node]       = 1;
+                    level.input_size[node] = input_size;
+                    for ( int i = 0; i < input_size; ++i ) {
+                        auto sig = n.inputs[i];
+                        BB_ASSERT(sig.first >= 0 && sig.first <= l);
+                        if ( sig.first == 0 ) {
+                            BB_ASSERT(sig.second >= 0 && sig.second < input_node_size);
+                        }
+                        else {
+                            BB_ASSERT(sig.second >= 0 && sig.second < (index_t)nodes[sig.first - 1].size());
+                            BB_ASSERT(nodes[sig.first - 1][sig.second].used);
+                        }
+                        level.input_index[node * level.max_input_size + i] = stage.level_offset[sig.first] + sig.second;
+                    }
+                    for ( int i = 0; i < (1 << input_size); ++i ) {
+                        if ( n.table[i] ) {
+                            level.table[node * level.table_unit + i / 64] |= ((word_t)1 << (i % 64));
+                        }
+                    }
+                }
+
+                stage.level_offset.push_back(stage.level_offset.back() + level.node_size);
+                stage.levels.push_back(std::move(level));
+            }
+
+            stage.value.assign(stage.level_offset.back(), 0);
+            stage.ff.assign(stage.output_node_size, 0);
+            stage.user.assign(std::max(user_width, 1), 0);
+            self->m_stages.push_back(std::move(stage));
+
+            input_node_size = self->m_stages.back().output_node_size;
+        }
+
+        return self;
+    }
+
+    /**
+     * @brief  生成
+     * @detail ExportVerilog_LutLayers と同じ手順でネットリストを作って回路とする
+     * @param  layers      LutLayer 列 (ExportVerilog_LutLayers に渡すものと同じ)
+     * @param  config      ExportVerilog_LutLayers に渡すものと同じ設定
+     * @param  user_width  USER_WIDTH
+     */
+    template <typename FT = Bit, typename BT = float>
+    static std::shared_ptr<VerilogSimulatorLutLayers> Create(std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers,
+                ExportVerilogConfig const &config = ExportVerilogConfig(), int user_width = 32)
+    {
+        BB_ASSERT(!layers.empty());
+
+        std::vector<Netlist> netlists;
+        for ( auto const &stage : ExportVerilog_SplitStages<FT, BT>(layers, config.register_interval) ) {
+            netlists.push_back(ExportVerilog_MakeLutStage<FT, BT>(stage, config));
+        }
+        return CreateFromNetlist(netlists, layers.front()->GetInputNodeSize(), user_width);
+    }
+
+    template <typename FT = Bit, typename BT = float>
+    static std::shared_ptr<VerilogSimulatorLutLayers> Create(std::shared_ptr<Sequential> net,
+                ExportVerilogConfig const &config = ExportVerilogConfig(), int user_width = 32)
+    {
+        std::vector< std::shared_ptr< LutLayer<FT, BT> > > layers;
+        for (int i = 0; i < net->GetSize(); ++i) {
+            auto layer = std::dynamic_pointer_cast< LutLayer<FT, BT> >(net->Get(i));
+            if ( layer != nullptr ) {
+                layers.push_back(layer);
+            }
+        }
+        return Create<FT, BT>(layers, config, user_width);
+    }
+
+    index_t GetInputNodeSize(void)  const { return m_stages.front().input_node_size; }
+    index_t GetOutputNodeSize(void) const { return m_stages.back().output_node_size; }
+    int     GetUserWidth(void)      const { return m_user_width; }
+    int     GetLatency(void)        const { return (int)m_stages.size(); }
+
+    /**
+     * @brief  リセット
+     * @detail lut_ff と valid を 0 にする (user は不定なので 0 とする)
+     */
+    void Reset(void)
+    {
+        for ( auto &stage : m_stages ) {
+            std::fill(stage.ff.begin(), stage.ff.end(), 0);
+            std::fill(stage.user.begin(), stage.user.end(), 0);
+            stage.valid = 0;
+        }
+    }
+
+    /**
+     * @brief  1クロック進める
+     * @param  in_data   入力 [input_node]
+     * @param  in_valid  in_valid
+     * @param  in_user   in_user [user_bit] (nullptr なら 0)
+     * @param  cke       レーン毎の cke
+     */
+    void Clock(word_t const *in_data, word_t in_valid, word_t const *in_user = nullptr, word_t cke = ~(word_t)0)
+    {
+        int stage_size = (int)m_stages.size();
+
+        // 全段の LUT を現在のレジスタ値で評価してから一斉に更新する
+        for ( int s = 0; s < stage_size; ++s ) {
+            auto &stage = m_stages[s];
+            word_t const *src = (s == 0) ? in_data : m_stages[s-1].ff.data();
+            std::copy(src, src + stage.input_node_size, stage.value.begin());
+
+            for ( size_t l = 0; l < stage.levels.size(); ++l ) {
+                auto const &level  = stage.levels[l];
+                word_t     *dst    = &stage.value[stage.level_offset[l + 1]];
+                word_t const *value = stage.value.data();
+                ParallelFor(0, level.node_size, [&](index_t node) {
+                        dst[node] = level.used[node] ? EvalLut(level, node, value) : 0;
+                    }, 256);
+            }
+        }
+
+        for ( int s = stage_size - 1; s >= 0; --s ) {
+            auto &stage = m_stages[s];
+            word_t const *next = &stage.value[stage.level_offset[stage.levels.size()]];
+            for ( index_t node = 0; node < stage.output_node_size; ++node ) {
+                stage.ff[node] = (stage.ff[node] & ~cke) | (next[node] & cke);
+            }
+
+            word_t valid = (s == 0) ? in_valid : m_stages[s-1].valid;
+            stage.valid = (stage.valid & ~cke) | (valid & cke);
+            for ( int b = 0; b < m_user_width; ++b ) {
+                word_t user = (s == 0) ? (in_user != nullptr ? in_user[b] : 0) : m_stages[s-1].user[b];
+                stage.user[b] = (stage.user[b] & ~cke) | (user & cke);
+            }
+        }
+    }
+
+    word_t const *GetOutData(void)     const { return m_stages.back().ff.data(); }
+    word_t        GetOutData(index_t node) const { return m_stages.back().ff[node]; }
+    word_t        GetOutValid(void)    const { return m_stages.back().valid; }
+    word_t const *GetOutUser(void)     const { return m_stages.back().user.data(); }
+
+
+    /**
+     * @brief  フレーム列を流して出力を得る
+     * @detail frame を レーン (frame % 64) に順に割り当てて入力し、
+     *         user にはレーン内の通し番号を乗せて、出力側では user から書き込み先フレームを復元する
+     *         bubble_rate > 0 ならレーン毎にランダムに cke と in_valid を落とす
+     * @param  x_buf        入力(Bit 以外は変換する)
+     * @param  bubble_rate  cke/in_valid を落とす確率
+     * @param  seed         乱数シード
+     * @return 出力(Bit)
+     */
+    FrameBuffer Simulate(FrameBuffer x_buf, double bubble_rate = 0.0, std::uint64_t seed = 1)
+    {
+        if ( x_buf.GetType() != BB_TYPE_BIT ) {
+            x_buf = x_buf.ConvertTo(BB_TYPE_BIT);
+        }
+        BB_ASSERT(x_buf.GetNodeSize() == GetInputNodeSize());
+
+        index_t frame_size  = x_buf.GetFrameSize();
+        index_t input_size  = GetInputNodeSize();
+        index_t output_size = GetOutputNodeSize();
+        index_t lane_frames = (frame_size + lane_size - 1) / lane_size;
+        BB_ASSERT(m_user_width >= 64 || lane_frames <= ((index_t)1 << m_user_width));
+
+        FrameBuffer y_buf(frame_size, {output_size}, BB_TYPE_BIT);
+
+        auto x_ptr = x_buf.LockConst<Bit>();
+        auto y_ptr = y_buf.Lock<Bit>(true);
+
+        std::vector<index_t> issue(lane_size, 0);
+        std::vector<index_t> done(lane_size, 0);
+        std::vector<index_t> count(lane_size, 0);
+        index_t remain = frame_size;
+        for ( int lane = 0; lane < lane_size; ++lane ) {
+            count[lane] = (frame_size - lane + lane_size - 1) / lane_size;
+        }
+
+        std::mt19937_64                         mt(seed);
+        std::bernoulli_distribution             bubble(bubble_rate);
+        std::vector<word_t>                     in_data(input_size);
+        std::vector<word_t>                     in_user(std::max(m_user_width, 1));
+
+        Reset();
+
+        index_t max_cycle = (lane_frames + GetLatency() + 1) * (bubble_rate > 0 ? (index_t)(16 / (1.0 - std::min(bubble_rate, 0.9))) : 1) + 1024;
+        for ( index_t cycle = 0; remain > 0; ++cycle ) {
+            BB_ASSERT(cycle < max_cycle);
+
+            word_t cke      = 0;
+            word_t in_valid = 0;
+            for ( int lane = 0; lane < lane_size; ++lane ) {
+                if ( bubble_rate <= 0 || !bubble(mt) ) { cke      |= ((word_t)1 << lane); }
+                if ( bubble_rate <= 0 || !bubble(mt) ) { in_valid |= ((word_t)1 << lane); }
+            }
+
+            // 出力側 (cke の有効なサイクルで取り込む)
+            word_t capture = GetOutValid() & cke;
+            if ( capture ) {
+                auto out_data = GetOutData();
+                auto out_user = GetOutUser();
+                for ( int lane = 0; lane < lane_size; ++lane ) {
+                    if ( !((capture >> lane) & 1) ) { continue; }
+                    index_t seq = 0;
+                    for ( int b = 0; b < m_user_width; ++b ) {
+                        seq |= (index_t)((out_user[b] >> lane) & 1) << b;
+                    }
+                    index_t frame = seq * lane_size + lane;
+                    BB_ASSERT(frame < frame_size);
+                    for ( index_t node = 0; node < output_size; ++node ) {
+                        y_ptr.Set(frame, node, (Bit)((out_data[node] >> lane) & 1));
+                    }
+                    ++done[lane];
+                    --remain;
+                }
+            }
+
+            // 入力側
+            std::fill(in_data.begin(), in_data.end(), 0);
+            std::fill(in_user.begin(), in_user.end(), 0);
+            for ( int lane = 0; lane < lane_size; ++lane ) {
+                if ( issue[lane] >= count[lane] ) {
+                    in_valid &= ~((word_t)1 << lane);
+                    continue;
+                }
+                if ( !((in_valid >> lane) & 1) ) {
+                    continue;
+                }
+                index_t frame = issue[lane] * lane_size + lane;
+                for ( index_t node = 0; node < input_size; ++node ) {
+                    if ( x_ptr.Get(frame, node) ) {
+                        in_data[node] |= ((word_t)1 << lane);
+                    }
+                }
+                for ( int b = 0; b < m_user_width; ++b ) {
+                    in_user[b] |= (word_t)((issue[lane] >> b) & 1) << lane;
+                }
+                if ( (cke >> lane) & 1 ) {
+                    ++issue[lane];
+                }
+            }
+
+            Clock(in_data.data(), in_valid, in_user.data(), cke);
+        }
+
+        return y_buf;
+    }
+};
+
+
+/**
+ * @brief  ExportVerilog_LutCnnLayersAxi4s 出力回路の機能シミュレータ
+ * @detail AXI4-Stream のラインバッファのタイミングはサイクル単位では模擬せず、
+ *         画像をラスタ順の画素ストリームとして流し、
+ *         畳み込みは jelly_img_blk_buffer と同じ中心位置 ((N-1)/2, (M-1)/2)・
+ *         定数0境界の窓を作って MLP (VerilogSimulatorLutLayers) に渡す。
+ *         MaxPooling は jelly_img_dnn_maxpol 相当としてブロック毎の OR を取る。
+ *         回路は stride 1 で入力と同じ大きさの画像を出力するので、
+ *         モデル側が padding="same", border_mode=BB_BORDER_CONSTANT(0) のときに Forward と一致する
+ *         (それ以外の設定では境界部の差異として検出される)
+ */
+class VerilogSimulatorLutCnn
+{
+public:
+    using word_t = VerilogSimulatorLutLayers::word_t;
+
+protected:
+    struct Layer
+    {
+        std::shared_ptr<VerilogSimulatorLutLayers>  mlp;    // nullptr なら MaxPooling
+        index_t                                     filter_h_size = 1;
+        index_t                                     filter_w_size = 1;
+        index_t                                     output_c_size = 0;
+    };
+
+    std::vector<Layer>  m_layers;
+    indices_t           m_input_shape;
+
+    VerilogSimulatorLutCnn() {}
+
+public:
+    template <typename FT = Bit, typename BT = float>
+    static std::shared_ptr<VerilogSimulatorLutCnn> Create(std::vector< std::shared_ptr< Filter2d<FT, BT> > > layers,
+                ExportVerilogConfig const &config = ExportVerilogConfig())
+    {
+        BB_ASSERT(!layers.empty());
+
+        auto self = std::shared_ptr<VerilogSimulatorLutCnn>(new VerilogSimulatorLutCnn);
+        self->m_input_shape = layers.front()->GetInputShape();
+        BB_ASSERT(self->m_input_shape.size() == 3);
+
+        for ( auto const &filter : layers ) {
+            Layer layer;
+            layer.filter_h_size = filter->GetFilterHeight();
+            layer.filter_w_size = filter->GetFilterWidth();
+            layer.output_c_size = filter->GetOutputChannels();
+
+            auto cnv = std::dynamic_pointer_cast< LoweringConvolution<FT, BT> >(filter);
+            auto pol = std::dynamic_pointer_cast< MaxPooling<FT, BT> >(filter);
+            if ( cnv ) {
+                BB_ASSERT(cnv->GetXStride() == 1 && cnv->GetYStride() == 1);
+                auto net = std::dynamic_pointer_cast<Sequential>(cnv->GetLayer());
+                BB_ASSERT(net);
+                layer.mlp = VerilogSimulatorLutLayers::Create<FT, BT>(net, config);
+                BB_ASSERT(layer.mlp->GetInputNodeSize() == filter->GetInputChannels() * layer.filter_h_size * layer.filter_w_size);
+                BB_ASSERT(layer.mlp->GetOutputNodeSize() == layer.output_c_size);
+            }
+            else if ( pol ) {
+                BB_ASSERT(pol->GetOutputWidth()  == pol->GetInputWidth()  / layer.filter_w_size);
+                BB_ASSERT(pol->GetOutputHeight() == pol->GetInputHeight() / layer.filter_h_size);
+            }
+            else {
+                BB_ASSERT(0);
+            }
+            self->m_layers.push_back(layer);
+        }
+
+        return self;
+    }
+
+    /**
+     * @brief  画像列を流して出力を得る
+     * @param  x_buf        入力(形状 {w, h, c}, Bit 以外は変換する)
+     * @param  bubble_rate  MLP パイプラインの cke/valid を落とす確率
+     * @return 出力(Bit)
+     */
+    FrameBuffer Simulate(FrameBuffer x_buf, double bubble_rate = 0.0, std::uint64_t seed = 1)
+    {
+        if ( x_buf.GetType() != BB_TYPE_BIT ) {
+            x_buf = x_buf.ConvertTo(BB_TYPE_BIT);
+        }
+        BB_ASSERT(x_buf.GetShape() == m_input_shape);
+
+        index_t frame_size = x_buf.GetFrameSize();
+        index_t w = m_input_shape[0];
+        index_t h = m_input_shape[1];
+        index_t c = m_input_shape[2];
+
+        for ( auto &layer : m_layers ) {
+            index_t fh = layer.filter_h_size;
+            index_t fw = layer.filter_w_size;
+
+            if ( layer.mlp ) {
+                // ラインバッファの窓 (画素ストリーム順にフレームを並べる)
+                index_t nc = (fh - 1) / 2;
+                index_t mc = (fw - 1) / 2;
+                FrameBuffer blk_buf(frame_size * h * w, {c * fh * fw}, BB_TYPE_BIT);
+                {
+                    auto x_ptr   = x_buf.LockConst<Bit>();
+                    auto blk_ptr = blk_buf.Lock<Bit>(true);
+                    ParallelFor(0, frame_size * h, [&](index_t fy) {
+                            index_t frame = fy / h;
+                            index_t y     = fy % h;
+                            for ( index_t x = 0; x < w; ++x ) {
+                                index_t pixel = fy * w + x;
+                                for ( index_t ch = 0; ch < c; ++ch ) {
+                                    for ( index_t j = 0; j < fh; ++j ) {
+                                        for ( index_t k = 0; k < fw; ++k ) {
+                                            index_t iy = y - nc + j;
+                                            index_t ix = x - mc + k;
+                                            Bit v = 0;
+                                            if ( iy >= 0 && iy < h && ix >= 0 && ix < w ) {
+                                                v = x_ptr.Get(frame, (ch * h + iy) * w + ix);
+                                            }
+                                            blk_ptr.Set(pixel, (ch * fh + j) * fw + k, v);
+                                        }
+                                    }
+                                }
+                            }
+                        });
+                }
+
+                auto out_buf = layer.mlp->Simulate(blk_buf, bubble_rate, seed);
+
+                c = layer.output_c_size;
+                FrameBuffer y_buf(frame_size, {w, h, c}, BB_TYPE_BIT);
+                {
+                    auto out_ptr = out_buf.LockConst<Bit>();
+                    auto y_ptr   = y_buf.Lock<Bit>(true);
+                    ParallelFor(0, frame_size, [&](index_t frame) {
+                            for ( index_t ch = 0; ch < c; ++ch ) {
+                                for ( index_t i = 0; i < h * w; ++i ) {
+                                    y_ptr.Set(frame, ch * h * w + i, out_ptr.Get(frame * h * w + i, ch));
+                                }
+                            }
+                        });
+                }
+                x_buf = y_buf;
+            }
+            else {
+                // MaxPooling (ブロック内の OR)
+                index_t ow = w / fw;
+                index_t oh = h / fh;
+                FrameBuffer y_buf(frame_size, {ow, oh, c}, BB_TYPE_BIT);
+                {
+                    auto x_ptr = x_buf.LockConst<Bit>();
+                    auto y_ptr = y_buf.Lock<Bit>(true);
+                    ParallelFor(0, frame_size, [&](index_t frame) {
+                            for ( index_t ch = 0; ch < c; ++ch ) {
+                                for ( index_t y = 0; y < oh; ++y ) {
+                                    for ( index_t x = 0; x < ow; ++x ) {
+                                        Bit v = 0;
+                                        for ( index_t j = 0; j < fh; ++j ) {
+                                            for ( index_t k = 0; k < fw; ++k ) {
+                                                v = v | x_ptr.Get(frame, (ch * h + y * fh + j) * w + x * fw + k);
+                                            }
+                                        }
+                                        y_ptr.Set(frame, (ch * oh + y) * ow + x, v);
+                                    }
+                                }
+                            }
+                        });
+                }
+                w = ow;
+                h = oh;
+                x_buf = y_buf;
+            }
+        }
+
+        return x_buf;
+    }
+};
+
+
+/**
+ * @brief  回路シミュレーションと Forward の照合
+ * @param  net          照合するモデル
+ * @param  sim          VerilogSimulatorLutLayers もしくは VerilogSimulatorLutCnn
+ * @param  x_buf        入力
+ * @param  bubble_rate  cke/in_valid を落とす確率
+ * @return 不一致ビット数
+ */
+template <typename FT = Bit, class Simulator>
+index_t VerilogSimulator_Verify(std::shared_ptr<Model> net, std::shared_ptr<Simulator> sim, FrameBuffer x_buf, double bubble_rate = 0.0)
+{
+    auto y_exp = net->Forward(x_buf, false);
+    auto y_sim = sim->Simulate(x_buf, bubble_rate);
+    BB_ASSERT(y_exp.GetFrameSize() == y_sim.GetFrameSize());
+    BB_ASSERT(y_exp.GetNodeSize()  == y_sim.GetNodeSize());
+
+    index_t error = 0;
+    for ( index_t frame = 0; frame < y_exp.GetFrameSize(); ++frame ) {
+        for ( index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+            if ( (bool)y_exp.GetValue<FT>(frame, node) != (bool)y_sim.GetBit(frame, node) ) {
+                ++error;
+            }
+        }
+    }
+    return error;
+}
+
+
+/**
+ * @brief  出力 HDL のネットリストと Forward の照合
+ * @detail net の LutLayer 列から config に従って ExportVerilog_LutLayers と同じネットリストを作り、
+ *         回路シミュレーションの結果を Forward と比べる
+ * @param  net          照合するモデル
+ * @param  config       ExportVerilog_LutLayers に渡す設定
+ * @param  x_buf        入力
+ * @param  bubble_rate  cke/in_valid を落とす確率
+ * @return 不一致ビット数
+ */
+template <typename FT = Bit, typename BT = float>
+index_t VerilogSimulator_VerifyNetlist(std::shared_ptr<Sequential> net, ExportVerilogConfig const &config, FrameBuffer x_buf, double bubble_rate = 0.0)
+{
+    auto sim = VerilogSimulatorLutLayers::Create<FT, BT>(net, config);
+    return VerilogSimulator_Verify<FT>(net, sim, x_buf, bubble_rate);
+}
+
+
+}
+
+
+// end of file
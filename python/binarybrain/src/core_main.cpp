@@ -11,9 +11,11 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/operators.h>
+#include <pybind11/numpy.h>
 
 
 #include "bb/Version.h"
+#include "bb/Numa.h"
 #include "bb/DataType.h"
 
 #include "bb/Tensor.h"
@@ -23,6 +25,7 @@
 #include "bb/Sequential.h"
 #include "bb/DenseAffine.h"
 #include "bb/DepthwiseDenseAffine.h"
+#include "bb/BinaryDense.h"
 #include "bb/SparseLutN.h"
 #include "bb/SparseLutDiscreteN.h"
 #include "bb/BinaryLutN.h"
@@ -33,6 +36,7 @@
 #include "bb/ReLU.h"
 #include "bb/HardTanh.h"
 #include "bb/Dropout.h"
+#include "bb/DataAugmentation.h"
 #include "bb/BatchNormalization.h"
 #include "bb/StochasticBatchNormalization.h"
 
@@ -57,6 +61,10 @@
 #include "bb/LoadMnist.h"
 #include "bb/LoadCifar10.h"
 #include "bb/ExportVerilog.h"
+#include "bb/ExportCpp.h"
+#include "bb/ReorderNodes.h"
+#include "bb/OptimizeLut.h"
+#include "bb/FoldBatchNormalization.h"
 
 #ifdef BB_WITH_CUDA
 #include "bbcu/bbcu.h"
@@ -69,10 +77,13 @@ using FrameBuffer                  = bb::FrameBuffer;
 using Variables                    = bb::Variables;
 
 using Model                        = bb::Model;
+using InferenceContext             = bb::InferenceContext;
 using SparseLayer                  = bb::SparseLayer;
 using Sequential                   = bb::Sequential;
 using DenseAffine                  = bb::DenseAffine<float>;
 using DepthwiseDenseAffine         = bb::DepthwiseDenseAffine<float>;
+using BinaryDense                  = bb::BinaryDense<float, float>;
+using BinaryDenseBit               = bb::BinaryDense<bb::Bit, float>;
 using LutLayer                     = bb::LutLayer<float, float>;
 using LutLayerBit                  = bb::LutLayer<bb::Bit, float>;
 
@@ -116,11 +127,14 @@ using MaxPoolingBit                = bb::MaxPooling<bb::Bit, float>;
 using Activation                   = bb::Activation;
 using Binarize                     = bb::Binarize<float, float>;
 using BinarizeBit                  = bb::Binarize<bb::Bit, float>;
+using BinarizeThreshold            = bb::BinarizeThreshold<float, float>;
+using BinarizeThresholdBit         = bb::BinarizeThreshold<bb::Bit, float>;
 using Sigmoid                      = bb::Sigmoid<float>;
 using ReLU                         = bb::ReLU<float, float>;
 using ReLUBit                      = bb::ReLU<bb::Bit, float>;
 using HardTanh                     = bb::HardTanh<float, float>;
 using Dropout                      = bb::Dropout<float, float>;
+using DataAugmentation             = bb::DataAugmentation<float>;
 using BatchNormalization           = bb::BatchNormalization<float>;
 using StochasticBatchNormalization = bb::StochasticBatchNormalization<float>;
 
@@ -169,36 +183,118 @@ std::string GetDevicePropertiesString(int device)
 #if BB_WITH_CUDA
     return bbcu::GetDevicePropertiesString(device);
 #else
-    return "host only\n"
+    return "host only\n";
 #endif
 }
 
-std::string MakeVerilog_FromLut(std::string module_name, std::vector< std::shared_ptr< bb::LutLayer<float, float> > > layers)
+void SetNumThreads(int num_threads)
+{
+    omp_set_num_threads(num_threads);
+    bb::SetThreadSize(num_threads);
+    bb::Numa::BindThreads();
+}
+
+void SetNumaMode(bool enable, bool bind_threads)
+{
+    bb::Numa::SetEnable(enable, bind_threads);
+}
+
+void SetSimdLevel(std::string level)
+{
+    bb::SimdKernel::SetLimit(bb::SimdLevelFromString(level));
+}
+
+std::string GetSimdLevel(void)
+{
+    return bb::SimdLevelToString(bb::SimdKernel::GetLevel());
+}
+
+std::string MakeVerilog_FromLut(std::string module_name, std::vector< std::shared_ptr< bb::LutLayer<float, float> > > layers,
+                int register_interval, bool lut_packing, int lut_size)
+{
+    bb::ExportVerilogConfig config;
+    config.register_interval = register_interval;
+    config.lut_packing       = lut_packing;
+    config.lut_size          = lut_size;
+
+    std::stringstream ss;
+    bb::ExportVerilog_LutLayers<float, float>(ss, module_name, layers, config);
+    return ss.str();
+}
+
+std::string MakeVerilog_FromLutBit(std::string module_name, std::vector< std::shared_ptr< bb::LutLayer<bb::Bit, float> > > layers,
+                int register_interval, bool lut_packing, int lut_size)
+{
+    bb::ExportVerilogConfig config;
+    config.register_interval = register_interval;
+    config.lut_packing       = lut_packing;
+    config.lut_size          = lut_size;
+
+    std::stringstream ss;
+    bb::ExportVerilog_LutLayers<bb::Bit, float>(ss, module_name, layers, config);
+    return ss.str();
+}
+
+std::string MakeCpp_FromLut(std::string func_name, std::vector< std::shared_ptr< bb::LutLayer<float, float> > > layers, std::string simd)
 {
     std::stringstream ss;
-    bb::ExportVerilog_LutLayers<float, float>(ss, module_name, layers);
+    bb::ExportCpp_LutLayers<float, float>(ss, func_name, layers, simd);
     return ss.str();
 }
 
-std::string MakeVerilog_FromLutBit(std::string module_name, std::vector< std::shared_ptr< bb::LutLayer<bb::Bit, float> > > layers)
+std::string MakeCpp_FromLutBit(std::string func_name, std::vector< std::shared_ptr< bb::LutLayer<bb::Bit, float> > > layers, std::string simd)
 {
     std::stringstream ss;
-    bb::ExportVerilog_LutLayers<bb::Bit, float>(ss, module_name, layers);
+    bb::ExportCpp_LutLayers<bb::Bit, float>(ss, func_name, layers, simd);
     return ss.str();
 }
 
 
-std::string MakeVerilogAxi4s_FromLutFilter2d(std::string module_name, std::vector< std::shared_ptr< bb::Filter2d<float, float> > > layers)
+std::pair< std::shared_ptr<bb::Sequential>, std::string > OptimizeLut(std::vector< std::shared_ptr< bb::LutLayer<float, float> > > layers)
+{
+    bb::OptimizeLutReport report;
+    auto net = bb::OptimizeLut_LutLayers<float, float>(layers, &report);
+    return std::make_pair(net, report.GetInfoString());
+}
+
+std::pair< std::shared_ptr<bb::Sequential>, std::string > OptimizeLutBit(std::vector< std::shared_ptr< bb::LutLayer<bb::Bit, float> > > layers)
+{
+    bb::OptimizeLutReport report;
+    auto net = bb::OptimizeLut_LutLayers<bb::Bit, float>(layers, &report);
+    return std::make_pair(net, report.GetInfoString());
+}
+
+std::pair< std::shared_ptr<bb::Sequential>, std::string > FoldBatchNormalization(std::shared_ptr<bb::Sequential> net)
+{
+    bb::FoldBatchNormalizationReport report;
+    auto folded_net = bb::FoldBatchNormalization_Sequential<float>(net, &report);
+    return std::make_pair(folded_net, report.GetInfoString());
+}
+
+
+std::string MakeVerilogAxi4s_FromLutFilter2d(std::string module_name, std::vector< std::shared_ptr< bb::Filter2d<float, float> > > layers,
+                int register_interval, bool lut_packing, int lut_size)
 {
+    bb::ExportVerilogConfig config;
+    config.register_interval = register_interval;
+    config.lut_packing       = lut_packing;
+    config.lut_size          = lut_size;
+
     std::stringstream ss;
-    bb::ExportVerilog_LutCnnLayersAxi4s(ss, module_name, layers);
+    bb::ExportVerilog_LutCnnLayersAxi4s<float, float>(ss, module_name, layers, config);
     return ss.str();
 }
 
-std::string MakeVerilogAxi4s_FromLutFilter2dBit(std::string module_name, std::vector< std::shared_ptr< bb::Filter2d<bb::Bit, float> > > layers)
+std::string MakeVerilogAxi4s_FromLutFilter2dBit(std::string module_name, std::vector< std::shared_ptr< bb::Filter2d<bb::Bit, float> > > layers,
+                int register_interval, bool lut_packing, int lut_size)
 {
+    bb::ExportVerilogConfig config;
+    config.register_interval = register_interval;
+    config.lut_packing       = lut_packing;
+    config.lut_size          = lut_size;
+
     std::stringstream ss;
-    bb::ExportVerilog_LutCnnLayersAxi4s(ss, module_name, layers);
+    bb::ExportVerilog_LutCnnLayersAxi4s<bb::Bit, float>(ss, module_name, layers, config);
     return ss.str();
 }
 
@@ -314,6 +410,194 @@ Returns:
 //////////////////////////////////////]
 
 namespace py = pybind11;
+
+
+// NumPy 配列との変換
+//   FrameBuffer の配列は [frame][node...] (サンプル優先)、転置は C++ 側で行う
+//   バッファプロトコルはホストメモリをコピーせずに公開する
+//   (FrameBuffer は [node][frame] の並び、resize や GPU 側での更新後は取り直すこと)
+
+template<typename T>
+void FrameBuffer_SetArray(FrameBuffer &buf, py::array_t<T, py::array::c_style | py::array::forcecast> data, bb::index_t offset, float scale)
+{
+    BB_ASSERT(data.ndim() >= 1);
+    bb::index_t size = (bb::index_t)data.shape(0);
+    BB_ASSERT(size == 0 || (bb::index_t)data.size() / size == buf.GetNodeSize());
+    py::gil_scoped_release release;
+    buf.SetDataArray<T>(data.data(), size, offset, scale);
+}
+
+void FrameBuffer_SetNumpy(FrameBuffer &buf, py::array data, bb::index_t offset, float scale)
+{
+    if ( py::isinstance< py::array_t<std::uint8_t> >(data) ) {
+        FrameBuffer_SetArray<std::uint8_t>(buf, data, offset, scale);
+    }
+    else {
+        FrameBuffer_SetArray<float>(buf, data, offset, scale);
+    }
+}
+
+py::array_t<float> FrameBuffer_GetNumpy(FrameBuffer const &buf, bb::index_t size, bb::index_t offset)
+{
+    if ( size <= 0 ) { size = buf.GetFrameSize() - offset; }
+
+    std::vector<py::ssize_t> shape;
+    shape.push_back((py::ssize_t)size);
+    auto node_shape = buf.GetShape();
+    for ( auto it = node_shape.rbegin(); it != node_shape.rend(); ++it ) {
+        shape.push_back((py::ssize_t)*it);
+    }
+
+    py::array_t<float> data(shape);
+    float *addr = data.mutable_data();
+    {
+        py::gil_scoped_release release;
+        buf.GetDataArray<float>(addr, size, offset);
+    }
+    return data;
+}
+
+void Tensor_SetNumpy(Tensor &t, py::array_t<float, py::array::c_style | py::array::forcecast> data)
+{
+    py::gil_scoped_release release;
+    t.SetDataArray<float>(data.data(), (bb::index_t)data.size());
+}
+
+py::array_t<float> Tensor_GetNumpy(Tensor const &t)
+{
+    auto tensor_shape = t.GetShape();
+    std::vector<py::ssize_t> shape(tensor_shape.rbegin(), tensor_shape.rend());
+    py::array_t<float> data(shape);
+    float *addr = data.mutable_data();
+    {
+        py::gil_scoped_release release;
+        t.GetDataArray<float>(addr, t.GetSize());
+    }
+    return data;
+}
+
+
+// numpy 配列 [frame][node...] のノード形状 (FrameBuffer と同じく逆順)
+bb::indices_t Numpy_GetNodeShape(py::array const &data)
+{
+    bb::indices_t shape;
+    for ( py::ssize_t i = data.ndim() - 1; i >= 1; --i ) {
+        shape.push_back((bb::index_t)data.shape(i));
+    }
+    return shape;
+}
+
+// numpy 配列を直接用いた学習 (エポックループ全体を GIL 解放して C++ で回す)
+double Runner_FittingArrays(Runner &runner,
+            py::array_t<float, py::array::c_style | py::array::forcecast> x_train,
+            py::array_t<float, py::array::c_style | py::array::forcecast> t_train,
+            bb::index_t epoch_size, bb::index_t batch_size, py::object x_test_obj, py::object t_test_obj)
+{
+    BB_ASSERT(x_train.ndim() >= 2 && t_train.ndim() >= 2);
+    BB_ASSERT(x_train.shape(0) == t_train.shape(0));
+
+    py::array_t<float, py::array::c_style | py::array::forcecast> x_test;
+    py::array_t<float, py::array::c_style | py::array::forcecast> t_test;
+    float const *x_test_addr = nullptr;
+    float const *t_test_addr = nullptr;
+    bb::index_t  test_size   = 0;
+    if ( !x_test_obj.is_none() && !t_test_obj.is_none() ) {
+        x_test = py::array_t<float, py::array::c_style | py::array::forcecast>(x_test_obj);
+        t_test = py::array_t<float, py::array::c_style | py::array::forcecast>(t_test_obj);
+        BB_ASSERT(x_test.shape(0) == t_test.shape(0));
+        BB_ASSERT(x_test.size() / x_test.shape(0) == x_train.size() / x_train.shape(0));
+        BB_ASSERT(t_test.size() / t_test.shape(0) == t_train.size() / t_train.shape(0));
+        x_test_addr = x_test.data();
+        t_test_addr = t_test.data();
+        test_size   = (bb::index_t)x_test.shape(0);
+    }
+
+    auto x_shape = Numpy_GetNodeShape(x_train);
+    auto t_shape = Numpy_GetNodeShape(t_train);
+
+    py::gil_scoped_release release;
+    return runner.FittingArray(x_train.data(), t_train.data(), (bb::index_t)x_train.shape(0),
+                    x_test_addr, t_test_addr, test_size, x_shape, t_shape, epoch_size, batch_size);
+}
+
+double Runner_EvaluationArrays(Runner &runner,
+            py::array_t<float, py::array::c_style | py::array::forcecast> x,
+            py::array_t<float, py::array::c_style | py::array::forcecast> t,
+            bb::index_t batch_size)
+{
+    BB_ASSERT(x.ndim() >= 2 && t.ndim() >= 2);
+    BB_ASSERT(x.shape(0) == t.shape(0));
+
+    auto x_shape = Numpy_GetNodeShape(x);
+    auto t_shape = Numpy_GetNodeShape(t);
+
+    py::gil_scoped_release release;
+    return runner.EvaluationArray(x.data(), t.data(), (bb::index_t)x.shape(0), x_shape, t_shape, batch_size);
+}
+
+py::buffer_info MakeBufferInfo(void *addr, int type, std::vector<py::ssize_t> shape, std::vector<py::ssize_t> strides)
+{
+    py::ssize_t itemsize;
+    std::string format;
+    switch ( type ) {
+    case BB_TYPE_FP32:   itemsize = 4; format = py::format_descriptor<float        >::format(); break;
+    case BB_TYPE_FP64:   itemsize = 8; format = py::format_descriptor<double       >::format(); break;
+    case BB_TYPE_INT8:   itemsize = 1; format = py::format_descriptor<std::int8_t  >::format(); break;
+    case BB_TYPE_INT16:  itemsize = 2; format = py::format_descriptor<std::int16_t >::format(); break;
+    case BB_TYPE_INT32:  itemsize = 4; format = py::format_descriptor<std::int32_t >::format(); break;
+    case BB_TYPE_INT64:  itemsize = 8; format = py::format_descriptor<std::int64_t >::format(); break;
+    case BB_TYPE_UINT8:  itemsize = 1; format = py::format_descriptor<std::uint8_t >::format(); break;
+    case BB_TYPE_UINT16: itemsize = 2; format = py::format_descriptor<std::uint16_t>::format(); break;
+    case BB_TYPE_UINT32: itemsize = 4; format = py::format_descriptor<std::uint32_t>::format(); break;
+    case BB_TYPE_UINT64: itemsize = 8; format = py::format_descriptor<std::uint64_t>::format(); break;
+    default: throw std::runtime_error("buffer protocol is not supported for this data type");
+    }
+    for ( auto &s : strides ) { s *= itemsize; }
+    return py::buffer_info(addr, itemsize, format, (py::ssize_t)shape.size(), shape, strides);
+}
+
+// バッファプロトコルはホストメモリの参照を返すだけでロックを保持しない。
+// CUDA 有効時にデバイス側で更新されると見えている内容は古くなり、
+// ビュー経由のホスト側の書き込みも次にデバイス側をロックした時点で失われるため、
+// host_only のオブジェクトに限定する(それ以外は numpy() でコピーを取る)
+inline void CheckBufferHostOnly(bool host_only)
+{
+#ifdef BB_WITH_CUDA
+    if ( !host_only && bb::Manager::IsDeviceAvailable() ) {
+        throw std::runtime_error("buffer protocol is host-only: create the object with host_only=True or use numpy() to copy");
+    }
+#else
+    (void)host_only;
+#endif
+}
+
+py::buffer_info Tensor_GetBufferInfo(Tensor &t)
+{
+    CheckBufferHostOnly(t.IsHostOnly());
+
+    auto tensor_shape  = t.GetShape();
+    auto tensor_stride = t.GetStride();
+    std::vector<py::ssize_t> shape(tensor_shape.rbegin(), tensor_shape.rend());
+    std::vector<py::ssize_t> strides(tensor_stride.rbegin(), tensor_stride.rend());
+    auto ptr = t.LockMemory();
+    return MakeBufferInfo(ptr.GetAddr(), t.GetType(), shape, strides);
+}
+
+py::buffer_info FrameBuffer_GetBufferInfo(FrameBuffer &buf)
+{
+    if ( buf.GetType() == BB_TYPE_BIT ) {
+        throw std::runtime_error("buffer protocol is not supported for TYPE_BIT");
+    }
+    CheckBufferHostOnly(buf.IsHostOnly());
+
+    auto ptr  = buf.LockMemory();
+    auto item = (py::ssize_t)bb::DataType_GetByteSize(buf.GetType());
+    return MakeBufferInfo(ptr.GetAddr(), buf.GetType(),
+                {(py::ssize_t)buf.GetNodeSize(), (py::ssize_t)buf.GetFrameSize()},
+                {(py::ssize_t)buf.GetFrameStride() / item, 1});
+}
+
+
 PYBIND11_MODULE(core, m) {
     m.doc() = "BinaryBrain ver " + bb::GetVersionString();
 
@@ -342,17 +626,21 @@ PYBIND11_MODULE(core, m) {
 
 
     // Tensor
-    py::class_< Tensor >(m, "Tensor")
+    py::class_< Tensor >(m, "Tensor", py::buffer_protocol())
+        .def_buffer(&Tensor_GetBufferInfo)
         .def("get_type", &Tensor::GetType, doc__Tensor__get_type)
         .def("get_shape", &Tensor::GetShape, doc__Tensor__get_shape)
+        .def("set_data", &Tensor_SetNumpy, doc__Tensor__set_data)
         .def("set_data", &Tensor::SetData<float>, doc__Tensor__set_data)
+        .def("numpy", &Tensor_GetNumpy, "get data as numpy.ndarray (shape is reversed tensor shape)")
         .def("get_data", &Tensor::GetData<float>, doc__Tensor__get_data)
         .def("set_data_int32", &Tensor::SetData<int>, doc__Tensor__set_data_int32)
         .def("get_data_int32", &Tensor::GetData<int>, doc__Tensor__get_data_int32);
 
 
     // FrameBuffer
-    py::class_< FrameBuffer >(m, "FrameBuffer")
+    py::class_< FrameBuffer >(m, "FrameBuffer", py::buffer_protocol())
+        .def_buffer(&FrameBuffer_GetBufferInfo)
         .def(py::init< bb::index_t, bb::indices_t, int, bool>(), doc__FrameBuffer__init,
             py::arg("frame_size") = 0,
             py::arg("shape") = bb::indices_t(),
@@ -370,6 +658,20 @@ PYBIND11_MODULE(core, m) {
         .def("range", &FrameBuffer::Range)
         .def("concatenate", &FrameBuffer::Concatenate)
 
+        .def("set_data", &FrameBuffer_SetNumpy,
+R"(set data to frames
+
+    set data from numpy.ndarray (float32 or uint8 are copied without conversion)
+
+Args:
+    data(numpy.ndarray): data [frame][node...]
+    offset(int): offset
+    scale(float): scale factor applied while copying (e.g. 1/255 for uint8 images)
+)",
+                py::arg("data"),
+                py::arg("offset") = 0,
+                py::arg("scale") = 1.0f)
+
         .def("set_data", &FrameBuffer::SetData<float>,
 R"(set data to frames
 
@@ -387,6 +689,18 @@ R"(get data from frames
 
     set data to frames
 
+Args:
+    size(int): size (If you specify 0 or less, it will be the size to the end)
+    offset(int): offset
+)",
+                py::arg("size") = 0,
+                py::arg("offset") = 0)
+
+        .def("numpy", &FrameBuffer_GetNumpy,
+R"(get data as numpy.ndarray
+
+    get data as numpy.ndarray [frame][node...]
+
 Args:
     size(int): size (If you specify 0 or less, it will be the size to the end)
     offset(int): offset
@@ -404,6 +718,11 @@ Args:
     //  Models
     // ------------------------------------
     
+    // inference context
+    py::class_< InferenceContext >(m, "InferenceContext")
+        .def(py::init<>())
+        .def("clear", &InferenceContext::Clear);
+
     // model
     py::class_< Model, std::shared_ptr<Model> >(m, "Model")
         .def("get_name", &Model::GetName)
@@ -420,14 +739,19 @@ Args:
         .def("get_parameters", &Model::GetParameters)
         .def("get_gradients", &Model::GetGradients)
         .def("forward_node",  &Model::ForwardNode)
-        .def("forward",  &Model::Forward, "Forward",
+        .def("forward",  (FrameBuffer (Model::*)(FrameBuffer, bool))&Model::Forward, "Forward",
                 py::arg("x_buf"),
-                py::arg("train") = true)
-        .def("backward", &Model::Backward, "Backward")
+                py::arg("train") = true,
+                py::call_guard<py::gil_scoped_release>())
+        .def("forward_inference",  (FrameBuffer (Model::*)(FrameBuffer, InferenceContext &) const)&Model::Forward, "Forward for inference",
+                py::arg("x_buf"),
+                py::arg("ctx"),
+                py::call_guard<py::gil_scoped_release>())
+        .def("backward", &Model::Backward, "Backward",
+                py::call_guard<py::gil_scoped_release>())
         .def("send_command",  &Model::SendCommand, "SendCommand",
                 py::arg("command"),
                 py::arg("send_to") = "all")
-        .def("backward", &Model::Backward, "Backward")
         .def("save_binary", &Model::SaveBinary)
         .def("load_binary", &Model::LoadBinary)
         .def("save_json", &Model::SaveJson)
@@ -457,6 +781,23 @@ Args:
         .def("dW", ((Tensor& (DepthwiseDenseAffine::*)())&DepthwiseDenseAffine::dW))
         .def("db", ((Tensor& (DepthwiseDenseAffine::*)())&DepthwiseDenseAffine::db));
 
+    // BinaryDense
+    py::class_< BinaryDense, Model, std::shared_ptr<BinaryDense> >(m, "BinaryDense")
+        .def_static("create",   &BinaryDense::CreateEx, "create",
+            py::arg("output_shape"),
+            py::arg("initialize_std") = 0.01f,
+            py::arg("seed")           = 1)
+        .def("W", ((Tensor& (BinaryDense::*)())&BinaryDense::W))
+        .def("dW", ((Tensor& (BinaryDense::*)())&BinaryDense::dW));
+
+    py::class_< BinaryDenseBit, Model, std::shared_ptr<BinaryDenseBit> >(m, "BinaryDenseBit")
+        .def_static("create",   &BinaryDenseBit::CreateEx, "create",
+            py::arg("output_shape"),
+            py::arg("initialize_std") = 0.01f,
+            py::arg("seed")           = 1)
+        .def("W", ((Tensor& (BinaryDenseBit::*)())&BinaryDenseBit::W))
+        .def("dW", ((Tensor& (BinaryDenseBit::*)())&BinaryDenseBit::dW));
+
     // SparseLayer
     py::class_< SparseLayer, Model, std::shared_ptr<SparseLayer> >(m, "SparseLayer")
          .def("get_connection_size", &SparseLayer::GetConnectionSize)
@@ -495,7 +836,14 @@ Args:
                 py::arg("inference_value_generator") = nullptr,
                 py::arg("inference_framewise")       = true,
                 py::arg("inference_input_range_lo")  = 0.0f,
-                py::arg("inference_input_range_hi")  = 1.0f);
+                py::arg("inference_input_range_hi")  = 1.0f)
+        .def("set_anytime_inference", &BinaryModulation::SetAnytimeInference,
+                py::arg("stage_size"),
+                py::arg("margin")    = 0.5f,
+                py::arg("min_stage") = 1,
+                py::arg("exact")     = false)
+        .def("get_anytime_average_modulation_size", &BinaryModulation::GetAnytimeAverageModulationSize)
+        .def("reset_anytime_statistics", &BinaryModulation::ResetAnytimeStatistics);
 
     py::class_< BinaryModulationBit, Model, std::shared_ptr<BinaryModulationBit> >(m, "BinaryModulationBit")
         .def_static("create", &BinaryModulationBit::CreateEx,
@@ -510,7 +858,14 @@ Args:
                 py::arg("inference_value_generator") = nullptr,
                 py::arg("inference_framewise")       = true,
                 py::arg("inference_input_range_lo")  = 0.0f,
-                py::arg("inference_input_range_hi")  = 1.0f);
+                py::arg("inference_input_range_hi")  = 1.0f)
+        .def("set_anytime_inference", &BinaryModulationBit::SetAnytimeInference,
+                py::arg("stage_size"),
+                py::arg("margin")    = 0.5f,
+                py::arg("min_stage") = 1,
+                py::arg("exact")     = false)
+        .def("get_anytime_average_modulation_size", &BinaryModulationBit::GetAnytimeAverageModulationSize)
+        .def("reset_anytime_statistics", &BinaryModulationBit::ResetAnytimeStatistics);
 
     py::class_< RealToBinary, Model, std::shared_ptr<RealToBinary> >(m, "RealToBinary")
         .def_static("create", &RealToBinary::CreateEx,
@@ -563,7 +918,11 @@ R"(create BinaryLut6 object
                 py::arg("momentum")   = 0.0,
                 py::arg("gamma")      = 0.3,
                 py::arg("beta")       = 0.5,
-                py::arg("seed")       = 1);
+                py::arg("seed")       = 1)
+        .def("set_sparse_gradient", &SparseLut6::SetSparseGradient,
+                py::arg("enable"),
+                py::arg("threshold") = 0.01f)
+        .def("is_sparse_gradient", &SparseLut6::IsSparseGradient);
 
     py::class_< SparseLut6Bit, SparseLayer, std::shared_ptr<SparseLut6Bit> >(m, "SparseLut6Bit")
         .def_static("create", &SparseLut6Bit::CreateEx, "create SparseLut6Bit",
@@ -573,20 +932,32 @@ R"(create BinaryLut6 object
                 py::arg("momentum")   = 0.0,
                 py::arg("gamma")      = 0.3,
                 py::arg("beta")       = 0.5,
-                py::arg("seed")       = 1);
+                py::arg("seed")       = 1)
+        .def("set_sparse_gradient", &SparseLut6Bit::SetSparseGradient,
+                py::arg("enable"),
+                py::arg("threshold") = 0.01f)
+        .def("is_sparse_gradient", &SparseLut6Bit::IsSparseGradient);
     
     
     py::class_< StochasticLut6, SparseLayer, std::shared_ptr<StochasticLut6> >(m, "StochasticLut6")
         .def_static("create", &StochasticLut6::CreateEx, "create StochasticLut6",
                 py::arg("output_shape"),
                 py::arg("connection") = "",
-                py::arg("seed") = 1);
+                py::arg("seed") = 1)
+        .def("set_sparse_gradient", &StochasticLut6::SetSparseGradient,
+                py::arg("enable"),
+                py::arg("threshold") = 0.01f)
+        .def("is_sparse_gradient", &StochasticLut6::IsSparseGradient);
     
     py::class_< StochasticLut6Bit, SparseLayer, std::shared_ptr<StochasticLut6Bit> >(m, "StochasticLut6Bit")
         .def_static("create", &StochasticLut6Bit::CreateEx, "create StochasticLut6Bit",
                 py::arg("output_shape"),
                 py::arg("connection") = "",
-                py::arg("seed") = 1);
+                py::arg("seed") = 1)
+        .def("set_sparse_gradient", &StochasticLut6Bit::SetSparseGradient,
+                py::arg("enable"),
+                py::arg("threshold") = 0.01f)
+        .def("is_sparse_gradient", &StochasticLut6Bit::IsSparseGradient);
     
     
     // filter
@@ -641,6 +1012,26 @@ R"(create BinaryLut6 object
                 py::arg("hardtanh_min") = -1.0f,
                 py::arg("hardtanh_max") = +1.0f);
 
+    py::class_< BinarizeThreshold, Activation, std::shared_ptr<BinarizeThreshold> >(m, "BinarizeThreshold")
+        .def_static("create", (std::shared_ptr<BinarizeThreshold> (*)(bb::indices_t const &))&BinarizeThreshold::Create,
+                py::arg("shape"))
+        .def("set_threshold", &BinarizeThreshold::SetThreshold,
+                py::arg("node"),
+                py::arg("th"),
+                py::arg("invert") = false)
+        .def("get_threshold", &BinarizeThreshold::GetThreshold)
+        .def("get_invert",    &BinarizeThreshold::GetInvert);
+
+    py::class_< BinarizeThresholdBit, Activation, std::shared_ptr<BinarizeThresholdBit> >(m, "BinarizeThresholdBit")
+        .def_static("create", (std::shared_ptr<BinarizeThresholdBit> (*)(bb::indices_t const &))&BinarizeThresholdBit::Create,
+                py::arg("shape"))
+        .def("set_threshold", &BinarizeThresholdBit::SetThreshold,
+                py::arg("node"),
+                py::arg("th"),
+                py::arg("invert") = false)
+        .def("get_threshold", &BinarizeThresholdBit::GetThreshold)
+        .def("get_invert",    &BinarizeThresholdBit::GetInvert);
+
     py::class_< Sigmoid, Binarize, std::shared_ptr<Sigmoid> >(m, "Sigmoid")
         .def_static("create",   &Sigmoid::Create);
 
@@ -661,6 +1052,41 @@ R"(create BinaryLut6 object
                 py::arg("rate") = 0.5,
                 py::arg("seed") = 1);
 
+    py::class_< DataAugmentation, Activation, std::shared_ptr<DataAugmentation> >(m, "DataAugmentation")
+        .def_static("create", &DataAugmentation::CreateEx,
+R"(create DataAugmentation
+
+    random affine / flip / crop / negative / noise for image input (applied only when train=True)
+
+Args:
+    shift_x_range(float): shift range (ratio of width)
+    shift_y_range(float): shift range (ratio of height)
+    rotation_range(float): rotation range (degree)
+    scale_range(float): scale range
+    flip_x_rate(float): horizontal flip rate
+    flip_y_rate(float): vertical flip rate
+    crop_padding(int): random crop with padding (pixels)
+    neg_rate(float): negative rate
+    noise_stddev(float): stddev of gaussian noise
+    rate(float): rate of augmented frames
+    border_replicate(bool): replicate border pixels (otherwise border_value)
+    border_value(float): value of outside
+    seed(int): seed of random
+)",
+                py::arg("shift_x_range")    = 0.0f,
+                py::arg("shift_y_range")    = 0.0f,
+                py::arg("rotation_range")   = 0.0f,
+                py::arg("scale_range")      = 0.0f,
+                py::arg("flip_x_rate")      = 0.0f,
+                py::arg("flip_y_rate")      = 0.0f,
+                py::arg("crop_padding")     = 0,
+                py::arg("neg_rate")         = 0.0f,
+                py::arg("noise_stddev")     = 0.0f,
+                py::arg("rate")             = 1.0f,
+                py::arg("border_replicate") = false,
+                py::arg("border_value")     = 0.0f,
+                py::arg("seed")             = 1);
+
     py::class_< BatchNormalization, Activation, std::shared_ptr<BatchNormalization> >(m, "BatchNormalization")
         .def_static("create", &BatchNormalization::CreateEx,
                 py::arg("momentum")  = 0.9f,
@@ -682,7 +1108,8 @@ R"(create BinaryLut6 object
         .def("calculate_loss", &LossFunction::CalculateLoss,
             py::arg("y_buf"),
             py::arg("t_buf"),
-            py::arg("mini_batch_size"));
+            py::arg("mini_batch_size"),
+            py::call_guard<py::gil_scoped_release>());
 
     py::class_< LossSoftmaxCrossEntropy, LossFunction, std::shared_ptr<LossSoftmaxCrossEntropy> >(m, "LossSoftmaxCrossEntropy")
         .def_static("create", &LossSoftmaxCrossEntropy::Create);
@@ -695,7 +1122,7 @@ R"(create BinaryLut6 object
     py::class_< MetricsFunction, std::shared_ptr<MetricsFunction> >(m, "MetricsFunction")
         .def("clear",              &MetricsFunction::Clear)
         .def("get_metrics",        &MetricsFunction::GetMetrics)
-        .def("calculate_metrics",  &MetricsFunction::CalculateMetrics)
+        .def("calculate_metrics",  &MetricsFunction::CalculateMetrics, py::call_guard<py::gil_scoped_release>())
         .def("get_metrics_string", &MetricsFunction::GetMetricsString);
 
     py::class_< MetricsCategoricalAccuracy, MetricsFunction, std::shared_ptr<MetricsCategoricalAccuracy> >(m, "MetricsCategoricalAccuracy")
@@ -708,7 +1135,7 @@ R"(create BinaryLut6 object
     // Optimizer
     py::class_< Optimizer, std::shared_ptr<Optimizer> >(m, "Optimizer")
         .def("set_variables", &Optimizer::SetVariables)
-        .def("update",        &Optimizer::Update);
+        .def("update",        &Optimizer::Update, py::call_guard<py::gil_scoped_release>());
     
     py::class_< OptimizerSgd, Optimizer, std::shared_ptr<OptimizerSgd> >(m, "OptimizerSgd")
         .def_static("create", (std::shared_ptr<OptimizerSgd> (*)(float))&OptimizerSgd::Create, "create",
@@ -789,25 +1216,102 @@ R"(create BinaryLut6 object
             py::arg("write_serial") = false,
             py::arg("initial_evaluation") = false,
             py::arg("seed") = 1)
+        .def("set_evaluation_size", &Runner::SetEvaluationSize,
+            py::arg("test_size"),
+            py::arg("train_size"),
+            py::arg("train_reuse") = false)
+        .def("set_evaluation_net", &Runner::SetEvaluationNet,
+            py::arg("eval_net"),
+            py::arg("eval_metricsFunc"))
         .def("fitting", &Runner::Fitting,
             py::arg("td"),
             py::arg("epoch_size"),
+            py::arg("batch_size"),
+            py::call_guard<py::gil_scoped_release>())
+        .def("evaluation", &Runner::Evaluation,
+            py::arg("td"),
+            py::arg("batch_size"),
+            py::call_guard<py::gil_scoped_release>())
+        .def("fitting_arrays", &Runner_FittingArrays,
+R"(fitting with numpy arrays
+
+    run whole epoch loop in C++ without GIL
+
+Args:
+    x_train(numpy.ndarray): input data [frame][node...]
+    t_train(numpy.ndarray): teaching data [frame][node...]
+    epoch_size(int): epoch size
+    batch_size(int): mini batch size
+    x_test(numpy.ndarray): input data for evaluation (if None, x_train is used)
+    t_test(numpy.ndarray): teaching data for evaluation
+
+Returns:
+    float: metrics of last epoch
+)",
+            py::arg("x_train"),
+            py::arg("t_train"),
+            py::arg("epoch_size"),
+            py::arg("batch_size"),
+            py::arg("x_test") = py::none(),
+            py::arg("t_test") = py::none())
+        .def("evaluation_arrays", &Runner_EvaluationArrays,
+            py::arg("x"),
+            py::arg("t"),
             py::arg("batch_size"));
 
     
-    // OpenMP
-    m.def("omp_set_num_threads", &omp_set_num_threads);
+    // Thread
+    m.def("omp_set_num_threads", &SetNumThreads);
+    m.def("set_num_threads",     &SetNumThreads);
+    m.def("get_num_threads",     &bb::GetThreadSize);
+
+    // NUMA
+    m.def("set_numa_mode", &SetNumaMode,
+            py::arg("enable")       = true,
+            py::arg("bind_threads") = true);
+    m.def("get_numa_info", &bb::Numa::GetInfoString);
+
+    // SIMD
+    m.def("set_simd_level", &SetSimdLevel, py::arg("level") = "avx512");
+    m.def("get_simd_level", &GetSimdLevel);
+    m.def("get_simd_info",  &bb::GetSimdInfoString);
 
     // CUDA device
     m.def("get_device_count",      &GetDeviceCount);
     m.def("set_device",            &SetDevice,                 py::arg("device") = 0);
     m.def("get_device_properties", &GetDevicePropertiesString, py::arg("device") = 0);
 
+    // node reordering
+    m.def("reorder_nodes", (int (*)(std::shared_ptr<bb::Sequential>))&bb::ReorderNodes, py::call_guard<py::gil_scoped_release>());
+
+    // LUT logic optimization
+    m.def("optimize_lut",     &OptimizeLut,    py::call_guard<py::gil_scoped_release>());
+    m.def("optimize_lut_bit", &OptimizeLutBit, py::call_guard<py::gil_scoped_release>());
+    m.def("fold_batch_normalization", &FoldBatchNormalization, py::call_guard<py::gil_scoped_release>());
+
     // verilog
-    m.def("make_verilog_from_lut", &MakeVerilog_FromLut);
-    m.def("make_verilog_from_lut_bit", &MakeVerilog_FromLutBit);
-    m.def("make_verilog_axi4s_from_lut_cnn", &MakeVerilogAxi4s_FromLutFilter2d);
-    m.def("make_verilog_axi4s_from_lut_cnn_bit", &MakeVerilogAxi4s_FromLutFilter2dBit);
+    m.def("make_verilog_from_lut", &MakeVerilog_FromLut,
+            py::arg("module_name"), py::arg("layers"),
+            py::arg("register_interval") = 1,
+            py::arg("lut_packing")       = false,
+            py::arg("lut_size")          = 6);
+    m.def("make_verilog_from_lut_bit", &MakeVerilog_FromLutBit,
+            py::arg("module_name"), py::arg("layers"),
+            py::arg("register_interval") = 1,
+            py::arg("lut_packing")       = false,
+            py::arg("lut_size")          = 6);
+    m.def("make_cpp_from_lut",     &MakeCpp_FromLut,    py::arg("func_name"), py::arg("layers"), py::arg("simd") = "u64");
+    m.def("make_cpp_from_lut_bit", &MakeCpp_FromLutBit, py::arg("func_name"), py::arg("layers"), py::arg("simd") = "u64");
+    m.def("make_verilog_axi4s_from_lut_cnn", &MakeVerilogAxi4s_FromLutFilter2d,
+            py::arg("module_name"), py::arg("layers"),
+            py::arg("register_interval") = 1,
+            py::arg("lut_packing")       = false,
+            py::arg("lut_size")          = 6);
+    m.def("make_verilog_axi4s_from_lut_cnn_bit", &MakeVerilogAxi4s_FromLutFilter2dBit,
+            py::arg("module_name"), py::arg("layers"),
+            py::arg("register_interval") = 1,
+            py::arg("lut_packing")       = false,
+            py::arg("lut_size")          = 6);
 
     m.def("get_version", &bb::GetVersionString);
 }
@@ -288,11 +288,11 @@ class BuildExt(build_ext):
     ar_args = {'unix':[], 'msvc':[]}
     if CUDA is None:
         # unix(cpu)
-        cc_args['unix'] += ['-mavx2', '-mfma', '-fopenmp', '-std=c++14']
+        cc_args['unix'] += ['-fopenmp', '-std=c++14']
         ar_args['unix'] += ['-fopenmp', '-lstdc++', '-lm']
         
         # windows(cpu)
-        cc_args['msvc'] += ['/EHsc', '/Oi', '/MT', '/arch:AVX2', '/openmp', '/std:c++14', '/wd"4819"']
+        cc_args['msvc'] += ['/EHsc', '/Oi', '/MT', '/openmp', '/std:c++14', '/wd"4819"']
         ar_args['msvc'] += []
     else:
         # unix(gpu)
@@ -302,8 +302,6 @@ class BuildExt(build_ext):
                             '-gencode=arch=compute_61,code=sm_61',
                             '-gencode=arch=compute_75,code=sm_75',
                             '-Xcompiler', '-pthread',
-                            '-Xcompiler', '-mavx2',
-                            '-Xcompiler', '-mfma',
                             '-Xcompiler', '-fopenmp',
                             '-Xcompiler', '-std=c++14',
                             '-Xcompiler', '-fPIC' ]
@@ -327,7 +325,6 @@ class BuildExt(build_ext):
                             '-Xcompiler', '/FS',
                             '-Xcompiler', '/Zi',
                             '-Xcompiler', '/MT',
-                            '-Xcompiler', '/arch:AVX2',
                             '-Xcompiler', '/openmp',
                             '-Xcompiler', '/std:c++14',
                             '-Xcompiler', '/wd\"4819\"']
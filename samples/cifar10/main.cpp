@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "bb/Version.h"
+#include "bb/ThreadPool.h"
 #ifdef BB_WITH_CUDA
 #include "bbcu/bbcu.h"
 #endif
@@ -72,6 +73,7 @@ int main(int argc, char *argv[])
 #ifdef _OPENMP
             omp_set_num_threads(num_threads);
 #endif
+            bb::SetThreadSize(num_threads);
         }
         else if (strcmp(argv[i], "-epoch") == 0 && i + 1 < argc) {
             ++i;
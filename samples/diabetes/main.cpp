@@ -10,6 +10,7 @@
 #include <omp.h>
 
 #include "bb/Manager.h"
+#include "bb/ThreadPool.h"
 
 void DiabetesAffineRegression(int epoch_size, size_t mini_batch_size);
 void DiabetesRegressionMicroMlpLut(int epoch_size, size_t mini_batch_size, size_t mux_size);
@@ -19,7 +20,10 @@ void DiabetesRegressionStochasticLut6(int epoch_size, size_t mini_batch_size);
 // メイン関数
 int main()
 {
+#ifdef _OPENMP
     omp_set_num_threads(4);
+#endif
+    bb::SetThreadSize(4);
 
     // 普通のDenseAffineでの回帰
     DiabetesAffineRegression(64, 16);
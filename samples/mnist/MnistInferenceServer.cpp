@@ -0,0 +1,96 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   MNIST sample
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include <iostream>
+#include <fstream>
+
+#include "bb/Sequential.h"
+#include "bb/BinaryModulation.h"
+#include "bb/DenseAffine.h"
+#include "bb/BatchNormalization.h"
+#include "bb/ReLU.h"
+#include "bb/Runner.h"
+#include "bb/InferenceServer.h"
+
+
+// MnistDenseSimple で学習したネットを読み込んで推論サーバーとして動かす
+void MnistInferenceServer(std::string socket_path, int max_batch_size, double max_delay, int train_modulation_size, int test_modulation_size, bool binary_mode)
+{
+#ifndef _WIN32
+    std::string net_name = "MnistDenseSimple";
+
+    // create network (MnistDenseSimple と同じ構成)
+    auto main_net = bb::Sequential::Create();
+    main_net->Add(bb::DenseAffine<float>::Create(1024));
+    main_net->Add(bb::BatchNormalization<float>::Create());
+    main_net->Add(bb::ReLU<float>::Create());
+    main_net->Add(bb::DenseAffine<float>::Create(512));
+    main_net->Add(bb::BatchNormalization<float>::Create());
+    main_net->Add(bb::ReLU<float>::Create());
+    main_net->Add(bb::DenseAffine<float>::Create(bb::indices_t({10})));
+    if ( binary_mode ) {
+        main_net->Add(bb::BatchNormalization<float>::Create());
+        main_net->Add(bb::ReLU<float>::Create());
+    }
+
+    auto net = bb::BinaryModulation<float>::Create(main_net, train_modulation_size, test_modulation_size);
+    net->SetInputShape({28, 28, 1});
+    net->SendCommand(binary_mode ? "binary true" : "binary false");
+
+    // load
+    bb::Runner<float>::create_t runner_create;
+    runner_create.name = net_name;
+    runner_create.net  = net;
+    auto runner = bb::Runner<float>::Create(runner_create);
+
+#ifdef BB_WITH_CEREAL
+    std::string net_file_name = net_name + "_net.json";
+#else
+    std::string net_file_name = net_name + "_net.bin";
+#endif
+    if ( !std::ifstream(net_file_name).is_open() ) {
+        std::cout << "[error] " << net_file_name << " not found. run DenseSimple first." << std::endl;
+        return;
+    }
+#ifdef BB_WITH_CEREAL
+    runner->LoadJson(net_file_name);
+#else
+    runner->LoadBinary(net_file_name);
+#endif
+    std::cout << "[load] " << net_file_name << std::endl;
+
+    // 推論用の変調設定に切り替えておく
+    net->Forward(bb::FrameBuffer(1, {28, 28, 1}, BB_TYPE_FP32), false);
+
+    // start server
+    bb::InferenceServer::create_t server_create;
+    server_create.net            = net;
+    server_create.socket_path    = socket_path;
+    server_create.max_batch_size = max_batch_size;
+    server_create.max_delay      = max_delay;
+    auto server = bb::InferenceServer::Create(server_create);
+    if ( !server->Start() ) {
+        std::cout << "[error] failed to listen " << socket_path << std::endl;
+        return;
+    }
+
+    std::cout << "listening        : " << socket_path << std::endl;
+    std::cout << "max_batch_size   : " << max_batch_size << std::endl;
+    std::cout << "max_delay        : " << max_delay * 1000.0 << " [ms]" << std::endl;
+    std::cout << "press enter key to stop." << std::endl;
+    std::cin.get();
+
+    server->Stop();
+    std::cout << server->GetStatisticsString() << std::endl;
+#else
+    std::cout << "inference server is not supported on this platform." << std::endl;
+#endif
+}
+
+
+// end of file
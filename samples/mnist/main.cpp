@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "bb/Version.h"
+#include "bb/ThreadPool.h"
 
 #ifdef BB_WITH_CUDA
 #include "bbcu/bbcu.h"
@@ -28,6 +29,7 @@ void MnistDenseCnn           (int epoch_size, int mini_batch_size, int train_mod
 void MnistCustomModel        (int epoch_size, int mini_batch_size,                                                      bool binary_mode                );
 void MnistAeSparseLutSimple  (int epoch_size, int mini_batch_size, int train_modulation_size, int test_modulation_size, bool binary_mode, bool file_read);
 void MnistAeSparseLutCnn     (int epoch_size, int mini_batch_size, int train_modulation_size, int test_modulation_size, bool binary_mode, bool file_read);
+void MnistInferenceServer    (std::string socket_path, int max_batch_size, double max_delay, int train_modulation_size, int test_modulation_size, bool binary_mode);
 
 
 // メイン関数
@@ -42,6 +44,9 @@ int main(int argc, char *argv[])
     bool        file_read             = false;
     bool        binary_mode           = true;
     bool        print_device          = false;
+    std::string socket_path           = "/tmp/bb_mnist.sock";
+    int         max_batch_size        = 256;
+    double      max_delay             = 1.0;
 
     std::cout << "BinaryBrain version " << bb::GetVersionString();
     std::cout << "  MNIST sample\n" << std::endl;
@@ -57,6 +62,9 @@ int main(int argc, char *argv[])
         std::cout << "  -test_modulation_size <modulation_size> set test modulation size" << std::endl;
         std::cout << "  -binary <0|1>                           set binary mode" << std::endl;
         std::cout << "  -read <0|1>                             file read" << std::endl;
+        std::cout << "  -socket <path>                          set socket path (Server)" << std::endl;
+        std::cout << "  -max_batch <frame size>                 set max batch size (Server)" << std::endl;
+        std::cout << "  -max_delay <ms>                         set max batching delay (Server)" << std::endl;
         std::cout << "" << std::endl;
         std::cout << "<sample name>" << std::endl;
         std::cout << "  StochasticLutSimple Stochastic-Lut LUT-Network Simple DNN" << std::endl;
@@ -68,6 +76,7 @@ int main(int argc, char *argv[])
         std::cout << "  AeSparseLutSimple   AutoEncoder Simple DNN" << std::endl;
         std::cout << "  AeSparseLutCnn      AutoEncoder CNN" << std::endl;
         std::cout << "  All                 run all" << std::endl;
+        std::cout << "  Server              inference server (loads DenseSimple result)" << std::endl;
         return 1;
     }
 
@@ -78,6 +87,7 @@ int main(int argc, char *argv[])
 #ifdef _OPENMP
             omp_set_num_threads(num_threads);
 #endif
+            bb::SetThreadSize(num_threads);
         }
         else if (strcmp(argv[i], "-epoch") == 0 && i + 1 < argc) {
             ++i;
@@ -103,6 +113,18 @@ int main(int argc, char *argv[])
             ++i;
             file_read = (strtoul(argv[i], NULL, 0) != 0);
         }
+        else if (strcmp(argv[i], "-socket") == 0 && i + 1 < argc) {
+            ++i;
+            socket_path = argv[i];
+        }
+        else if (strcmp(argv[i], "-max_batch") == 0 && i + 1 < argc) {
+            ++i;
+            max_batch_size = (int)strtoul(argv[i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-max_delay") == 0 && i + 1 < argc) {
+            ++i;
+            max_delay = strtod(argv[i], NULL);
+        }
         else if (strcmp(argv[i], "-print_device") == 0 ) {
             print_device = true;
         }
@@ -162,6 +184,11 @@ int main(int argc, char *argv[])
         MnistAeSparseLutCnn(epoch_size, mini_batch_size, train_modulation_size, test_modulation_size, binary_mode, file_read);
     }
 
+    // 推論サーバー
+    if ( netname == "Server" ) {
+        MnistInferenceServer(socket_path, max_batch_size, max_delay / 1000.0, train_modulation_size, test_modulation_size, binary_mode);
+    }
+
     // (おまけ)レイヤー内部を自分で書く人向けサンプル
     if ( strcmp(argv[1], "Custom") == 0 ) {
         MnistCustomModel(epoch_size, mini_batch_size, binary_mode);
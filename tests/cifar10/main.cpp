@@ -10,6 +10,8 @@
 #include <iostream>
 #include <string.h>
 
+#include "bb/ThreadPool.h"
+
 #ifdef BB_WITH_CUDA
 #include "bbcu/bbcu.h"
 #endif
@@ -73,6 +75,7 @@ int main(int argc, char *argv[])
 #ifdef _OPENMP
             omp_set_num_threads(num_threads);
 #endif
+            bb::SetThreadSize(num_threads);
         }
         else if (strcmp(argv[i], "-epoch") == 0 && i + 1 < argc) {
             ++i;
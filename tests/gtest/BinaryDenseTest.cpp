@@ -0,0 +1,229 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/BinaryDense.h"
+#include "bb/BinaryConvolution.h"
+
+
+TEST(BinaryDenseTest, testTranspose64)
+{
+    std::mt19937_64 mt(1);
+    std::uint64_t src[64], dst[64];
+    for ( int i = 0; i < 64; ++i ) {
+        src[i] = dst[i] = mt();
+    }
+
+    bb::BinaryDense_Transpose64(dst);
+
+    for ( int i = 0; i < 64; ++i ) {
+        for ( int j = 0; j < 64; ++j ) {
+            EXPECT_EQ((src[i] >> j) & 1, (dst[j] >> i) & 1);
+        }
+    }
+}
+
+
+// 素朴な ±1 内積との比較
+template <typename FT>
+void BinaryDenseTest_Forward(bb::index_t frame_size, bb::index_t input_node_size, bb::index_t output_node_size)
+{
+    std::mt19937_64 mt(frame_size + input_node_size);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+
+    bb::FrameBuffer x_buf(frame_size, {input_node_size}, bb::DataType<FT>::type);
+    {
+        auto x_ptr = x_buf.Lock<FT>();
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < input_node_size; ++node ) {
+                x_ptr.Set(frame, node, (FT)dist(mt));
+            }
+        }
+    }
+
+    auto dense = bb::BinaryDense<FT, float>::Create(output_node_size);
+    dense->SetInputShape(x_buf.GetShape());
+    dense->W().InitNormalDistribution(0.0, 1.0, 3);
+
+    std::vector<float> exp_y(output_node_size * frame_size);
+    {
+        auto x_ptr = x_buf.LockConst<FT>();
+        auto W_ptr = dense->lock_W_const();
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t output_node = 0; output_node < output_node_size; ++output_node ) {
+                float sum = 0;
+                for ( bb::index_t input_node = 0; input_node < input_node_size; ++input_node ) {
+                    float x = ((float)x_ptr.Get(frame, input_node) > 0) ? +1.0f : -1.0f;
+                    float w = (W_ptr(output_node, input_node) >= 0) ? +1.0f : -1.0f;
+                    sum += x * w;
+                }
+                exp_y[output_node * frame_size + frame] = sum;
+            }
+        }
+    }
+
+    auto level = bb::SimdKernel::GetLevel();
+    for ( int host_simd = 0; host_simd < 2; ++host_simd ) {
+        for ( auto limit : {bb::SimdLevel::None, bb::SimdLevel::AVX2} ) {
+            bb::SimdKernel::SetLimit(limit);
+            dense->SendCommand(host_simd ? "host_simd true" : "host_simd false");
+            bb::FrameBuffer y_buf = dense->Forward(x_buf, false);
+            EXPECT_EQ(BB_TYPE_FP32, y_buf.GetType());
+            EXPECT_EQ(output_node_size, y_buf.GetNodeSize());
+
+            auto y_ptr = y_buf.LockConst<float>();
+            for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                for ( bb::index_t output_node = 0; output_node < output_node_size; ++output_node ) {
+                    EXPECT_EQ(exp_y[output_node * frame_size + frame], y_ptr.Get(frame, output_node));
+                }
+            }
+        }
+    }
+    bb::SimdKernel::SetLimit(level);
+}
+
+TEST(BinaryDenseTest, testForwardBit)
+{
+    BinaryDenseTest_Forward<bb::Bit>(100, 70, 5);
+    BinaryDenseTest_Forward<bb::Bit>(64, 64, 3);
+    BinaryDenseTest_Forward<bb::Bit>(1, 1, 1);
+    BinaryDenseTest_Forward<bb::Bit>(257, 200, 17);
+}
+
+TEST(BinaryDenseTest, testForwardFloat)
+{
+    BinaryDenseTest_Forward<float>(100, 70, 5);
+    BinaryDenseTest_Forward<float>(130, 129, 4);
+}
+
+
+// 素朴な STE との比較
+template <typename FT>
+void BinaryDenseTest_Backward(bb::index_t frame_size, bb::index_t input_node_size, bb::index_t output_node_size)
+{
+    std::mt19937_64 mt(frame_size * 3 + input_node_size);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+
+    bb::FrameBuffer x_buf(frame_size, {input_node_size}, bb::DataType<FT>::type);
+    bb::FrameBuffer dy_buf(frame_size, {output_node_size}, BB_TYPE_FP32);
+    {
+        auto x_ptr  = x_buf.Lock<FT>();
+        auto dy_ptr = dy_buf.Lock<float>();
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < input_node_size; ++node ) {
+                x_ptr.Set(frame, node, (FT)(dist(mt) * 1.5f));
+            }
+            for ( bb::index_t node = 0; node < output_node_size; ++node ) {
+                dy_ptr.Set(frame, node, dist(mt));
+            }
+        }
+    }
+
+    for ( int host_simd = 0; host_simd < 2; ++host_simd ) {
+        auto dense = bb::BinaryDense<FT, float>::Create(output_node_size);
+        dense->SetInputShape(x_buf.GetShape());
+        dense->SendCommand(host_simd ? "host_simd true" : "host_simd false");
+
+        dense->Forward(x_buf, true);
+        bb::FrameBuffer dx_buf = dense->Backward(dy_buf);
+
+        auto x_ptr  = x_buf.LockConst<FT>();
+        auto dy_ptr = dy_buf.LockConst<float>();
+        auto dx_ptr = dx_buf.LockConst<float>();
+        auto W_ptr  = dense->lock_W_const();
+        auto dW_ptr = dense->lock_dW_const();
+
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t input_node = 0; input_node < input_node_size; ++input_node ) {
+                float exp_dx = 0;
+                for ( bb::index_t output_node = 0; output_node < output_node_size; ++output_node ) {
+                    float w = (W_ptr(output_node, input_node) >= 0) ? +1.0f : -1.0f;
+                    exp_dx += w * dy_ptr.Get(frame, output_node);
+                }
+                float x = (float)x_ptr.Get(frame, input_node);
+                if ( bb::DataType<FT>::type != BB_TYPE_BIT && (x < -1.0f || x > 1.0f) ) {
+                    exp_dx = 0;
+                }
+                EXPECT_NEAR(exp_dx, dx_ptr.Get(frame, input_node), 1.0e-4f);
+            }
+        }
+
+        for ( bb::index_t output_node = 0; output_node < output_node_size; ++output_node ) {
+            for ( bb::index_t input_node = 0; input_node < input_node_size; ++input_node ) {
+                float exp_dW = 0;
+                for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                    float x = ((float)x_ptr.Get(frame, input_node) > 0) ? +1.0f : -1.0f;
+                    exp_dW += dy_ptr.Get(frame, output_node) * x;
+                }
+                EXPECT_NEAR(exp_dW, dW_ptr(output_node, input_node), 1.0e-3f);
+            }
+        }
+    }
+}
+
+TEST(BinaryDenseTest, testBackwardBit)
+{
+    BinaryDenseTest_Backward<bb::Bit>(100, 70, 5);
+}
+
+TEST(BinaryDenseTest, testBackwardFloat)
+{
+    BinaryDenseTest_Backward<float>(67, 33, 9);
+}
+
+
+// 重みは次の forward で [-1, +1] にクリップされる
+TEST(BinaryDenseTest, testClamp)
+{
+    bb::FrameBuffer x_buf(8, {4}, BB_TYPE_BIT);
+    x_buf.FillZero();
+
+    auto dense = bb::BinaryDense<>::Create(2);
+    dense->SetInputShape(x_buf.GetShape());
+    {
+        auto W_ptr = dense->lock_W();
+        W_ptr(0, 0) = +3.0f;
+        W_ptr(1, 3) = -2.0f;
+    }
+
+    bb::FrameBuffer dy_buf(8, {2}, BB_TYPE_FP32);
+    dy_buf.FillZero();
+    dense->Forward(x_buf, true);
+    dense->Backward(dy_buf);
+    dense->Forward(x_buf, false);
+
+    auto W_ptr = dense->lock_W_const();
+    EXPECT_EQ(+1.0f, W_ptr(0, 0));
+    EXPECT_EQ(-1.0f, W_ptr(1, 3));
+}
+
+
+TEST(BinaryDenseTest, testConvolution)
+{
+    bb::index_t frame_size = 10;
+
+    bb::FrameBuffer x_buf(frame_size, {8, 7, 3}, BB_TYPE_BIT);
+    {
+        std::mt19937_64 mt(5);
+        auto x_ptr = x_buf.Lock<bb::Bit>();
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node ) {
+                x_ptr.Set(frame, node, (mt() & 1) != 0);
+            }
+        }
+    }
+
+    auto cnv = bb::BinaryConvolution_Create<bb::Bit>(4, 3, 3);
+    cnv->SetInputShape(x_buf.GetShape());
+    auto y_buf = cnv->Forward(x_buf);
+    EXPECT_EQ(BB_TYPE_BIT, y_buf.GetType());
+    EXPECT_EQ(frame_size, y_buf.GetFrameSize());
+    EXPECT_EQ(bb::indices_t({6, 5, 4}), y_buf.GetShape());
+
+    bb::FrameBuffer dy_buf(frame_size, y_buf.GetShape(), BB_TYPE_FP32);
+    dy_buf.FillZero();
+    auto dx_buf = cnv->Backward(dy_buf);
+    EXPECT_EQ(x_buf.GetShape(), dx_buf.GetShape());
+    EXPECT_EQ(3, cnv->GetParameters().GetSize());
+}
@@ -189,3 +189,84 @@ TEST(NeuralNetBinaryLut6, testLoweringConvolution_cmp_bit)
     testBinaryLut6_cmpare<6, bb::Bit, float>(2, 16, 16, 32);
 }
 
+
+
+template<int N>
+void testBinaryLutN_BitSlice(int frame_size, int input_node_size, int output_node_size)
+{
+    auto lut = bb::BinaryLutN<N, bb::Bit, float>::Create(output_node_size);
+
+    bb::FrameBuffer x_buf(frame_size, {input_node_size}, BB_TYPE_BIT);
+    lut->SetInputShape(x_buf.GetShape());
+
+    std::mt19937_64 mt(N);
+    std::uniform_int_distribution<int> dist(0, 1);
+    for ( int frame = 0; frame < frame_size; ++frame ) {
+        for ( int node = 0; node < input_node_size; ++node ) {
+            x_buf.SetBit(frame, node, dist(mt) != 0);
+        }
+    }
+    for ( int node = 0; node < output_node_size; ++node ) {
+        for ( int i = 0; i < (1 << N); ++i ) {
+            lut->SetLutTable(node, i, dist(mt) != 0);
+        }
+    }
+
+    // 汎用版
+    lut->SendCommand("host_simd false");
+    auto y_exp = lut->Forward(x_buf, false);
+
+    // ビットスライス版
+    lut->SendCommand("host_simd true");
+    auto y_buf = lut->Forward(x_buf, false);
+
+    for ( int frame = 0; frame < frame_size; ++frame ) {
+        for ( int node = 0; node < output_node_size; ++node ) {
+            EXPECT_EQ(y_exp.GetBit(frame, node), y_buf.GetBit(frame, node));
+        }
+    }
+
+    // 命令セット毎の実装比較
+    {
+        auto x_ptr = x_buf.LockMemoryConst();
+        auto tbl   = lut->lock_InputIndex_const();
+        bb::index_t stride = x_buf.GetFrameStride();
+
+        std::uint8_t const *x_addr[N];
+        for ( int k = 0; k < N; ++k ) {
+            x_addr[k] = (std::uint8_t const *)x_ptr.GetAddr() + stride * tbl(0, k);
+        }
+
+        std::int32_t table[((1 << N) + 31) / 32] = {0};
+        for ( int i = 0; i < (1 << N); ++i ) {
+            if ( lut->GetLutTable(0, i) ) { table[i / 32] |= (1 << (i % 32)); }
+        }
+
+        std::uint8_t sel[1 << (N-1)];
+        bb::simd_bit_BinaryLutN_MakeSelect<N>(table, sel);
+
+        std::vector<std::uint8_t> y_u64(stride), y_avx2(stride), y_avx512(stride);
+        bb::simd_bit_BinaryLutN_Row_u64<N>(x_addr, &y_u64[0], stride, sel);
+        if ( bb::GetSimdFeatures().avx2 ) {
+            bb::simd_bit_BinaryLutN_Row_avx2<N>(x_addr, &y_avx2[0], stride, sel);
+            EXPECT_EQ(y_u64, y_avx2);
+        }
+        if ( bb::GetSimdFeatures().avx512f ) {
+            std::uint8_t imm[(N <= 3) ? 1 : (1 << (N-3))];
+            bb::simd_bit_BinaryLutN_MakeLeafImm<N>(table, imm);
+            bb::simd_bit_BinaryLutN_Row_avx512<N>(x_addr, &y_avx512[0], stride, imm, bb::simd_bit_GetTernaryLogicTable());
+            EXPECT_EQ(y_u64, y_avx512);
+        }
+    }
+}
+
+TEST(BinaryLutTest, testBinaryLutN_BitSlice)
+{
+    testBinaryLutN_BitSlice<2>(300,  16, 17);
+    testBinaryLutN_BitSlice<3>(1000, 16, 17);
+    testBinaryLutN_BitSlice<4>(2100, 32, 9);
+    testBinaryLutN_BitSlice<5>(513,  32, 9);
+    testBinaryLutN_BitSlice<6>(4097, 32, 33);
+    testBinaryLutN_BitSlice<7>(256,  32, 5);
+    testBinaryLutN_BitSlice<8>(1234, 32, 5);
+}
@@ -0,0 +1,96 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/BinaryModulation.h"
+#include "bb/Sequential.h"
+#include "bb/DenseAffine.h"
+#include "bb/Binarize.h"
+
+
+static int ArgMax(bb::FrameBuffer const &buf, bb::index_t frame)
+{
+    int top = 0;
+    for ( bb::index_t node = 1; node < buf.GetNodeSize(); ++node ) {
+        if ( buf.GetFP32(frame, node) > buf.GetFP32(frame, top) ) {
+            top = (int)node;
+        }
+    }
+    return top;
+}
+
+
+TEST(BinaryModulationTest, testBinaryModulation_Anytime)
+{
+    bb::index_t const frame_size      = 64;
+    bb::index_t const input_node      = 8;
+    bb::index_t const output_node     = 4;
+    bb::index_t const modulation_size = 15;
+    bb::index_t const stage_size      = 4;
+
+    // 出力ノードを3つずつ畳み込んで4クラスにする
+    auto layer = bb::Sequential::Create();
+    layer->Add(bb::DenseAffine<>::Create(output_node * 3));
+    layer->Add(bb::Binarize<float, float>::Create(0.0f, 0.0f, 1.0f));
+
+    auto mod = bb::BinaryModulation<float, float>::CreateEx(layer, {output_node}, modulation_size, nullptr, true, 0.0f, 1.0f, modulation_size);
+    mod->SetInputShape({input_node});
+
+    std::mt19937_64 mt(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    bb::FrameBuffer x_buf(frame_size, {input_node}, BB_TYPE_FP32);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < input_node; ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    auto y_full = mod->Forward(x_buf, false).Clone();
+
+    // 打ち切らなければ全変調と一致
+    mod->SetAnytimeInference(stage_size, 2.0f);
+    auto y_all = mod->Forward(x_buf, false).Clone();
+    EXPECT_DOUBLE_EQ((double)modulation_size, mod->GetAnytimeAverageModulationSize());
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < output_node; ++node ) {
+            EXPECT_EQ(y_full.GetFP32(frame, node), y_all.GetFP32(frame, node));
+        }
+    }
+
+    // 確定判定なら1位は全変調と一致し、変調数は減る
+    mod->ResetAnytimeStatistics();
+    mod->SetAnytimeInference(stage_size, 0.0f, 1, true);
+    auto y_exact = mod->Forward(x_buf, false).Clone();
+    EXPECT_LT(mod->GetAnytimeAverageModulationSize(), (double)modulation_size);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        EXPECT_EQ(ArgMax(y_full, frame), ArgMax(y_exact, frame));
+    }
+
+    // 推論コンテキスト経由でも同じ結果
+    bb::InferenceContext ctx;
+    auto y_ctx = mod->Forward(x_buf, ctx);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < output_node; ++node ) {
+            EXPECT_EQ(y_exact.GetFP32(frame, node), y_ctx.GetFP32(frame, node));
+        }
+    }
+
+    // 差0なら全サンプルが1段目で打ち切られる
+    mod->ResetAnytimeStatistics();
+    mod->SetAnytimeInference(stage_size, 0.0f);
+    mod->Forward(x_buf, false);
+    EXPECT_DOUBLE_EQ((double)((modulation_size + stage_size - 1) / stage_size), mod->GetAnytimeAverageModulationSize());
+
+    // 無効に戻せば通常の推論
+    mod->SetAnytimeInference(0);
+    auto y_off = mod->Forward(x_buf, false);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < output_node; ++node ) {
+            EXPECT_EQ(y_full.GetFP32(frame, node), y_off.GetFP32(frame, node));
+        }
+    }
+}
+
+
+// end of file
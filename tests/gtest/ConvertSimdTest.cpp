@@ -0,0 +1,240 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include "gtest/gtest.h"
+
+#include "bb/FrameBuffer.h"
+#include "bb/ConvertSimd.h"
+
+
+static std::vector<bb::SimdLevel> const ConvertSimdTest_Levels = {bb::SimdLevel::None, bb::SimdLevel::AVX2};
+
+
+TEST(ConvertSimdTest, testFp16_Scalar)
+{
+    EXPECT_EQ(0x3c00, bb::Fp32ToFp16(1.0f));
+    EXPECT_EQ(0xc000, bb::Fp32ToFp16(-2.0f));
+    EXPECT_EQ(0x0000, bb::Fp32ToFp16(0.0f));
+    EXPECT_EQ(0x7bff, bb::Fp32ToFp16(65504.0f));
+    EXPECT_EQ(0x7c00, bb::Fp32ToFp16(65520.0f));             // 丸めで inf
+    EXPECT_EQ(0x0001, bb::Fp32ToFp16(std::ldexp(1.0f, -24)));  // 最小の非正規化数
+    EXPECT_EQ(0x0000, bb::Fp32ToFp16(std::ldexp(1.0f, -25)));  // 偶数丸めで 0
+    EXPECT_EQ(0x3555, bb::Fp32ToFp16(1.0f / 3.0f));
+
+    EXPECT_EQ(1.0f,                      bb::Fp16ToFp32(0x3c00));
+    EXPECT_EQ(-2.0f,                     bb::Fp16ToFp32(0xc000));
+    EXPECT_EQ(65504.0f,                  bb::Fp16ToFp32(0x7bff));
+    EXPECT_EQ(std::ldexp(1.0f, -24),     bb::Fp16ToFp32(0x0001));
+    EXPECT_TRUE(std::isinf(bb::Fp16ToFp32(0x7c00)));
+    EXPECT_TRUE(std::isnan(bb::Fp16ToFp32(0x7e00)));
+
+    // fp16 で表せる値は往復で一致する
+    for ( int h = 0; h < 0x10000; ++h ) {
+        if ( (h & 0x7c00) == 0x7c00 ) { continue; }
+        EXPECT_EQ(h, bb::Fp32ToFp16(bb::Fp16ToFp32((std::uint16_t)h)));
+    }
+}
+
+
+TEST(ConvertSimdTest, testFp16_F16c)
+{
+    if ( !bb::GetSimdFeatures().f16c ) {
+        return;
+    }
+
+    std::mt19937_64 mt(1);
+    std::uniform_real_distribution<float> dist(-70000.0f, 70000.0f);
+
+    std::vector<float> src(1003);
+    for ( size_t i = 0; i < src.size(); ++i ) {
+        src[i] = dist(mt) * std::ldexp(1.0f, -(int)(i % 40));
+    }
+    src[0] = 65520.0f;
+    src[1] = std::ldexp(1.0f, -25);
+    src[2] = std::ldexp(3.0f, -26);
+    src[3] = -0.0f;
+
+    std::vector<std::uint16_t> h0(src.size()), h1(src.size());
+    bb::simd_fp32_ConvertToFp16(src.data(), h0.data(), (bb::index_t)src.size());
+    bb::simd_fp32_ConvertToFp16_f16c(src.data(), h1.data(), (bb::index_t)src.size());
+    EXPECT_EQ(h0, h1);
+
+    std::vector<float> f0(src.size()), f1(src.size());
+    bb::simd_fp16_ConvertToFp32(h0.data(), f0.data(), (bb::index_t)src.size());
+    bb::simd_fp16_ConvertToFp32_f16c(h0.data(), f1.data(), (bb::index_t)src.size());
+    EXPECT_EQ(f0, f1);
+}
+
+
+// ConvertTo の SIMD 版と汎用版の比較(端数フレーム、ビュー)
+TEST(ConvertSimdTest, testConvertTo)
+{
+    auto level = bb::SimdKernel::GetLevel();
+
+    for ( bb::index_t frame_size : {1, 7, 8, 33, 300} ) {
+        bb::FrameBuffer src_fp32(frame_size, {13}, BB_TYPE_FP32);
+        bb::FrameBuffer src_u8(frame_size, {13}, BB_TYPE_UINT8);
+        std::mt19937_64 mt(frame_size);
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        for ( bb::index_t node = 0; node < 13; ++node ) {
+            for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                src_fp32.SetFP32(frame, node, dist(mt));
+                src_u8.SetUINT8(frame, node, (std::uint8_t)(mt() & 0xff));
+            }
+        }
+
+        for ( auto limit : ConvertSimdTest_Levels ) {
+            bb::SimdKernel::SetLimit(limit);
+
+            auto bit_buf  = src_fp32.ConvertTo(BB_TYPE_BIT);
+            auto real_buf = bit_buf.ConvertTo(BB_TYPE_FP32);
+            auto u8_buf   = src_u8.ConvertTo(BB_TYPE_FP32);
+            auto fp16_buf = src_fp32.ConvertTo(BB_TYPE_FP16);
+            auto back_buf = fp16_buf.ConvertTo(BB_TYPE_FP32);
+            EXPECT_EQ(BB_TYPE_FP16, fp16_buf.GetType());
+
+            for ( bb::index_t node = 0; node < 13; ++node ) {
+                for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                    float x = src_fp32.GetFP32(frame, node);
+                    EXPECT_EQ(x > 0, (bool)bit_buf.GetBit(frame, node));
+                    EXPECT_EQ(x > 0 ? 1.0f : 0.0f, real_buf.GetFP32(frame, node));
+                    EXPECT_EQ((float)src_u8.GetUINT8(frame, node), u8_buf.GetFP32(frame, node));
+                    EXPECT_EQ(bb::Fp16ToFp32(bb::Fp32ToFp16(x)), back_buf.GetFP32(frame, node));
+                }
+            }
+        }
+
+        // フレーム範囲切り出し(部分範囲はコピー、全範囲はビュー)からの変換
+        if ( frame_size > 256 ) {
+            bb::SimdKernel::SetLimit(bb::SimdLevel::AVX2);
+            auto range_buf = src_fp32.FrameRange(40, 256);
+            EXPECT_FALSE(range_buf.IsView());
+            auto bit_buf = range_buf.ConvertTo(BB_TYPE_BIT);
+            for ( bb::index_t node = 0; node < 13; ++node ) {
+                for ( bb::index_t frame = 0; frame < 40; ++frame ) {
+                    EXPECT_EQ(src_fp32.GetFP32(256 + frame, node) > 0, (bool)bit_buf.GetBit(frame, node));
+                }
+            }
+
+            auto view_buf = src_fp32.FrameRange(frame_size, 0);
+            EXPECT_TRUE(view_buf.IsView());
+            auto bit_view_buf = view_buf.ConvertTo(BB_TYPE_BIT);
+            for ( bb::index_t node = 0; node < 13; ++node ) {
+                for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                    EXPECT_EQ(src_fp32.GetFP32(frame, node) > 0, (bool)bit_view_buf.GetBit(frame, node));
+                }
+            }
+        }
+    }
+
+    bb::SimdKernel::SetLimit(level);
+}
+
+
+// サンプル優先配列との転送(端数ノード/フレーム、オフセット)
+TEST(ConvertSimdTest, testDataArray)
+{
+    auto level = bb::SimdKernel::GetLevel();
+
+    bb::index_t const node_size = 37;
+    for ( bb::index_t frame_size : {5, 64, 77} ) {
+        for ( bb::index_t offset : {0, 3, 8} ) {
+            bb::index_t size = frame_size - offset;
+            if ( size <= 0 ) { continue; }
+
+            std::mt19937_64 mt(frame_size * 100 + offset);
+            std::normal_distribution<float> dist(0.0f, 1.0f);
+            std::vector<float>        data_f(size * node_size);
+            std::vector<std::uint8_t> data_u8(size * node_size);
+            for ( auto &v : data_f )  { v = dist(mt); }
+            for ( auto &v : data_u8 ) { v = (std::uint8_t)(mt() & 0xff); }
+
+            for ( auto limit : ConvertSimdTest_Levels ) {
+                bb::SimdKernel::SetLimit(limit);
+
+                bb::FrameBuffer buf_f(frame_size, {node_size}, BB_TYPE_FP32);
+                bb::FrameBuffer buf_b(frame_size, {node_size}, BB_TYPE_BIT);
+                bb::FrameBuffer buf_u(frame_size, {node_size}, BB_TYPE_FP32);
+                buf_f.FillZero();
+                buf_b.FillZero();
+                buf_f.SetDataArray(data_f.data(), size, offset);
+                buf_b.SetDataArray(data_f.data(), size, offset);
+                buf_u.SetDataArray(data_u8.data(), size, offset, 1.0f / 255.0f);
+
+                for ( bb::index_t i = 0; i < size; ++i ) {
+                    for ( bb::index_t node = 0; node < node_size; ++node ) {
+                        float x = data_f[i * node_size + node];
+                        EXPECT_EQ(x,                  buf_f.GetFP32(i + offset, node));
+                        EXPECT_EQ(x > 0,              (bool)buf_b.GetBit(i + offset, node));
+                        EXPECT_EQ((float)data_u8[i * node_size + node] * (1.0f / 255.0f), buf_u.GetFP32(i + offset, node));
+                    }
+                }
+                // 範囲外は書き換えない
+                for ( bb::index_t frame = 0; frame < offset; ++frame ) {
+                    for ( bb::index_t node = 0; node < node_size; ++node ) {
+                        EXPECT_EQ(0.0f, buf_f.GetFP32(frame, node));
+                        EXPECT_FALSE((bool)buf_b.GetBit(frame, node));
+                    }
+                }
+
+                std::vector<float> out_f(size * node_size);
+                std::vector<float> out_b(size * node_size);
+                buf_f.GetDataArray(out_f.data(), size, offset);
+                buf_b.GetDataArray(out_b.data(), size, offset);
+                for ( bb::index_t i = 0; i < size * node_size; ++i ) {
+                    EXPECT_EQ(data_f[i],               out_f[i]);
+                    EXPECT_EQ(data_f[i] > 0 ? 1.0f : 0.0f, out_b[i]);
+                }
+            }
+        }
+    }
+
+    bb::SimdKernel::SetLimit(level);
+}
+
+
+// vector 版の転送
+TEST(ConvertSimdTest, testVector)
+{
+    auto level = bb::SimdKernel::GetLevel();
+
+    bb::index_t const frame_size = 19;
+    bb::index_t const node_size  = 11;
+
+    std::mt19937_64 mt(3);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector< std::vector<float> > data(frame_size + 4, std::vector<float>(node_size));
+    for ( auto &row : data ) {
+        for ( auto &v : row ) { v = dist(mt); }
+    }
+
+    for ( auto limit : ConvertSimdTest_Levels ) {
+        bb::SimdKernel::SetLimit(limit);
+
+        bb::FrameBuffer buf(frame_size, {node_size}, BB_TYPE_FP32);
+        buf.SetVector(data, 4);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            EXPECT_EQ(data[frame + 4], buf.GetVector<float>(frame));
+        }
+
+        std::vector< std::vector<float> > head(data.begin(), data.begin() + frame_size);
+        bb::FrameBuffer bit_buf(frame_size, {node_size}, BB_TYPE_BIT);
+        bit_buf.SetData(head);
+        auto out = bit_buf.GetData();
+        ASSERT_EQ((size_t)frame_size, out.size());
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < node_size; ++node ) {
+                EXPECT_EQ(data[frame][node] > 0 ? 1.0f : 0.0f, out[frame][node]);
+            }
+        }
+
+        bit_buf.SetVector(2, data[0]);
+        auto v = bit_buf.GetVector<float>(2);
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            EXPECT_EQ(data[0][node] > 0 ? 1.0f : 0.0f, v[node]);
+        }
+    }
+
+    bb::SimdKernel::SetLimit(level);
+}
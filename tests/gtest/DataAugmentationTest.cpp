@@ -0,0 +1,134 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <set>
+#include "gtest/gtest.h"
+
+#include "bb/DataAugmentation.h"
+
+
+static bb::FrameBuffer DataAugmentationTest_MakeInput(bb::index_t frame_size, bb::indices_t shape)
+{
+    bb::FrameBuffer x_buf(frame_size, shape, BB_TYPE_FP32);
+    std::mt19937_64 mt(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+    return x_buf;
+}
+
+
+TEST(DataAugmentationTest, testDataAugmentation_Basic)
+{
+    bb::index_t const frame_size = 21;
+    bb::index_t const w = 7, h = 5, c = 3;
+    auto x_buf = DataAugmentationTest_MakeInput(frame_size, {w, h, c});
+
+    // 変換なしなら一致
+    {
+        auto da = bb::DataAugmentation<>::CreateEx();
+        auto y_buf = da->Forward(x_buf, true);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < w*h*c; ++node ) {
+                EXPECT_EQ(x_buf.GetFP32(frame, node), y_buf.GetFP32(frame, node));
+            }
+        }
+    }
+
+    // 左右反転 + ネガポジ
+    {
+        auto da = bb::DataAugmentation<>::CreateEx(0, 0, 0, 0, 1.0f, 0, 0, 1.0f);
+        auto y_buf = da->Forward(x_buf, true);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t ch = 0; ch < c; ++ch ) {
+                for ( bb::index_t y = 0; y < h; ++y ) {
+                    for ( bb::index_t x = 0; x < w; ++x ) {
+                        float v = x_buf.GetFP32(frame, (ch*h + y)*w + (w-1-x));
+                        EXPECT_NEAR(1.0f - v, y_buf.GetFP32(frame, (ch*h + y)*w + x), 1.0e-6f);
+                    }
+                }
+            }
+        }
+
+        // 推論時は素通し
+        auto y_test = da->Forward(x_buf, false);
+        EXPECT_EQ(x_buf.GetFP32(3, 4), y_test.GetFP32(3, 4));
+    }
+
+    // クロップ(整数移動)は画素がそのまま移動し、範囲外が border_value になる
+    {
+        // 値が位置を表すパターン (border_value の -1 とは重ならない)
+        bb::index_t const crop_frame_size = 64;
+        int const         pad = 2;
+        bb::FrameBuffer   x_pat(crop_frame_size, {w, h, c}, BB_TYPE_FP32);
+        for ( bb::index_t frame = 0; frame < crop_frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < w*h*c; ++node ) {
+                x_pat.SetFP32(frame, node, (float)(node + 1));
+            }
+        }
+
+        auto da = bb::DataAugmentation<>::CreateEx(0, 0, 0, 0, 0, 0, pad, 0, 0, 1.0f, false, -1.0f);
+        auto y_buf = da->Forward(x_pat, true);
+
+        std::set< std::pair<int, int> > shifts;
+        for ( bb::index_t frame = 0; frame < crop_frame_size; ++frame ) {
+            // 出力(x, y) = 入力(x - tx, y - ty) となる移動量がちょうど1つ存在する
+            int match = 0;
+            for ( int ty = -pad; ty <= pad; ++ty ) {
+                for ( int tx = -pad; tx <= pad; ++tx ) {
+                    bool ok = true;
+                    for ( bb::index_t ch = 0; ch < c && ok; ++ch ) {
+                        for ( bb::index_t y = 0; y < h && ok; ++y ) {
+                            for ( bb::index_t x = 0; x < w && ok; ++x ) {
+                                bb::index_t sx = x - tx;
+                                bb::index_t sy = y - ty;
+                                float exp = (sx >= 0 && sx < w && sy >= 0 && sy < h) ? (float)((ch*h + sy)*w + sx + 1) : -1.0f;
+                                ok = (y_buf.GetFP32(frame, (ch*h + y)*w + x) == exp);
+                            }
+                        }
+                    }
+                    if ( ok ) {
+                        ++match;
+                        shifts.insert(std::make_pair(tx, ty));
+                    }
+                }
+            }
+            EXPECT_EQ(1, match);
+        }
+
+        // フレーム毎に異なる移動量が選ばれている
+        EXPECT_GE((int)shifts.size(), 8);
+    }
+}
+
+
+TEST(DataAugmentationTest, testDataAugmentation_Simd)
+{
+    bb::index_t const frame_size = 37;
+    bb::index_t const w = 9, h = 8, c = 2;
+    auto x_buf = DataAugmentationTest_MakeInput(frame_size, {w, h, c});
+
+    auto level = bb::SimdKernel::GetLevel();
+
+    for ( bool replicate : {false, true} ) {
+        // 汎用版と AVX2 版が一致すること
+        bb::SimdKernel::SetLimit(bb::SimdLevel::None);
+        auto da0 = bb::DataAugmentation<>::CreateEx(0.2f, 0.1f, 30.0f, 0.2f, 0.5f, 0.5f, 1, 0.5f, 0.1f, 0.8f, replicate, 0.5f);
+        auto y0_buf = da0->Forward(x_buf, true);
+
+        bb::SimdKernel::SetLimit(bb::SimdLevel::AVX512);
+        auto da1 = bb::DataAugmentation<>::CreateEx(0.2f, 0.1f, 30.0f, 0.2f, 0.5f, 0.5f, 1, 0.5f, 0.1f, 0.8f, replicate, 0.5f);
+        auto y1_buf = da1->Forward(x_buf, true);
+
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < w*h*c; ++node ) {
+                EXPECT_NEAR(y0_buf.GetFP32(frame, node), y1_buf.GetFP32(frame, node), 1.0e-4f);
+            }
+        }
+    }
+
+    bb::SimdKernel::SetLimit(level);
+}
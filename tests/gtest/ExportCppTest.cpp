@@ -0,0 +1,390 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <map>
+#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include "gtest/gtest.h"
+
+#include "bb/ExportCpp.h"
+#include "bb/BinaryLutN.h"
+#include "bb/SimdSupport.h"
+
+
+// 生成された式を u64 で評価する簡易インタプリタ
+class ExportCppTest_Evaluator
+{
+public:
+    std::map<std::string, std::uint64_t>    m_vars;
+
+    std::uint64_t Eval(std::string const &expr)
+    {
+        size_t pos = 0;
+        auto v = Parse(expr, pos);
+        EXPECT_EQ(expr.size(), pos) << expr;
+        return v;
+    }
+
+protected:
+    static void Skip(std::string const &s, size_t &pos)
+    {
+        while ( pos < s.size() && s[pos] == ' ' ) { ++pos; }
+    }
+
+    static void Expect(std::string const &s, size_t &pos, char c)
+    {
+        Skip(s, pos);
+        EXPECT_LT(pos, s.size());
+        EXPECT_EQ(c, pos < s.size() ? s[pos] : '\0') << s;
+        ++pos;
+    }
+
+    std::uint64_t Parse(std::string const &s, size_t &pos)
+    {
+        Skip(s, pos);
+        size_t start = pos;
+        while ( pos < s.size() && s[pos] != '(' && s[pos] != ',' && s[pos] != ')' && s[pos] != ' ' ) { ++pos; }
+        std::string name = s.substr(start, pos - start);
+
+        if ( pos >= s.size() || s[pos] != '(' ) {
+            // 変数
+            auto it = m_vars.find(name);
+            EXPECT_TRUE(it != m_vars.end()) << name;
+            return it != m_vars.end() ? it->second : 0;
+        }
+
+        ++pos;
+        std::vector<std::uint64_t> args;
+        Skip(s, pos);
+        if ( s[pos] != ')' ) {
+            for ( ; ; ) {
+                args.push_back(Parse(s, pos));
+                Skip(s, pos);
+                if ( s[pos] != ',' ) { break; }
+                ++pos;
+            }
+        }
+        Expect(s, pos, ')');
+
+        if ( name == "bb_zero" && args.size() == 0 ) { return 0; }
+        if ( name == "bb_ones" && args.size() == 0 ) { return ~(std::uint64_t)0; }
+        if ( name == "bb_not"  && args.size() == 1 ) { return ~args[0]; }
+        if ( name == "bb_and"    && args.size() == 2 ) { return args[0] & args[1]; }
+        if ( name == "bb_andnot" && args.size() == 2 ) { return ~args[0] & args[1]; }
+        if ( name == "bb_or"     && args.size() == 2 ) { return args[0] | args[1]; }
+        if ( name == "bb_mux"    && args.size() == 3 ) { return args[1] ^ (args[0] & (args[1] ^ args[2])); }
+        ADD_FAILURE() << "unknown function : " << name;
+        return 0;
+    }
+};
+
+
+// 入力 k を「パターン番号のビット k」とした真理値表全体のワードで評価する
+static void ExportCppTest_CheckTable(std::vector<bool> const &table, int n)
+{
+    ExportCppTest_Evaluator eval;
+    std::vector<std::string> inputs(n);
+    for ( int k = 0; k < n; ++k ) {
+        inputs[k] = "x" + std::to_string(k);
+        std::uint64_t w = 0;
+        for ( int p = 0; p < 64; ++p ) {
+            if ( (p >> k) & 1 ) { w |= ((std::uint64_t)1 << p); }
+        }
+        eval.m_vars[inputs[k]] = w;
+    }
+
+    auto expr = bb::ExportCpp_LutExpression(table, inputs, n - 1, 0);
+    auto y    = eval.Eval(expr);
+    for ( int p = 0; p < (1 << n); ++p ) {
+        ASSERT_EQ((bool)table[p], (bool)((y >> p) & 1)) << "pattern " << p << " : " << expr;
+    }
+}
+
+
+TEST(ExportCppTest, testExportCpp_Expression)
+{
+    std::vector<std::string> in = {"a", "b"};
+
+    EXPECT_EQ("bb_zero()",               bb::ExportCpp_LutExpression({0, 0, 0, 0}, in, 1, 0));
+    EXPECT_EQ("bb_ones()",               bb::ExportCpp_LutExpression({1, 1, 1, 1}, in, 1, 0));
+    EXPECT_EQ("a",                       bb::ExportCpp_LutExpression({0, 1, 0, 1}, in, 1, 0));
+    EXPECT_EQ("bb_not(b)",               bb::ExportCpp_LutExpression({1, 1, 0, 0}, in, 1, 0));
+    EXPECT_EQ("bb_and(b, a)",            bb::ExportCpp_LutExpression({0, 0, 0, 1}, in, 1, 0));
+    EXPECT_EQ("bb_or(b, a)",             bb::ExportCpp_LutExpression({0, 1, 1, 1}, in, 1, 0));
+    EXPECT_EQ("bb_mux(b, a, bb_not(a))", bb::ExportCpp_LutExpression({0, 1, 1, 0}, in, 1, 0));
+}
+
+
+TEST(ExportCppTest, testExportCpp_LutLayers)
+{
+    auto layer0 = bb::BinaryLutN<6, bb::Bit>::Create(32);
+    auto layer1 = bb::BinaryLutN<4, bb::Bit>::Create(8);
+
+    auto net = bb::Sequential::Create();
+    net->Add(layer0);
+    net->Add(layer1);
+    net->SetInputShape({64});
+
+    for ( int simd = 0; simd < 2; ++simd ) {
+        std::stringstream ss;
+        bb::ExportCpp_LutLayers<bb::Bit>(ss, "lut_net", net, simd ? "avx2" : "u64");
+        auto src = ss.str();
+
+        EXPECT_NE(std::string::npos, src.find("void lut_net(lut_net_word_t const *in_data, lut_net_word_t *out_data)"));
+        EXPECT_NE(std::string::npos, src.find("void lut_net_scratch(lut_net_word_t const *in_data, lut_net_word_t *out_data, lut_net_word_t *scratch)"));
+        EXPECT_NE(std::string::npos, src.find("void lut_net_frames("));
+        EXPECT_NE(std::string::npos, src.find("void lut_net_frames_scratch("));
+        EXPECT_NE(std::string::npos, src.find("lut_net_input_words   = 64;"));
+        EXPECT_NE(std::string::npos, src.find("lut_net_output_words  = 8;"));
+        EXPECT_NE(std::string::npos, src.find("lut_net_scratch_words = 32;"));
+        EXPECT_EQ(std::string::npos, src.find("thread_local"));
+        EXPECT_NE(std::string::npos, src.find("layer0[31] = "));
+        EXPECT_NE(std::string::npos, src.find("out_data[7] = "));
+        EXPECT_EQ(std::string::npos, src.find("out_data[8] = "));
+        EXPECT_EQ(simd == 1, src.find("__m256i") != std::string::npos);
+    }
+
+    // スタック使用量が上限を超える版は生成しない
+    //  u64 : scratch 32 words = 256 bytes, frames (64 + 8 + 32) words = 832 bytes
+    {
+        std::stringstream ss;
+        bb::ExportCpp_LutLayers<bb::Bit>(ss, "lut_net", net, "u64", 512);
+        auto src = ss.str();
+        EXPECT_NE(std::string::npos, src.find("void lut_net(lut_net_word_t const *in_data, lut_net_word_t *out_data)"));
+        EXPECT_EQ(std::string::npos, src.find("void lut_net_frames("));
+        EXPECT_NE(std::string::npos, src.find("void lut_net_frames_scratch("));
+    }
+    {
+        std::stringstream ss;
+        bb::ExportCpp_LutLayers<bb::Bit>(ss, "lut_net", net, "u64", 0);
+        auto src = ss.str();
+        EXPECT_EQ(std::string::npos, src.find("void lut_net("));
+        EXPECT_EQ(std::string::npos, src.find("void lut_net_frames("));
+        EXPECT_NE(std::string::npos, src.find("void lut_net_scratch("));
+        EXPECT_NE(std::string::npos, src.find("void lut_net_frames_scratch("));
+    }
+}
+
+
+
+TEST(ExportCppTest, testExportCpp_ExpressionTruthTable)
+{
+    // 4入力までは全真理値表を網羅
+    for ( int n = 1; n <= 4; ++n ) {
+        for ( std::uint32_t t = 0; t < (1u << (1 << n)); ++t ) {
+            std::vector<bool> table(1 << n);
+            for ( int p = 0; p < (1 << n); ++p ) {
+                table[p] = ((t >> p) & 1) != 0;
+            }
+            ExportCppTest_CheckTable(table, n);
+        }
+    }
+
+    // 6入力は乱数と、簡約が効く疎な表で確認
+    std::mt19937_64 mt(1);
+    for ( int loop = 0; loop < 4096; ++loop ) {
+        std::uint64_t t = mt();
+        if ( loop % 4 == 1 ) { t &= mt(); t &= mt(); t &= mt(); }
+        if ( loop % 4 == 2 ) { t |= mt(); t |= mt(); t |= mt(); }
+        if ( loop % 4 == 3 ) { t = (t & 0xffffffff) * 0x100000001ull; }   // 上位入力に無関係
+        std::vector<bool> table(64);
+        for ( int p = 0; p < 64; ++p ) {
+            table[p] = ((t >> p) & 1) != 0;
+        }
+        ExportCppTest_CheckTable(table, 6);
+    }
+}
+
+
+// 生成された u64 版の関数本体を評価して Forward と比較
+TEST(ExportCppTest, testExportCpp_LutLayersForward)
+{
+    int const input_node_size = 64;
+
+    auto layer0 = bb::BinaryLutN<6, bb::Bit>::Create(32);
+    auto layer1 = bb::BinaryLutN<6, bb::Bit>::Create(16);
+    auto layer2 = bb::BinaryLutN<4, bb::Bit>::Create(8);
+
+    auto net = bb::Sequential::Create();
+    net->Add(layer0);
+    net->Add(layer1);
+    net->Add(layer2);
+    net->SetInputShape({input_node_size});
+
+    std::mt19937_64 mt(2);
+    for ( auto layer : {std::static_pointer_cast< bb::LutLayer<bb::Bit, float> >(layer0),
+                        std::static_pointer_cast< bb::LutLayer<bb::Bit, float> >(layer1),
+                        std::static_pointer_cast< bb::LutLayer<bb::Bit, float> >(layer2)} ) {
+        for ( bb::index_t node = 0; node < layer->GetOutputNodeSize(); ++node ) {
+            for ( int i = 0; i < layer->GetLutTableSize(node); ++i ) {
+                layer->SetLutTable(node, i, (mt() & 1) != 0);
+            }
+        }
+    }
+
+    std::stringstream ss;
+    bb::ExportCpp_LutLayers<bb::Bit>(ss, "lut_net", net, "u64");
+    auto src = ss.str();
+
+    // 64フレーム分の入力
+    bb::FrameBuffer x_buf(64, {input_node_size}, BB_TYPE_BIT);
+    ExportCppTest_Evaluator eval;
+    for ( int node = 0; node < input_node_size; ++node ) {
+        std::uint64_t w = 0;
+        for ( int frame = 0; frame < 64; ++frame ) {
+            bool v = (mt() & 1) != 0;
+            x_buf.SetBit(frame, node, v);
+            if ( v ) { w |= ((std::uint64_t)1 << frame); }
+        }
+        eval.m_vars["in_data[" + std::to_string(node) + "]"] = w;
+    }
+
+    // "    dst[n] = expr;" の行を順に実行
+    std::istringstream is(src.substr(src.find("void lut_net_scratch(")));
+    std::string line;
+    int assign_count = 0;
+    while ( std::getline(is, line) && line != "}" ) {
+        auto eq = line.find(" = ");
+        if ( line.compare(0, 4, "    ") != 0 || eq == std::string::npos || line.back() != ';' || line.find("*") != std::string::npos ) {
+            continue;
+        }
+        auto dst  = line.substr(4, eq - 4);
+        auto expr = line.substr(eq + 3, line.size() - eq - 4);
+        eval.m_vars[dst] = eval.Eval(expr);
+        ++assign_count;
+    }
+    EXPECT_EQ(32 + 16 + 8, assign_count);
+
+    auto y_buf = net->Forward(x_buf, false);
+    for ( int node = 0; node < 8; ++node ) {
+        auto w = eval.m_vars["out_data[" + std::to_string(node) + "]"];
+        for ( int frame = 0; frame < 64; ++frame ) {
+            EXPECT_EQ((bool)y_buf.GetBit(frame, node), (bool)((w >> frame) & 1)) << "frame " << frame << " node " << node;
+        }
+    }
+}
+
+
+#ifndef _WIN32
+
+// 生成したソースを実際にコンパイル・実行して Forward と比較(u64 版と avx2 版)
+TEST(ExportCppTest, testExportCpp_CompileAndRun)
+{
+    char const *env_cxx = getenv("CXX");
+    std::string cxx = (env_cxx != nullptr && env_cxx[0] != '\0') ? env_cxx : "c++";
+    if ( std::system((cxx + " --version > /dev/null 2>&1").c_str()) != 0 ) {
+        GTEST_SKIP() << "C++ compiler not found";
+    }
+
+    int const input_node_size  = 64;
+    int const output_node_size = 8;
+    int const frame_size       = 512;
+
+    auto layer0 = bb::BinaryLutN<6, bb::Bit>::Create(32);
+    auto layer1 = bb::BinaryLutN<6, bb::Bit>::Create(16);
+    auto layer2 = bb::BinaryLutN<6, bb::Bit>::Create(16);   // 作業領域の面を使い回す層
+    auto layer3 = bb::BinaryLutN<4, bb::Bit>::Create(output_node_size);
+
+    auto net = bb::Sequential::Create();
+    net->Add(layer0);
+    net->Add(layer1);
+    net->Add(layer2);
+    net->Add(layer3);
+    net->SetInputShape({input_node_size});
+
+    std::mt19937_64 mt(3);
+    for ( auto layer : {std::static_pointer_cast< bb::LutLayer<bb::Bit, float> >(layer0),
+                        std::static_pointer_cast< bb::LutLayer<bb::Bit, float> >(layer1),
+                        std::static_pointer_cast< bb::LutLayer<bb::Bit, float> >(layer2),
+                        std::static_pointer_cast< bb::LutLayer<bb::Bit, float> >(layer3)} ) {
+        for ( bb::index_t node = 0; node < layer->GetOutputNodeSize(); ++node ) {
+            for ( int i = 0; i < layer->GetLutTableSize(node); ++i ) {
+                layer->SetLutTable(node, i, (mt() & 1) != 0);
+            }
+        }
+    }
+
+    bb::FrameBuffer x_buf(frame_size, {input_node_size}, BB_TYPE_BIT);
+    for ( int node = 0; node < input_node_size; ++node ) {
+        for ( int frame = 0; frame < frame_size; ++frame ) {
+            x_buf.SetBit(frame, node, (mt() & 1) != 0);
+        }
+    }
+    auto y_buf = net->Forward(x_buf, false);
+
+    for ( std::string simd : {"u64", "avx2"} ) {
+        if ( simd == "avx2" && bb::SimdKernel::GetCpuLevel() < bb::SimdLevel::AVX2 ) {
+            continue;
+        }
+
+        int word_size = frame_size / (simd == "avx2" ? 256 : 64);
+        int half_size = word_size / 2;     // 前半をスタック版、後半を作業領域を渡す版で処理
+        std::string base = "ExportCppTest_" + simd;
+
+        // 生成コード + ファイル入出力の main
+        {
+            std::ofstream ofs(base + ".cpp");
+            bb::ExportCpp_LutLayers<bb::Bit>(ofs, "lut_net", net, simd);
+            ofs << "#include <stdio.h>\n"
+                << "static lut_net_word_t in_data[" << input_node_size * word_size << "];\n"
+                << "static lut_net_word_t out_data[" << output_node_size * word_size << "];\n"
+                << "static lut_net_word_t scratch[lut_net_scratch_words];\n"
+                << "static lut_net_word_t in_buf[lut_net_input_words];\n"
+                << "static lut_net_word_t out_buf[lut_net_output_words];\n"
+                << "int main(int argc, char *argv[])\n"
+                << "{\n"
+                << "    if ( argc < 3 ) { return 1; }\n"
+                << "    FILE *fp = fopen(argv[1], \"rb\");\n"
+                << "    if ( fp == NULL || fread(in_data, sizeof(in_data), 1, fp) != 1 ) { return 1; }\n"
+                << "    fclose(fp);\n"
+                << "    lut_net_frames(in_data, " << word_size << ", out_data, " << word_size << ", " << half_size << ");\n"
+                << "    lut_net_frames_scratch(in_data + " << half_size << ", " << word_size << ", out_data + " << half_size << ", " << word_size << ", "
+                                            << word_size - half_size << ", scratch, in_buf, out_buf);\n"
+                << "    fp = fopen(argv[2], \"wb\");\n"
+                << "    if ( fp == NULL || fwrite(out_data, sizeof(out_data), 1, fp) != 1 ) { return 1; }\n"
+                << "    fclose(fp);\n"
+                << "    return 0;\n"
+                << "}\n";
+        }
+
+        // 入力はノード毎にフレームをビットパック(下位ビットが若いフレーム)
+        {
+            std::ofstream ofs(base + "_in.bin", std::ios::binary);
+            for ( int node = 0; node < input_node_size; ++node ) {
+                for ( int frame = 0; frame < frame_size; frame += 8 ) {
+                    unsigned char c = 0;
+                    for ( int i = 0; i < 8; ++i ) {
+                        if ( x_buf.GetBit(frame + i, node) ) { c |= (unsigned char)(1 << i); }
+                    }
+                    ofs.put((char)c);
+                }
+            }
+        }
+
+        ASSERT_EQ(0, std::system((cxx + " -O1 -std=c++11 -o " + base + ".out " + base + ".cpp").c_str())) << simd;
+        ASSERT_EQ(0, std::system(("./" + base + ".out " + base + "_in.bin " + base + "_out.bin").c_str())) << simd;
+
+        std::ifstream ifs(base + "_out.bin", std::ios::binary);
+        std::vector<char> out((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        ASSERT_EQ((size_t)(output_node_size * frame_size / 8), out.size()) << simd;
+        for ( int node = 0; node < output_node_size; ++node ) {
+            for ( int frame = 0; frame < frame_size; ++frame ) {
+                bool v = ((out[node * frame_size / 8 + frame / 8] >> (frame % 8)) & 1) != 0;
+                EXPECT_EQ((bool)y_buf.GetBit(frame, node), v) << simd << " frame " << frame << " node " << node;
+            }
+        }
+
+        std::remove((base + ".cpp").c_str());
+        std::remove((base + ".out").c_str());
+        std::remove((base + "_in.bin").c_str());
+        std::remove((base + "_out.bin").c_str());
+    }
+}
+
+#endif
+
+
+// end of file
@@ -0,0 +1,176 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/FoldBatchNormalization.h"
+#include "bb/HardTanh.h"
+
+
+static void FoldBatchNormalizationTest_SetRandom(bb::FrameBuffer &buf, std::uint64_t seed, float mean, float stddev)
+{
+    std::mt19937_64 mt(seed);
+    std::normal_distribution<float> dist(mean, stddev);
+    auto ptr = buf.Lock<float>();
+    for ( bb::index_t node = 0; node < buf.GetNodeSize(); ++node ) {
+        for ( bb::index_t frame = 0; frame < buf.GetFrameSize(); ++frame ) {
+            ptr.Set(frame, node, dist(mt));
+        }
+    }
+}
+
+template <typename BinType>
+static bb::index_t FoldBatchNormalizationTest_CountDiff(bb::FrameBuffer y0_buf, bb::FrameBuffer y1_buf)
+{
+    EXPECT_EQ(y0_buf.GetNodeSize(),  y1_buf.GetNodeSize());
+    EXPECT_EQ(y0_buf.GetFrameSize(), y1_buf.GetFrameSize());
+
+    bb::index_t diff = 0;
+    auto y0_ptr = y0_buf.LockConst<BinType>();
+    auto y1_ptr = y1_buf.LockConst<BinType>();
+    for ( bb::index_t node = 0; node < y0_buf.GetNodeSize(); ++node ) {
+        for ( bb::index_t frame = 0; frame < y0_buf.GetFrameSize(); ++frame ) {
+            if ( (float)y0_ptr.Get(frame, node) != (float)y1_ptr.Get(frame, node) ) {
+                ++diff;
+            }
+        }
+    }
+    return diff;
+}
+
+
+TEST(FoldBatchNormalizationTest, testFoldBatchNormalization)
+{
+    bb::index_t const node_size  = 37;
+    bb::index_t const frame_size = 203;
+
+    auto bn  = bb::BatchNormalization<float>::Create();
+    auto bin = bb::Binarize<bb::Bit, float>::Create();
+
+    auto net = bb::Sequential::Create();
+    net->Add(bn);
+    net->Add(bin);
+    net->SetInputShape({node_size});
+
+    // running_mean/var の学習(学習時のフレーム数は SIMD 幅に揃える)
+    for ( int i = 0; i < 20; ++i ) {
+        bb::FrameBuffer x_buf(256, {node_size}, BB_TYPE_FP32);
+        FoldBatchNormalizationTest_SetRandom(x_buf, i + 1, 1.5f, 3.0f);
+        net->Forward(x_buf, true);
+    }
+
+    // 正負/0 の gamma を混ぜる
+    {
+        auto gamma_ptr = bn->lock_gamma();
+        auto beta_ptr  = bn->lock_beta();
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            gamma_ptr(node) = (node % 3 == 0) ? -0.7f : 1.3f;
+            beta_ptr(node)  = 0.1f * (float)(node - node_size / 2);
+        }
+        gamma_ptr(1) = 0.0f; beta_ptr(1) = +0.5f;
+        gamma_ptr(2) = 0.0f; beta_ptr(2) = -0.5f;
+    }
+
+    bb::FoldBatchNormalizationReport report;
+    auto folded_net = bb::FoldBatchNormalization_Sequential<float>(net, &report);
+
+    EXPECT_EQ(1, folded_net->GetSize());
+    EXPECT_EQ("BinarizeThreshold", folded_net->Get(0)->GetClassName());
+    EXPECT_EQ(1, report.folded_bn);
+    EXPECT_EQ(2, report.constant_nodes);
+    EXPECT_EQ((node_size + 2) / 3, report.inverted_nodes);
+
+    bb::FrameBuffer x_buf(frame_size, {node_size}, BB_TYPE_FP32);
+    FoldBatchNormalizationTest_SetRandom(x_buf, 100, 1.5f, 3.0f);
+
+    auto y0_buf = net->Forward(x_buf, false);
+    auto y1_buf = folded_net->Forward(x_buf, false);
+    EXPECT_EQ(BB_TYPE_BIT, y1_buf.GetType());
+    EXPECT_LE(FoldBatchNormalizationTest_CountDiff<bb::Bit>(y0_buf, y1_buf), 1);
+
+    {
+        auto y_ptr = y1_buf.LockConst<bb::Bit>();
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            EXPECT_EQ(1, (int)y_ptr.Get(frame, 1));
+            EXPECT_EQ(0, (int)y_ptr.Get(frame, 2));
+        }
+    }
+
+    // 汎用版との一致
+    folded_net->SendCommand("host_simd false");
+    auto y2_buf = folded_net->Forward(x_buf, false);
+    EXPECT_EQ(0, FoldBatchNormalizationTest_CountDiff<bb::Bit>(y1_buf, y2_buf));
+}
+
+
+TEST(FoldBatchNormalizationTest, testFoldStochasticBatchNormalization)
+{
+    bb::index_t const node_size  = 16;
+    bb::index_t const frame_size = 64;
+
+    auto bn = bb::StochasticBatchNormalization<float>::Create(0.9f, -0.2f, 0.5f);
+    auto ht = bb::HardTanh<float, float>::Create(0.0f, 1.0f);
+
+    auto net = bb::Sequential::Create();
+    net->Add(bn);
+    net->Add(ht);
+    net->SetInputShape({node_size});
+    net->SendCommand("binary true");
+
+    for ( int i = 0; i < 10; ++i ) {
+        bb::FrameBuffer x_buf(frame_size, {node_size}, BB_TYPE_FP32);
+        FoldBatchNormalizationTest_SetRandom(x_buf, i + 10, 0.3f, 0.2f);
+        net->Forward(x_buf, true);
+    }
+
+    bb::FoldBatchNormalizationReport report;
+    auto folded_net = bb::FoldBatchNormalization_Sequential<float>(net, &report);
+    EXPECT_EQ(1, report.folded_bn);
+    EXPECT_EQ(node_size, report.inverted_nodes);
+
+    bb::FrameBuffer x_buf(frame_size, {node_size}, BB_TYPE_FP32);
+    FoldBatchNormalizationTest_SetRandom(x_buf, 200, 0.3f, 0.2f);
+
+    auto y0_buf = net->Forward(x_buf, false);
+    auto y1_buf = folded_net->Forward(x_buf, false);
+    EXPECT_EQ(BB_TYPE_FP32, y1_buf.GetType());
+    EXPECT_LE(FoldBatchNormalizationTest_CountDiff<float>(y0_buf, y1_buf), 1);
+}
+
+
+TEST(FoldBatchNormalizationTest, testFoldSparseLut)
+{
+    bb::index_t const input_node_size = 64;
+    bb::index_t const node_size       = 32;
+    bb::index_t const frame_size      = 128;
+
+    auto lut = bb::SparseLutN<6, bb::Bit>::Create(node_size);
+    lut->SetInputShape({input_node_size});
+
+    std::mt19937_64 mt(1);
+    bb::FrameBuffer x_buf(frame_size, {input_node_size}, BB_TYPE_BIT);
+    {
+        auto x_ptr = x_buf.Lock<bb::Bit>();
+        for ( bb::index_t node = 0; node < input_node_size; ++node ) {
+            for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                x_ptr.Set(frame, node, (mt() & 1) != 0);
+            }
+        }
+    }
+    for ( int i = 0; i < 4; ++i ) {
+        lut->Forward(x_buf, true);
+    }
+
+    bb::FoldBatchNormalizationReport report;
+    auto folded_lut = bb::FoldBatchNormalization_SparseLut<bb::Bit, float>(lut, report);
+    ASSERT_TRUE(folded_lut != nullptr);
+    EXPECT_EQ(1, report.folded_lut);
+    EXPECT_EQ("BinaryLutN", folded_lut->GetClassName());
+
+    auto y0_buf = lut->Forward(x_buf, false);
+    auto y1_buf = folded_lut->Forward(x_buf, false);
+    EXPECT_EQ(0, FoldBatchNormalizationTest_CountDiff<bb::Bit>(y0_buf, y1_buf));
+}
+
+
+// end of file
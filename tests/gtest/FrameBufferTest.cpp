@@ -4,6 +4,11 @@
 #include "gtest/gtest.h"
 
 #include "bb/FrameBuffer.h"
+#include "bb/DenseAffine.h"
+#include "bb/BinaryLutN.h"
+#include "bb/BatchNormalization.h"
+#include "bb/DataAugmentation.h"
+#include "bb/Sequential.h"
 
 
 #if BB_WITH_CEREAL
@@ -211,6 +216,297 @@ TEST(FrameBufferTest, FrameBuffer_Concatenate)
 }
 
 
+// ビュー(メモリ共有の切り出し)と copy-on-write
+TEST(FrameBufferTest, FrameBuffer_FrameRangeView)
+{
+    bb::index_t const frame_size = 100;
+    bb::index_t const node_size  = 3;
+
+    bb::FrameBuffer buf(frame_size, {node_size}, BB_TYPE_FP32);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            buf.SetFP32(frame, node, (float)(frame*100 + node));
+        }
+    }
+
+    // 部分範囲は標準の frame_stride でパディングがゼロのコピー
+    auto copy = buf.FrameRange(36, 16);
+    EXPECT_FALSE(copy.IsView());
+    EXPECT_EQ(36, copy.GetFrameSize());
+    EXPECT_EQ(bb::FrameBuffer(36, {node_size}, BB_TYPE_FP32).GetFrameStride(), copy.GetFrameStride());
+    for ( bb::index_t frame = 0; frame < 36; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            EXPECT_EQ((float)((frame+16)*100 + node), copy.GetFP32(frame, node));
+        }
+    }
+    {
+        auto ptr = copy.LockConst<float>();
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            for ( bb::index_t frame = 36; frame < 40; ++frame ) {
+                EXPECT_EQ(0.0f, ptr.GetAddr(node)[frame]);
+            }
+        }
+    }
+
+    // 全範囲はビュー
+    auto view = buf.FrameRange(frame_size, 0);
+    EXPECT_TRUE(view.IsView());
+    EXPECT_EQ(buf.GetFrameStride(), view.GetFrameStride());
+    EXPECT_EQ((float)(40*100 + 2), view.GetFP32(40, 2));
+
+    // 書き込むと切り離される
+    view.SetFP32(0, 0, -1.0f);
+    EXPECT_FALSE(view.IsView());
+    EXPECT_EQ(-1.0f, view.GetFP32(0, 0));
+    EXPECT_EQ((float)(1*100 + 0), view.GetFP32(1, 0));
+    EXPECT_EQ((float)(0*100 + 0), buf.GetFP32(0, 0));
+}
+
+TEST(FrameBufferTest, FrameBuffer_FrameRangeViewBit)
+{
+    bb::index_t const frame_size = 600;
+    bb::index_t const node_size  = 5;
+
+    std::mt19937_64 mt(1);
+    bb::FrameBuffer buf(frame_size, {node_size}, BB_TYPE_BIT);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            buf.SetBit(frame, node, (mt() & 1) != 0);
+        }
+    }
+
+    auto copy0 = buf.FrameRange(300, 256);
+    auto copy1 = buf.FrameRange(300, 3);
+    EXPECT_FALSE(copy0.IsView());
+    EXPECT_FALSE(copy1.IsView());
+    EXPECT_EQ(bb::FrameBuffer(300, {node_size}, BB_TYPE_BIT).GetFrameStride(), copy0.GetFrameStride());
+    for ( bb::index_t frame = 0; frame < 300; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            EXPECT_EQ(buf.GetBit(frame + 256, node), copy0.GetBit(frame, node));
+            EXPECT_EQ(buf.GetBit(frame + 3,   node), copy1.GetBit(frame, node));
+        }
+    }
+
+    // パディングのビットはゼロ
+    for ( auto const &copy : {copy0, copy1} ) {
+        auto ptr = copy.LockMemoryConst();
+        auto addr = (std::uint8_t const *)ptr.GetAddr();
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            auto row = addr + copy.GetFrameStride() * node;
+            EXPECT_EQ(0, row[300 / 8] >> (300 % 8));
+            for ( bb::index_t i = 300 / 8 + 1; i < copy.GetFrameStride(); ++i ) {
+                EXPECT_EQ(0, row[i]);
+            }
+        }
+    }
+
+    auto view  = buf.FrameRange(frame_size);
+    auto clone = view.Clone();
+    EXPECT_FALSE(clone.IsView());
+    EXPECT_TRUE(view.IsView());
+    for ( bb::index_t node = 0; node < node_size; ++node ) {
+        EXPECT_EQ(buf.GetBit(599, node), clone.GetBit(599, node));
+    }
+}
+
+TEST(FrameBufferTest, FrameBuffer_RangeView)
+{
+    bb::index_t const frame_size = 20;
+    bb::index_t const node_size  = 10;
+
+    bb::FrameBuffer buf(frame_size, {node_size}, BB_TYPE_FP32);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            buf.SetFP32(frame, node, (float)(frame*100 + node));
+        }
+    }
+
+    auto buf0 = buf.Range(3, 2);
+    auto buf1 = buf.Range(4, 5);
+    EXPECT_TRUE(buf0.IsView());
+    EXPECT_TRUE(buf1.IsView());
+
+    // 隣接したビューの連結はビュー
+    auto cat = buf0.Concatenate(buf1);
+    EXPECT_TRUE(cat.IsView());
+    EXPECT_EQ(7, cat.GetNodeSize());
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 7; ++node ) {
+            EXPECT_EQ((float)(frame*100 + node + 2), cat.GetFP32(frame, node));
+        }
+    }
+
+    // 隣接していなければコピー
+    auto cat2 = buf1.Concatenate(buf0);
+    EXPECT_FALSE(cat2.IsView());
+    EXPECT_EQ((float)(3*100 + 5), cat2.GetFP32(3, 0));
+    EXPECT_EQ((float)(3*100 + 2), cat2.GetFP32(3, 4));
+
+    // フレーム方向の切り出しとの連結
+    auto cat3 = buf.FrameRange(12, 8).Concatenate(bb::FrameBuffer(12, {2}, BB_TYPE_FP32));
+    EXPECT_EQ(12, cat3.GetNodeSize());
+    EXPECT_EQ((float)(19*100 + 9), cat3.GetFP32(11, 9));
+
+    // 演算やゼロ埋めは元に影響しない
+    auto sum = buf0 + buf0;
+    EXPECT_EQ((float)(2*(5*100 + 3)), sum.GetFP32(5, 1));
+    buf0.FillZero();
+    EXPECT_FALSE(buf0.IsView());
+    EXPECT_EQ(0.0f, buf0.GetFP32(5, 1));
+    EXPECT_EQ((float)(5*100 + 3), buf.GetFP32(5, 3));
+}
+
+// レイヤーはビューをそのまま受け付ける
+TEST(FrameBufferTest, FrameBuffer_ViewForward)
+{
+    bb::index_t const frame_size = 64;
+    bb::index_t const node_size  = 12;
+
+    std::mt19937_64 mt(2);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    bb::FrameBuffer buf(frame_size, {node_size}, BB_TYPE_FP32);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    auto affine = bb::DenseAffine<>::Create(5);
+    affine->SetInputShape({node_size - 4});
+
+    auto view = buf.Range(node_size - 4, 2);
+    auto y_view = affine->Forward(view, false);
+    auto y_copy = affine->Forward(view.Clone(), false);
+    EXPECT_TRUE(view.IsView());
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 5; ++node ) {
+            EXPECT_EQ(y_copy.GetFP32(frame, node), y_view.GetFP32(frame, node));
+        }
+    }
+}
+
+
+// 切り出し/連結した結果を各種レイヤーに通しても複製と同じ結果になる
+TEST(FrameBufferTest, FrameBuffer_ViewLayers)
+{
+    std::mt19937_64 mt(3);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+
+    // BinaryLutN (Bit)
+    {
+        bb::FrameBuffer buf(1000, {64}, BB_TYPE_BIT);
+        for ( bb::index_t frame = 0; frame < 1000; ++frame ) {
+            for ( bb::index_t node = 0; node < 64; ++node ) {
+                buf.SetBit(frame, node, (mt() & 1) != 0);
+            }
+        }
+
+        auto lut = bb::BinaryLutN<6, bb::Bit>::Create(32);
+        lut->SetInputShape({64});
+
+        for ( auto x_buf : {buf.FrameRange(1000), buf.FrameRange(300, 256), buf.FrameRange(77, 3),
+                            buf.Range(20, 0).Concatenate(buf.Range(44, 20))} ) {
+            auto y_view = lut->Forward(x_buf, false).Clone();
+            auto y_copy = lut->Forward(x_buf.Clone(), false);
+            EXPECT_EQ(y_copy.GetFrameStride(), y_view.GetFrameStride());
+            for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+                for ( bb::index_t node = 0; node < 32; ++node ) {
+                    EXPECT_EQ(y_copy.GetBit(frame, node), y_view.GetBit(frame, node));
+                }
+            }
+        }
+    }
+
+    // BatchNormalization (学習時の統計はパディングを含まない)
+    {
+        bb::FrameBuffer buf(100, {6}, BB_TYPE_FP32);
+        for ( bb::index_t frame = 0; frame < 100; ++frame ) {
+            for ( bb::index_t node = 0; node < 6; ++node ) {
+                buf.SetFP32(frame, node, dist(mt) * 3.0f + 1.0f);
+            }
+        }
+
+        for ( auto x_buf : {buf.FrameRange(37, 8), buf.FrameRange(41, 59),
+                            buf.Range(2, 0).Concatenate(buf.Range(4, 2))} ) {
+            auto bn_view = bb::BatchNormalization<float>::Create();
+            auto bn_ref  = bb::BatchNormalization<float>::Create();
+            bn_ref->SendCommand("host_simd false");
+            bn_view->SetInputShape(x_buf.GetShape());
+            bn_ref->SetInputShape(x_buf.GetShape());
+
+            auto y_view = bn_view->Forward(x_buf, true);
+
+            // 参照はパディングを含まない汎用版
+            bb::FrameBuffer x_ref(x_buf.GetFrameSize(), x_buf.GetShape(), BB_TYPE_FP32);
+            for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+                for ( bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node ) {
+                    x_ref.SetFP32(frame, node, x_buf.GetFP32(frame, node));
+                }
+            }
+            auto y_ref = bn_ref->Forward(x_ref, true);
+
+            for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+                for ( bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node ) {
+                    EXPECT_NEAR(y_ref.GetFP32(frame, node), y_view.GetFP32(frame, node), 1.0e-4f);
+                }
+            }
+        }
+    }
+
+    // DataAugmentation (x と y の frame_stride が一致していること)
+    {
+        bb::FrameBuffer buf(50, {8, 8}, BB_TYPE_FP32);
+        for ( bb::index_t frame = 0; frame < 50; ++frame ) {
+            for ( bb::index_t node = 0; node < 64; ++node ) {
+                buf.SetFP32(frame, node, dist(mt));
+            }
+        }
+
+        auto cat = buf.Range(30, 0).Concatenate(buf.Range(34, 30));
+        cat.Reshape({8, 8});
+        for ( auto x_buf : {buf.FrameRange(50), buf.FrameRange(21, 16), cat} ) {
+            auto da_view = bb::DataAugmentation<>::CreateEx(0.2f, 0.1f, 30.0f, 0.2f, 0.5f, 0.5f, 1, 0.5f, 0.1f, 0.8f);
+            auto da_copy = bb::DataAugmentation<>::CreateEx(0.2f, 0.1f, 30.0f, 0.2f, 0.5f, 0.5f, 1, 0.5f, 0.1f, 0.8f);
+            da_view->SetInputShape(x_buf.GetShape());
+            da_copy->SetInputShape(x_buf.GetShape());
+            auto y_view = da_view->Forward(x_buf, true);
+            auto y_copy = da_copy->Forward(x_buf.Clone(), true);
+            EXPECT_EQ(y_copy.GetFrameStride(), y_view.GetFrameStride());
+            for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+                for ( bb::index_t node = 0; node < 64; ++node ) {
+                    EXPECT_EQ(y_copy.GetFP32(frame, node), y_view.GetFP32(frame, node));
+                }
+            }
+        }
+    }
+
+    // Sequential のパイプライン推論(チャンクは FrameRange で切り出される)
+    {
+        bb::FrameBuffer x_buf(1024, {64}, BB_TYPE_BIT);
+        for ( bb::index_t frame = 0; frame < 1024; ++frame ) {
+            for ( bb::index_t node = 0; node < 64; ++node ) {
+                x_buf.SetBit(frame, node, (mt() & 1) != 0);
+            }
+        }
+
+        auto net = bb::Sequential::Create();
+        net->Add(bb::BinaryLutN<6, bb::Bit>::Create(128));
+        net->Add(bb::BinaryLutN<6, bb::Bit>::Create(32));
+        net->SetInputShape({64});
+
+        auto y_ref = net->Forward(x_buf, false).Clone();
+        net->SetPipeline(256, 2);
+        auto y_pipe = net->Forward(x_buf, false);
+        net->SetPipeline(0);
+        for ( bb::index_t frame = 0; frame < 1024; ++frame ) {
+            for ( bb::index_t node = 0; node < 32; ++node ) {
+                EXPECT_EQ(y_ref.GetBit(frame, node), y_pipe.GetBit(frame, node));
+            }
+        }
+    }
+}
+
+
 TEST(FrameBufferTest, FrameBuffer_SetGetTensor)
 {
     bb::index_t const frame_size = 32;
@@ -534,4 +830,44 @@ TEST(FrameBufferTest, testConvertTo_BitToFP32)
 
 
 
+TEST(FrameBufferTest, testFrameBuffer_DataArray)
+{
+    int frame_size = 77;
+    int node_size  = 45;
+
+    std::vector<float>          src_fp32(frame_size * node_size);
+    std::vector<std::uint8_t>   src_u8(frame_size * node_size);
+    for ( int i = 0; i < frame_size * node_size; ++i ) {
+        src_fp32[i] = (float)i * 0.5f;
+        src_u8[i]   = (std::uint8_t)((i * 7) % 3 == 0 ? 1 : 0);
+    }
+
+    // サンプル優先の配列からの設定と取得
+    bb::FrameBuffer buf_fp32(frame_size + 3, {node_size}, BB_TYPE_FP32);
+    buf_fp32.SetDataArray(src_fp32.data(), frame_size, 3);
+    for ( int frame = 0; frame < frame_size; ++frame ) {
+        for ( int node = 0; node < node_size; ++node ) {
+            EXPECT_EQ(src_fp32[frame * node_size + node], buf_fp32.GetFP32(frame + 3, node));
+        }
+    }
+
+    std::vector<float> dst_fp32(frame_size * node_size);
+    buf_fp32.GetDataArray(dst_fp32.data(), frame_size, 3);
+    EXPECT_EQ(src_fp32, dst_fp32);
+
+    // uint8 から Bit への変換
+    bb::FrameBuffer buf_bit(frame_size, {node_size}, BB_TYPE_BIT);
+    buf_bit.SetDataArray(src_u8.data(), frame_size);
+    for ( int frame = 0; frame < frame_size; ++frame ) {
+        for ( int node = 0; node < node_size; ++node ) {
+            EXPECT_EQ(src_u8[frame * node_size + node] != 0, (bool)buf_bit.GetBit(frame, node));
+        }
+    }
+
+    std::vector<std::uint8_t> dst_u8(frame_size * node_size);
+    buf_bit.GetDataArray(dst_u8.data(), frame_size);
+    EXPECT_EQ(src_u8, dst_u8);
+}
+
+
 // end of file
\ No newline at end of file
@@ -0,0 +1,76 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/GemmSimd.h"
+
+
+// 素朴な実装との比較 (A/B の転置、端数、ブロック跨ぎ、beta=0/1)
+static void GemmSimdTest_Compare(bb::index_t M, bb::index_t N, bb::index_t K, bool a_trans, bool b_trans, float beta)
+{
+    std::mt19937_64 mt(M * 10007 + N * 101 + K);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    bb::index_t a_rs = a_trans ? 1 : K + 3;
+    bb::index_t a_cs = a_trans ? M + 5 : 1;
+    bb::index_t b_rs = b_trans ? 1 : N + 7;
+    bb::index_t b_cs = b_trans ? K + 2 : 1;
+    bb::index_t c_rs = N + 1;
+
+    std::vector<float> a((a_trans ? K * a_cs : M * a_rs));
+    std::vector<float> b((b_trans ? N * b_cs : K * b_rs));
+    std::vector<float> c0(M * c_rs);
+    for ( auto &v : a )  { v = dist(mt); }
+    for ( auto &v : b )  { v = dist(mt); }
+    for ( auto &v : c0 ) { v = dist(mt); }
+
+    std::vector<float> exp_c = c0;
+    for ( bb::index_t m = 0; m < M; ++m ) {
+        for ( bb::index_t n = 0; n < N; ++n ) {
+            double sum = 0;
+            for ( bb::index_t k = 0; k < K; ++k ) {
+                sum += (double)a[m * a_rs + k * a_cs] * (double)b[k * b_rs + n * b_cs];
+            }
+            exp_c[m * c_rs + n] = (float)(sum + beta * c0[m * c_rs + n]);
+        }
+    }
+
+    auto level = bb::SimdKernel::GetLevel();
+    for ( auto limit : {bb::SimdLevel::None, bb::SimdLevel::AVX2, bb::SimdLevel::AVX512} ) {
+        bb::SimdKernel::SetLimit(limit);
+
+        std::vector<float> c = c0;
+        bb::simd_fp32_Gemm(M, N, K, a.data(), a_rs, a_cs, b.data(), b_rs, b_cs, beta, c.data(), c_rs);
+
+        for ( bb::index_t m = 0; m < M; ++m ) {
+            for ( bb::index_t n = 0; n < N; ++n ) {
+                EXPECT_NEAR(exp_c[m * c_rs + n], c[m * c_rs + n], 1.0e-3f) << "m=" << m << " n=" << n;
+            }
+            // 有効範囲外は書き換えない
+            EXPECT_EQ(c0[m * c_rs + N], c[m * c_rs + N]);
+        }
+    }
+    bb::SimdKernel::SetLimit(level);
+}
+
+
+TEST(GemmSimdTest, testGemm_Small)
+{
+    GemmSimdTest_Compare(1,  1,  1, false, false, 0.0f);
+    GemmSimdTest_Compare(7, 13,  5, false, false, 0.0f);
+    GemmSimdTest_Compare(6, 16,  9, false, false, 1.0f);
+    GemmSimdTest_Compare(5, 33, 17, true,  false, 0.0f);
+    GemmSimdTest_Compare(11, 9, 40, false, true,  1.0f);
+}
+
+TEST(GemmSimdTest, testGemm_Block)
+{
+    // MC/KC/NC の境界を跨ぐサイズ
+    GemmSimdTest_Compare(100, 1030, 260, false, false, 1.0f);
+    GemmSimdTest_Compare(200,   45, 300, true,  false, 0.0f);
+    GemmSimdTest_Compare( 97,   70, 513, false, true,  1.0f);
+}
+
+
+// end of file
@@ -0,0 +1,103 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "bb/InferenceContext.h"
+#include "bb/Sequential.h"
+#include "bb/RealToBinary.h"
+#include "bb/BinaryLutN.h"
+#include "bb/ShuffleModulation.h"
+#include "bb/BinaryToReal.h"
+#include "bb/DenseAffine.h"
+#include "bb/BatchNormalization.h"
+#include "bb/ReLU.h"
+#include "bb/Sigmoid.h"
+#include "bb/Reduce.h"
+
+
+TEST(InferenceContextTest, testInferenceContext_State)
+{
+    bb::InferenceContext ctx;
+    int a = 0, b = 0;
+
+    ctx.GetState<int>(&a) = 1;
+    ctx.GetState<int>(&b) = 2;
+    EXPECT_EQ(1, ctx.GetState<int>(&a));
+    EXPECT_EQ(2, ctx.GetState<int>(&b));
+
+    ctx.Clear();
+    EXPECT_EQ(0, ctx.GetState<int>(&a));
+}
+
+
+TEST(InferenceContextTest, testInferenceContext_MultiThread)
+{
+    auto net = bb::Sequential::Create();
+    net->Add(bb::RealToBinary<bb::Bit>::Create(4));
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(64));
+    net->Add(bb::ShuffleModulation<bb::Bit>::Create(4));
+    net->Add(bb::BinaryToReal<bb::Bit>::Create(4, {64}));
+    net->Add(bb::DenseAffine<>::Create(32));
+    net->Add(bb::BatchNormalization<>::Create());
+    net->Add(bb::ReLU<>::Create());
+    net->Add(bb::DenseAffine<>::Create(16));
+    net->Add(bb::Sigmoid<>::Create());
+    net->Add(bb::Reduce<>::Create(8));      // 推論用forward未対応レイヤー(排他して呼ばれる)
+    net->SetInputShape({12});
+
+    int const       thread_size = 4;
+    bb::index_t     frame_size  = 67;
+
+    // スレッド毎に異なる入力を用意
+    std::mt19937_64                 mt(1);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<bb::FrameBuffer>    x_bufs;
+    for ( int i = 0; i < thread_size; ++i ) {
+        bb::FrameBuffer x_buf(frame_size + i, {12}, BB_TYPE_FP32);
+        for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+            for ( bb::index_t node = 0; node < 12; ++node ) {
+                x_buf.SetFP32(frame, node, dist(mt));
+            }
+        }
+        x_bufs.push_back(x_buf);
+    }
+
+    // BatchNormalization の実行時統計を学習で更新しておく
+    net->Forward(x_bufs[0], true);
+
+    // 期待値は従来の逐次実行
+    std::vector<bb::FrameBuffer> y_exps;
+    for ( auto &x_buf : x_bufs ) {
+        y_exps.push_back(net->Forward(x_buf, false).Clone());
+    }
+
+    // 同じモデルを複数スレッドから同時に呼ぶ
+    std::vector<bb::FrameBuffer> y_bufs(thread_size);
+    std::vector<std::thread>     threads;
+    for ( int i = 0; i < thread_size; ++i ) {
+        threads.push_back(std::thread([&, i]() {
+            bb::InferenceContext ctx;
+            for ( int loop = 0; loop < 3; ++loop ) {
+                y_bufs[i] = net->Forward(x_bufs[i], ctx).Clone();
+            }
+        }));
+    }
+    for ( auto &th : threads ) {
+        th.join();
+    }
+
+    for ( int i = 0; i < thread_size; ++i ) {
+        EXPECT_EQ(y_exps[i].GetFrameSize(), y_bufs[i].GetFrameSize());
+        EXPECT_EQ(y_exps[i].GetNodeSize(),  y_bufs[i].GetNodeSize());
+        for ( bb::index_t frame = 0; frame < y_exps[i].GetFrameSize(); ++frame ) {
+            for ( bb::index_t node = 0; node < y_exps[i].GetNodeSize(); ++node ) {
+                EXPECT_FLOAT_EQ(y_exps[i].GetFP32(frame, node), y_bufs[i].GetFP32(frame, node));
+            }
+        }
+    }
+}
+
+
+// end of file
@@ -0,0 +1,280 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <fstream>
+#include "gtest/gtest.h"
+
+#include "bb/DynamicBatcher.h"
+#include "bb/InferenceServer.h"
+#include "bb/Sequential.h"
+#include "bb/DenseAffine.h"
+#include "bb/BatchNormalization.h"
+#include "bb/ReLU.h"
+
+
+static std::shared_ptr<bb::Model> InferenceServerTest_CreateNet(void)
+{
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<>::Create(32));
+    net->Add(bb::BatchNormalization<>::Create());
+    net->Add(bb::ReLU<>::Create());
+    net->Add(bb::DenseAffine<>::Create(10));
+    net->SetInputShape({16});
+    return net;
+}
+
+// 入力によらず1フレームだけ返す(フレーム数の不一致を起こす)モデル
+class InferenceServerTest_OneFrame : public bb::Model
+{
+public:
+    std::string GetClassName(void) const { return "InferenceServerTest_OneFrame"; }
+    bb::indices_t GetInputShape(void) const  { return {16}; }
+    bb::indices_t GetOutputShape(void) const { return {16}; }
+
+    bb::FrameBuffer Forward(bb::FrameBuffer x_buf, bool train = true)
+    {
+        bb::FrameBuffer y_buf(1, {16}, BB_TYPE_FP32);
+        x_buf.CopyTo(y_buf, 1);
+        return y_buf;
+    }
+
+    bb::FrameBuffer Backward(bb::FrameBuffer dy_buf) { return dy_buf; }
+};
+
+static bb::FrameBuffer InferenceServerTest_CreateInput(bb::index_t frame_size, std::uint64_t seed)
+{
+    std::mt19937_64                 mt(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    bb::FrameBuffer x_buf(frame_size, {16}, BB_TYPE_FP32);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 16; ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+    return x_buf;
+}
+
+
+TEST(InferenceServerTest, testDynamicBatcher)
+{
+    auto net = InferenceServerTest_CreateNet();
+
+    int const request_size = 16;
+    std::vector<bb::FrameBuffer> x_bufs;
+    std::vector<bb::FrameBuffer> y_exps;
+    for ( int i = 0; i < request_size; ++i ) {
+        x_bufs.push_back(InferenceServerTest_CreateInput(1 + i % 5, i));
+        y_exps.push_back(net->Forward(x_bufs[i], false).Clone());
+    }
+
+    // 十分な待ち時間をとって要求がまとめられること
+    auto batcher = bb::DynamicBatcher::Create(net, 64, 0.05);
+    std::vector< std::future<bb::FrameBuffer> > futures;
+    for ( int i = 0; i < request_size; ++i ) {
+        futures.push_back(batcher->Submit(x_bufs[i]));
+    }
+
+    for ( int i = 0; i < request_size; ++i ) {
+        auto y_buf = futures[i].get();
+        ASSERT_EQ(y_exps[i].GetFrameSize(), y_buf.GetFrameSize());
+        ASSERT_EQ(y_exps[i].GetNodeSize(),  y_buf.GetNodeSize());
+        for ( bb::index_t frame = 0; frame < y_buf.GetFrameSize(); ++frame ) {
+            for ( bb::index_t node = 0; node < y_buf.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(y_exps[i].GetFP32(frame, node), y_buf.GetFP32(frame, node), 1.0e-4f);
+            }
+        }
+    }
+
+    auto stat = batcher->GetStatistics();
+    EXPECT_EQ((std::uint64_t)request_size, stat.request_count);
+    EXPECT_LT(stat.batch_count, stat.request_count);
+    EXPECT_GT(stat.AverageBatchSize(), 1.0);
+    EXPECT_GT(stat.FrameThroughput(), 0.0);
+
+    // max_batch_size を超える要求は単独で処理されること
+    auto y_buf = batcher->Forward(InferenceServerTest_CreateInput(100, 99));
+    EXPECT_EQ(100, y_buf.GetFrameSize());
+}
+
+
+TEST(InferenceServerTest, testDynamicBatcher_FrameSizeMismatch)
+{
+    // 出力フレーム数が合わなければ要求元に例外が返り、以降の要求も処理できる
+    auto batcher = bb::DynamicBatcher::Create(std::make_shared<InferenceServerTest_OneFrame>(), 64, 0.0);
+    EXPECT_THROW(batcher->Forward(InferenceServerTest_CreateInput(3, 1)), std::runtime_error);
+
+    auto y_buf = batcher->Forward(InferenceServerTest_CreateInput(1, 2));
+    EXPECT_EQ(1, y_buf.GetFrameSize());
+}
+
+
+// InferenceServer は Unix ドメインソケットを使うので Windows では対象外
+#ifndef _WIN32
+
+#include <unistd.h>
+#include <future>
+#include <sys/resource.h>
+
+TEST(InferenceServerTest, testInferenceServer)
+{
+    auto net = InferenceServerTest_CreateNet();
+
+    std::string path = "/tmp/bb_inference_server_test_" + std::to_string(getpid()) + ".sock";
+    auto server = bb::InferenceServer::Create(net, path, 64, 0.005);
+    ASSERT_TRUE(server->Start());
+
+    // 複数クライアントから同時に要求
+    int const client_size = 4;
+    std::vector<bb::FrameBuffer>    x_bufs;
+    std::vector<bb::FrameBuffer>    y_exps;
+    for ( int i = 0; i < client_size; ++i ) {
+        x_bufs.push_back(InferenceServerTest_CreateInput(3 + i, 100 + i));
+        y_exps.push_back(net->Forward(x_bufs[i], false).Clone());
+    }
+
+    std::vector<bb::FrameBuffer>    y_bufs(client_size);
+    std::vector<std::thread>        threads;
+    for ( int i = 0; i < client_size; ++i ) {
+        threads.push_back(std::thread([&, i]() {
+            bb::InferenceClient client;
+            if ( client.Connect(path) ) {
+                for ( int loop = 0; loop < 4; ++loop ) {
+                    y_bufs[i] = client.Forward(x_bufs[i]);
+                }
+            }
+        }));
+    }
+    for ( auto &th : threads ) {
+        th.join();
+    }
+
+    for ( int i = 0; i < client_size; ++i ) {
+        ASSERT_EQ(y_exps[i].GetFrameSize(), y_bufs[i].GetFrameSize());
+        ASSERT_EQ(y_exps[i].GetNodeSize(),  y_bufs[i].GetNodeSize());
+        for ( bb::index_t frame = 0; frame < y_exps[i].GetFrameSize(); ++frame ) {
+            for ( bb::index_t node = 0; node < y_exps[i].GetNodeSize(); ++node ) {
+                EXPECT_NEAR(y_exps[i].GetFP32(frame, node), y_bufs[i].GetFP32(frame, node), 1.0e-4f);
+            }
+        }
+    }
+
+    // 統計情報と不正な要求
+    bb::InferenceClient client;
+    ASSERT_TRUE(client.Connect(path));
+    auto str = client.GetStatisticsString();
+    EXPECT_NE(std::string::npos, str.find("requests           : 16"));
+
+    std::vector<float> x(8, 0.0f), y;
+    bb::index_t output_node_size = 0;
+    EXPECT_FALSE(client.Forward(x.data(), 1, 8, y, output_node_size));
+
+    server->Stop();
+}
+
+
+TEST(InferenceServerTest, testInferenceServer_FrameSizeMismatch)
+{
+    std::string path = "/tmp/bb_inference_server_test_" + std::to_string(getpid()) + "_mismatch.sock";
+    auto server = bb::InferenceServer::Create(std::make_shared<InferenceServerTest_OneFrame>(), path, 64, 0.0);
+    ASSERT_TRUE(server->Start());
+
+    // サーバーは落ちずにエラーを返し、同じ接続で次の要求を受け付ける
+    bb::InferenceClient client;
+    ASSERT_TRUE(client.Connect(path));
+    EXPECT_EQ(0, client.Forward(InferenceServerTest_CreateInput(3, 1)).GetFrameSize());
+    EXPECT_EQ(1, client.Forward(InferenceServerTest_CreateInput(1, 2)).GetFrameSize());
+
+    server->Stop();
+}
+
+
+// RLIMIT_NOFILE をスコープを抜ける時に(ASSERT で抜けた場合も)元に戻す
+class InferenceServerTest_RestoreFileLimit
+{
+protected:
+    struct rlimit   m_limit;
+    bool            m_valid = false;
+
+public:
+    InferenceServerTest_RestoreFileLimit()
+    {
+        m_valid = (getrlimit(RLIMIT_NOFILE, &m_limit) == 0);
+    }
+
+    ~InferenceServerTest_RestoreFileLimit()
+    {
+        Restore();
+    }
+
+    bool IsValid(void) const { return m_valid; }
+    struct rlimit const &GetLimit(void) const { return m_limit; }
+
+    bool Restore(void)
+    {
+        return !m_valid || setrlimit(RLIMIT_NOFILE, &m_limit) == 0;
+    }
+};
+
+TEST(InferenceServerTest, testInferenceServer_AcceptRetry)
+{
+    auto net = InferenceServerTest_CreateNet();
+    auto x_buf = InferenceServerTest_CreateInput(2, 7);
+
+    std::string path = "/tmp/bb_inference_server_test_" + std::to_string(getpid()) + "_retry.sock";
+    auto server = bb::InferenceServer::Create(net, path, 64, 0.0);
+    ASSERT_TRUE(server->Start());
+
+    // クライアント側のソケットまでで記述子を使い切らせて accept を EMFILE で失敗させる
+    InferenceServerTest_RestoreFileLimit org_limit;
+    ASSERT_TRUE(org_limit.IsValid());
+    int next_fd = dup(0);
+    ASSERT_GE(next_fd, 0);
+    close(next_fd);
+
+    struct rlimit limit = org_limit.GetLimit();
+    limit.rlim_cur = (rlim_t)next_fd + 1;
+    ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limit));
+
+    bb::InferenceClient client;
+    bool connected = client.Connect(path);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_TRUE(org_limit.Restore());
+    ASSERT_TRUE(connected);
+
+    // 制限が解ければ保留されていた接続も受け付けて処理する
+    auto result = std::async(std::launch::async, [&]() { return client.Forward(x_buf).GetFrameSize(); });
+    bool ready = (result.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+    server->Stop();     // 受け付けられなかった場合もここで接続が切れて Forward が戻る
+    EXPECT_TRUE(ready);
+    EXPECT_EQ(2, result.get());
+}
+
+
+TEST(InferenceServerTest, testInferenceServer_KeepRegularFile)
+{
+    auto net = InferenceServerTest_CreateNet();
+
+    // ソケット以外のファイルは消さずに起動に失敗する
+    std::string path = "/tmp/bb_inference_server_test_" + std::to_string(getpid()) + ".txt";
+    {
+        std::ofstream ofs(path);
+        ofs << "keep";
+    }
+
+    auto server = bb::InferenceServer::Create(net, path, 64, 0.005);
+    EXPECT_FALSE(server->Start());
+
+    std::ifstream ifs(path);
+    std::string str;
+    ifs >> str;
+    EXPECT_EQ(std::string("keep"), str);
+
+    unlink(path.c_str());
+}
+
+#endif
+
+
+// end of file
@@ -0,0 +1,112 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/MultiRunner.h"
+#include "bb/Runner.h"
+#include "bb/Sequential.h"
+#include "bb/DenseAffine.h"
+#include "bb/ReLU.h"
+#include "bb/LossSoftmaxCrossEntropy.h"
+#include "bb/MetricsCategoricalAccuracy.h"
+#include "bb/OptimizerAdam.h"
+
+
+static void MakeMultiRunnerTestData(bb::TrainData<float> &td)
+{
+    std::mt19937_64 mt(3);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    td.x_shape = bb::indices_t({4});
+    td.t_shape = bb::indices_t({2});
+    for ( int frame = 0; frame < 768; ++frame ) {
+        std::vector<float> x(4);
+        for ( auto &v : x ) {
+            v = dist(mt);
+        }
+        int c = (x[0] + x[1] > 0) ? 1 : 0;
+        std::vector<float> t = {(c == 0) ? 1.0f : 0.0f, (c == 1) ? 1.0f : 0.0f};
+        if ( frame < 512 ) {
+            td.x_train.push_back(x);
+            td.t_train.push_back(t);
+        }
+        else {
+            td.x_test.push_back(x);
+            td.t_test.push_back(t);
+        }
+    }
+}
+
+static std::shared_ptr<bb::Sequential> MakeMultiRunnerTestNet(bool hidden)
+{
+    auto net = bb::Sequential::Create();
+    if ( hidden ) {
+        net->Add(bb::DenseAffine<>::Create(8));
+        net->Add(bb::ReLU<float>::Create());
+    }
+    net->Add(bb::DenseAffine<>::Create(2));
+    net->SetInputShape({4});
+    return net;
+}
+
+
+TEST(MultiRunnerTest, testMultiRunner_Lockstep)
+{
+    bb::index_t const epoch_size = 5;
+    bb::index_t const batch_size = 16;
+
+    // 比較用に単独の Runner で学習
+    bb::TrainData<float> td_single;
+    MakeMultiRunnerTestData(td_single);
+    auto net_single = MakeMultiRunnerTestNet(false);
+    auto runner = bb::Runner<float>::CreateEx("MultiRunnerTestSingle", net_single,
+                        bb::LossSoftmaxCrossEntropy<float>::Create(),
+                        bb::MetricsCategoricalAccuracy<float>::Create(),
+                        bb::OptimizerAdam<float>::Create(0.01f),
+                        0, false, false, false, false);
+    runner->Fitting(td_single, epoch_size, batch_size);
+    double acc_single = runner->Evaluation(td_single, 64);
+
+    for ( int parallel = 0; parallel < 2; ++parallel ) {
+        // 構成と学習率の異なるモデルを同時に学習
+        bb::TrainData<float> td;
+        MakeMultiRunnerTestData(td);
+
+        bb::MultiRunner<float>::create_t create;
+        create.name           = "MultiRunnerTest";
+        create.parallel       = (parallel != 0);
+        create.print_progress = false;
+        create.log_write      = false;
+        auto multi_runner = bb::MultiRunner<float>::Create(create);
+
+        std::vector< std::shared_ptr<bb::Sequential> > nets;
+        for ( int k = 0; k < 3; ++k ) {
+            nets.push_back(MakeMultiRunnerTestNet(k == 2));
+            multi_runner->AddModel("model" + std::to_string(k), nets[k],
+                        bb::LossSoftmaxCrossEntropy<float>::Create(),
+                        bb::MetricsCategoricalAccuracy<float>::Create(),
+                        bb::OptimizerAdam<float>::Create(k == 1 ? 0.002f : 0.01f));
+        }
+        EXPECT_EQ(3, multi_runner->GetModelSize());
+
+        auto acc = multi_runner->Fitting(td, epoch_size, batch_size);
+        ASSERT_EQ(3, (int)acc.size());
+        EXPECT_GT(acc[0], 0.9);
+        EXPECT_GT(acc[2], 0.9);
+
+        // 同じミニバッチ列で学習するので単独学習と同じ結果になる
+        EXPECT_DOUBLE_EQ(acc_single, acc[0]);
+
+        auto eval = multi_runner->Evaluation(td, 64);
+        for ( int k = 0; k < 3; ++k ) {
+            EXPECT_DOUBLE_EQ(acc[k], eval[k]);
+        }
+
+        // モデルスレッド用に休ませたワーカーは元に戻っている
+        auto &pool = bb::ThreadPool::GetInstance();
+        EXPECT_EQ(pool.GetThreadSize(), pool.GetActiveThreadSize());
+    }
+}
+
+
+// end of file
@@ -0,0 +1,112 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "bb/Numa.h"
+#include "bb/FrameBuffer.h"
+
+
+TEST(NumaTest, testNuma_ParseCpuList)
+{
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), bb::Numa::ParseCpuList("0-3,8,10-11"));
+    EXPECT_EQ(std::vector<int>({5}),                     bb::Numa::ParseCpuList("5"));
+    EXPECT_EQ(std::vector<int>({0, 1}),                  bb::Numa::ParseCpuList("0-1\n"));
+    EXPECT_EQ(std::vector<int>({2, 3, 7}),               bb::Numa::ParseCpuList(" 2-3 , 7 "));
+    EXPECT_EQ(std::vector<int>({4}),                     bb::Numa::ParseCpuList("4-4"));
+
+    // 空
+    EXPECT_TRUE(bb::Numa::ParseCpuList("").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("\n").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList(",,").empty());
+
+    // 不正な項目は読み飛ばす
+    EXPECT_TRUE(bb::Numa::ParseCpuList("abc").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("-").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("3-").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("-3").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("1a").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("1-2-3").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("5-2").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("99999999999").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("0-99999999999").empty());
+    EXPECT_TRUE(bb::Numa::ParseCpuList("0-65536").empty());
+    EXPECT_EQ(std::vector<int>({0, 1, 6}), bb::Numa::ParseCpuList("0-1,x,3-,6"));
+}
+
+
+TEST(NumaTest, testNuma_GetThreadCpu)
+{
+    std::vector< std::vector<int> > node_cpus = {{0, 1}, {8, 9}};
+
+    // ノード順に連続して割り当て
+    EXPECT_EQ(0, bb::Numa::GetThreadCpu(node_cpus, 0, 4));
+    EXPECT_EQ(1, bb::Numa::GetThreadCpu(node_cpus, 1, 4));
+    EXPECT_EQ(8, bb::Numa::GetThreadCpu(node_cpus, 2, 4));
+    EXPECT_EQ(9, bb::Numa::GetThreadCpu(node_cpus, 3, 4));
+
+    // CPU数より多いスレッドはノード内で巡回
+    EXPECT_EQ(0, bb::Numa::GetThreadCpu(node_cpus, 2, 6));
+    EXPECT_EQ(8, bb::Numa::GetThreadCpu(node_cpus, 3, 6));
+    EXPECT_EQ(8, bb::Numa::GetThreadCpu(node_cpus, 5, 6));
+
+    // 割り当てできない場合
+    EXPECT_EQ(-1, bb::Numa::GetThreadCpu(node_cpus, 4, 4));
+    EXPECT_EQ(-1, bb::Numa::GetThreadCpu(node_cpus, 0, 0));
+    EXPECT_EQ(-1, bb::Numa::GetThreadCpu({std::vector<int>()}, 0, 2));
+    EXPECT_EQ(-1, bb::Numa::GetThreadCpu({}, 0, 2));
+}
+
+
+TEST(NumaTest, testNuma_FrameBuffer)
+{
+    bb::index_t const frame_size = 37;
+    bb::index_t const node_size  = 53;
+
+    bool prev_enable = bb::Numa::IsEnabled();
+
+    bb::Numa::SetEnable(false);
+    bb::FrameBuffer buf0(frame_size, {node_size}, BB_TYPE_FP32);
+
+    bb::Numa::SetEnable(true, false);
+    bb::FrameBuffer buf1(frame_size, {node_size}, BB_TYPE_FP32);
+    bb::FrameBuffer buf2(frame_size, {node_size}, BB_TYPE_BIT);
+    EXPECT_TRUE(bb::Numa::IsEnabled());
+
+    bb::Numa::SetEnable(prev_enable, false);
+
+    // first-touch でゼロ初期化されている
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            EXPECT_EQ(0.0f, buf1.GetFP32(frame, node));
+            EXPECT_EQ(0,    (int)buf2.GetBit(frame, node));
+        }
+    }
+
+    // NUMAモードで確保したバッファも同じ配置でアクセスできる
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            float val = (float)(frame * 1000 + node);
+            buf0.SetFP32(frame, node, val);
+            buf1.SetFP32(frame, node, val);
+            buf2.SetBit(frame, node, (bb::Bit)((frame + node) % 2));
+        }
+    }
+
+    EXPECT_EQ(buf0.GetFrameStride(), buf1.GetFrameStride());
+    {
+        auto ptr0 = buf0.LockConst<float>();
+        auto ptr1 = buf1.LockConst<float>();
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < node_size; ++node ) {
+                EXPECT_EQ(ptr0.Get(frame, node), ptr1.Get(frame, node));
+            }
+        }
+    }
+
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            EXPECT_EQ((frame + node) % 2, (int)buf2.GetBit(frame, node));
+        }
+    }
+}
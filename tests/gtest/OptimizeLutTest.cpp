@@ -0,0 +1,79 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/OptimizeLut.h"
+
+
+TEST(OptimizeLutTest, testOptimizeLut)
+{
+    auto layer0 = bb::BinaryLutN<6, bb::Bit>::Create(360);
+    auto layer1 = bb::BinaryLutN<6, bb::Bit>::Create(60);
+    auto layer2 = bb::BinaryLutN<6, bb::Bit>::Create(10);
+
+    auto net = bb::Sequential::Create();
+    net->Add(layer0);
+    net->Add(layer1);
+    net->Add(layer2);
+    net->SetInputShape({256});
+
+    // 定数ノード
+    for ( bb::index_t node = 0; node < 20; ++node ) {
+        for ( int i = 0; i < 64; ++i ) {
+            layer1->SetLutTable(node, i, (node % 2) == 0);
+        }
+    }
+
+    // 重複ノード
+    for ( bb::index_t node = 1; node < 10; ++node ) {
+        for ( int i = 0; i < 6; ++i ) {
+            layer0->SetNodeConnectionIndex(node, i, layer0->GetNodeConnectionIndex(0, 5 - i));
+        }
+        for ( int i = 0; i < 64; ++i ) {
+            // 入力順を逆にした真理値表
+            int j = 0;
+            for ( int b = 0; b < 6; ++b ) {
+                j |= ((i >> b) & 1) << (5 - b);
+            }
+            layer0->SetLutTable(node, i, layer0->GetLutTable(0, j));
+        }
+    }
+
+    // 無関係入力 (x0 & x1 のみに依存)
+    for ( bb::index_t node = 10; node < 50; ++node ) {
+        for ( int i = 0; i < 64; ++i ) {
+            layer0->SetLutTable(node, i, (i & 3) == 3);
+        }
+    }
+
+    bb::OptimizeLutReport report;
+    auto opt_net = bb::OptimizeLut_LutLayers<bb::Bit>(net, &report);
+
+    EXPECT_EQ(3, (int)report.layers.size());
+    EXPECT_EQ(20, report.layers[1].constant_nodes);
+    EXPECT_GE(report.layers[0].duplicate_nodes, 9);
+    EXPECT_GT(report.layers[0].dead_nodes, 0);
+    EXPECT_GE(report.layers[0].removed_inputs, 40 * 4);
+    EXPECT_LT(report.GetNodeSizeAfter(), report.GetNodeSizeBefore());
+    EXPECT_EQ(10, report.layers[2].node_size_after);
+
+    // 演算結果は変わらない
+    bb::index_t const frame_size = 500;
+    bb::FrameBuffer x_buf(frame_size, {256}, BB_TYPE_BIT);
+    std::mt19937_64 mt(1);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 256; ++node ) {
+            x_buf.SetBit(frame, node, (mt() & 1) != 0);
+        }
+    }
+
+    auto y_exp = net->Forward(x_buf, false);
+    auto y_buf = opt_net->Forward(x_buf, false);
+    EXPECT_EQ(y_exp.GetNodeSize(), y_buf.GetNodeSize());
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+            EXPECT_EQ(y_exp.GetBit(frame, node), y_buf.GetBit(frame, node));
+        }
+    }
+}
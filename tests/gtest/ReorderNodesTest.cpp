@@ -0,0 +1,84 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/ReorderNodes.h"
+#include "bb/Sequential.h"
+#include "bb/SparseLutN.h"
+#include "bb/BinaryLutN.h"
+#include "bb/MicroMlp.h"
+
+
+static bb::FrameBuffer ReorderNodesTest_MakeInput(bb::index_t frame_size, bb::index_t node_size, int type)
+{
+    bb::FrameBuffer x_buf(frame_size, {node_size}, type);
+    std::mt19937_64 mt(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < node_size; ++node ) {
+            if ( type == BB_TYPE_BIT ) {
+                x_buf.SetBit(frame, node, dist(mt) > 0.5f);
+            }
+            else {
+                x_buf.SetFP32(frame, node, dist(mt));
+            }
+        }
+    }
+    return x_buf;
+}
+
+
+TEST(ReorderNodesTest, testReorderNodes_SparseLutN)
+{
+    auto layer0 = bb::SparseLutN<6, float>::Create(1024);
+    auto layer1 = bb::SparseLutN<6, float>::Create(216);
+    auto layer2 = bb::SparseLutN<6, float>::Create(36);
+    auto layer3 = bb::MicroMlp<6, 16, float>::Create({6});
+
+    auto net = bb::Sequential::Create();
+    net->Add(layer0);
+    net->Add(layer1);
+    net->Add(layer2);
+    net->Add(layer3);
+    net->SetInputShape({784});
+
+    auto x_buf = ReorderNodesTest_MakeInput(77, 784, BB_TYPE_FP32);
+    auto y_exp = net->Forward(x_buf, false);
+
+    double span_before = bb::ReorderNodes_GetAverageSpan(layer1);
+    EXPECT_EQ(3, bb::ReorderNodes(net));
+    double span_after = bb::ReorderNodes_GetAverageSpan(layer1);
+    EXPECT_LT(span_after, span_before);
+
+    // 演算結果は変わらない
+    auto y_buf = net->Forward(x_buf, false);
+    EXPECT_EQ(y_exp.GetNodeSize(), y_buf.GetNodeSize());
+    for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+        for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+            EXPECT_NEAR(y_exp.GetFP32(frame, node), y_buf.GetFP32(frame, node), 1.0e-5f);
+        }
+    }
+}
+
+
+TEST(ReorderNodesTest, testReorderNodes_BinaryLutN)
+{
+    auto net = bb::Sequential::Create();
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(360));
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(60));
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(10));
+    net->SetInputShape({512});
+
+    auto x_buf = ReorderNodesTest_MakeInput(300, 512, BB_TYPE_BIT);
+    auto y_exp = net->Forward(x_buf, false);
+
+    EXPECT_EQ(2, bb::ReorderNodes(net));
+
+    auto y_buf = net->Forward(x_buf, false);
+    for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+        for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+            EXPECT_EQ(y_exp.GetBit(frame, node), y_buf.GetBit(frame, node));
+        }
+    }
+}
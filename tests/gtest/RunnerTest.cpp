@@ -0,0 +1,149 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/Runner.h"
+#include "bb/Sequential.h"
+#include "bb/DenseAffine.h"
+#include "bb/LossSoftmaxCrossEntropy.h"
+#include "bb/MetricsCategoricalAccuracy.h"
+#include "bb/OptimizerAdam.h"
+
+
+TEST(RunnerTest, testRunner_FittingArray)
+{
+    bb::index_t const frame_size = 256;
+    bb::index_t const x_node     = 4;
+    bb::index_t const t_node     = 2;
+
+    // x0 + x1 > 0 の2クラス分類
+    std::mt19937_64 mt(1);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> x(frame_size * x_node);
+    std::vector<float> t(frame_size * t_node);
+    bb::TrainData<float> td;
+    td.x_shape = bb::indices_t({x_node});
+    td.t_shape = bb::indices_t({t_node});
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < x_node; ++node ) {
+            x[frame * x_node + node] = dist(mt);
+        }
+        int c = (x[frame * x_node + 0] + x[frame * x_node + 1] > 0) ? 1 : 0;
+        t[frame * t_node + 0] = (c == 0) ? 1.0f : 0.0f;
+        t[frame * t_node + 1] = (c == 1) ? 1.0f : 0.0f;
+
+        td.x_test.push_back(std::vector<float>(&x[frame * x_node], &x[(frame + 1) * x_node]));
+        td.t_test.push_back(std::vector<float>(&t[frame * t_node], &t[(frame + 1) * t_node]));
+    }
+    auto x_org = x;
+
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<>::Create(t_node));
+    net->SetInputShape({x_node});
+
+    auto runner = bb::Runner<float>::CreateEx("RunnerTest", net,
+                        bb::LossSoftmaxCrossEntropy<float>::Create(),
+                        bb::MetricsCategoricalAccuracy<float>::Create(),
+                        bb::OptimizerAdam<float>::Create(0.01f),
+                        0, false, false, false, false);
+
+    // 連続配列での評価は TrainData での評価と一致すること
+    double acc_array = runner->EvaluationArray(&x[0], &t[0], frame_size, {x_node}, {t_node}, 17);
+    double acc_td    = runner->Evaluation(td, 17);
+    EXPECT_DOUBLE_EQ(acc_td, acc_array);
+
+    double acc = runner->FittingArray(&x[0], &t[0], frame_size, nullptr, nullptr, 0, {x_node}, {t_node}, 20, 16);
+    EXPECT_GT(acc, 0.95);
+    EXPECT_DOUBLE_EQ(acc, runner->EvaluationArray(&x[0], &t[0], frame_size, {x_node}, {t_node}, 64));
+
+    // 入力配列は変更されない
+    EXPECT_EQ(x_org, x);
+}
+
+
+static void MakeRunnerTestData(bb::TrainData<float> &td, bb::index_t train_size, bb::index_t test_size)
+{
+    std::mt19937_64 mt(2);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    td.x_shape = bb::indices_t({4});
+    td.t_shape = bb::indices_t({2});
+    for ( bb::index_t frame = 0; frame < train_size + test_size; ++frame ) {
+        std::vector<float> x(4);
+        for ( auto &v : x ) {
+            v = dist(mt);
+        }
+        int c = (x[0] + x[1] > 0) ? 1 : 0;
+        std::vector<float> t = {(c == 0) ? 1.0f : 0.0f, (c == 1) ? 1.0f : 0.0f};
+        if ( frame < train_size ) {
+            td.x_train.push_back(x);
+            td.t_train.push_back(t);
+        }
+        else {
+            td.x_test.push_back(x);
+            td.t_test.push_back(t);
+        }
+    }
+}
+
+TEST(RunnerTest, testRunner_FittingSubsetEvaluation)
+{
+    bb::TrainData<float> td;
+    MakeRunnerTestData(td, 512, 256);
+    auto x_test_org = td.x_test;
+
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<>::Create(2));
+    net->SetInputShape(td.x_shape);
+
+    bb::Runner<float>::create_t create;
+    create.name             = "RunnerTestSubset";
+    create.net              = net;
+    create.lossFunc         = bb::LossSoftmaxCrossEntropy<float>::Create();
+    create.metricsFunc      = bb::MetricsCategoricalAccuracy<float>::Create();
+    create.optimizer        = bb::OptimizerAdam<float>::Create(0.01f);
+    create.print_progress   = false;
+    create.log_write        = false;
+    create.eval_test_size   = 64;
+    create.eval_train_reuse = true;
+    auto runner = bb::Runner<float>::Create(create);
+
+    double acc = runner->Fitting(td, 10, 16);
+    EXPECT_GT(acc, 0.9);
+    EXPECT_GT(runner->Evaluation(td, 64), 0.9);
+
+    // テストデータは変更されない
+    EXPECT_EQ(x_test_org, td.x_test);
+}
+
+TEST(RunnerTest, testRunner_FittingAsyncEvaluation)
+{
+    bb::TrainData<float> td;
+    MakeRunnerTestData(td, 512, 256);
+
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<>::Create(2));
+    net->SetInputShape(td.x_shape);
+
+    auto eval_net = bb::Sequential::Create();
+    eval_net->Add(bb::DenseAffine<>::Create(2));
+
+    bb::Runner<float>::create_t create;
+    create.name             = "RunnerTestAsync";
+    create.net              = net;
+    create.lossFunc         = bb::LossSoftmaxCrossEntropy<float>::Create();
+    create.metricsFunc      = bb::MetricsCategoricalAccuracy<float>::Create();
+    create.optimizer        = bb::OptimizerAdam<float>::Create(0.01f);
+    create.print_progress   = false;
+    create.log_write        = false;
+    create.eval_train_size  = 128;
+    create.eval_net         = eval_net;
+    create.eval_metricsFunc = bb::MetricsCategoricalAccuracy<float>::Create();
+    auto runner = bb::Runner<float>::Create(create);
+
+    double acc = runner->Fitting(td, 10, 16);
+    EXPECT_GT(acc, 0.9);
+
+    // 最終エポックの非同期評価は学習後のネットでの全数評価と一致する
+    EXPECT_DOUBLE_EQ(runner->Evaluation(td, 64), acc);
+}
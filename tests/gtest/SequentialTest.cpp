@@ -0,0 +1,326 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/Sequential.h"
+#include "bb/DenseAffine.h"
+#include "bb/ReLU.h"
+#include "bb/Sigmoid.h"
+#include "bb/Binarize.h"
+#include "bb/BatchNormalization.h"
+#include "bb/Dropout.h"
+#include "bb/RealToBinary.h"
+#include "bb/BinaryToReal.h"
+#include "bb/ConvolutionIm2Col.h"
+
+
+TEST(SequentialTest, testSequential_Pipeline)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+    pool.SetThreadSize(4);
+
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<>::Create(32));
+    net->Add(bb::ReLU<>::Create());
+    net->Add(bb::DenseAffine<>::Create(16));
+    net->Add(bb::Sigmoid<>::Create());
+    net->Add(bb::DenseAffine<>::Create(8));
+    net->Add(bb::Binarize<bb::Bit>::Create());
+    net->SetInputShape({12});
+
+    bb::index_t const frame_size = 103;
+    bb::FrameBuffer x_buf(frame_size, {12}, BB_TYPE_FP32);
+    std::mt19937_64 mt(1);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 12; ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    auto y_exp = net->Forward(x_buf, false);
+
+    // チャンクがビット境界に揃わない場合も含めて逐次実行と一致すること
+    for ( int stage_size : {0, 2, 3, 6} ) {
+        net->SendCommand("pipeline_chunk_size 20");
+        net->SendCommand("pipeline_stage_size " + std::to_string(stage_size));
+        auto y_buf = net->Forward(x_buf, false);
+
+        EXPECT_EQ(y_exp.GetFrameSize(), y_buf.GetFrameSize());
+        EXPECT_EQ(y_exp.GetNodeSize(),  y_buf.GetNodeSize());
+        EXPECT_EQ(y_exp.GetType(),      y_buf.GetType());
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+                EXPECT_EQ(y_exp.GetBit(frame, node), y_buf.GetBit(frame, node));
+            }
+        }
+    }
+
+    net->SetPipeline(0);
+    pool.SetThreadSize(thread_size);
+}
+
+TEST(SequentialTest, testSequential_PipelineTrain)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+    pool.SetThreadSize(4);
+
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<>::Create(32));
+    net->Add(bb::ReLU<>::Create());
+    net->Add(bb::DenseAffine<>::Create(16));
+    net->Add(bb::Sigmoid<>::Create());
+    net->Add(bb::DenseAffine<>::Create(8));
+    net->SetInputShape({12});
+    EXPECT_TRUE(net->IsForwardReplayable());
+
+    bb::index_t const frame_size = 103;
+    bb::FrameBuffer x_buf(frame_size, {12}, BB_TYPE_FP32);
+    bb::FrameBuffer dy_buf(frame_size, {8}, BB_TYPE_FP32);
+    std::mt19937_64 mt(2);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 12; ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+        for ( bb::index_t node = 0; node < 8; ++node ) {
+            dy_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    // 逐次実行での期待値
+    auto gradients = net->GetGradients();
+    gradients = 0;
+    auto y_exp  = net->Forward(x_buf, true);
+    auto dx_exp = net->Backward(dy_buf);
+    std::vector<bb::Tensor> grad_exp;
+    for ( bb::index_t i = 0; i < gradients.GetSize(); ++i ) {
+        grad_exp.push_back(gradients[i].Clone());
+    }
+
+    // 逆伝播もチャンク単位で流して、出力・入力勾配・パラメータ勾配が一致すること
+    for ( int stage_size : {0, 2, 3, 5} ) {
+        net->SetPipeline(20, stage_size);
+        gradients = 0;
+        auto y_buf  = net->Forward(x_buf, true);
+        auto dx_buf = net->Backward(dy_buf);
+
+        EXPECT_EQ(y_exp.GetFrameSize(), y_buf.GetFrameSize());
+        EXPECT_EQ(dx_exp.GetFrameSize(), dx_buf.GetFrameSize());
+        EXPECT_EQ(dx_exp.GetNodeSize(),  dx_buf.GetNodeSize());
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(y_exp.GetFP32(frame, node), y_buf.GetFP32(frame, node), 1.0e-5f);
+            }
+            for ( bb::index_t node = 0; node < dx_exp.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(dx_exp.GetFP32(frame, node), dx_buf.GetFP32(frame, node), 1.0e-5f);
+            }
+        }
+
+        for ( bb::index_t i = 0; i < gradients.GetSize(); ++i ) {
+            auto exp_ptr = grad_exp[i].LockConst<float>();
+            auto val_ptr = gradients[i].LockConst<float>();
+            for ( bb::index_t j = 0; j < gradients[i].GetSize(); ++j ) {
+                EXPECT_NEAR(exp_ptr[j], val_ptr[j], 1.0e-3f);
+            }
+        }
+    }
+
+    net->SetPipeline(0);
+    pool.SetThreadSize(thread_size);
+}
+
+
+TEST(SequentialTest, testSequential_PipelineTrainFallback)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+    pool.SetThreadSize(4);
+
+    // 同じ初期値・乱数列の2つのネットを用意し、片方だけパイプラインを設定する
+    auto make_net = []() {
+        auto net = bb::Sequential::Create();
+        net->Add(bb::DenseAffine<>::Create(32));
+        net->Add(bb::BatchNormalization<>::Create());
+        net->Add(bb::ReLU<>::Create());
+        net->Add(bb::DenseAffine<>::Create(16));
+        net->Add(bb::Dropout<>::Create(0.3, 5));
+        net->Add(bb::DenseAffine<>::Create(8));
+        net->SetInputShape({12});
+        return net;
+    };
+    auto net_exp = make_net();
+    auto net     = make_net();
+    net->SetPipeline(20, 3);
+    EXPECT_FALSE(net->IsForwardReplayable());
+
+    bb::index_t const frame_size = 103;
+    bb::FrameBuffer x_buf(frame_size, {12}, BB_TYPE_FP32);
+    bb::FrameBuffer dy_buf(frame_size, {8}, BB_TYPE_FP32);
+    std::mt19937_64 mt(3);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 12; ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+        for ( bb::index_t node = 0; node < 8; ++node ) {
+            dy_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    // Dropout や BatchNormalization を含む学習は逐次実行と同じ結果になること
+    auto grad_exp = net_exp->GetGradients();
+    auto grad     = net->GetGradients();
+    for ( int iter = 0; iter < 2; ++iter ) {
+        grad_exp = 0;
+        grad     = 0;
+        auto y_exp  = net_exp->Forward(x_buf, true);
+        auto dx_exp = net_exp->Backward(dy_buf);
+        auto y_buf  = net->Forward(x_buf, true);
+        auto dx_buf = net->Backward(dy_buf);
+
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(y_exp.GetFP32(frame, node), y_buf.GetFP32(frame, node), 1.0e-5f);
+            }
+            for ( bb::index_t node = 0; node < dx_exp.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(dx_exp.GetFP32(frame, node), dx_buf.GetFP32(frame, node), 1.0e-5f);
+            }
+        }
+
+        for ( bb::index_t i = 0; i < grad.GetSize(); ++i ) {
+            auto exp_ptr = grad_exp[i].LockConst<float>();
+            auto val_ptr = grad[i].LockConst<float>();
+            for ( bb::index_t j = 0; j < grad[i].GetSize(); ++j ) {
+                EXPECT_NEAR(exp_ptr[j], val_ptr[j], 1.0e-4f);
+            }
+        }
+    }
+
+    net->SetPipeline(0);
+    pool.SetThreadSize(thread_size);
+}
+
+TEST(SequentialTest, testSequential_PipelineFrameModulation)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+    pool.SetThreadSize(4);
+
+    bb::index_t const frame_size = 103;
+    bb::FrameBuffer x_buf(frame_size, {12}, BB_TYPE_FP32);
+    std::mt19937_64 mt(4);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 12; ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    // フレーム数を変える RealToBinary を含むネット(出力で BinaryToReal により戻す場合と戻さない場合)
+    for ( int restore = 0; restore < 2; ++restore ) {
+        auto net = bb::Sequential::Create();
+        net->Add(bb::RealToBinary<float>::Create(3));
+        net->Add(bb::DenseAffine<>::Create(16));
+        net->Add(bb::ReLU<>::Create());
+        net->Add(bb::DenseAffine<>::Create(8));
+        if ( restore ) {
+            net->Add(bb::BinaryToReal<float>::Create(3));
+        }
+        net->SetInputShape({12});
+
+        auto y_exp = net->Forward(x_buf, false);
+        EXPECT_EQ(restore ? frame_size : frame_size * 3, y_exp.GetFrameSize());
+
+        for ( int stage_size : {2, 3, 5} ) {
+            net->SetPipeline(20, stage_size);
+            auto y_buf = net->Forward(x_buf, false);
+
+            ASSERT_EQ(y_exp.GetFrameSize(), y_buf.GetFrameSize());
+            ASSERT_EQ(y_exp.GetNodeSize(),  y_buf.GetNodeSize());
+            for ( bb::index_t frame = 0; frame < y_exp.GetFrameSize(); ++frame ) {
+                for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+                    EXPECT_NEAR(y_exp.GetFP32(frame, node), y_buf.GetFP32(frame, node), 1.0e-5f);
+                }
+            }
+        }
+    }
+
+    pool.SetThreadSize(thread_size);
+}
+
+
+TEST(SequentialTest, testSequential_PipelineTrainFrameChange)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+    pool.SetThreadSize(4);
+
+    // Im2Col で出力フレーム数が入力の 4 倍(2x2 の出力位置)になるネット
+    auto net = bb::Sequential::Create();
+    net->Add(bb::ConvolutionIm2Col<>::Create(2, 2));
+    net->Add(bb::DenseAffine<>::Create(16));
+    net->Add(bb::ReLU<>::Create());
+    net->Add(bb::DenseAffine<>::Create(8));
+    net->SetInputShape({3, 3, 2});
+    EXPECT_TRUE(net->IsForwardReplayable());
+
+    bb::index_t const frame_size = 53;
+    bb::FrameBuffer x_buf(frame_size, {3, 3, 2}, BB_TYPE_FP32);
+    bb::FrameBuffer dy_buf(frame_size * 4, {8}, BB_TYPE_FP32);
+    std::mt19937_64 mt(5);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < 18; ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+    for ( bb::index_t frame = 0; frame < frame_size * 4; ++frame ) {
+        for ( bb::index_t node = 0; node < 8; ++node ) {
+            dy_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    auto gradients = net->GetGradients();
+    gradients = 0;
+    auto y_exp  = net->Forward(x_buf, true);
+    auto dx_exp = net->Backward(dy_buf);
+    std::vector<bb::Tensor> grad_exp;
+    for ( bb::index_t i = 0; i < gradients.GetSize(); ++i ) {
+        grad_exp.push_back(gradients[i].Clone());
+    }
+
+    for ( int stage_size : {2, 4} ) {
+        net->SetPipeline(10, stage_size);
+        gradients = 0;
+        auto y_buf  = net->Forward(x_buf, true);
+        auto dx_buf = net->Backward(dy_buf);
+
+        ASSERT_EQ(y_exp.GetFrameSize(),  y_buf.GetFrameSize());
+        ASSERT_EQ(dx_exp.GetFrameSize(), dx_buf.GetFrameSize());
+        for ( bb::index_t frame = 0; frame < y_exp.GetFrameSize(); ++frame ) {
+            for ( bb::index_t node = 0; node < y_exp.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(y_exp.GetFP32(frame, node), y_buf.GetFP32(frame, node), 1.0e-5f);
+            }
+        }
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < dx_exp.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(dx_exp.GetFP32(frame, node), dx_buf.GetFP32(frame, node), 1.0e-5f);
+            }
+        }
+
+        for ( bb::index_t i = 0; i < gradients.GetSize(); ++i ) {
+            auto exp_ptr = grad_exp[i].LockConst<float>();
+            auto val_ptr = gradients[i].LockConst<float>();
+            for ( bb::index_t j = 0; j < gradients[i].GetSize(); ++j ) {
+                EXPECT_NEAR(exp_ptr[j], val_ptr[j], 1.0e-3f);
+            }
+        }
+    }
+
+    net->SetPipeline(0);
+    pool.SetThreadSize(thread_size);
+}
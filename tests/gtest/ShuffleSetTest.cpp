@@ -0,0 +1,105 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <set>
+#include "gtest/gtest.h"
+
+#include "bb/ShuffleSet.h"
+#include "bb/ConnectionTable.h"
+
+
+TEST(ShuffleSetTest, testShuffleSet_RandomSet)
+{
+    bb::ShuffleSet<bb::index_t> ss(10, 1);
+
+    // 一巡するまでは重複しない
+    std::vector<int> count(10, 0);
+    for ( int i = 0; i < 5; ++i ) {
+        auto s = ss.GetRandomSet(2);
+        for ( auto v : s ) {
+            count[v]++;
+        }
+    }
+    for ( auto c : count ) {
+        EXPECT_EQ(1, c);
+    }
+
+    // 再充填をまたいでもセット内は重複しない
+    for ( int i = 0; i < 100; ++i ) {
+        auto s = ss.GetRandomSet(3);
+        std::set<bb::index_t> u(s.begin(), s.end());
+        EXPECT_EQ(3, (int)u.size());
+        for ( auto v : s ) {
+            EXPECT_TRUE(v >= 0 && v < 10);
+        }
+    }
+
+    // サイズを超える場合
+    auto s = ss.GetRandomSet(25);
+    EXPECT_EQ(25, (int)s.size());
+    std::set<bb::index_t> u(s.begin(), s.end());
+    EXPECT_EQ(10, (int)u.size());
+}
+
+
+TEST(ShuffleSetTest, testConnectionTable_MakeTable)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+
+    bb::indices_t input_shape     = {8, 8, 6};
+    bb::index_t   input_node_size = bb::GetShapeSize(input_shape);
+
+    struct { char const *connection; bb::indices_t output_shape; } rules[] = {
+            {"random",    {8, 8, 12}},
+            {"pointwise", {8, 8, 12}},
+            {"depthwise", {4, 4, 6}},
+            {"gauss",     {4, 4, 3}},
+            {"serial",    {8, 8, 12}},
+        };
+
+    for ( auto const &rule : rules ) {
+        bb::index_t output_node_size = bb::GetShapeSize(rule.output_shape);
+        std::vector<bb::index_t> offset(output_node_size + 1);
+        for ( bb::index_t node = 0; node <= output_node_size; ++node ) {
+            offset[node] = node * 6;
+        }
+
+        // スレッド数に依らず同じ結果
+        std::vector<bb::index_t> table1, table4;
+        pool.SetThreadSize(1);
+        bb::ConnectionTable_MakeTable(table1, offset, input_shape, rule.output_shape, 123, rule.connection);
+        pool.SetThreadSize(4);
+        bb::ConnectionTable_MakeTable(table4, offset, input_shape, rule.output_shape, 123, rule.connection);
+        EXPECT_EQ(table1, table4);
+
+        for ( bb::index_t node = 0; node < output_node_size; ++node ) {
+            std::set<bb::index_t> u(&table1[offset[node]], &table1[offset[node]] + 6);
+            EXPECT_EQ(6, (int)u.size());
+            for ( auto v : u ) {
+                EXPECT_TRUE(v >= 0 && v < input_node_size);
+            }
+        }
+    }
+
+    // random は入力が均等に使われる
+    {
+        bb::indices_t output_shape = {8, 8, 12};
+        bb::index_t   output_node_size = bb::GetShapeSize(output_shape);
+        std::vector<bb::index_t> offset(output_node_size + 1);
+        for ( bb::index_t node = 0; node <= output_node_size; ++node ) {
+            offset[node] = node * 6;
+        }
+
+        std::vector<bb::index_t> table;
+        bb::ConnectionTable_MakeTable(table, offset, input_shape, output_shape, 1, "random");
+        std::vector<int> count(input_node_size, 0);
+        for ( auto v : table ) {
+            count[v]++;
+        }
+        for ( auto c : count ) {
+            EXPECT_EQ(12, c);
+        }
+    }
+
+    pool.SetThreadSize(thread_size);
+}
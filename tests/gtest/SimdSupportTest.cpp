@@ -0,0 +1,123 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/SimdSupport.h"
+#include "bb/ReLU.h"
+#include "bb/MaxPooling.h"
+#include "bb/BatchNormalization.h"
+#include "bb/DenseAffine.h"
+#include "bb/DepthwiseDenseAffine.h"
+
+
+TEST(SimdSupportTest, testSimdKernel_Select)
+{
+    auto level = bb::SimdKernel::GetLevel();
+
+    bb::SimdKernel kernel("SimdSupportTest", {bb::SimdLevel::AVX2});
+
+    bb::SimdKernel::SetLimit(bb::SimdLevel::None);
+    EXPECT_EQ(bb::SimdLevel::None, bb::SimdKernel::GetLevel());
+    EXPECT_EQ(bb::SimdLevel::None, kernel.Select());
+
+    // 未実装の命令セットは下位の実装に落ちる
+    bb::SimdKernel::SetLimit(bb::SimdLevel::AVX512);
+    auto selected = kernel.Select();
+    EXPECT_TRUE(selected == bb::SimdLevel::None || selected == bb::SimdLevel::AVX2);
+    EXPECT_EQ(bb::SimdKernel::GetCpuLevel() >= bb::SimdLevel::AVX2, selected == bb::SimdLevel::AVX2);
+    EXPECT_NE(std::string::npos, bb::GetSimdInfoString().find("SimdSupportTest"));
+
+    bb::SimdKernel::SetLimit(level);
+}
+
+
+// 汎用版と SIMD 版の結果比較
+TEST(SimdSupportTest, testSimdKernel_Compare)
+{
+    auto level = bb::SimdKernel::GetLevel();
+
+    bb::index_t const frame_size = 37;
+    bb::FrameBuffer x_buf(frame_size, {6, 5, 3}, BB_TYPE_FP32);
+    bb::FrameBuffer dy_buf(frame_size, {6, 5, 3}, BB_TYPE_FP32);
+    bb::FrameBuffer dy_pool_buf(frame_size, {3, 3, 3}, BB_TYPE_FP32);
+    bb::FrameBuffer dy_dw_buf(frame_size, {3, 5, 3}, BB_TYPE_FP32);
+    // SIMD 版はフレームの端数領域も演算するのでゼロで埋めておく
+    x_buf.FillZero();
+    dy_buf.FillZero();
+    dy_pool_buf.FillZero();
+    dy_dw_buf.FillZero();
+
+    std::mt19937_64 mt(1);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+        for ( bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node ) {
+            x_buf.SetFP32(frame, node, dist(mt));
+            dy_buf.SetFP32(frame, node, dist(mt));
+        }
+        for ( bb::index_t node = 0; node < dy_pool_buf.GetNodeSize(); ++node ) {
+            dy_pool_buf.SetFP32(frame, node, dist(mt));
+        }
+        for ( bb::index_t node = 0; node < dy_dw_buf.GetNodeSize(); ++node ) {
+            dy_dw_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    std::vector<bb::FrameBuffer> results[2];
+    std::vector<float>           grads[2];
+    bb::SimdLevel levels[2] = { bb::SimdLevel::None, bb::SimdLevel::AVX512 };
+    for ( int i = 0; i < 2; ++i ) {
+        bb::SimdKernel::SetLimit(levels[i]);
+
+        auto relu = bb::ReLU<float>::Create();
+        relu->SetInputShape(x_buf.GetShape());
+        results[i].push_back(relu->Forward(x_buf));
+        results[i].push_back(relu->Backward(dy_buf));
+
+        auto maxpol = bb::MaxPooling<float>::Create(2, 2);
+        maxpol->SetInputShape(x_buf.GetShape());
+        results[i].push_back(maxpol->Forward(x_buf));
+        results[i].push_back(maxpol->Backward(dy_pool_buf));
+
+        auto batch_norm = bb::BatchNormalization<float>::Create();
+        batch_norm->SetInputShape(x_buf.GetShape());
+        batch_norm->SendCommand("host_only true");
+        results[i].push_back(batch_norm->Forward(x_buf));
+        results[i].push_back(batch_norm->Backward(dy_buf));
+
+        auto affine = bb::DenseAffine<float>::Create({6, 5, 3});
+        affine->SetInputShape(x_buf.GetShape());
+        results[i].push_back(affine->Forward(x_buf));
+        results[i].push_back(affine->Backward(dy_buf));
+
+        auto depthwise = bb::DepthwiseDenseAffine<float>::Create({3, 5, 3});
+        depthwise->SetInputShape(x_buf.GetShape());
+        results[i].push_back(depthwise->Forward(x_buf));
+        results[i].push_back(depthwise->Backward(dy_dw_buf));
+
+        for ( auto const &t : {affine->dW(), affine->db(), depthwise->dW(), depthwise->db()} ) {
+            auto ptr = t.LockConst<float>();
+            for ( bb::index_t j = 0; j < t.GetSize(); ++j ) {
+                grads[i].push_back(ptr[j]);
+            }
+        }
+    }
+
+    for ( size_t k = 0; k < results[0].size(); ++k ) {
+        auto &exp_buf = results[0][k];
+        auto &buf     = results[1][k];
+        EXPECT_EQ(exp_buf.GetNodeSize(), buf.GetNodeSize());
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < exp_buf.GetNodeSize(); ++node ) {
+                EXPECT_NEAR(exp_buf.GetFP32(frame, node), buf.GetFP32(frame, node), 1.0e-3f);
+            }
+        }
+    }
+
+    ASSERT_EQ(grads[0].size(), grads[1].size());
+    for ( size_t j = 0; j < grads[0].size(); ++j ) {
+        EXPECT_NEAR(grads[0][j], grads[1][j], 1.0e-3f);
+    }
+
+    bb::SimdKernel::SetLimit(level);
+}
@@ -0,0 +1,297 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/SparseGradient.h"
+#include "bb/StochasticLutN.h"
+#include "bb/SparseLutN.h"
+#include "bb/OptimizerAdam.h"
+#include "bb/OptimizerSgd.h"
+
+
+TEST(SparseGradientTest, testSparseGradient_Accumulate)
+{
+    bb::SparseGradient  sg;
+    sg.Resize(2, 4);
+
+    float grad[4] = {1.0f, 0.001f, -0.5f, 0.0f};
+    float dst[4]  = {0};
+    sg.AccumulateBlock<float>(1, grad, dst, 0.01f);
+
+    EXPECT_EQ(1.0f,  dst[0]);
+    EXPECT_EQ(0.0f,  dst[1]);
+    EXPECT_EQ(-0.5f, dst[2]);
+    EXPECT_EQ(0.0f,  dst[3]);
+
+    EXPECT_EQ(0, (int)sg.GetTouched(0).size());
+    ASSERT_EQ(2, (int)sg.GetTouched(1).size());
+    EXPECT_EQ(0, (int)sg.GetTouched(1)[0]);
+    EXPECT_EQ(2, (int)sg.GetTouched(1)[1]);
+
+    // 同じ行は重複して記録しない
+    sg.AccumulateBlock<float>(1, grad, dst, 0.01f);
+    EXPECT_EQ(2, (int)sg.GetTouchedSize());
+    EXPECT_EQ(2.0f,  dst[0]);
+
+    sg.Clear();
+    EXPECT_EQ(0, (int)sg.GetTouchedSize());
+    sg.Touch(1, 0);
+    EXPECT_EQ(1, (int)sg.GetTouchedSize());
+}
+
+
+TEST(SparseGradientTest, testSparseGradient_Variables)
+{
+    auto tensor = std::make_shared<bb::Tensor>(bb::indices_t({4}), BB_TYPE_FP32);
+    auto sg     = std::make_shared<bb::SparseGradient>();
+
+    bb::Variables v;
+    v.PushBack(tensor);
+    v.PushBack(tensor, sg);
+    EXPECT_EQ(nullptr, v.GetSparseGradient(0));
+    EXPECT_EQ(nullptr, v.GetSparseGradient(1));     // 無効の間は見えない
+
+    sg->SetEnable(true);
+    EXPECT_EQ(nullptr, v.GetSparseGradient(0));
+    EXPECT_EQ(sg, v.GetSparseGradient(1));
+
+    // 複製や連結でも勾配Tensorと組のまま
+    bb::Variables v2;
+    v2.PushBack(tensor);
+    v2.PushBack(v);
+    EXPECT_EQ(sg, v2.GetSparseGradient(2));
+    bb::Variables v3(v2);
+    EXPECT_EQ(sg, v3.GetSparseGradient(2));
+
+    // 演算結果は新しい Tensor なので持たない
+    auto v4 = v * 2.0;
+    EXPECT_EQ(nullptr, v4.GetSparseGradient(1));
+
+    // 別モデルの同じ形状の勾配には影響しない
+    auto lut0 = bb::StochasticLutN<6, float>::Create(4);
+    auto lut1 = bb::StochasticLutN<6, float>::Create(4);
+    lut0->SetInputShape({8});
+    lut1->SetInputShape({8});
+    lut0->SetSparseGradient(true);
+    EXPECT_NE(nullptr, lut0->GetGradients().GetSparseGradient(0));
+    EXPECT_EQ(nullptr, lut1->GetGradients().GetSparseGradient(0));
+}
+
+
+// 閾値0で全エントリが勾配を受ければ密な更新と一致する
+TEST(SparseGradientTest, testSparseGradient_StochasticLutDense)
+{
+    int const input_node_size  = 16;
+    int const output_node_size = 8;
+    int const frame_size       = 16;
+
+    auto lut_dense  = bb::StochasticLutN<6, float>::Create(output_node_size);
+    auto lut_sparse = bb::StochasticLutN<6, float>::Create(output_node_size);
+    lut_dense->SendCommand("host_simd false");
+    lut_dense->SendCommand("host_only true");
+    lut_sparse->SendCommand("host_only true");
+    lut_sparse->SetSparseGradient(true, 0.0f);
+    EXPECT_TRUE(lut_sparse->IsSparseGradient());
+
+    bb::FrameBuffer x_buf(frame_size, {input_node_size}, BB_TYPE_FP32);
+    lut_dense->SetInputShape(x_buf.GetShape());
+    lut_sparse->SetInputShape(x_buf.GetShape());
+
+    auto opt_dense  = bb::OptimizerAdam<float>::Create();
+    auto opt_sparse = bb::OptimizerAdam<float>::Create();
+    opt_dense->SetVariables(lut_dense->GetParameters(), lut_dense->GetGradients());
+    opt_sparse->SetVariables(lut_sparse->GetParameters(), lut_sparse->GetGradients());
+
+    std::mt19937_64 mt(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for ( int loop = 0; loop < 3; ++loop ) {
+        bb::FrameBuffer dy_buf(frame_size, {output_node_size}, BB_TYPE_FP32);
+        for ( int frame = 0; frame < frame_size; ++frame ) {
+            for ( int node = 0; node < input_node_size; ++node ) {
+                x_buf.SetFP32(frame, node, dist(mt));
+            }
+            for ( int node = 0; node < output_node_size; ++node ) {
+                dy_buf.SetFP32(frame, node, dist(mt) - 0.5f);
+            }
+        }
+
+        lut_dense->Forward(x_buf);
+        lut_sparse->Forward(x_buf);
+        auto dx_dense  = lut_dense->Backward(dy_buf);
+        auto dx_sparse = lut_sparse->Backward(dy_buf);
+        for ( int frame = 0; frame < frame_size; ++frame ) {
+            for ( int node = 0; node < input_node_size; ++node ) {
+                EXPECT_NEAR(dx_dense.GetFP32(frame, node), dx_sparse.GetFP32(frame, node), 1.0e-5f);
+            }
+        }
+
+        opt_dense->Update();
+        opt_sparse->Update();
+
+        auto W_dense  = lut_dense->lock_W_const();
+        auto W_sparse = lut_sparse->lock_W_const();
+        for ( int node = 0; node < output_node_size; ++node ) {
+            for ( int i = 0; i < 64; ++i ) {
+                EXPECT_NEAR(W_dense(node, i), W_sparse(node, i), 1.0e-5f);
+            }
+        }
+    }
+}
+
+
+// バイナリモードでは一部のエントリだけが更新される
+TEST(SparseGradientTest, testSparseGradient_SparseLutBinary)
+{
+    int const input_node_size  = 32;
+    int const output_node_size = 16;
+    int const frame_size       = 4;
+
+    auto lut = bb::SparseLutN<6, float>::Create(output_node_size, false);
+    lut->SendCommand("binary true");
+    lut->SendCommand("host_only true");
+
+    bb::FrameBuffer x_buf(frame_size, {input_node_size}, BB_TYPE_FP32);
+    bb::FrameBuffer dy_buf(frame_size, {output_node_size}, BB_TYPE_FP32);
+    std::mt19937_64 mt(2);
+    for ( int frame = 0; frame < frame_size; ++frame ) {
+        for ( int node = 0; node < input_node_size; ++node ) {
+            x_buf.SetFP32(frame, node, (mt() & 1) ? 1.0f : 0.0f);
+        }
+        for ( int node = 0; node < output_node_size; ++node ) {
+            dy_buf.SetFP32(frame, node, 1.0f);
+        }
+    }
+
+    lut->SetInputShape(x_buf.GetShape());
+    std::vector<float> W0(output_node_size * 64);
+    {
+        auto W_ptr = lut->lock_W_const();
+        for ( int node = 0; node < output_node_size; ++node ) {
+            for ( int i = 0; i < 64; ++i ) {
+                W0[node * 64 + i] = W_ptr(node, i);
+            }
+        }
+    }
+
+    // Optimizer に渡した後から有効にしても反映される
+    auto opt = bb::OptimizerSgd<float>::Create(0.1f);
+    opt->SetVariables(lut->GetParameters(), lut->GetGradients());
+    lut->SendCommand("sparse_gradient true");
+    EXPECT_TRUE(lut->IsSparseGradient());
+    lut->SetSparseGradient(true, 0.2f);
+
+    lut->Forward(x_buf);
+    lut->Backward(dy_buf);
+
+    // bias=0.25 では距離dのエントリの勾配は (1/3)^d 倍なので距離1以内だけが残る
+    auto sparse = lut->GetGradients().GetSparseGradient(0);
+    ASSERT_NE(nullptr, sparse);
+    auto touched = sparse->GetTouchedSize();
+    EXPECT_GT(touched, 0);
+    EXPECT_LT(touched, output_node_size * 64);
+
+    std::vector<bool> is_touched(output_node_size * 64, false);
+    for ( int node = 0; node < output_node_size; ++node ) {
+        for ( auto i : sparse->GetTouched(node) ) {
+            is_touched[node * 64 + i] = true;
+        }
+    }
+
+    opt->Update();
+    EXPECT_EQ(0, sparse->GetTouchedSize());
+
+    {
+        auto W_ptr  = lut->lock_W_const();
+        auto dW_ptr = lut->lock_dW_const();
+        for ( int node = 0; node < output_node_size; ++node ) {
+            for ( int i = 0; i < 64; ++i ) {
+                EXPECT_EQ(0.0f, dW_ptr(node, i));
+                if ( !is_touched[node * 64 + i] ) {
+                    EXPECT_EQ(W0[node * 64 + i], W_ptr(node, i));
+                }
+            }
+        }
+    }
+
+    // 無効に戻せば密な更新になる
+    lut->SetSparseGradient(false);
+    EXPECT_EQ(nullptr, lut->GetGradients().GetSparseGradient(0));
+    lut->Forward(x_buf);
+    lut->Backward(dy_buf);
+    opt->Update();
+
+    int changed = 0;
+    {
+        auto W_ptr  = lut->lock_W_const();
+        for ( int node = 0; node < output_node_size; ++node ) {
+            for ( int i = 0; i < 64; ++i ) {
+                if ( !is_touched[node * 64 + i] && W0[node * 64 + i] != W_ptr(node, i) ) {
+                    ++changed;
+                }
+            }
+        }
+    }
+    EXPECT_GT(changed, 0);
+}
+
+
+// 遅延Adamは飛ばしたステップ分の m,v の減衰を補正する
+TEST(SparseGradientTest, testSparseGradient_LazyAdam)
+{
+    auto make_var = [](std::shared_ptr<bb::Tensor> t) {
+        bb::Variables v;
+        v.PushBack(t);
+        return v;
+    };
+
+    auto param_dense  = std::make_shared<bb::Tensor>(bb::indices_t({2, 1}), BB_TYPE_FP32);
+    auto grad_dense   = std::make_shared<bb::Tensor>(bb::indices_t({2, 1}), BB_TYPE_FP32);
+    auto param_sparse = std::make_shared<bb::Tensor>(bb::indices_t({2, 1}), BB_TYPE_FP32);
+    auto grad_sparse  = std::make_shared<bb::Tensor>(bb::indices_t({2, 1}), BB_TYPE_FP32);
+    *param_dense  = 0.5f;
+    *param_sparse = 0.5f;
+    *grad_dense   = 0.0f;
+    *grad_sparse  = 0.0f;
+
+    auto sg = std::make_shared<bb::SparseGradient>();
+    sg->Resize(1, 2);
+    sg->SetEnable(true);
+
+    auto opt_dense  = bb::OptimizerAdam<float>::Create(0.01f);
+    auto opt_sparse = bb::OptimizerAdam<float>::Create(0.01f);
+    opt_dense->SetVariables(make_var(param_dense), make_var(grad_dense));
+    bb::Variables grads_sparse;
+    grads_sparse.PushBack(grad_sparse, sg);
+    opt_sparse->SetVariables(make_var(param_sparse), grads_sparse);
+
+    // エントリ1はステップ1と3だけ勾配を受ける
+    float const g[3] = {0.3f, 0.0f, -0.2f};
+    float p_dense[3];
+    float p_sparse[3];
+    for ( int step = 0; step < 3; ++step ) {
+        {
+            auto gd = grad_dense->Lock<float>();
+            auto gs = grad_sparse->Lock<float>();
+            gd[1] = g[step];
+            if ( g[step] != 0.0f ) {
+                gs[1] = g[step];
+                sg->Touch(0, 1);
+            }
+        }
+        opt_dense->Update();
+        opt_sparse->Update();
+        p_dense[step]  = param_dense->Lock<float>()[1];
+        p_sparse[step] = param_sparse->Lock<float>()[1];
+        EXPECT_EQ(0.5f, param_sparse->Lock<float>()[0]);
+    }
+
+    EXPECT_NEAR(p_dense[0], p_sparse[0], 1.0e-6f);
+    EXPECT_EQ(p_sparse[0], p_sparse[1]);
+
+    // ステップ3の移動量は m,v が一致していれば同じになる
+    EXPECT_NEAR(p_dense[2] - p_dense[1], p_sparse[2] - p_sparse[1], 1.0e-6f);
+}
+
+
+// end of file
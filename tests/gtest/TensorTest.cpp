@@ -1620,3 +1620,24 @@ TEST(TensorTest, testTensorX_Operator)
     test_OperatorX<std::uint32_t>({1, 2, 3, 7});
 //    test_OperatorX<std::uint64_t>({1, 2, 3});
 }
+
+
+TEST(TensorTest, testTensor_DataArray)
+{
+    bb::Tensor t({3, 4, 5}, BB_TYPE_FP32);
+
+    std::vector<double> src(3 * 4 * 5);
+    for ( size_t i = 0; i < src.size(); ++i ) {
+        src[i] = (double)i + 0.25;
+    }
+    t.SetDataArray(src.data(), (bb::index_t)src.size());
+
+    auto data = t.GetData<float>();
+    for ( size_t i = 0; i < src.size(); ++i ) {
+        EXPECT_EQ((float)src[i], data[i]);
+    }
+
+    std::vector<float> dst(src.size());
+    t.GetDataArray(dst.data(), (bb::index_t)dst.size());
+    EXPECT_EQ(data, dst);
+}
@@ -0,0 +1,141 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include "gtest/gtest.h"
+
+#include "bb/ThreadPool.h"
+
+
+TEST(ThreadPoolTest, testThreadPool_ParallelFor)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+
+    pool.SetThreadSize(4);
+
+    std::vector<int> buf(1000, 0);
+    bb::ParallelFor(0, (bb::index_t)buf.size(), [&](bb::index_t i) {
+            buf[i] += (int)i;
+        });
+    for ( size_t i = 0; i < buf.size(); ++i ) {
+        EXPECT_EQ((int)i, buf[i]);
+    }
+
+    // grain より小さければ分割しない
+    std::atomic<int> chunk_count(0);
+    bb::ParallelForRange(0, 100, [&](bb::index_t begin, bb::index_t end) {
+            EXPECT_EQ(0,   begin);
+            EXPECT_EQ(100, end);
+            ++chunk_count;
+        }, 1000);
+    EXPECT_EQ(1, chunk_count.load());
+
+    // 範囲の分割
+    std::vector<int> hit(1001, 0);
+    chunk_count = 0;
+    bb::ParallelForRange(0, 1001, [&](bb::index_t begin, bb::index_t end) {
+            for ( bb::index_t i = begin; i < end; ++i ) {
+                hit[i]++;
+            }
+            ++chunk_count;
+        });
+    EXPECT_EQ(4, chunk_count.load());
+    for ( auto h : hit ) {
+        EXPECT_EQ(1, h);
+    }
+
+    pool.SetThreadSize(thread_size);
+}
+
+
+TEST(ThreadPoolTest, testThreadPool_Nested)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+
+    pool.SetThreadSize(3);
+
+    for ( auto policy : {bb::ThreadPool::NestedPolicy::Serial, bb::ThreadPool::NestedPolicy::Parallel} ) {
+        pool.SetNestedPolicy(policy);
+
+        std::vector<int> buf(30 * 40, 0);
+        bb::ParallelFor(0, 30, [&](bb::index_t y) {
+                bb::ParallelFor(0, 40, [&](bb::index_t x) {
+                        buf[y * 40 + x] = (int)(y * 100 + x);
+                    });
+            });
+        for ( int y = 0; y < 30; ++y ) {
+            for ( int x = 0; x < 40; ++x ) {
+                EXPECT_EQ(y * 100 + x, buf[y * 40 + x]);
+            }
+        }
+    }
+
+    pool.SetNestedPolicy(bb::ThreadPool::NestedPolicy::Serial);
+    pool.SetThreadSize(thread_size);
+}
+
+
+TEST(ThreadPoolTest, testThreadPool_TaskGroup)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+
+    pool.SetThreadSize(2);
+
+    std::atomic<int> sum(0);
+    bb::ThreadPool::TaskGroup group;
+    for ( int i = 1; i <= 100; ++i ) {
+        group.Run([&sum, i]() { sum += i; });
+    }
+    group.Wait();
+    EXPECT_EQ(5050, sum.load());
+
+    // 例外は Wait で再送出
+    group.Run([]() { throw std::runtime_error("error"); });
+    EXPECT_THROW(group.Wait(), std::runtime_error);
+
+    EXPECT_THROW(bb::ParallelFor(0, 10, [](bb::index_t i) {
+            if ( i == 7 ) { throw std::runtime_error("error"); }
+        }), std::runtime_error);
+
+    pool.SetThreadSize(thread_size);
+}
+
+
+TEST(ThreadPoolTest, testThreadPool_Reserve)
+{
+    auto &pool = bb::ThreadPool::GetInstance();
+    int thread_size = pool.GetThreadSize();
+
+    pool.SetThreadSize(4);
+    EXPECT_EQ(4, pool.GetActiveThreadSize());
+
+    {
+        bb::ThreadPool::ReserveScope reserve(2);
+        EXPECT_EQ(2, pool.GetActiveThreadSize());
+
+        // 休ませている間も結果は変わらない
+        std::vector<int> buf(1000, 0);
+        bb::ParallelFor(0, (bb::index_t)buf.size(), [&](bb::index_t i) { buf[i] += (int)i; });
+        for ( int i = 0; i < (int)buf.size(); ++i ) {
+            EXPECT_EQ(i, buf[i]);
+        }
+
+        // 予約が重なっても呼び出し元スレッドは残る
+        {
+            bb::ThreadPool::ReserveScope reserve2(5);
+            EXPECT_EQ(1, pool.GetActiveThreadSize());
+
+            std::atomic<int> sum(0);
+            bb::ParallelFor(0, 100, [&](bb::index_t i) { sum += (int)i; });
+            EXPECT_EQ(4950, sum.load());
+        }
+        EXPECT_EQ(2, pool.GetActiveThreadSize());
+    }
+    EXPECT_EQ(4, pool.GetActiveThreadSize());
+
+    pool.SetThreadSize(thread_size);
+}
@@ -0,0 +1,235 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include "gtest/gtest.h"
+
+#include "bb/VerilogSimulator.h"
+#include "bb/BinaryLutN.h"
+
+
+static void VerilogSimulatorTest_SetRandom(bb::FrameBuffer &x_buf, std::uint64_t seed)
+{
+    std::mt19937_64 mt(seed);
+    for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+        for ( bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node ) {
+            x_buf.SetBit(frame, node, (mt() & 1) != 0);
+        }
+    }
+}
+
+
+TEST(VerilogSimulatorTest, testVerilogSimulator_LutLayers)
+{
+    auto net = bb::Sequential::Create();
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(256, 1));
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(64,  2));
+    net->Add(bb::BinaryLutN<4, bb::Bit>::Create(16,  3));
+    net->SetInputShape({128});
+
+    auto sim = bb::VerilogSimulatorLutLayers::Create<bb::Bit>(net);
+    EXPECT_EQ(3, sim->GetLatency());
+
+    bb::FrameBuffer x_buf(301, {128}, BB_TYPE_BIT);
+    VerilogSimulatorTest_SetRandom(x_buf, 1);
+
+    EXPECT_EQ(0, bb::VerilogSimulator_Verify(net, sim, x_buf));
+    EXPECT_EQ(0, bb::VerilogSimulator_Verify(net, sim, x_buf, 0.3));
+    EXPECT_EQ(0, bb::VerilogSimulator_VerifyNetlist<bb::Bit>(net, bb::ExportVerilogConfig(), x_buf));
+
+    // valid はレイヤー数サイクル遅れて出る
+    std::vector<std::uint64_t> in_data(128, 0);
+    sim->Reset();
+    sim->Clock(in_data.data(), 0x5);
+    EXPECT_EQ(0u, sim->GetOutValid());
+    sim->Clock(in_data.data(), 0);
+    sim->Clock(in_data.data(), 0, nullptr, 0x1);   // レーン2 は cke 停止
+    EXPECT_EQ(0x1u, sim->GetOutValid());
+    sim->Clock(in_data.data(), 0);
+    EXPECT_EQ(0x4u, sim->GetOutValid());
+}
+
+
+TEST(VerilogSimulatorTest, testVerilogSimulator_Packing)
+{
+    auto net = bb::Sequential::Create();
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(256, 1));
+    net->Add(bb::BinaryLutN<4, bb::Bit>::Create(128, 2));
+    net->Add(bb::BinaryLutN<2, bb::Bit>::Create(64,  3));
+    net->Add(bb::BinaryLutN<2, bb::Bit>::Create(32,  4));
+    net->Add(bb::BinaryLutN<4, bb::Bit>::Create(8,   5));
+    net->SetInputShape({128});
+
+    bb::ExportVerilogConfig config;
+    config.register_interval = 2;
+    config.lut_packing       = true;
+
+    bb::ExportVerilogEstimate base_estimate;
+    bb::ExportVerilogEstimate pack_estimate;
+    std::stringstream ss_base;
+    std::stringstream ss_pack;
+    bb::ExportVerilog_LutLayers<bb::Bit>(ss_base, "lut_net", net, bb::ExportVerilogConfig(), &base_estimate);
+    bb::ExportVerilog_LutLayers<bb::Bit>(ss_pack, "lut_net", net, config, &pack_estimate);
+
+    // トップ + 3段 (2段目の BinaryLutN<2> の連鎖は1つの LUT にまとまる)
+    ASSERT_EQ(4, (int)pack_estimate.modules.size());
+    EXPECT_EQ(5, base_estimate.modules[0].latency);
+    EXPECT_EQ(3, pack_estimate.modules[0].latency);
+    EXPECT_EQ(256 + 128 + 64 + 32 + 8, base_estimate.modules[0].lut_count);
+    EXPECT_EQ(32, pack_estimate.modules[2].packed_nodes);
+    EXPECT_EQ(32, pack_estimate.modules[2].lut_count);
+    EXPECT_LT(pack_estimate.modules[0].lut_count, base_estimate.modules[0].lut_count);
+    EXPECT_LT(pack_estimate.modules[0].ff_count,  base_estimate.modules[0].ff_count);
+    EXPECT_NE(std::string::npos, ss_pack.str().find("(packed)"));
+
+    // まとめたネットリストも Forward と一致する
+    bb::FrameBuffer x_buf(200, {128}, BB_TYPE_BIT);
+    VerilogSimulatorTest_SetRandom(x_buf, 3);
+    EXPECT_EQ(0, bb::VerilogSimulator_VerifyNetlist<bb::Bit>(net, config, x_buf, 0.2));
+
+    // レジスタ段の間引きはレイテンシに反映される
+    auto sim = bb::VerilogSimulatorLutLayers::Create<bb::Bit>(net, config);
+    EXPECT_EQ(3, sim->GetLatency());
+}
+
+
+TEST(VerilogSimulatorTest, testVerilogSimulator_NetlistError)
+{
+    auto net = bb::Sequential::Create();
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(64, 1));
+    net->Add(bb::BinaryLutN<2, bb::Bit>::Create(32, 2));
+    net->Add(bb::BinaryLutN<2, bb::Bit>::Create(16, 3));
+    net->SetInputShape({64});
+
+    std::vector< std::shared_ptr< bb::LutLayer<bb::Bit, float> > > layers;
+    for ( int i = 0; i < net->GetSize(); ++i ) {
+        layers.push_back(std::dynamic_pointer_cast< bb::LutLayer<bb::Bit, float> >(net->Get(i)));
+    }
+
+    bb::ExportVerilogConfig config;
+    config.register_interval = 3;
+    config.lut_packing       = true;
+
+    std::vector<bb::VerilogSimulatorLutLayers::Netlist> netlists;
+    for ( auto const &stage : bb::ExportVerilog_SplitStages<bb::Bit, float>(layers, config.register_interval) ) {
+        netlists.push_back(bb::ExportVerilog_MakeLutStage<bb::Bit, float>(stage, config));
+    }
+    ASSERT_EQ(1, (int)netlists.size());
+
+    bb::FrameBuffer x_buf(256, {64}, BB_TYPE_BIT);
+    VerilogSimulatorTest_SetRandom(x_buf, 5);
+
+    auto sim = bb::VerilogSimulatorLutLayers::CreateFromNetlist(netlists, 64);
+    EXPECT_EQ(1, sim->GetLatency());
+    EXPECT_EQ(0, bb::VerilogSimulator_Verify(net, sim, x_buf));
+
+    // 出力ノードのテーブルを反転したネットリストは Forward との照合で検出される
+    auto err_netlists = netlists;
+    for ( auto &&v : err_netlists[0].back()[0].table ) {
+        v = !v;
+    }
+    auto err_sim = bb::VerilogSimulatorLutLayers::CreateFromNetlist(err_netlists, 64);
+    EXPECT_EQ(x_buf.GetFrameSize(), bb::VerilogSimulator_Verify(net, err_sim, x_buf));
+
+    // 使われている LUT の入力の並びを入れ替えたネットリストも検出される
+    auto swap_netlists = netlists;
+    for ( auto &n : swap_netlists[0][0] ) {
+        if ( n.used ) {
+            std::reverse(n.inputs.begin(), n.inputs.end());
+        }
+    }
+    auto swap_sim = bb::VerilogSimulatorLutLayers::CreateFromNetlist(swap_netlists, 64);
+    EXPECT_LT(0, bb::VerilogSimulator_Verify(net, swap_sim, x_buf));
+}
+
+
+TEST(VerilogSimulatorTest, testVerilogSimulator_LutCnn)
+{
+    for ( int border_mode : {BB_BORDER_CONSTANT, BB_BORDER_REFLECT_101} ) {
+        auto cnv0_net = bb::Sequential::Create();
+        cnv0_net->Add(bb::BinaryLutN<6, bb::Bit>::Create(36, 1));
+        cnv0_net->Add(bb::BinaryLutN<6, bb::Bit>::Create(6,  2));
+
+        auto cnv1_net = bb::Sequential::Create();
+        cnv1_net->Add(bb::BinaryLutN<6, bb::Bit>::Create(24, 3));
+        cnv1_net->Add(bb::BinaryLutN<6, bb::Bit>::Create(4,  4));
+
+        auto cnv0 = bb::LoweringConvolution<bb::Bit>::CreateEx(cnv0_net, 3, 3, 1, 1, "same", border_mode);
+        auto pol0 = bb::MaxPooling<bb::Bit>::Create(2, 2);
+        auto cnv1 = bb::LoweringConvolution<bb::Bit>::CreateEx(cnv1_net, 3, 3, 1, 1, "same", border_mode);
+
+        auto net = bb::Sequential::Create();
+        net->Add(cnv0);
+        net->Add(pol0);
+        net->Add(cnv1);
+        net->SetInputShape({8, 8, 2});
+
+        auto sim = bb::VerilogSimulatorLutCnn::Create<bb::Bit>({cnv0, pol0, cnv1});
+
+        bb::FrameBuffer x_buf(5, {8, 8, 2}, BB_TYPE_BIT);
+        VerilogSimulatorTest_SetRandom(x_buf, 2);
+
+        auto error = bb::VerilogSimulator_Verify(net, sim, x_buf, 0.1);
+        if ( border_mode == BB_BORDER_CONSTANT ) {
+            EXPECT_EQ(0, error);
+        }
+        else {
+            // 回路は定数0境界なので境界部の差異として検出される
+            EXPECT_GT(error, 0);
+        }
+    }
+}
+
+TEST(VerilogSimulatorTest, testVerilogSimulator_LutCnnConfig)
+{
+    auto cnv0_net = bb::Sequential::Create();
+    cnv0_net->Add(bb::BinaryLutN<2, bb::Bit>::Create(36, 1));
+    cnv0_net->Add(bb::BinaryLutN<2, bb::Bit>::Create(18, 2));
+    cnv0_net->Add(bb::BinaryLutN<6, bb::Bit>::Create(6,  3));
+
+    auto cnv1_net = bb::Sequential::Create();
+    cnv1_net->Add(bb::BinaryLutN<6, bb::Bit>::Create(24, 4));
+    cnv1_net->Add(bb::BinaryLutN<6, bb::Bit>::Create(4,  5));
+
+    auto cnv0 = bb::LoweringConvolution<bb::Bit>::CreateEx(cnv0_net, 3, 3, 1, 1, "same", BB_BORDER_CONSTANT);
+    auto pol0 = bb::MaxPooling<bb::Bit>::Create(2, 2);
+    auto cnv1 = bb::LoweringConvolution<bb::Bit>::CreateEx(cnv1_net, 3, 3, 1, 1, "same", BB_BORDER_CONSTANT);
+
+    auto net = bb::Sequential::Create();
+    net->Add(cnv0);
+    net->Add(pol0);
+    net->Add(cnv1);
+    net->SetInputShape({8, 8, 2});
+
+    bb::ExportVerilogConfig config;
+    config.register_interval = 2;
+    config.lut_packing       = true;
+
+    bb::ExportVerilogEstimate base_estimate;
+    bb::ExportVerilogEstimate pack_estimate;
+    std::stringstream ss_base;
+    std::stringstream ss_pack;
+    bb::ExportVerilog_LutCnnLayersAxi4s<bb::Bit>(ss_base, "cnn", {cnv0, pol0, cnv1}, bb::ExportVerilogConfig(), &base_estimate);
+    bb::ExportVerilog_LutCnnLayersAxi4s<bb::Bit>(ss_pack, "cnn", {cnv0, pol0, cnv1}, config, &pack_estimate);
+
+    // cnn, cnn_l0, cnn_l0_mlp + 2段, cnn_l2, cnn_l2_mlp + 1段 (MaxPooling は見積り対象外)
+    ASSERT_EQ(8, (int)pack_estimate.modules.size());
+    EXPECT_EQ("cnn",    pack_estimate.modules[0].name);
+    EXPECT_EQ("cnn_l0", pack_estimate.modules[1].name);
+    EXPECT_EQ("cnn_l2", pack_estimate.modules[5].name);
+    EXPECT_EQ(3 + 2, base_estimate.modules[0].latency);
+    EXPECT_EQ(2 + 1, pack_estimate.modules[0].latency);
+    EXPECT_EQ(2, pack_estimate.modules[1].latency);
+    EXPECT_EQ(36 + 18 + 6 + 24 + 4, base_estimate.modules[0].lut_count);
+    EXPECT_EQ(     18 + 6 + 24 + 4, pack_estimate.modules[0].lut_count);   // BinaryLutN<2> の連鎖は1つの LUT にまとまる
+    EXPECT_NE(std::string::npos, ss_pack.str().find("(packed)"));
+    EXPECT_NE(std::string::npos, ss_pack.str().find("module cnn_l0_mlp_sub1"));
+    EXPECT_EQ(std::string::npos, ss_pack.str().find("module cnn_l0_mlp_sub2"));
+
+    // レジスタ段を間引いた回路も Forward と一致する
+    auto sim = bb::VerilogSimulatorLutCnn::Create<bb::Bit>({cnv0, pol0, cnv1}, config);
+
+    bb::FrameBuffer x_buf(5, {8, 8, 2}, BB_TYPE_BIT);
+    VerilogSimulatorTest_SetRandom(x_buf, 4);
+    EXPECT_EQ(0, bb::VerilogSimulator_Verify(net, sim, x_buf, 0.1));
+}